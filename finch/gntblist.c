@@ -1017,6 +1017,8 @@ chat_components_edit_ok(PurpleChat *chat, PurpleRequestPage *page) {
 
 		g_object_unref(group);
 	}
+
+	purple_blist_update_chats_cache(chat);
 }
 
 static void
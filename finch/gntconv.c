@@ -158,6 +158,11 @@ entry_key_pressed(G_GNUC_UNUSED GntWidget *w, FinchConv *ggconv)
 		purple_conversation_send(ggconv->active_conv, escape);
 		g_free(escape);
 		purple_idle_touch();
+
+		/* Sending brings us back to the newest messages, so anything that
+		 * /older loaded doesn't need to stay in memory anymore.
+		 */
+		purple_conversation_release_older_messages(ggconv->active_conv);
 	}
 	gnt_entry_add_to_history(GNT_ENTRY(ggconv->entry), text);
 	gnt_entry_clear(GNT_ENTRY(ggconv->entry));
@@ -1258,6 +1263,101 @@ cmd_message_color(G_GNUC_UNUSED PurpleConversation *conv,
 	return PURPLE_CMD_RET_OK;
 }
 
+static void
+older_message_write(FinchConv *fc, PurpleMessage *message)
+{
+	GntTextView *tv = GNT_TEXT_VIEW(fc->tv);
+	const char *author = NULL;
+	char *newline = NULL, *strip = NULL;
+
+	gnt_text_view_append_text_with_flags(tv, "\n", GNT_TEXT_FLAG_NORMAL);
+
+	if (purple_prefs_get_bool("/finch/conversations/timestamps")) {
+		char *timestamp = purple_message_format_timestamp(message,
+		                                                  "(%H:%M:%S) ");
+
+		gnt_text_view_append_text_with_flags(tv, timestamp,
+		                                     gnt_color_pair(color_timestamp));
+		g_free(timestamp);
+	}
+
+	author = purple_message_get_author_alias(message);
+	if (author == NULL)
+		author = purple_message_get_author(message);
+	if (author != NULL) {
+		char *name = g_strdup_printf("%s: ", author);
+		gnt_text_view_append_text_with_flags(tv, name, GNT_TEXT_FLAG_DIM);
+		g_free(name);
+	}
+
+	newline = purple_strdup_withhtml(purple_message_get_contents(message));
+	strip = purple_markup_strip_html(newline);
+	gnt_text_view_append_text_with_flags(tv, strip, GNT_TEXT_FLAG_DIM);
+	g_free(newline);
+	g_free(strip);
+}
+
+static PurpleCmdRet
+older_command_cb(PurpleConversation *conv, G_GNUC_UNUSED const char *cmd,
+                 char **args, char **error, G_GNUC_UNUSED gpointer data)
+{
+	FinchConv *fc = FINCH_CONV(conv);
+	GListModel *messages = NULL;
+	GError *local_error = NULL;
+	char *header = NULL;
+	guint64 count = 20;
+	guint loaded = 0;
+
+	if (!fc)
+		return PURPLE_CMD_RET_FAILED;
+
+	if (args[0] != NULL &&
+	    !g_ascii_string_to_unsigned(args[0], 10, 1, G_MAXUINT, &count, NULL))
+	{
+		if (error)
+			*error = g_strdup_printf(_("%s is not a valid number of messages."), args[0]);
+		return PURPLE_CMD_RET_FAILED;
+	}
+
+	loaded = purple_conversation_load_older_messages(conv, count,
+	                                                 &local_error);
+	if (local_error != NULL) {
+		if (error)
+			*error = g_strdup(local_error->message);
+		g_clear_error(&local_error);
+		return PURPLE_CMD_RET_FAILED;
+	}
+
+	if (loaded == 0) {
+		purple_conversation_write_system_message(conv,
+			_("There are no older messages to show."),
+			PURPLE_MESSAGE_NO_LOG);
+		return PURPLE_CMD_RET_OK;
+	}
+
+	/* The text view can only append, so the older messages are shown as a
+	 * block below what is already there.
+	 */
+	header = g_strdup_printf(ngettext("\n--- %u older message ---",
+	                                  "\n--- %u older messages ---", loaded),
+	                         loaded);
+	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(fc->tv), header,
+	                                     GNT_TEXT_FLAG_BOLD);
+	g_free(header);
+
+	messages = purple_conversation_get_messages(conv);
+	for (guint i = 0; i < loaded; i++) {
+		PurpleMessage *message = g_list_model_get_item(messages, i);
+
+		older_message_write(fc, message);
+		g_object_unref(message);
+	}
+
+	gnt_text_view_scroll(GNT_TEXT_VIEW(fc->tv), 0);
+
+	return PURPLE_CMD_RET_OK;
+}
+
 static PurpleCmdRet
 users_command_cb(PurpleConversation *conv, G_GNUC_UNUSED const char *cmd,
                  G_GNUC_UNUSED char **args, G_GNUC_UNUSED char **error,
@@ -1321,6 +1421,9 @@ finch_conversation_init(void)
 	purple_cmd_register("users", "", PURPLE_CMD_P_DEFAULT,
 	                  PURPLE_CMD_FLAG_CHAT | PURPLE_CMD_FLAG_ALLOW_WRONG_ARGS, NULL,
 	                  users_command_cb, _("users:  Show the list of users in the chat."), NULL);
+	purple_cmd_register("older", "w", PURPLE_CMD_P_DEFAULT,
+	                  PURPLE_CMD_FLAG_CHAT | PURPLE_CMD_FLAG_IM | PURPLE_CMD_FLAG_ALLOW_WRONG_ARGS, NULL,
+	                  older_command_cb, _("older [&lt;count&gt;]:  Show up to count (default 20) older messages from the history. Sending a message lets them go again."), NULL);
 
 	/* Now some commands to bring up some other windows */
 	purple_cmd_register("plugins", "", PURPLE_CMD_P_DEFAULT,
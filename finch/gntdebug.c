@@ -37,6 +37,14 @@
 
 #define PREF_ROOT "/finch/debug"
 
+/* Messages are collected in debug.ring by the log writer, which may run on any
+ * thread, and are added to the window in batches at most this often.
+ */
+#define FINCH_DEBUG_FLUSH_INTERVAL (50)
+
+/* How many messages the debug window keeps by default. */
+#define FINCH_DEBUG_DEFAULT_MAX_LINES (5000)
+
 struct _FinchDebugUi
 {
 	GObject parent;
@@ -96,18 +104,39 @@ static struct
 	GntWidget *tview;
 	GntWidget *search;
 	gboolean paused;
+
+	PurpleDebugRing *ring;
+	guint64 cursor;
+	guint messages;
 } debug;
 
+static guint
+finch_debug_get_max_lines(void)
+{
+	int max_lines = purple_prefs_get_int(PREF_ROOT "/max_lines");
+
+	return max_lines > 0 ? (guint)max_lines : FINCH_DEBUG_DEFAULT_MAX_LINES;
+}
+
+static void
+update_debug_enabled(void)
+{
+	purple_debug_set_enabled(debug.window != NULL && !debug.paused);
+}
+
 static void
 reset_debug_win(G_GNUC_UNUSED GntWidget *w, G_GNUC_UNUSED gpointer data)
 {
 	debug.window = debug.tview = debug.search = NULL;
+	update_debug_enabled();
 }
 
 static void
 clear_debug_win(G_GNUC_UNUSED GntWidget *w, GntTextView *tv)
 {
 	gnt_text_view_clear(tv);
+	purple_debug_ring_clear(debug.ring);
+	debug.messages = 0;
 }
 
 static void
@@ -120,36 +149,18 @@ static void
 toggle_pause(G_GNUC_UNUSED GntWidget *w, G_GNUC_UNUSED gpointer n)
 {
 	debug.paused = !debug.paused;
+	update_debug_enabled();
 }
 
-static GLogWriterOutput
-finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
-                          gsize n_fields, G_GNUC_UNUSED gpointer user_data)
+static void
+finch_debug_append(GDateTime *timestamp, PurpleDebugLevel level,
+                   const gchar *domain, const gchar *msg,
+                   G_GNUC_UNUSED gpointer data)
 {
-	const gchar *domain = NULL;
-	const gchar *msg = NULL;
 	const gchar *search_str = NULL;
-	gint pos = 0;
 	GntTextFormatFlags flag = 0;
-	GDateTime *local_date_time = NULL;
 	gchar *local_time = NULL;
-	gsize i;
 
-	if (debug.window == NULL || debug.paused) {
-		return G_LOG_WRITER_UNHANDLED;
-	}
-
-	for (i = 0; i < n_fields; i++) {
-		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
-			domain = fields[i].value;
-		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
-			msg = fields[i].value;
-		}
-	}
-
-	if (msg == NULL) {
-		return G_LOG_WRITER_UNHANDLED;
-	}
 	if (domain == NULL) {
 		domain = "g_log";
 	}
@@ -161,16 +172,11 @@ finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
 		if (g_strrstr(domain, search_str) == NULL &&
 		    g_strrstr(msg, search_str) == NULL)
 		{
-			return G_LOG_WRITER_UNHANDLED;
+			return;
 		}
 	}
 
-	pos = gnt_text_view_get_lines_below(GNT_TEXT_VIEW(debug.tview));
-
-	local_date_time = g_date_time_new_now_local();
-	local_time = g_date_time_format(local_date_time, "%H:%M:%S ");
-	g_date_time_unref(local_date_time);
-
+	local_time = g_date_time_format(timestamp, "%H:%M:%S ");
 	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(debug.tview), local_time,
 	                                     GNT_TEXT_FLAG_NORMAL);
 	g_free(local_time);
@@ -181,11 +187,11 @@ finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
 	                                     GNT_TEXT_FLAG_BOLD);
 
 	flag = GNT_TEXT_FLAG_NORMAL;
-	switch (log_level & G_LOG_LEVEL_MASK) {
-		case G_LOG_LEVEL_WARNING:
+	switch (level) {
+		case PURPLE_DEBUG_WARNING:
 			flag |= GNT_TEXT_FLAG_UNDERLINE;
 			/* fallthrough */
-		case G_LOG_LEVEL_ERROR:
+		case PURPLE_DEBUG_FATAL:
 			flag |= GNT_TEXT_FLAG_BOLD;
 			break;
 		default:
@@ -196,10 +202,99 @@ finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
 	                                     flag);
 	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(debug.tview), "\n",
 	                                     GNT_TEXT_FLAG_NORMAL);
+}
+
+static gboolean
+finch_debug_flush_cb(G_GNUC_UNUSED gpointer data)
+{
+	guint max_lines = 0;
+	gint pos = 0;
+
+	if (debug.ring == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
+	if (debug.window == NULL) {
+		/* The window was closed after these messages were sent. */
+		purple_debug_ring_clear(debug.ring);
+		return G_SOURCE_REMOVE;
+	}
+
+	pos = gnt_text_view_get_lines_below(GNT_TEXT_VIEW(debug.tview));
+
+	debug.messages += purple_debug_ring_read(debug.ring, &debug.cursor,
+	                                         finch_debug_append, NULL);
+
+	/* GntTextView can't drop lines from the top, so once it holds twice the
+	 * retention cap, start over with just what the ring still has.
+	 */
+	max_lines = finch_debug_get_max_lines();
+	if (debug.messages > 2 * max_lines) {
+		guint64 cursor = 0;
+
+		gnt_text_view_clear(GNT_TEXT_VIEW(debug.tview));
+		debug.messages = purple_debug_ring_read(debug.ring, &cursor,
+		                                        finch_debug_append, NULL);
+	}
+
 	if (pos <= 1) {
 		gnt_text_view_scroll(GNT_TEXT_VIEW(debug.tview), 0);
 	}
 
+	return G_SOURCE_REMOVE;
+}
+
+static GLogWriterOutput
+finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
+                          gsize n_fields, G_GNUC_UNUSED gpointer user_data)
+{
+	PurpleDebugLevel level = PURPLE_DEBUG_MISC;
+	PurpleDebugRing *ring = NULL;
+	const gchar *domain = NULL;
+	const gchar *msg = NULL;
+	gsize i;
+
+	/* The ring is gone once finch_debug_uninit has run. */
+	ring = g_atomic_pointer_get(&debug.ring);
+	if (debug.window == NULL || debug.paused || ring == NULL) {
+		return G_LOG_WRITER_UNHANDLED;
+	}
+
+	for (i = 0; i < n_fields; i++) {
+		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
+			domain = fields[i].value;
+		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
+			msg = fields[i].value;
+		}
+	}
+
+	if (msg == NULL) {
+		return G_LOG_WRITER_UNHANDLED;
+	}
+
+	switch (log_level & G_LOG_LEVEL_MASK) {
+		case G_LOG_LEVEL_ERROR:
+			level = PURPLE_DEBUG_FATAL;
+			break;
+		case G_LOG_LEVEL_CRITICAL:
+			level = PURPLE_DEBUG_ERROR;
+			break;
+		case G_LOG_LEVEL_WARNING:
+			level = PURPLE_DEBUG_WARNING;
+			break;
+		case G_LOG_LEVEL_MESSAGE:
+			level = PURPLE_DEBUG_INFO;
+			break;
+		default:
+			level = PURPLE_DEBUG_MISC;
+			break;
+	}
+
+	/* Only the first message of a batch schedules the flush. */
+	if (purple_debug_ring_push(ring, level, domain, msg)) {
+		g_timeout_add(FINCH_DEBUG_FLUSH_INTERVAL, finch_debug_flush_cb, NULL);
+	}
+
 	return G_LOG_WRITER_HANDLED;
 }
 
@@ -272,10 +367,16 @@ finch_debug_window_show(void)
 
 	debug.paused = FALSE;
 	if (debug.window) {
+		update_debug_enabled();
 		gnt_window_present(debug.window);
 		return;
 	}
 
+	/* Don't replay whatever was left over from the last window. */
+	purple_debug_ring_set_capacity(debug.ring, finch_debug_get_max_lines());
+	purple_debug_ring_clear(debug.ring);
+	debug.messages = 0;
+
 	debug.window = gnt_vbox_new(FALSE);
 	gnt_box_set_toplevel(GNT_BOX(debug.window), TRUE);
 	gnt_box_set_title(GNT_BOX(debug.window), _("Debug Window"));
@@ -331,11 +432,18 @@ finch_debug_window_show(void)
 	gnt_text_view_attach_pager_widget(GNT_TEXT_VIEW(debug.tview), debug.window);
 
 	gnt_widget_show(debug.window);
+
+	update_debug_enabled();
 }
 
 void
 finch_debug_init_handler(void)
 {
+	/* This is called before the preferences are loaded, so the ring is sized
+	 * when the window is shown.
+	 */
+	debug.ring = purple_debug_ring_new(FINCH_DEBUG_DEFAULT_MAX_LINES);
+
 	g_log_set_writer_func(finch_debug_g_log_handler, NULL, NULL);
 }
 
@@ -347,6 +455,7 @@ finch_debug_init(void)
 
 	purple_prefs_add_none(PREF_ROOT);
 	purple_prefs_add_string(PREF_ROOT "/filter", "");
+	purple_prefs_add_int(PREF_ROOT "/max_lines", FINCH_DEBUG_DEFAULT_MAX_LINES);
 	purple_prefs_add_none(PREF_ROOT "/size");
 	purple_prefs_add_int(PREF_ROOT "/size/width", 60);
 	purple_prefs_add_int(PREF_ROOT "/size/height", 15);
@@ -356,4 +465,9 @@ void
 finch_debug_uninit(void)
 {
 	handle_fprintf_stderr(TRUE);
+
+	/* GLib doesn't let us remove the log writer, so take the ring away from
+	 * it before freeing it.
+	 */
+	purple_debug_ring_free(g_atomic_pointer_exchange(&debug.ring, NULL));
 }
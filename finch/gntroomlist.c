@@ -289,6 +289,34 @@ fl_destroy(G_GNUC_UNUSED gpointer data, GObject *list)
 	}
 }
 
+static void
+fl_items_changed(GListModel *model, guint position, G_GNUC_UNUSED guint removed,
+                 guint added, G_GNUC_UNUSED gpointer data)
+{
+	GntTree *tree = NULL;
+
+	if (!froomlist.window || G_OBJECT(froomlist.roomlist) != G_OBJECT(model))
+		return;
+
+	tree = GNT_TREE(froomlist.tree);
+
+	/* Rooms arrive in batches, so only redraw once per batch. */
+	for (guint i = position; i < position + added; i++) {
+		PurpleRoomlistRoom *room = g_list_model_get_item(model, i);
+
+		gnt_tree_remove(tree, room);
+		gnt_tree_add_row_after(tree, room,
+				gnt_tree_create_row(tree,
+					purple_roomlist_room_get_name(room), ""),
+			NULL, NULL);
+		gnt_tree_set_expanded(tree, room, TRUE);
+
+		g_object_unref(room);
+	}
+
+	gnt_widget_draw(froomlist.tree);
+}
+
 static void
 fl_create(PurpleRoomlist *list)
 {
@@ -296,33 +324,20 @@ fl_create(PurpleRoomlist *list)
 	g_object_weak_ref(G_OBJECT(list), (GWeakNotify)fl_destroy, NULL);
 	setup_roomlist(NULL);
 	g_set_object(&froomlist.roomlist, list);
-}
 
-static void
-fl_set_fields(G_GNUC_UNUSED PurpleRoomlist *list, G_GNUC_UNUSED GList *fields)
-{
+	g_signal_connect(list, "items-changed", G_CALLBACK(fl_items_changed),
+	                 NULL);
 }
 
 static void
-fl_add_room(PurpleRoomlist *roomlist, PurpleRoomlistRoom *room)
+fl_set_fields(G_GNUC_UNUSED PurpleRoomlist *list, G_GNUC_UNUSED GList *fields)
 {
-	gchar *category = NULL;
-	if (froomlist.roomlist != roomlist)
-		return;
-
-	gnt_tree_remove(GNT_TREE(froomlist.tree), room);
-	gnt_tree_add_row_after(GNT_TREE(froomlist.tree), room,
-			gnt_tree_create_row(GNT_TREE(froomlist.tree),
-				purple_roomlist_room_get_name(room), ""),
-		NULL, NULL);
-	gnt_tree_set_expanded(GNT_TREE(froomlist.tree), room, category == NULL);
 }
 
 static PurpleRoomlistUiOps ui_ops = {
 	.show_with_account = fl_show_with_account,
 	.create = fl_create,
 	.set_fields = fl_set_fields,
-	.add_room = fl_add_room,
 };
 
 PurpleRoomlistUiOps *finch_roomlist_get_ui_ops(void)
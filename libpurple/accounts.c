@@ -26,6 +26,7 @@
 #include "debug.h"
 #include "network.h"
 #include "purpleaccountmanager.h"
+#include "purpleconfigjournal.h"
 #include "purpleconversationmanager.h"
 #include "purplecredentialmanager.h"
 #include "purpleenums.h"
@@ -33,6 +34,7 @@
 
 static guint    save_timer = 0;
 static gboolean accounts_loaded = FALSE;
+static PurpleConfigJournal *accounts_journal = NULL;
 
 static void
 purple_accounts_network_changed_cb(G_GNUC_UNUSED GNetworkMonitor *m,
@@ -69,11 +71,49 @@ accounts_to_xmlnode(void)
 	return node;
 }
 
+/* Each account is stored on its own, so only the ones that changed are
+ * written. */
+static gchar *
+accounts_journal_key(PurpleXmlNode *node, guint depth, gboolean *container)
+{
+	PurpleXmlNode *child = NULL;
+	gchar *id = NULL, *protocol = NULL, *name = NULL, *key = NULL;
+
+	if (depth == 0) {
+		*container = TRUE;
+		return g_strdup(node->name);
+	}
+
+	child = purple_xmlnode_get_child(node, "id");
+	if (child != NULL) {
+		id = purple_xmlnode_get_data(child);
+		if (id != NULL) {
+			return id;
+		}
+	}
+
+	child = purple_xmlnode_get_child(node, "protocol");
+	if (child != NULL) {
+		protocol = purple_xmlnode_get_data(child);
+	}
+	child = purple_xmlnode_get_child(node, "name");
+	if (child != NULL) {
+		name = purple_xmlnode_get_data(child);
+	}
+
+	key = g_strdup_printf("%s:%s", protocol ? protocol : "",
+	                      name ? name : "");
+
+	g_free(protocol);
+	g_free(name);
+
+	return key;
+}
+
 static void
 sync_accounts(void)
 {
 	PurpleXmlNode *node;
-	char *data;
 
 	if (!accounts_loaded)
 	{
@@ -83,9 +123,8 @@ sync_accounts(void)
 	}
 
 	node = accounts_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("accounts.xml", data, -1);
-	g_free(data);
+	purple_config_journal_replace(accounts_journal, NULL, node);
+	purple_config_journal_save(accounts_journal);
 	purple_xmlnode_free(node);
 }
 
@@ -431,33 +470,42 @@ parse_account(PurpleXmlNode *node)
 	return ret;
 }
 
+static void
+load_account_node(PurpleXmlNode *node, gpointer data) {
+	PurpleAccountManager *manager = data;
+	PurpleAccount *new_acct = NULL;
+
+	/* The root element is passed in too, but only its children matter. */
+	if(node->parent == NULL || !purple_strequal(node->name, "account")) {
+		return;
+	}
+
+	new_acct = parse_account(node);
+
+	purple_account_manager_add(manager, new_acct);
+	g_clear_object(&new_acct);
+}
+
 static void
 load_accounts(void) {
 	PurpleAccountManager *manager = NULL;
-	PurpleXmlNode *node, *child;
 
 	accounts_loaded = TRUE;
 
-	node = purple_util_read_xml_from_config_file("accounts.xml", _("accounts"));
-
-	if(node == NULL) {
-		return;
-	}
+	accounts_journal = purple_config_journal_new("accounts.xml",
+	                                             accounts_journal_key);
+	purple_config_journal_recover(accounts_journal);
 
 	manager = purple_account_manager_get_default();
 
-	for(child = purple_xmlnode_get_child(node, "account"); child != NULL;
-	    child = purple_xmlnode_get_next_twin(child))
+	/* Each account is parsed and added as soon as it has been read. */
+	if(!purple_util_stream_xml_from_config_file("accounts.xml",
+	                                            _("accounts"), 1,
+	                                            load_account_node, manager))
 	{
-		PurpleAccount *new_acct;
-		new_acct = parse_account(child);
-
-		purple_account_manager_add(manager, new_acct);
-		g_clear_object(&new_acct);
+		return;
 	}
 
-	purple_xmlnode_free(node);
-
 	_purple_buddy_icons_account_loaded_cb();
 }
 
@@ -685,6 +733,8 @@ purple_accounts_uninit(void)
 		sync_accounts();
 	}
 
+	g_clear_pointer(&accounts_journal, purple_config_journal_free);
+
 	purple_signals_disconnect_by_handle(handle);
 	purple_signals_unregister_by_instance(handle);
 }
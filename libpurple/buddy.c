@@ -729,7 +729,7 @@ purple_buddy_update_status(PurpleBuddy *buddy, PurpleStatus *old_status) {
 	 */
 	purple_meta_contact_invalidate_priority_buddy(purple_buddy_get_contact(buddy));
 
-	purple_blist_update_node(blist, PURPLE_BLIST_NODE(buddy));
+	purple_blist_queue_update_node(blist, PURPLE_BLIST_NODE(buddy));
 }
 
 PurpleMediaCaps
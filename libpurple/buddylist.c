@@ -29,6 +29,7 @@
 #include "notify.h"
 #include "prefs.h"
 #include "purpleaccountmanager.h"
+#include "purpleconfigjournal.h"
 #include "purpleprivate.h"
 #include "purpleprotocol.h"
 #include "purpleprotocolchat.h"
@@ -63,10 +64,61 @@ static GHashTable *buddies_cache = NULL;
  */
 static GHashTable *groups_cache = NULL;
 
+/*
+ * A hash table used for efficient lookups of chats by name.
+ * PurpleAccount* => PurpleBlistChatIndex*. An account's index is built the
+ * first time purple_blist_find_chat() is called for it while it is connected,
+ * and kept up to date from then on.
+ */
+static GHashTable *chats_cache = NULL;
+
+typedef struct {
+	/* The component that holds the name of a chat. */
+	gchar *identifier;
+
+	/* normalized name => GQueue* of PurpleChat*, oldest first. */
+	GHashTable *names;
+
+	/* PurpleChat* => the key it is stored under in names. */
+	GHashTable *chats;
+} PurpleBlistChatIndex;
+
 static guint          save_timer = 0;
 static gboolean       blist_loaded = FALSE;
 static gchar *localized_default_group_name = NULL;
 
+/* The longest a queued UI update may be deferred, in milliseconds. */
+#define PURPLE_BLIST_UPDATE_INTERVAL 100
+
+/*
+ * Nodes whose UI update has been deferred by purple_blist_queue_update_node(),
+ * holding a reference to each. They are all updated when update_timer fires.
+ * The property notifications of a pending buddy's presence are frozen until
+ * then as well.
+ */
+static GHashTable *pending_updates = NULL;
+static guint update_timer = 0;
+
+/*
+ * What has changed since blist.xml was last synced. Each set holds a reference
+ * to its nodes.
+ *
+ * dirty_nodes holds contacts and chats that need to be written, dirty_groups
+ * holds groups whose name or settings changed, and reordered_groups holds
+ * groups that had children removed or moved. group_keys maps each group to
+ * the key it was last written with, so a renamed group can be found, and
+ * node_keys does the same for contacts and chats, whose keys can also change
+ * when a sibling with the same key comes or goes.
+ */
+static PurpleConfigJournal *blist_journal = NULL;
+static GHashTable *dirty_nodes = NULL;
+static GHashTable *dirty_groups = NULL;
+static GHashTable *reordered_groups = NULL;
+static GHashTable *group_keys = NULL;
+static GHashTable *node_keys = NULL;
+static gboolean blist_reordered = FALSE;
+static gboolean blist_full_sync = FALSE;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
@@ -155,6 +207,127 @@ static void
 purple_blist_buddies_cache_remove_account(const PurpleAccount *account)
 {
 	g_hash_table_remove(buddies_cache, account);
+	g_hash_table_remove(chats_cache, account);
+}
+
+static void
+purple_blist_chat_index_free(PurpleBlistChatIndex *index)
+{
+	g_hash_table_destroy(index->chats);
+	g_hash_table_destroy(index->names);
+	g_free(index->identifier);
+	g_free(index);
+}
+
+static void
+purple_blist_chat_index_add(PurpleBlistChatIndex *index, PurpleChat *chat)
+{
+	const char *name, *normname;
+	gchar *key = NULL;
+	GQueue *queue = NULL;
+
+	if (g_hash_table_contains(index->chats, chat))
+		return;
+
+	name = g_hash_table_lookup(purple_chat_get_components(chat),
+	                           index->identifier);
+	if (name == NULL)
+		return;
+
+	normname = purple_normalize(purple_chat_get_account(chat), name);
+	if (!g_hash_table_lookup_extended(index->names, normname,
+	                                  (gpointer *)&key, (gpointer *)&queue)) {
+		key = g_strdup(normname);
+		queue = g_queue_new();
+		g_hash_table_insert(index->names, key, queue);
+	}
+
+	g_queue_push_tail(queue, chat);
+	g_hash_table_insert(index->chats, chat, key);
+}
+
+static void
+purple_blist_chat_index_remove(PurpleBlistChatIndex *index, PurpleChat *chat)
+{
+	const gchar *key = g_hash_table_lookup(index->chats, chat);
+	GQueue *queue;
+
+	if (key == NULL)
+		return;
+
+	queue = g_hash_table_lookup(index->names, key);
+	g_queue_remove(queue, chat);
+	g_hash_table_remove(index->chats, chat);
+
+	/* This frees key, so it has to come last. */
+	if (g_queue_is_empty(queue))
+		g_hash_table_remove(index->names, key);
+}
+
+/* Returns the index of a connected account, building it if needed. */
+static PurpleBlistChatIndex *
+purple_blist_chats_cache_get(PurpleAccount *account)
+{
+	PurpleBlistChatIndex *index;
+	PurpleProtocol *protocol;
+	PurpleProtocolChatEntry *pce;
+	PurpleBlistNode *node, *group;
+	GList *parts;
+
+	index = g_hash_table_lookup(chats_cache, account);
+	if (index != NULL)
+		return index;
+
+	protocol = purple_account_get_protocol(account);
+	if (!PURPLE_PROTOCOL_IMPLEMENTS(protocol, CHAT, info))
+		return NULL;
+
+	parts = purple_protocol_chat_info(PURPLE_PROTOCOL_CHAT(protocol),
+		purple_account_get_connection(account));
+	if (parts == NULL)
+		return NULL;
+
+	pce = parts->data;
+
+	index = g_new0(PurpleBlistChatIndex, 1);
+	index->identifier = g_strdup(pce->identifier);
+	index->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                     (GDestroyNotify)g_queue_free);
+	index->chats = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_list_free_full(parts, g_free);
+
+	for (group = purple_blist_get_default_root(); group != NULL;
+	     group = group->next) {
+		for (node = group->child; node != NULL; node = node->next) {
+			if (PURPLE_IS_CHAT(node) &&
+			    purple_chat_get_account(PURPLE_CHAT(node)) == account)
+				purple_blist_chat_index_add(index, PURPLE_CHAT(node));
+		}
+	}
+
+	g_hash_table_insert(chats_cache, account, index);
+
+	return index;
+}
+
+static void
+purple_blist_chats_cache_add(PurpleChat *chat)
+{
+	PurpleBlistChatIndex *index = g_hash_table_lookup(chats_cache,
+		purple_chat_get_account(chat));
+
+	if (index != NULL)
+		purple_blist_chat_index_add(index, chat);
+}
+
+static void
+purple_blist_chats_cache_remove(PurpleChat *chat)
+{
+	PurpleBlistChatIndex *index = g_hash_table_lookup(chats_cache,
+		purple_chat_get_account(chat));
+
+	if (index != NULL)
+		purple_blist_chat_index_remove(index, chat);
 }
 
 static void
@@ -318,20 +491,31 @@ chat_to_xmlnode(PurpleChat *chat)
 	return node;
 }
 
+/* Unlike purple_blist_get_default_group(), this doesn't create the group,
+ * which would change the list while it's being saved. */
+static gboolean
+blist_is_default_group(PurpleGroup *group)
+{
+	return group == purple_blist_find_group(PURPLE_BLIST_DEFAULT_GROUP_NAME);
+}
+
 static PurpleXmlNode *
-group_to_xmlnode(PurpleGroup *group)
+group_to_xmlnode(PurpleGroup *group, gboolean children)
 {
 	PurpleXmlNode *node, *child;
 	PurpleBlistNode *cnode;
 
 	node = purple_xmlnode_new("group");
-	if (group != purple_blist_get_default_group())
+	if (!blist_is_default_group(group))
 		purple_xmlnode_set_attrib(node, "name", purple_group_get_name(group));
 
 	/* Write settings */
 	g_hash_table_foreach(purple_blist_node_get_settings(PURPLE_BLIST_NODE(group)),
 			value_to_xmlnode, node);
 
+	if (!children)
+		return node;
+
 	/* Write contacts and chats */
 	for (cnode = PURPLE_BLIST_NODE(group)->child; cnode != NULL; cnode = cnode->next)
 	{
@@ -353,7 +537,7 @@ group_to_xmlnode(PurpleGroup *group)
 }
 
 static PurpleXmlNode *
-blist_to_xmlnode(void) {
+blist_to_xmlnode(gboolean groups) {
 	PurpleXmlNode *node, *child, *grandchild;
 	PurpleBlistNode *gnode;
 	const gchar *localized_default;
@@ -372,13 +556,16 @@ blist_to_xmlnode(void) {
 			"localized-default-group", localized_default);
 	}
 
+	if (!groups)
+		return node;
+
 	for (gnode = purple_blist_get_default_root(); gnode != NULL;
 	     gnode = gnode->next) {
 		if (purple_blist_node_is_transient(gnode))
 			continue;
 		if (PURPLE_IS_GROUP(gnode))
 		{
-			grandchild = group_to_xmlnode(PURPLE_GROUP(gnode));
+			grandchild = group_to_xmlnode(PURPLE_GROUP(gnode), TRUE);
 			purple_xmlnode_insert_child(child, grandchild);
 		}
 	}
@@ -386,12 +573,417 @@ blist_to_xmlnode(void) {
 	return node;
 }
 
+/*
+ * Keys for blist.xml. Groups are keyed by name and contacts by their first
+ * buddy, while chats are keyed by their components. The same keys must come
+ * out of the file and out of the nodes in memory. Contacts and chats in the
+ * same group can end up with the same key, in which case the journal adds a
+ * suffix in order, and blist_group_child_keys() does the same.
+ */
+static gchar *
+blist_group_key_build(const gchar *name)
+{
+	return g_strconcat("group:", name, NULL);
+}
+
+static gchar *
+blist_contact_key_build(const gchar *protocol, const gchar *account,
+                        const gchar *name)
+{
+	return g_strjoin("\x1f", "contact", protocol ? protocol : "",
+	                 account ? account : "", name ? name : "", NULL);
+}
+
+static gchar *
+blist_chat_key_build(const gchar *protocol, const gchar *account,
+                     GHashTable *components)
+{
+	GString *key = g_string_new("chat");
+	GList *names = NULL;
+
+	g_string_append_printf(key, "\x1f%s\x1f%s", protocol ? protocol : "",
+	                       account ? account : "");
+
+	names = g_list_sort(g_hash_table_get_keys(components),
+	                    (GCompareFunc)g_strcmp0);
+	for (GList *l = names; l != NULL; l = l->next) {
+		const gchar *value = g_hash_table_lookup(components, l->data);
+
+		if (value != NULL) {
+			g_string_append_printf(key, "\x1f%s=%s", (gchar *)l->data,
+			                       value);
+		}
+	}
+	g_list_free(names);
+
+	return g_string_free(key, FALSE);
+}
+
+static gchar *
+blist_journal_key(PurpleXmlNode *node, guint depth, gboolean *container)
+{
+	PurpleXmlNode *child = NULL;
+	gchar *key = NULL;
+
+	switch (depth) {
+		case 0:
+			*container = TRUE;
+			return g_strdup(node->name);
+		case 1:
+			*container = purple_strequal(node->name, "blist");
+			return g_strdup(node->name);
+		case 2:
+			if (!purple_strequal(node->name, "group"))
+				return NULL;
+			*container = TRUE;
+			return blist_group_key_build(
+				purple_xmlnode_get_attrib(node, "name"));
+		case 3:
+			break;
+		default:
+			return NULL;
+	}
+
+	if (purple_strequal(node->name, "contact") ||
+	    purple_strequal(node->name, "person"))
+	{
+		PurpleXmlNode *name_node = NULL;
+		gchar *name = NULL;
+
+		child = purple_xmlnode_get_child(node, "buddy");
+		if (child == NULL)
+			return blist_contact_key_build(NULL, NULL, NULL);
+
+		name_node = purple_xmlnode_get_child(child, "name");
+		if (name_node != NULL)
+			name = purple_xmlnode_get_data(name_node);
+		key = blist_contact_key_build(
+			purple_xmlnode_get_attrib(child, "proto"),
+			purple_xmlnode_get_attrib(child, "account"), name);
+		g_free(name);
+	} else if (purple_strequal(node->name, "chat")) {
+		GHashTable *components = g_hash_table_new_full(g_str_hash,
+		                                               g_str_equal, NULL,
+		                                               g_free);
+
+		for (child = purple_xmlnode_get_child(node, "component");
+		     child != NULL; child = purple_xmlnode_get_next_twin(child))
+		{
+			const gchar *name = purple_xmlnode_get_attrib(child, "name");
+
+			if (name != NULL) {
+				g_hash_table_insert(components, (gpointer)name,
+				                    purple_xmlnode_get_data(child));
+			}
+		}
+
+		key = blist_chat_key_build(purple_xmlnode_get_attrib(node, "proto"),
+		                           purple_xmlnode_get_attrib(node, "account"),
+		                           components);
+		g_hash_table_destroy(components);
+	}
+
+	return key;
+}
+
+static gchar *
+blist_group_key(PurpleGroup *group)
+{
+	if (blist_is_default_group(group))
+		return blist_group_key_build(NULL);
+
+	return blist_group_key_build(purple_group_get_name(group));
+}
+
+static gchar *
+blist_node_key(PurpleBlistNode *node)
+{
+	if (PURPLE_IS_META_CONTACT(node)) {
+		PurpleBlistNode *bnode;
+
+		for (bnode = node->child; bnode != NULL; bnode = bnode->next) {
+			PurpleBuddy *buddy = PURPLE_BUDDY(bnode);
+			PurpleAccount *account = NULL;
+
+			if (purple_blist_node_is_transient(bnode))
+				continue;
+
+			account = purple_buddy_get_account(buddy);
+			return blist_contact_key_build(
+				purple_account_get_protocol_id(account),
+				purple_contact_info_get_username(PURPLE_CONTACT_INFO(account)),
+				purple_buddy_get_name(buddy));
+		}
+
+		return blist_contact_key_build(NULL, NULL, NULL);
+	} else if (PURPLE_IS_CHAT(node)) {
+		PurpleChat *chat = PURPLE_CHAT(node);
+		PurpleAccount *account = purple_chat_get_account(chat);
+
+		return blist_chat_key_build(
+			purple_account_get_protocol_id(account),
+			purple_contact_info_get_username(PURPLE_CONTACT_INFO(account)),
+			purple_chat_get_components(chat));
+	}
+
+	return NULL;
+}
+
+static const gchar *
+blist_group_get_key(PurpleGroup *group)
+{
+	gchar *key = g_hash_table_lookup(group_keys, group);
+
+	if (key == NULL) {
+		key = blist_group_key(group);
+		g_hash_table_insert(group_keys, group, key);
+	}
+
+	return key;
+}
+
 static void
-purple_blist_sync(void)
+blist_set_add(GHashTable *set, gpointer node)
+{
+	if (!g_hash_table_contains(set, node))
+		g_hash_table_add(set, g_object_ref(node));
+}
+
+/* Drops a queued update for a node that is being removed or was updated. */
+static void
+purple_blist_cancel_update(PurpleBlistNode *node)
+{
+	if (pending_updates != NULL) {
+		g_hash_table_remove(pending_updates, node);
+	}
+}
+
+/* Returns a table of the contacts and chats in @group that are saved to the
+ * keys they have in the file. If @order isn't NULL, the keys are added to it
+ * in order as well. */
+static GHashTable *
+blist_group_child_keys(PurpleGroup *group, GPtrArray *order)
+{
+	PurpleBlistNode *cnode;
+	GHashTable *siblings = NULL;
+	GHashTable *keys = NULL;
+
+	siblings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	keys = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+	for (cnode = PURPLE_BLIST_NODE(group)->child; cnode != NULL;
+	     cnode = cnode->next)
+	{
+		gchar *base = NULL, *key = NULL;
+
+		if (purple_blist_node_is_transient(cnode))
+			continue;
+
+		base = blist_node_key(cnode);
+		if (base == NULL)
+			continue;
+
+		key = g_strdup(purple_config_journal_unique_key(siblings, base));
+		g_free(base);
+
+		g_hash_table_insert(keys, cnode, key);
+		if (order != NULL)
+			g_ptr_array_add(order, key);
+	}
+
+	g_hash_table_destroy(siblings);
+
+	return keys;
+}
+
+/* Writes the contacts and chats of @group that changed or got a new key, and
+ * puts them in order. */
+static void
+blist_sync_group(PurpleGroup *group)
+{
+	PurpleBlistNode *cnode;
+	const gchar *path[3] = { "blist", NULL, NULL };
+	GPtrArray *order = g_ptr_array_new();
+	GHashTable *keys = blist_group_child_keys(group, order);
+
+	path[1] = blist_group_get_key(group);
+
+	for (cnode = PURPLE_BLIST_NODE(group)->child; cnode != NULL;
+	     cnode = cnode->next)
+	{
+		const gchar *key = g_hash_table_lookup(keys, cnode);
+		PurpleXmlNode *node = NULL;
+
+		if (key == NULL)
+			continue;
+
+		if (!g_hash_table_contains(dirty_nodes, cnode) &&
+		    purple_strequal(g_hash_table_lookup(node_keys, cnode), key))
+		{
+			continue;
+		}
+
+		if (PURPLE_IS_META_CONTACT(cnode))
+			node = contact_to_xmlnode(PURPLE_META_CONTACT(cnode));
+		else
+			node = chat_to_xmlnode(PURPLE_CHAT(cnode));
+
+		purple_config_journal_set_with_key(blist_journal, path, key, node);
+		purple_xmlnode_free(node);
+
+		g_hash_table_insert(node_keys, cnode, g_strdup(key));
+	}
+	g_ptr_array_add(order, NULL);
+
+	purple_config_journal_set_order(blist_journal, path,
+	                                (const gchar * const *)order->pdata);
+	g_ptr_array_free(order, TRUE);
+	g_hash_table_destroy(keys);
+}
+
+static void
+blist_sync_groups_order(void)
+{
+	PurpleBlistNode *gnode;
+	const gchar *path[2] = { "blist", NULL };
+	GPtrArray *keys = g_ptr_array_new();
+
+	for (gnode = purple_blist_get_default_root(); gnode != NULL;
+	     gnode = gnode->next)
+	{
+		if (PURPLE_IS_GROUP(gnode) && !purple_blist_node_is_transient(gnode))
+			g_ptr_array_add(keys, (gpointer)blist_group_get_key(PURPLE_GROUP(gnode)));
+	}
+	g_ptr_array_add(keys, NULL);
+
+	purple_config_journal_set_order(blist_journal, path,
+	                                (const gchar * const *)keys->pdata);
+	g_ptr_array_free(keys, TRUE);
+}
+
+static void
+blist_record_keys(void)
+{
+	PurpleBlistNode *gnode;
+
+	g_hash_table_remove_all(group_keys);
+	g_hash_table_remove_all(node_keys);
+
+	for (gnode = purple_blist_get_default_root(); gnode != NULL;
+	     gnode = gnode->next)
+	{
+		GHashTable *keys = NULL;
+		GHashTableIter iter;
+		gpointer cnode, key;
+
+		if (!PURPLE_IS_GROUP(gnode))
+			continue;
+
+		blist_group_get_key(PURPLE_GROUP(gnode));
+
+		keys = blist_group_child_keys(PURPLE_GROUP(gnode), NULL);
+		g_hash_table_iter_init(&iter, keys);
+		while (g_hash_table_iter_next(&iter, &cnode, &key)) {
+			g_hash_table_iter_steal(&iter);
+			g_hash_table_insert(node_keys, cnode, key);
+		}
+		g_hash_table_destroy(keys);
+	}
+}
+
+/* Writes everything, but only what differs from the file reaches the disk. */
+static void
+blist_sync_all(void)
+{
+	PurpleXmlNode *node = blist_to_xmlnode(TRUE);
+
+	purple_config_journal_replace(blist_journal, NULL, node);
+	purple_xmlnode_free(node);
+
+	g_hash_table_remove_all(dirty_nodes);
+	g_hash_table_remove_all(dirty_groups);
+	g_hash_table_remove_all(reordered_groups);
+	blist_record_keys();
+	blist_reordered = FALSE;
+	blist_full_sync = FALSE;
+}
+
+/* Writes only the nodes that changed since the last sync. */
+static void
+blist_sync_changes(void)
 {
 	PurpleXmlNode *node;
-	char *data;
+	GHashTableIter iter;
+	gpointer key;
+	const gchar *blist_path[2] = { "blist", NULL };
+
+	node = blist_to_xmlnode(FALSE);
+	purple_config_journal_set(blist_journal, NULL, node);
+	purple_xmlnode_free(node);
+
+	g_hash_table_iter_init(&iter, dirty_groups);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleGroup *group = key;
+		const gchar *old_key = g_hash_table_lookup(group_keys, group);
+		gchar *new_key = blist_group_key(group);
+
+		if (purple_blist_node_is_transient(PURPLE_BLIST_NODE(group))) {
+			g_free(new_key);
+			continue;
+		}
+
+		if (!purple_strequal(old_key, new_key)) {
+			PurpleBlistNode *cnode;
+
+			/* It was renamed or is new, so everything in it moves. */
+			for (cnode = PURPLE_BLIST_NODE(group)->child; cnode != NULL;
+			     cnode = cnode->next)
+			{
+				blist_set_add(dirty_nodes, cnode);
+			}
+
+			g_hash_table_insert(group_keys, group, new_key);
+			blist_reordered = TRUE;
+		} else {
+			g_free(new_key);
+		}
+
+		node = group_to_xmlnode(group, FALSE);
+		purple_config_journal_set(blist_journal, blist_path, node);
+		purple_xmlnode_free(node);
+	}
+
+	/* The nodes are written by their group, since their keys depend on
+	 * their siblings. */
+	g_hash_table_iter_init(&iter, dirty_nodes);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleBlistNode *cnode = key;
+
+		if (cnode->parent != NULL)
+			blist_set_add(reordered_groups, cnode->parent);
+	}
+
+	g_hash_table_iter_init(&iter, reordered_groups);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleBlistNode *gnode = key;
+
+		/* Removed groups are dropped from the set, so this one is live. */
+		if (!purple_blist_node_is_transient(gnode))
+			blist_sync_group(PURPLE_GROUP(gnode));
+	}
 
+	if (blist_reordered)
+		blist_sync_groups_order();
+
+	g_hash_table_remove_all(dirty_nodes);
+	g_hash_table_remove_all(dirty_groups);
+	g_hash_table_remove_all(reordered_groups);
+	blist_reordered = FALSE;
+}
+
+static void
+purple_blist_sync(void)
+{
 	if (!blist_loaded)
 	{
 		purple_debug_error("buddylist", "Attempted to save buddy list before it "
@@ -399,11 +991,12 @@ purple_blist_sync(void)
 		return;
 	}
 
-	node = blist_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("blist.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	if (blist_full_sync)
+		blist_sync_all();
+	else
+		blist_sync_changes();
+
+	purple_config_journal_save(blist_journal);
 }
 
 static gboolean
@@ -425,21 +1018,55 @@ static void
 purple_blist_real_save_account(G_GNUC_UNUSED PurpleBuddyList *list,
                                G_GNUC_UNUSED PurpleAccount *account)
 {
-#if 1
+	/* Every key with the account's name in it may have changed. */
+	blist_full_sync = TRUE;
 	purple_blist_real_schedule_save();
-#else
-	if (account != NULL) {
-		/* Save the buddies and privacy data for this account */
+}
+
+static void
+purple_blist_real_save_node(G_GNUC_UNUSED PurpleBuddyList *list,
+                            PurpleBlistNode *node)
+{
+	if (!blist_loaded)
+		return;
+
+	if (PURPLE_IS_BUDDY(node))
+		node = node->parent;
+
+	if (node == NULL) {
+		return;
+	} else if (PURPLE_IS_GROUP(node)) {
+		blist_set_add(dirty_groups, node);
 	} else {
-		/* Save all buddies and privacy data */
+		blist_set_add(dirty_nodes, node);
 	}
-#endif
+
+	purple_blist_real_schedule_save();
 }
 
 static void
-purple_blist_real_save_node(G_GNUC_UNUSED PurpleBuddyList *list,
-                            G_GNUC_UNUSED PurpleBlistNode *node)
+purple_blist_real_remove_node(G_GNUC_UNUSED PurpleBuddyList *list,
+                              PurpleBlistNode *node)
 {
+	if (!blist_loaded)
+		return;
+
+	if (PURPLE_IS_BUDDY(node)) {
+		/* If this empties the contact, it will be removed next. */
+		if (node->parent != NULL)
+			blist_set_add(dirty_nodes, node->parent);
+	} else if (PURPLE_IS_GROUP(node)) {
+		g_hash_table_remove(dirty_groups, node);
+		g_hash_table_remove(reordered_groups, node);
+		g_hash_table_remove(group_keys, node);
+		blist_reordered = TRUE;
+	} else {
+		g_hash_table_remove(dirty_nodes, node);
+		g_hash_table_remove(node_keys, node);
+		if (node->parent != NULL)
+			blist_set_add(reordered_groups, node->parent);
+	}
+
 	purple_blist_real_schedule_save();
 }
 
@@ -530,15 +1157,15 @@ parse_buddy(PurpleGroup *group, PurpleMetaContact *contact, PurpleXmlNode *bnode
 	g_free(alias);
 }
 
-static void
-parse_contact(PurpleGroup *group, PurpleXmlNode *cnode)
+/* Returns the last child of the group afterwards. */
+static PurpleBlistNode *
+parse_contact(PurpleGroup *group, PurpleBlistNode *prev, PurpleXmlNode *cnode)
 {
 	PurpleMetaContact *contact = purple_meta_contact_new();
 	PurpleXmlNode *x;
 	const char *alias;
 
-	purple_blist_add_contact(contact, group,
-			_purple_blist_get_last_child((PurpleBlistNode*)group));
+	purple_blist_add_contact(contact, group, prev);
 
 	if ((alias = purple_xmlnode_get_attrib(cnode, "alias"))) {
 		purple_meta_contact_set_alias(contact, alias);
@@ -554,12 +1181,17 @@ parse_contact(PurpleGroup *group, PurpleXmlNode *cnode)
 	}
 
 	/* if the contact is empty, don't keep it around.  it causes problems */
-	if (!PURPLE_BLIST_NODE(contact)->child)
+	if (!PURPLE_BLIST_NODE(contact)->child) {
 		purple_blist_remove_contact(contact);
+		return prev;
+	}
+
+	return PURPLE_BLIST_NODE(contact);
 }
 
-static void
-parse_chat(PurpleGroup *group, PurpleXmlNode *cnode)
+/* Returns the last child of the group afterwards. */
+static PurpleBlistNode *
+parse_chat(PurpleGroup *group, PurpleBlistNode *prev, PurpleXmlNode *cnode)
 {
 	PurpleAccount *account;
 	PurpleAccountManager *manager = purple_account_manager_get_default();
@@ -573,13 +1205,13 @@ parse_chat(PurpleGroup *group, PurpleXmlNode *cnode)
 	proto = purple_xmlnode_get_attrib(cnode, "proto");
 
 	if(!acct_name || !proto) {
-		return;
+		return prev;
 	}
 
 	account = purple_account_manager_find(manager, acct_name, proto);
 
 	if(!account) {
-		return;
+		return prev;
 	}
 
 	if((x = purple_xmlnode_get_child(cnode, "alias"))) {
@@ -598,8 +1230,7 @@ parse_chat(PurpleGroup *group, PurpleXmlNode *cnode)
 	}
 
 	chat = purple_chat_new(account, alias, components);
-	purple_blist_add_chat(chat, group,
-			_purple_blist_get_last_child((PurpleBlistNode*)group));
+	purple_blist_add_chat(chat, group, prev);
 
 	for(x = purple_xmlnode_get_child(cnode, "setting"); x; x = purple_xmlnode_get_next_twin(x)) {
 		parse_setting((PurpleBlistNode*)chat, x);
@@ -607,63 +1238,118 @@ parse_chat(PurpleGroup *group, PurpleXmlNode *cnode)
 
 	g_clear_object(&account);
 	g_free(alias);
+
+	return PURPLE_BLIST_NODE(chat);
 }
 
+/*
+ * blist.xml is streamed, so only one contact or chat is in memory as a
+ * PurpleXmlNode tree at a time:
+ *
+ *     <purple>                 depth 0
+ *       <blist>                depth 1, passed when it starts
+ *         <group>              depth 2, passed when it starts
+ *           <contact>...       depth 3, passed when it is complete
+ */
+#define BLIST_STREAM_DEPTH 3
+
+typedef struct {
+	PurpleGroup *group;
+	PurpleBlistNode *last;
+} BlistLoadData;
+
 static void
-parse_group(PurpleXmlNode *groupnode)
+parse_group_start(BlistLoadData *load, PurpleXmlNode *groupnode)
 {
 	const char *name = purple_xmlnode_get_attrib(groupnode, "name");
-	PurpleGroup *group;
-	PurpleXmlNode *cnode;
 
-	group = purple_group_new(name);
-	purple_blist_add_group(group, purple_blist_get_last_sibling(
+	load->group = purple_group_new(name);
+	purple_blist_add_group(load->group, purple_blist_get_last_sibling(
 	                                      purple_blist_get_default_root()));
 
-	for (cnode = groupnode->child; cnode; cnode = cnode->next) {
-		if (cnode->type != PURPLE_XMLNODE_TYPE_TAG)
-			continue;
-		if (purple_strequal(cnode->name, "setting"))
-			parse_setting((PurpleBlistNode*)group, cnode);
-		else if (purple_strequal(cnode->name, "contact") ||
-				purple_strequal(cnode->name, "person"))
-			parse_contact(group, cnode);
-		else if (purple_strequal(cnode->name, "chat"))
-			parse_chat(group, cnode);
+	/* The group may already have children if the file lists it twice. */
+	load->last = _purple_blist_get_last_child(PURPLE_BLIST_NODE(load->group));
+}
+
+static void
+load_blist_node(PurpleXmlNode *node, gpointer data)
+{
+	BlistLoadData *load = data;
+	PurpleXmlNode *parent = node->parent;
+	guint depth = 0;
+
+	for (PurpleXmlNode *p = parent; p != NULL; p = p->parent)
+		depth++;
+
+	switch (depth) {
+		case 1:
+			if (purple_strequal(node->name, "blist")) {
+				g_free(localized_default_group_name);
+				localized_default_group_name = g_strdup(
+					purple_xmlnode_get_attrib(node,
+						"localized-default-group"));
+			}
+			break;
+		case 2:
+			load->group = NULL;
+			if (purple_strequal(parent->name, "blist") &&
+			    purple_strequal(node->name, "group"))
+				parse_group_start(load, node);
+			break;
+		case BLIST_STREAM_DEPTH:
+			if (load->group == NULL)
+				break;
+			if (purple_strequal(node->name, "setting"))
+				parse_setting(PURPLE_BLIST_NODE(load->group), node);
+			else if (purple_strequal(node->name, "contact") ||
+					purple_strequal(node->name, "person"))
+				load->last = parse_contact(load->group, load->last, node);
+			else if (purple_strequal(node->name, "chat"))
+				load->last = parse_chat(load->group, load->last, node);
+			break;
+		default:
+			break;
 	}
 }
 
 static void
 load_blist(void)
 {
-	PurpleXmlNode *purple, *blist;
-
-	blist_loaded = TRUE;
+	BlistLoadData load = { NULL, NULL };
 
-	purple = purple_util_read_xml_from_config_file("blist.xml", _("buddy list"));
+	dirty_nodes = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                    g_object_unref, NULL);
+	dirty_groups = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                     g_object_unref, NULL);
+	reordered_groups = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                         g_object_unref, NULL);
+	group_keys = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                   g_free);
+	node_keys = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                  g_free);
 
-	if(purple == NULL) {
-		return;
-	}
+	blist_journal = purple_config_journal_new("blist.xml", blist_journal_key);
+	purple_config_journal_recover(blist_journal);
 
-	blist = purple_xmlnode_get_child(purple, "blist");
-	if(blist) {
-		PurpleXmlNode *groupnode;
+	blist_loaded = TRUE;
 
-		localized_default_group_name = g_strdup(
-			purple_xmlnode_get_attrib(blist,
-				"localized-default-group"));
+	g_clear_pointer(&localized_default_group_name, g_free);
 
-		for(groupnode = purple_xmlnode_get_child(blist, "group"); groupnode != NULL;
-				groupnode = purple_xmlnode_get_next_twin(groupnode)) {
-			parse_group(groupnode);
-		}
-	} else {
-		g_free(localized_default_group_name);
-		localized_default_group_name = NULL;
+	if (!purple_util_stream_xml_from_config_file("blist.xml", _("buddy list"),
+	                                             BLIST_STREAM_DEPTH,
+	                                             load_blist_node, &load))
+	{
+		/* There's nothing on disk to build on. */
+		blist_full_sync = TRUE;
+		return;
 	}
 
-	purple_xmlnode_free(purple);
+	/* Everything that was just added is already on disk. */
+	g_hash_table_remove_all(dirty_nodes);
+	g_hash_table_remove_all(dirty_groups);
+	g_hash_table_remove_all(reordered_groups);
+	blist_reordered = FALSE;
+	blist_record_keys();
 
 	/* This tells the buddy icon code to do its thing. */
 	_purple_buddy_icons_blist_loaded_cb();
@@ -693,6 +1379,9 @@ purple_blist_boot(void)
 
 	groups_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
+	chats_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+					 (GDestroyNotify)purple_blist_chat_index_free);
+
 	manager_model = purple_account_manager_get_default_as_model();
 	n_items = g_list_model_get_n_items(manager_model);
 	for(guint index = 0; index < n_items; index++) {
@@ -826,6 +1515,18 @@ void purple_blist_update_groups_cache(PurpleGroup *group, const char *new_name)
 			purple_blist_fold_name(new_name), group);
 }
 
+void
+purple_blist_update_chats_cache(PurpleChat *chat)
+{
+	g_return_if_fail(PURPLE_IS_CHAT(chat));
+
+	if (PURPLE_BLIST_NODE(chat)->parent == NULL)
+		return;
+
+	purple_blist_chats_cache_remove(chat);
+	purple_blist_chats_cache_add(chat);
+}
+
 void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode *node)
 {
 	PurpleBlistNode *cnode = PURPLE_BLIST_NODE(chat);
@@ -910,6 +1611,8 @@ void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode
 		}
 	}
 
+	purple_blist_chats_cache_add(chat);
+
 	if (klass) {
 		if (klass->save_node) {
 			klass->save_node(purplebuddylist, cnode);
@@ -1022,6 +1725,9 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleMetaContact *contact, Purp
 		} else {
 			purple_meta_contact_invalidate_priority_buddy((PurpleMetaContact*)bnode->parent);
 
+			if (klass && klass->save_node) {
+				klass->save_node(purplebuddylist, bnode->parent);
+			}
 			if (klass && klass->update) {
 				klass->update(purplebuddylist, bnode->parent);
 			}
@@ -1364,6 +2070,8 @@ void purple_blist_remove_contact(PurpleMetaContact *contact)
 			node->next->prev = node->prev;
 		purple_counting_node_change_total_size(PURPLE_COUNTING_NODE(group), -1);
 
+		purple_blist_cancel_update(node);
+
 		/* Update the UI */
 		if (klass && klass->remove) {
 			klass->remove(purplebuddylist, node);
@@ -1449,6 +2157,8 @@ void purple_blist_remove_buddy(PurpleBuddy *buddy)
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 	g_hash_table_remove(account_buddies, &hb);
 
+	purple_blist_cancel_update(node);
+
 	/* Update the UI */
 	if (klass && klass->remove) {
 		klass->remove(purplebuddylist, node);
@@ -1503,6 +2213,10 @@ void purple_blist_remove_chat(PurpleChat *chat)
 		purple_counting_node_change_total_size(group_counter, -1);
 	}
 
+	purple_blist_chats_cache_remove(chat);
+
+	purple_blist_cancel_update(node);
+
 	/* Update the UI */
 	if (klass && klass->remove) {
 		klass->remove(purplebuddylist, node);
@@ -1555,6 +2269,8 @@ void purple_blist_remove_group(PurpleGroup *group)
 	g_hash_table_remove(groups_cache, key);
 	g_free(key);
 
+	purple_blist_cancel_update(node);
+
 	/* Update the UI */
 	if (klass && klass->remove) {
 		klass->remove(purplebuddylist, node);
@@ -1709,13 +2425,10 @@ purple_blist_get_default_group(void)
 PurpleChat *
 purple_blist_find_chat(PurpleAccount *account, const char *name)
 {
-	char *chat_name;
 	PurpleChat *chat;
 	PurpleProtocol *protocol = NULL;
-	PurpleProtocolChatEntry *pce;
-	PurpleBlistNode *node, *group;
-	GList *parts;
-	char *normname;
+	PurpleBlistChatIndex *index;
+	GQueue *chats;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail((name != NULL) && (*name != '\0'), NULL);
@@ -1734,36 +2447,15 @@ purple_blist_find_chat(PurpleAccount *account, const char *name)
 		}
 	}
 
-	normname = g_strdup(purple_normalize(account, name));
-	for (group = purple_blist_get_default_root(); group != NULL;
-	     group = group->next) {
-		for (node = group->child; node != NULL; node = node->next) {
-			if (PURPLE_IS_CHAT(node)) {
-
-				chat = (PurpleChat*)node;
-
-				if (account != purple_chat_get_account(chat))
-					continue;
-
-				parts = purple_protocol_chat_info(PURPLE_PROTOCOL_CHAT(protocol),
-					purple_account_get_connection(purple_chat_get_account(chat)));
-
-				pce = parts->data;
-				chat_name = g_hash_table_lookup(purple_chat_get_components(chat),
-												pce->identifier);
-				g_list_free_full(parts, g_free);
+	index = purple_blist_chats_cache_get(account);
+	if (index == NULL)
+		return NULL;
 
-				if (purple_chat_get_account(chat) == account && chat_name != NULL &&
-					purple_strequal(purple_normalize(account, chat_name), normname)) {
-					g_free(normname);
-					return chat;
-				}
-			}
-		}
-	}
+	chats = g_hash_table_lookup(index->names, purple_normalize(account, name));
+	if (chats == NULL)
+		return NULL;
 
-	g_free(normname);
-	return NULL;
+	return g_queue_peek_head(chats);
 }
 
 void purple_blist_add_account(PurpleAccount *account)
@@ -2022,12 +2714,101 @@ purple_blist_update_node(PurpleBuddyList *list, PurpleBlistNode *node)
 
 	g_return_if_fail(PURPLE_IS_BUDDY_LIST(list));
 
+	/* The node is up to date now, so a queued update would be redundant. */
+	purple_blist_cancel_update(node);
+
 	klass = PURPLE_BUDDY_LIST_GET_CLASS(list);
 	if (klass && klass->update) {
 		klass->update(list, node);
 	}
 }
 
+/* Releases a node that was queued by purple_blist_queue_update_node(). */
+static void
+purple_blist_pending_update_free(gpointer data)
+{
+	PurpleBlistNode *node = data;
+
+	if (PURPLE_IS_BUDDY(node)) {
+		PurplePresence *presence = purple_buddy_get_presence(PURPLE_BUDDY(node));
+
+		if (presence != NULL) {
+			g_object_thaw_notify(G_OBJECT(presence));
+		}
+	}
+
+	g_object_unref(node);
+}
+
+static gboolean
+purple_blist_flush_updates(G_GNUC_UNUSED gpointer data)
+{
+	PurpleBuddyListClass *klass = NULL;
+	GHashTable *nodes = pending_updates;
+	GHashTableIter iter;
+	gpointer node;
+
+	update_timer = 0;
+	/* Updating the UI may queue more updates, those go into the next batch. */
+	pending_updates = NULL;
+
+	if (nodes == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
+	if (PURPLE_IS_BUDDY_LIST(purplebuddylist)) {
+		klass = PURPLE_BUDDY_LIST_GET_CLASS(purplebuddylist);
+	}
+
+	if (klass && klass->update) {
+		g_hash_table_iter_init(&iter, nodes);
+		while (g_hash_table_iter_next(&iter, &node, NULL)) {
+			klass->update(purplebuddylist, node);
+		}
+	}
+
+	g_hash_table_destroy(nodes);
+
+	return G_SOURCE_REMOVE;
+}
+
+void
+purple_blist_queue_update_node(PurpleBuddyList *list, PurpleBlistNode *node)
+{
+	g_return_if_fail(PURPLE_IS_BUDDY_LIST(list));
+	g_return_if_fail(PURPLE_IS_BLIST_NODE(node));
+
+	if (pending_updates == NULL) {
+		pending_updates = g_hash_table_new_full(g_direct_hash,
+		                                        g_direct_equal,
+		                                        purple_blist_pending_update_free,
+		                                        NULL);
+	}
+
+	if (g_hash_table_contains(pending_updates, node)) {
+		return;
+	}
+
+	/* Hold back the presence notifications too, so that a burst of changes
+	 * reaches the listeners of the presence as one notification. */
+	if (PURPLE_IS_BUDDY(node)) {
+		PurplePresence *presence = purple_buddy_get_presence(PURPLE_BUDDY(node));
+
+		if (presence != NULL) {
+			g_object_freeze_notify(G_OBJECT(presence));
+		}
+	}
+
+	g_hash_table_add(pending_updates, g_object_ref(node));
+
+	/* The timer isn't pushed back by later updates, so no node waits longer
+	 * than PURPLE_BLIST_UPDATE_INTERVAL. */
+	if (update_timer == 0) {
+		update_timer = g_timeout_add(PURPLE_BLIST_UPDATE_INTERVAL,
+		                             purple_blist_flush_updates, NULL);
+	}
+}
+
 void
 purple_blist_save_node(PurpleBuddyList *list, PurpleBlistNode *node)
 {
@@ -2179,10 +2960,22 @@ purple_blist_uninit(void)
 		purple_blist_sync();
 	}
 
+	g_clear_handle_id(&update_timer, g_source_remove);
+	g_clear_pointer(&pending_updates, g_hash_table_destroy);
+
+	g_clear_pointer(&blist_journal, purple_config_journal_free);
+	g_clear_pointer(&dirty_nodes, g_hash_table_destroy);
+	g_clear_pointer(&dirty_groups, g_hash_table_destroy);
+	g_clear_pointer(&reordered_groups, g_hash_table_destroy);
+	g_clear_pointer(&group_keys, g_hash_table_destroy);
+	g_clear_pointer(&node_keys, g_hash_table_destroy);
+	blist_loaded = FALSE;
+
 	purple_debug_info("buddylist", "Destroying");
 
 	g_clear_pointer(&buddies_cache, g_hash_table_destroy);
 	g_clear_pointer(&groups_cache, g_hash_table_destroy);
+	g_clear_pointer(&chats_cache, g_hash_table_destroy);
 
 	g_clear_object(&purplebuddylist);
 
@@ -2250,6 +3043,6 @@ static void purple_buddy_list_class_init(PurpleBuddyListClass *klass)
 	obj_class->finalize = purple_buddy_list_finalize;
 
 	klass->save_node = purple_blist_real_save_node;
-	klass->remove_node = purple_blist_real_save_node;
+	klass->remove_node = purple_blist_real_remove_node;
 	klass->save_account = purple_blist_real_save_account;
 }
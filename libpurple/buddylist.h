@@ -253,6 +253,18 @@ void purple_blist_update_buddies_cache(PurpleBuddy *buddy, const char *new_name)
  */
 void purple_blist_update_groups_cache(PurpleGroup *group, const char *new_name);
 
+/**
+ * purple_blist_update_chats_cache:
+ * @chat: The chat whose components were changed.
+ *
+ * Updates the chats hash table after the components of a chat in the buddy
+ * list were changed in place, so purple_blist_find_chat() finds it by its new
+ * name.
+ *
+ * Since: 3.0.0
+ */
+void purple_blist_update_chats_cache(PurpleChat *chat);
+
 /**
  * purple_blist_add_chat:
  * @chat:  The new chat who gets added
@@ -533,6 +545,25 @@ void purple_blist_new_node(PurpleBuddyList *list, PurpleBlistNode *node);
  */
 void purple_blist_update_node(PurpleBuddyList *list, PurpleBlistNode *node);
 
+/**
+ * purple_blist_queue_update_node:
+ * @list: The buddy list to modify.
+ * @node: The node to update.
+ *
+ * Like purple_blist_update_node(), but defers the UI update for a short while
+ * so that any further changes to @node in that time are shown with a single
+ * update. This is meant for changes that can arrive in large bursts, like
+ * presence updates when an account connects. No update is deferred by more
+ * than 100 milliseconds.
+ *
+ * If @node is a buddy, the property notifications of its presence are held
+ * back for the same time, so its listeners also see one notification per
+ * property. The properties themselves always have their current values.
+ *
+ * Since: 3.0.0
+ */
+void purple_blist_queue_update_node(PurpleBuddyList *list, PurpleBlistNode *node);
+
 /**
  * purple_blist_save_node:
  * @list: The list that contains the node.
@@ -58,6 +58,9 @@ purple_conversations_init(void)
 
 	/* Conversations */
 	purple_prefs_add_none("/purple/conversations");
+	purple_prefs_add_int("/purple/conversations/message_limit",
+	                     PURPLE_CONVERSATION_DEFAULT_MESSAGE_LIMIT);
+	purple_prefs_add_int("/purple/conversations/message_size_limit", 0);
 
 	/* Conversations -> Chat */
 	purple_prefs_add_none("/purple/conversations/chat");
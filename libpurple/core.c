@@ -279,6 +279,9 @@ purple_core_quit(void)
 
 	purple_signals_uninit();
 
+	/* Every protocol is gone by now, so nothing is parsing into an arena. */
+	purple_xmlnode_uninit();
+
 	g_clear_object(&core->ui);
 	g_free(core);
 
@@ -20,8 +20,11 @@
  * along with this program; if not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "debug.h"
 #include "prefs.h"
+#include "util.h"
 
 /*
  * These determine whether verbose or unsafe debugging are desired.  I
@@ -31,45 +34,194 @@
 static gboolean debug_verbose = FALSE;
 static gboolean debug_unsafe = FALSE;
 
+/* Debug messages can come from any thread, so this is only accessed
+ * atomically.
+ */
+static gint debug_enabled = FALSE;
+
+/* The minimum level that is output for categories that aren't in
+ * category_levels, and the per category overrides, which map category names to
+ * levels. The default level is only accessed atomically. The table is only
+ * ever replaced, never modified in place, so readers only need the lock to
+ * take a reference to it.
+ */
+static gint default_level = PURPLE_DEBUG_ALL;
+static GHashTable *category_levels = NULL;
+G_LOCK_DEFINE_STATIC(category_levels);
+
+typedef struct {
+	GDateTime *timestamp;
+	PurpleDebugLevel level;
+	gchar *category;
+	gchar *message;
+} PurpleDebugRingRecord;
+
+struct _PurpleDebugRing {
+	GMutex lock;
+
+	PurpleDebugRingRecord **records;
+	guint capacity;
+
+	/* Records are numbered as they are pushed. The ring holds the records
+	 * from tail up to, but not including, head, and the record numbered n
+	 * lives in records[n % capacity].
+	 */
+	guint64 head;
+	guint64 tail;
+
+	gboolean wakeup_pending;
+};
+
+/* GLib's debug levels are not quite the same as ours, so we need to re-assign
+ * them. Returns 0 for an invalid level.
+ */
+static GLogLevelFlags
+purple_debug_level_to_log_level(PurpleDebugLevel level) {
+	switch(level) {
+		case PURPLE_DEBUG_MISC:
+			return G_LOG_LEVEL_INFO;
+		case PURPLE_DEBUG_INFO:
+			return G_LOG_LEVEL_MESSAGE;
+		case PURPLE_DEBUG_WARNING:
+			return G_LOG_LEVEL_WARNING;
+		case PURPLE_DEBUG_ERROR:
+			return G_LOG_LEVEL_CRITICAL;
+		case PURPLE_DEBUG_FATAL:
+			return G_LOG_LEVEL_ERROR;
+		default:
+			return 0;
+	}
+}
+
 static void
 purple_debug_vargs(PurpleDebugLevel level, const gchar *category,
                    const gchar *format, va_list args)
 {
 	GLogLevelFlags log_level = G_LOG_LEVEL_DEBUG;
 	gchar *msg = NULL;
+	gsize length = 0;
 
 	g_return_if_fail(format != NULL);
 
-	/* GLib's debug levels are not quite the same as ours, so we need to
-	 * re-assign them. */
-	switch(level) {
-		case PURPLE_DEBUG_MISC:
-			log_level = G_LOG_LEVEL_INFO;
-			break;
-		case PURPLE_DEBUG_INFO:
-			log_level = G_LOG_LEVEL_MESSAGE;
-			break;
-		case PURPLE_DEBUG_WARNING:
-			log_level = G_LOG_LEVEL_WARNING;
-			break;
-		case PURPLE_DEBUG_ERROR:
-			log_level = G_LOG_LEVEL_CRITICAL;
-			break;
-		case PURPLE_DEBUG_FATAL:
-			log_level = G_LOG_LEVEL_ERROR;
-			break;
-		default:
-			g_return_if_reached();
+	log_level = purple_debug_level_to_log_level(level);
+	g_return_if_fail(log_level != 0);
+
+	/* Bail before doing any work if nobody is going to see this. */
+	if(!purple_debug_is_enabled(level, category)) {
+		return;
 	}
 
-	/* strip trailing linefeeds */
-	msg = g_strdup(format);
-	g_strchomp(msg);
+	/* strip trailing linefeeds, but only copy the format if there are any */
+	length = strlen(format);
+	if(length > 0 && g_ascii_isspace(format[length - 1])) {
+		msg = g_strdup(format);
+		g_strchomp(msg);
+		format = msg;
+	}
 
-	g_logv(category, log_level, msg, args);
+	g_logv(category, log_level, format, args);
 	g_free(msg);
 }
 
+/******************************************************************************
+ * Level Helpers
+ *****************************************************************************/
+static PurpleDebugLevel
+purple_debug_level_from_string(const gchar *str) {
+	if(purple_strequal(str, "misc") || purple_strequal(str, "all")) {
+		return PURPLE_DEBUG_MISC;
+	} else if(purple_strequal(str, "info")) {
+		return PURPLE_DEBUG_INFO;
+	} else if(purple_strequal(str, "warning")) {
+		return PURPLE_DEBUG_WARNING;
+	} else if(purple_strequal(str, "error")) {
+		return PURPLE_DEBUG_ERROR;
+	} else if(purple_strequal(str, "fatal")) {
+		return PURPLE_DEBUG_FATAL;
+	}
+
+	return PURPLE_DEBUG_ALL;
+}
+
+/* Parses PURPLE_DEBUG_LEVELS, which looks like "jabber=warning,irc=misc". A
+ * category of * sets the level for every category that isn't listed.
+ */
+static void
+purple_debug_parse_levels(const gchar *levels) {
+	gchar **entries = g_strsplit(levels, ",", -1);
+
+	for(gint i = 0; entries[i] != NULL; i++) {
+		gchar **parts = g_strsplit(g_strstrip(entries[i]), "=", 2);
+
+		if(parts[0] != NULL && parts[1] != NULL) {
+			PurpleDebugLevel level = PURPLE_DEBUG_ALL;
+
+			level = purple_debug_level_from_string(g_strstrip(parts[1]));
+
+			if(purple_strequal(parts[0], "*")) {
+				purple_debug_set_level(level);
+			} else {
+				purple_debug_set_category_level(parts[0], level);
+			}
+		}
+
+		g_strfreev(parts);
+	}
+
+	g_strfreev(entries);
+}
+
+static PurpleDebugLevel
+purple_debug_get_effective_level(const gchar *category) {
+	PurpleDebugLevel level = g_atomic_int_get(&default_level);
+	GHashTable *levels = NULL;
+
+	/* This is called for every debug message, so don't take the lock at all
+	 * when no category has its own level, which is the common case.
+	 */
+	if(category == NULL || g_atomic_pointer_get(&category_levels) == NULL) {
+		return level;
+	}
+
+	G_LOCK(category_levels);
+	if(category_levels != NULL) {
+		levels = g_hash_table_ref(category_levels);
+	}
+	G_UNLOCK(category_levels);
+
+	if(levels != NULL) {
+		gpointer value = NULL;
+
+		if(g_hash_table_lookup_extended(levels, category, NULL, &value)) {
+			level = GPOINTER_TO_INT(value);
+		}
+
+		g_hash_table_unref(levels);
+	}
+
+	return level;
+}
+
+/******************************************************************************
+ * Ring Helpers
+ *****************************************************************************/
+static void
+purple_debug_ring_record_clear(gpointer data) {
+	PurpleDebugRingRecord *record = data;
+
+	g_date_time_unref(record->timestamp);
+	g_free(record->category);
+	g_free(record->message);
+}
+
+static void
+purple_debug_ring_record_release(PurpleDebugRingRecord *record) {
+	if(record != NULL) {
+		g_atomic_rc_box_release_full(record, purple_debug_ring_record_clear);
+	}
+}
+
+
 void
 purple_debug(PurpleDebugLevel level, const gchar *category,
              const gchar *format, ...)
@@ -139,6 +291,271 @@ purple_debug_fatal(const gchar *category, const gchar *format, ...) {
 	va_end(args);
 }
 
+gboolean
+purple_debug_is_enabled(PurpleDebugLevel level, const gchar *category) {
+	GLogLevelFlags log_level = purple_debug_level_to_log_level(level);
+
+	g_return_val_if_fail(log_level != 0, FALSE);
+
+	if(level < purple_debug_get_effective_level(category)) {
+		return FALSE;
+	}
+
+	if(g_atomic_int_get(&debug_enabled)) {
+		return TRUE;
+	}
+
+	/* No user interface is showing debug output, so it's up to GLib's default
+	 * writer, which honors G_MESSAGES_DEBUG.
+	 */
+	return !g_log_writer_default_would_drop(log_level, category);
+}
+
+void
+purple_debug_set_enabled(gboolean enabled) {
+	g_atomic_int_set(&debug_enabled, enabled);
+}
+
+void
+purple_debug_set_level(PurpleDebugLevel level) {
+	g_return_if_fail(level <= PURPLE_DEBUG_FATAL);
+
+	g_atomic_int_set(&default_level, level);
+}
+
+PurpleDebugLevel
+purple_debug_get_level(void) {
+	return g_atomic_int_get(&default_level);
+}
+
+void
+purple_debug_set_category_level(const gchar *category, PurpleDebugLevel level)
+{
+	GHashTable *levels = NULL;
+
+	g_return_if_fail(category != NULL);
+	g_return_if_fail(level <= PURPLE_DEBUG_FATAL);
+
+	/* Readers may be holding a reference to the current table on other
+	 * threads, so build a new one and swap it in.
+	 */
+	levels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	G_LOCK(category_levels);
+	if(category_levels != NULL) {
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, category_levels);
+		while(g_hash_table_iter_next(&iter, &key, &value)) {
+			g_hash_table_insert(levels, g_strdup(key), value);
+		}
+	}
+
+	g_hash_table_insert(levels, g_strdup(category), GINT_TO_POINTER(level));
+
+	if(category_levels != NULL) {
+		g_hash_table_unref(category_levels);
+	}
+	g_atomic_pointer_set(&category_levels, levels);
+	G_UNLOCK(category_levels);
+}
+
+PurpleDebugLevel
+purple_debug_get_category_level(const gchar *category) {
+	g_return_val_if_fail(category != NULL, PURPLE_DEBUG_ALL);
+
+	return purple_debug_get_effective_level(category);
+}
+
+/******************************************************************************
+ * Ring API
+ *****************************************************************************/
+PurpleDebugRing *
+purple_debug_ring_new(guint capacity) {
+	PurpleDebugRing *ring = NULL;
+
+	g_return_val_if_fail(capacity > 0, NULL);
+
+	ring = g_new0(PurpleDebugRing, 1);
+	g_mutex_init(&ring->lock);
+	ring->capacity = capacity;
+	ring->records = g_new0(PurpleDebugRingRecord *, capacity);
+
+	return ring;
+}
+
+void
+purple_debug_ring_free(PurpleDebugRing *ring) {
+	if(ring == NULL) {
+		return;
+	}
+
+	for(guint i = 0; i < ring->capacity; i++) {
+		purple_debug_ring_record_release(ring->records[i]);
+	}
+
+	g_free(ring->records);
+	g_mutex_clear(&ring->lock);
+	g_free(ring);
+}
+
+guint
+purple_debug_ring_get_capacity(PurpleDebugRing *ring) {
+	guint capacity = 0;
+
+	g_return_val_if_fail(ring != NULL, 0);
+
+	g_mutex_lock(&ring->lock);
+	capacity = ring->capacity;
+	g_mutex_unlock(&ring->lock);
+
+	return capacity;
+}
+
+void
+purple_debug_ring_set_capacity(PurpleDebugRing *ring, guint capacity) {
+	PurpleDebugRingRecord **records = NULL;
+	guint64 keep = 0;
+
+	g_return_if_fail(ring != NULL);
+	g_return_if_fail(capacity > 0);
+
+	g_mutex_lock(&ring->lock);
+
+	if(capacity == ring->capacity) {
+		g_mutex_unlock(&ring->lock);
+		return;
+	}
+
+	/* Keep the newest records that fit, and drop the rest. */
+	keep = ring->head - MIN(ring->head - ring->tail, (guint64)capacity);
+
+	records = g_new0(PurpleDebugRingRecord *, capacity);
+	for(guint64 seq = ring->tail; seq < ring->head; seq++) {
+		PurpleDebugRingRecord *record = ring->records[seq % ring->capacity];
+
+		if(seq < keep) {
+			purple_debug_ring_record_release(record);
+		} else {
+			records[seq % capacity] = record;
+		}
+	}
+
+	g_free(ring->records);
+	ring->records = records;
+	ring->capacity = capacity;
+	ring->tail = keep;
+
+	g_mutex_unlock(&ring->lock);
+}
+
+gboolean
+purple_debug_ring_push(PurpleDebugRing *ring, PurpleDebugLevel level,
+                       const gchar *category, const gchar *message)
+{
+	PurpleDebugRingRecord *record = NULL;
+	PurpleDebugRingRecord *old = NULL;
+	gboolean wakeup = FALSE;
+	guint slot = 0;
+
+	g_return_val_if_fail(ring != NULL, FALSE);
+	g_return_val_if_fail(message != NULL, FALSE);
+
+	/* Everything that allocates happens outside of the lock. */
+	record = g_atomic_rc_box_new0(PurpleDebugRingRecord);
+	record->timestamp = g_date_time_new_now_local();
+	record->level = level;
+	record->category = g_strdup(category);
+	record->message = g_strdup(message);
+
+	g_mutex_lock(&ring->lock);
+
+	/* When the ring is full the oldest record makes room for the new one. */
+	slot = ring->head % ring->capacity;
+	if(ring->head - ring->tail == ring->capacity) {
+		old = ring->records[slot];
+		ring->tail++;
+	}
+	ring->records[slot] = record;
+	ring->head++;
+
+	wakeup = !ring->wakeup_pending;
+	ring->wakeup_pending = TRUE;
+
+	g_mutex_unlock(&ring->lock);
+
+	purple_debug_ring_record_release(old);
+
+	return wakeup;
+}
+
+guint
+purple_debug_ring_read(PurpleDebugRing *ring, guint64 *cursor,
+                       PurpleDebugRingFunc func, gpointer data)
+{
+	PurpleDebugRingRecord **records = NULL;
+	guint64 start = 0;
+	guint count = 0;
+
+	g_return_val_if_fail(ring != NULL, 0);
+	g_return_val_if_fail(cursor != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	/* Take references to everything that's new and let go of the lock before
+	 * calling func, which may very well log something itself.
+	 */
+	g_mutex_lock(&ring->lock);
+
+	start = MAX(*cursor, ring->tail);
+	if(start < ring->head) {
+		count = ring->head - start;
+		records = g_new(PurpleDebugRingRecord *, count);
+
+		for(guint i = 0; i < count; i++) {
+			PurpleDebugRingRecord *record = NULL;
+
+			record = ring->records[(start + i) % ring->capacity];
+			records[i] = g_atomic_rc_box_acquire(record);
+		}
+	}
+
+	*cursor = ring->head;
+	ring->wakeup_pending = FALSE;
+
+	g_mutex_unlock(&ring->lock);
+
+	for(guint i = 0; i < count; i++) {
+		PurpleDebugRingRecord *record = records[i];
+
+		func(record->timestamp, record->level, record->category,
+		     record->message, data);
+
+		purple_debug_ring_record_release(record);
+	}
+
+	g_free(records);
+
+	return count;
+}
+
+void
+purple_debug_ring_clear(PurpleDebugRing *ring) {
+	g_return_if_fail(ring != NULL);
+
+	g_mutex_lock(&ring->lock);
+
+	/* The head is left alone so that cursors stay valid. */
+	for(guint64 seq = ring->tail; seq < ring->head; seq++) {
+		g_clear_pointer(&ring->records[seq % ring->capacity],
+		                purple_debug_ring_record_release);
+	}
+	ring->tail = ring->head;
+	ring->wakeup_pending = FALSE;
+
+	g_mutex_unlock(&ring->lock);
+}
+
 gboolean
 purple_debug_is_verbose(void) {
 	return debug_verbose;
@@ -170,5 +587,9 @@ purple_debug_init(void) {
 		purple_debug_set_verbose(TRUE);
 	}
 
+	if(g_getenv("PURPLE_DEBUG_LEVELS")) {
+		purple_debug_parse_levels(g_getenv("PURPLE_DEBUG_LEVELS"));
+	}
+
 	purple_prefs_add_none("/purple/debug");
 }
@@ -143,6 +143,89 @@ void purple_debug_error(const gchar *category, const gchar *format, ...) G_GNUC_
  */
 void purple_debug_fatal(const gchar *category, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
 
+/**
+ * purple_debug_set_enabled:
+ * @enabled: %TRUE if the user interface is displaying debug output.
+ *
+ * Lets libpurple know whether the user interface is currently displaying debug
+ * output, for example because its debug window is open.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_enabled(gboolean enabled);
+
+/**
+ * purple_debug_is_enabled:
+ * @level: The debug level.
+ * @category: (nullable): The category.
+ *
+ * Checks if a message at @level for @category would be output anywhere. Use
+ * this to skip expensive work, like dumping a whole network buffer, that is
+ * only done for the sake of debug output.
+ *
+ * Returns: %TRUE if the message would be output, otherwise %FALSE.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_debug_is_enabled(PurpleDebugLevel level, const gchar *category);
+
+/**
+ * purple_debug_set_level:
+ * @level: The minimum level.
+ *
+ * Sets the minimum level of messages that are output for categories that
+ * don't have their own level set with purple_debug_set_category_level().
+ * Messages below it are dropped before they are formatted. The default is
+ * %PURPLE_DEBUG_ALL.
+ *
+ * This can also be set with the `PURPLE_DEBUG_LEVELS` environment variable
+ * using a category of `*`, for example `*=info`.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_level(PurpleDebugLevel level);
+
+/**
+ * purple_debug_get_level:
+ *
+ * Gets the minimum level of messages that are output for categories that
+ * don't have their own level.
+ *
+ * Returns: The minimum level.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugLevel purple_debug_get_level(void);
+
+/**
+ * purple_debug_set_category_level:
+ * @category: The category.
+ * @level: The minimum level.
+ *
+ * Sets the minimum level of messages that are output for @category. Messages
+ * below it are dropped before they are formatted.
+ *
+ * This can also be set with the `PURPLE_DEBUG_LEVELS` environment variable,
+ * which is a comma separated list of `category=level` pairs, for example
+ * `jabber=warning,irc=misc`.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_category_level(const gchar *category, PurpleDebugLevel level);
+
+/**
+ * purple_debug_get_category_level:
+ * @category: The category.
+ *
+ * Gets the minimum level of messages that are output for @category, falling
+ * back to purple_debug_get_level() if it doesn't have its own.
+ *
+ * Returns: The minimum level.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugLevel purple_debug_get_category_level(const gchar *category);
+
 /**
  * purple_debug_set_verbose:
  * @verbose: %TRUE to enable verbose debugging or %FALSE to disable it.
@@ -185,6 +268,130 @@ void purple_debug_set_unsafe(gboolean unsafe);
  */
 gboolean purple_debug_is_unsafe(void);
 
+/******************************************************************************
+ * Debug Ring
+ *****************************************************************************/
+
+/**
+ * PurpleDebugRing:
+ *
+ * A bounded buffer of debug messages that user interfaces can fill from their
+ * log writer, on any thread, and then display in batches from the main loop.
+ * Once it's full, the oldest messages are dropped to make room, so it also
+ * serves as the history that is retained.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleDebugRing PurpleDebugRing;
+
+/**
+ * PurpleDebugRingFunc:
+ * @timestamp: When the message was pushed.
+ * @level: The level of the message.
+ * @category: (nullable): The category of the message.
+ * @message: The message.
+ * @data: User data.
+ *
+ * The type of function passed to purple_debug_ring_read().
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PurpleDebugRingFunc)(GDateTime *timestamp, PurpleDebugLevel level, const gchar *category, const gchar *message, gpointer data);
+
+/**
+ * purple_debug_ring_new:
+ * @capacity: The number of messages to keep.
+ *
+ * Creates a new ring that holds up to @capacity messages.
+ *
+ * Returns: (transfer full): The new ring.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugRing *purple_debug_ring_new(guint capacity);
+
+/**
+ * purple_debug_ring_free:
+ * @ring: (nullable): The instance.
+ *
+ * Frees @ring and all of the messages in it.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_ring_free(PurpleDebugRing *ring);
+
+/**
+ * purple_debug_ring_get_capacity:
+ * @ring: The instance.
+ *
+ * Gets the number of messages that @ring can hold.
+ *
+ * Returns: The capacity.
+ *
+ * Since: 3.0.0
+ */
+guint purple_debug_ring_get_capacity(PurpleDebugRing *ring);
+
+/**
+ * purple_debug_ring_set_capacity:
+ * @ring: The instance.
+ * @capacity: The number of messages to keep.
+ *
+ * Changes the number of messages that @ring can hold. If it's shrinking, the
+ * oldest messages are dropped.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_ring_set_capacity(PurpleDebugRing *ring, guint capacity);
+
+/**
+ * purple_debug_ring_push:
+ * @ring: The instance.
+ * @level: The level of the message.
+ * @category: (nullable): The category of the message.
+ * @message: The message.
+ *
+ * Adds a message to @ring, dropping the oldest message if it is full. This is
+ * safe to call from any thread.
+ *
+ * Returns: %TRUE if this is the first message since the last call to
+ *          purple_debug_ring_read(), which means the caller should arrange for
+ *          it to be read.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_debug_ring_push(PurpleDebugRing *ring, PurpleDebugLevel level, const gchar *category, const gchar *message);
+
+/**
+ * purple_debug_ring_read:
+ * @ring: The instance.
+ * @cursor: (inout): Where the previous read stopped, 0 for the start.
+ * @func: (scope call): The function to call for each message.
+ * @data: User data to pass to @func.
+ *
+ * Calls @func for every message in @ring that was pushed after @cursor, oldest
+ * first, and then updates @cursor so that the next call continues from there.
+ * Messages that were dropped before they could be read are skipped.
+ *
+ * Passing a cursor of 0 reads every message that's still in @ring.
+ *
+ * Returns: The number of messages that were read.
+ *
+ * Since: 3.0.0
+ */
+guint purple_debug_ring_read(PurpleDebugRing *ring, guint64 *cursor, PurpleDebugRingFunc func, gpointer data);
+
+/**
+ * purple_debug_ring_clear:
+ * @ring: The instance.
+ *
+ * Removes every message from @ring. Existing cursors remain valid, and the
+ * next call to purple_debug_ring_push() will ask to be read again.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_ring_clear(PurpleDebugRing *ring);
+
 /******************************************************************************
  * Debug Subsystem
  *****************************************************************************/
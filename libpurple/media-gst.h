@@ -206,6 +206,27 @@ void purple_media_manager_set_video_caps(PurpleMediaManager *manager,
  */
 GstCaps *purple_media_manager_get_video_caps(PurpleMediaManager *manager);
 
+/**
+ * purple_media_manager_send_application_buffer:
+ * @manager: The manager to send data with.
+ * @media: The media instance to which the session belongs.
+ * @session_id: The session to send data to.
+ * @participant: The participant to send data to.
+ * @buffer: (transfer none): The buffer to send.
+ * @blocking: Whether to block until the data was sent or not.
+ *
+ * Like purple_media_manager_send_application_data(), but pushes @buffer into
+ * the stream as is. A reference is taken on @buffer, so its memory must not be
+ * modified afterwards.
+ *
+ * Returns: Number of bytes sent or -1 in case of error.
+ *
+ * Since: 3.0.0
+ */
+gint purple_media_manager_send_application_buffer(PurpleMediaManager *manager,
+		PurpleMedia *media, const gchar *session_id, const gchar *participant,
+		GstBuffer *buffer, gboolean blocking);
+
 gchar *purple_media_element_info_get_id(PurpleMediaElementInfo *info);
 gchar *purple_media_element_info_get_name(PurpleMediaElementInfo *info);
 PurpleMediaElementType purple_media_element_info_get_element_type(
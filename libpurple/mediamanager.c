@@ -64,7 +64,8 @@ typedef struct
 	GstDeviceMonitor *device_monitor;
 
 	/* Application data streams */
-	GList *appdata_info; /* holds PurpleMediaAppDataInfo */
+	/* PurpleMedia * -> (session id -> GList of PurpleMediaAppDataInfo) */
+	GHashTable *appdata_info;
 	GMutex appdata_mutex;
 	guint appdata_cb_token; /* last used read/write callback token */
 } PurpleMediaManagerPrivate;
@@ -106,6 +107,7 @@ typedef struct {
 
 static void purple_media_manager_finalize (GObject *object);
 static void free_appdata_info_locked (PurpleMediaAppDataInfo *info);
+static void free_appdata_info_list_locked (GList *list);
 static void purple_media_manager_init_device_monitor(PurpleMediaManager *manager);
 static void purple_media_manager_register_static_elements(PurpleMediaManager *manager);
 
@@ -168,7 +170,8 @@ purple_media_manager_init (PurpleMediaManager *media)
 	media->priv->medias = NULL;
 	media->priv->private_medias = NULL;
 	media->priv->next_output_window_id = 1;
-	media->priv->appdata_info = NULL;
+	media->priv->appdata_info = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, (GDestroyNotify)g_hash_table_destroy);
 	g_mutex_init (&media->priv->appdata_mutex);
 	if (gst_init_check(NULL, NULL, &error)) {
 		purple_media_manager_register_static_elements(media);
@@ -199,8 +202,7 @@ purple_media_manager_finalize (GObject *media)
 	g_list_free_full(priv->private_medias, g_object_unref);
 	g_list_free_full(priv->elements, g_object_unref);
 	g_clear_pointer(&priv->video_caps, gst_caps_unref);
-	g_clear_list(&priv->appdata_info,
-	             (GDestroyNotify)free_appdata_info_locked);
+	g_clear_pointer(&priv->appdata_info, g_hash_table_destroy);
 	g_mutex_clear (&priv->appdata_mutex);
 	if (priv->device_monitor) {
 		gst_device_monitor_stop(priv->device_monitor);
@@ -373,19 +375,7 @@ purple_media_manager_remove_media(PurpleMediaManager *manager, PurpleMedia *medi
 		*medias = g_list_delete_link(*medias, list);
 
 		g_mutex_lock (&manager->priv->appdata_mutex);
-		list = manager->priv->appdata_info;
-		while (list) {
-			PurpleMediaAppDataInfo *info = list->data;
-			GList *next = list->next;
-
-			if (info->media == media) {
-				manager->priv->appdata_info = g_list_delete_link (
-					manager->priv->appdata_info, list);
-				free_appdata_info_locked (info);
-			}
-
-			list = next;
-		}
+		g_hash_table_remove(manager->priv->appdata_info, media);
 		g_mutex_unlock (&manager->priv->appdata_mutex);
 	}
 }
@@ -490,6 +480,12 @@ free_appdata_info_locked (PurpleMediaAppDataInfo *info)
 	g_slice_free (PurpleMediaAppDataInfo, info);
 }
 
+static void
+free_appdata_info_list_locked (GList *list)
+{
+	g_list_free_full(list, (GDestroyNotify)free_appdata_info_locked);
+}
+
 /*
  * Get an app data info struct associated with a session and lock the mutex
  * We don't want to return an info struct and unlock then it gets destroyed
@@ -499,16 +495,21 @@ static PurpleMediaAppDataInfo *
 get_app_data_info_and_lock (PurpleMediaManager *manager,
 	PurpleMedia *media, const gchar *session_id, const gchar *participant)
 {
+	GHashTable *sessions;
 	GList *i;
 
 	g_mutex_lock (&manager->priv->appdata_mutex);
-	for (i = manager->priv->appdata_info; i; i = i->next) {
+	sessions = g_hash_table_lookup(manager->priv->appdata_info, media);
+	if (sessions == NULL || session_id == NULL) {
+		return NULL;
+	}
+
+	/* A session rarely has more than one participant, so the list is short. */
+	for (i = g_hash_table_lookup(sessions, session_id); i; i = i->next) {
 		PurpleMediaAppDataInfo *info = i->data;
 
-		if (info->media == media &&
-			purple_strequal (info->session_id, session_id) &&
-			(participant == NULL ||
-				purple_strequal (info->participant, participant))) {
+		if (participant == NULL ||
+			purple_strequal (info->participant, participant)) {
 			return info;
 		}
 	}
@@ -528,14 +529,30 @@ ensure_app_data_info_and_lock (PurpleMediaManager *manager, PurpleMedia *media,
 		session_id, participant);
 
 	if (info == NULL) {
+		GHashTable *sessions;
+		gchar *key = NULL;
+		GList *list = NULL;
+
 		info = g_slice_new0 (PurpleMediaAppDataInfo);
 		info->media = media;
 		g_weak_ref_init (&info->media_ref, media);
 		info->session_id = g_strdup (session_id);
 		info->participant = g_strdup (participant);
 		g_cond_init (&info->readable_cond);
-		manager->priv->appdata_info = g_list_prepend (
-			manager->priv->appdata_info, info);
+
+		sessions = g_hash_table_lookup(manager->priv->appdata_info, media);
+		if (sessions == NULL) {
+			sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify)free_appdata_info_list_locked);
+			g_hash_table_insert(manager->priv->appdata_info, media, sessions);
+		}
+
+		/* Steal the list so we can prepend without freeing the old head. */
+		if (!g_hash_table_steal_extended(sessions, session_id,
+				(gpointer *)&key, (gpointer *)&list)) {
+			key = g_strdup(session_id);
+		}
+		g_hash_table_insert(sessions, key, g_list_prepend(list, info));
 	}
 
 	return info;
@@ -1593,40 +1610,99 @@ purple_media_manager_set_application_data_callbacks(PurpleMediaManager *manager,
 	g_mutex_unlock (&manager->priv->appdata_mutex);
 }
 
-gint
-purple_media_manager_send_application_data (
-	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
-	const gchar *participant, gpointer buffer, guint size, gboolean blocking)
+/*
+ * Pushes @gstbuffer, which we take ownership of, into the appsrc of the
+ * session. The appdata lock is only held long enough to look up the session,
+ * so callers should build the buffer before calling this.
+ */
+static gint
+send_application_buffer(PurpleMediaManager *manager, PurpleMedia *media,
+                        const gchar *session_id, const gchar *participant,
+                        GstBuffer *gstbuffer, gboolean blocking)
 {
 	PurpleMediaAppDataInfo * info = get_app_data_info_and_lock (manager,
 		media, session_id, participant);
+	GstAppSrc *appsrc;
+	gsize size;
 
-	if (info && info->appsrc && info->connected) {
-		GstBuffer *gstbuffer = gst_buffer_new_wrapped (g_memdup2(buffer, size),
-			size);
-		GstAppSrc *appsrc = gst_object_ref (info->appsrc);
-
+	if (info == NULL || info->appsrc == NULL || !info->connected) {
 		g_mutex_unlock (&manager->priv->appdata_mutex);
-		if (gst_app_src_push_buffer (appsrc, gstbuffer) == GST_FLOW_OK) {
-			if (blocking) {
-				GstPad *srcpad;
-
-				srcpad = gst_element_get_static_pad (GST_ELEMENT (appsrc),
-					"src");
-				if (srcpad) {
-					gst_pad_peer_query (srcpad, gst_query_new_drain ());
-					gst_object_unref (srcpad);
-				}
-			}
-			gst_object_unref (appsrc);
-			return size;
-		} else {
-			gst_object_unref (appsrc);
-			return -1;
-		}
+		gst_buffer_unref(gstbuffer);
+		return -1;
 	}
+
+	appsrc = gst_object_ref (info->appsrc);
 	g_mutex_unlock (&manager->priv->appdata_mutex);
-	return -1;
+
+	size = gst_buffer_get_size(gstbuffer);
+	if (gst_app_src_push_buffer (appsrc, gstbuffer) != GST_FLOW_OK) {
+		gst_object_unref (appsrc);
+		return -1;
+	}
+
+	if (blocking) {
+		GstPad *srcpad;
+
+		srcpad = gst_element_get_static_pad (GST_ELEMENT (appsrc), "src");
+		if (srcpad) {
+			gst_pad_peer_query (srcpad, gst_query_new_drain ());
+			gst_object_unref (srcpad);
+		}
+	}
+	gst_object_unref (appsrc);
+
+	return size;
+}
+
+gint
+purple_media_manager_send_application_data (
+	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
+	const gchar *participant, gpointer buffer, guint size, gboolean blocking)
+{
+	GstBuffer *gstbuffer = gst_buffer_new_wrapped (g_memdup2(buffer, size),
+		size);
+
+	return send_application_buffer(manager, media, session_id, participant,
+	                               gstbuffer, blocking);
+}
+
+gint
+purple_media_manager_send_application_data_bytes(PurpleMediaManager *manager,
+                                                 PurpleMedia *media,
+                                                 const gchar *session_id,
+                                                 const gchar *participant,
+                                                 GBytes *bytes,
+                                                 gboolean blocking)
+{
+	GstBuffer *gstbuffer = NULL;
+	gconstpointer data = NULL;
+	gsize size = 0;
+
+	g_return_val_if_fail(bytes != NULL, -1);
+
+	/* The GstBuffer keeps a reference on the GBytes instead of copying it. */
+	data = g_bytes_get_data(bytes, &size);
+	gstbuffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+	                                        (gpointer)data, size, 0, size,
+	                                        g_bytes_ref(bytes),
+	                                        (GDestroyNotify)g_bytes_unref);
+
+	return send_application_buffer(manager, media, session_id, participant,
+	                               gstbuffer, blocking);
+}
+
+gint
+purple_media_manager_send_application_buffer(PurpleMediaManager *manager,
+                                             PurpleMedia *media,
+                                             const gchar *session_id,
+                                             const gchar *participant,
+                                             GstBuffer *buffer,
+                                             gboolean blocking)
+{
+	g_return_val_if_fail(GST_IS_BUFFER(buffer), -1);
+
+	return send_application_buffer(manager, media, session_id, participant,
+	                               gst_buffer_ref(buffer), blocking);
 }
 
 gint
@@ -1712,6 +1788,106 @@ purple_media_manager_receive_application_data (
 	return -1;
 }
 
+typedef struct {
+	GstBuffer *buffer;
+	GstMapInfo map;
+} PurpleMediaAppDataMapping;
+
+static void
+app_data_mapping_free(PurpleMediaAppDataMapping *mapping)
+{
+	gst_buffer_unmap(mapping->buffer, &mapping->map);
+	gst_buffer_unref(mapping->buffer);
+	g_free(mapping);
+}
+
+GBytes *
+purple_media_manager_receive_application_bytes(PurpleMediaManager *manager,
+                                               PurpleMedia *media,
+                                               const gchar *session_id,
+                                               const gchar *participant,
+                                               gboolean blocking)
+{
+	PurpleMediaAppDataInfo * info = get_app_data_info_and_lock (manager,
+		media, session_id, participant);
+	PurpleMediaAppDataMapping *mapping = NULL;
+	GstBuffer *gstbuffer = NULL;
+	GBytes *bytes = NULL;
+
+	while (info != NULL) {
+		if (!info->current_sample && info->appsink && info->num_samples > 0) {
+			info->current_sample = gst_app_sink_pull_sample (info->appsink);
+			info->sample_offset = 0;
+			if (info->current_sample) {
+				info->num_samples--;
+			}
+		}
+
+		if (info->current_sample) {
+			gstbuffer = gst_sample_get_buffer (info->current_sample);
+			if (gstbuffer) {
+				gst_buffer_ref(gstbuffer);
+				break;
+			}
+
+			/* In case there's no buffer in the sample (should never
+			 * happen), we need to at least unref it */
+			gst_sample_unref (info->current_sample);
+			info->current_sample = NULL;
+			info->sample_offset = 0;
+			continue;
+		}
+
+		if (!blocking || info->num_samples > 0) {
+			break;
+		}
+
+		/* See purple_media_manager_receive_application_data() for why we
+		 * have to look the info struct up again after waiting. */
+		g_cond_wait (&info->readable_cond, &manager->priv->appdata_mutex);
+		g_mutex_unlock (&manager->priv->appdata_mutex);
+		info = get_app_data_info_and_lock (manager, media, session_id,
+			participant);
+		if (info != NULL && info->appsink == NULL) {
+			info = NULL;
+		}
+	}
+
+	if (info == NULL) {
+		g_mutex_unlock (&manager->priv->appdata_mutex);
+		return NULL;
+	}
+
+	if (gstbuffer == NULL) {
+		g_mutex_unlock (&manager->priv->appdata_mutex);
+		return g_bytes_new(NULL, 0);
+	}
+
+	mapping = g_new0(PurpleMediaAppDataMapping, 1);
+	mapping->buffer = gstbuffer;
+	if (!gst_buffer_map(gstbuffer, &mapping->map, GST_MAP_READ)) {
+		g_free(mapping);
+		gst_buffer_unref(gstbuffer);
+		g_mutex_unlock (&manager->priv->appdata_mutex);
+		return NULL;
+	}
+
+	/* Hand out whatever a partial read with
+	 * purple_media_manager_receive_application_data() left behind, and
+	 * consume the rest of the sample. */
+	bytes = g_bytes_new_with_free_func(mapping->map.data + info->sample_offset,
+	                                   mapping->map.size - info->sample_offset,
+	                                   (GDestroyNotify)app_data_mapping_free,
+	                                   mapping);
+
+	g_clear_pointer(&info->current_sample, gst_sample_unref);
+	info->sample_offset = 0;
+
+	g_mutex_unlock (&manager->priv->appdata_mutex);
+
+	return bytes;
+}
+
 static void
 videosink_disable_last_sample(GstElement *sink)
 {
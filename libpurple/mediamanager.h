@@ -352,6 +352,51 @@ gint purple_media_manager_receive_application_data (
 	const gchar *participant, gpointer buffer, guint max_size,
 	gboolean blocking);
 
+/**
+ * purple_media_manager_send_application_data_bytes:
+ * @manager: The manager to send data with.
+ * @media: The media instance to which the session belongs.
+ * @session_id: The session to send data to.
+ * @participant: The participant to send data to.
+ * @bytes: (transfer none): The data to send.
+ * @blocking: Whether to block until the data was sent or not.
+ *
+ * Like purple_media_manager_send_application_data(), but sends @bytes without
+ * copying it. A reference is held on @bytes until the data has been sent.
+ *
+ * Returns: Number of bytes sent or -1 in case of error.
+ *
+ * Since: 3.0.0
+ */
+gint purple_media_manager_send_application_data_bytes(
+	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
+	const gchar *participant, GBytes *bytes, gboolean blocking);
+
+/**
+ * purple_media_manager_receive_application_bytes:
+ * @manager: The manager to receive data with.
+ * @media: The media instance to which the session belongs.
+ * @session_id: The session to receive data from.
+ * @participant: The participant to receive data from.
+ * @blocking: Whether to block until data is available.
+ *
+ * Receives the next chunk of data from a #PURPLE_MEDIA_APPLICATION session.
+ * Unlike purple_media_manager_receive_application_data(), the data is not
+ * copied; the returned #GBytes is a read-only view of the received buffer and
+ * keeps it alive until it is unreferenced.
+ *
+ * If @blocking is not set and no data is available, an empty #GBytes is
+ * returned.
+ *
+ * Returns: (transfer full) (nullable): The received data or %NULL in case of
+ *          error.
+ *
+ * Since: 3.0.0
+ */
+GBytes *purple_media_manager_receive_application_bytes(
+	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
+	const gchar *participant, gboolean blocking);
+
 /*}@*/
 
 G_END_DECLS
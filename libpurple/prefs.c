@@ -34,6 +34,7 @@
 
 #include "prefs.h"
 #include "debug.h"
+#include "purpleconfigjournal.h"
 #include "purplepath.h"
 #include "util.h"
 #ifdef _WIN32
@@ -95,6 +96,12 @@ static GHashTable *prefs_hash = NULL;
 static guint       save_timer = 0;
 static gboolean    prefs_loaded = FALSE;
 
+/* The prefs that were added or changed since prefs.xml was last synced. If
+ * the file couldn't be read, everything is written on the next sync. */
+static PurpleConfigJournal *prefs_journal = NULL;
+static GHashTable *dirty_prefs = NULL;
+static gboolean    prefs_full_sync = FALSE;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
@@ -205,11 +212,73 @@ prefs_to_xmlnode(void)
 	return node;
 }
 
+static gchar *
+prefs_journal_key(PurpleXmlNode *node, guint depth, gboolean *container)
+{
+	if (!purple_strequal(node->name, "pref"))
+		return NULL;
+
+	*container = (depth == 0 || purple_xmlnode_get_child(node, "pref"));
+
+	return g_strdup(purple_xmlnode_get_attrib(node, "name"));
+}
+
+/* Returns the names leading to @pref, not including the root or @pref. */
+static const gchar **
+pref_journal_path(struct purple_pref *pref)
+{
+	struct purple_pref *parent;
+	const gchar **path;
+	guint depth = 0;
+
+	for (parent = pref->parent; parent != &prefs; parent = parent->parent)
+		depth++;
+
+	path = g_new0(const gchar *, depth + 1);
+	for (parent = pref->parent; parent != &prefs; parent = parent->parent)
+		path[--depth] = parent->name;
+
+	return path;
+}
+
+static void
+mark_pref_dirty(struct purple_pref *pref)
+{
+	if (!prefs_loaded || pref == NULL || pref == &prefs)
+		return;
+
+	g_hash_table_add(dirty_prefs, pref);
+}
+
+static void
+sync_pref(struct purple_pref *pref)
+{
+	struct purple_pref *parent;
+	PurpleXmlNode *node;
+	const gchar **path;
+
+	/* A dirty parent writes this pref as well. */
+	for (parent = pref->parent; parent != &prefs; parent = parent->parent) {
+		if (g_hash_table_contains(dirty_prefs, parent))
+			return;
+	}
+
+	node = purple_xmlnode_new("pref");
+	pref_to_xmlnode(node, pref);
+
+	path = pref_journal_path(pref);
+	purple_config_journal_set(prefs_journal, path, node->child);
+	g_free(path);
+
+	purple_xmlnode_free(node);
+}
+
 static void
 sync_prefs(void)
 {
 	PurpleXmlNode *node;
-	char *data;
+	GHashTableIter iter;
+	gpointer pref;
 
 	if (!prefs_loaded)
 	{
@@ -222,11 +291,28 @@ sync_prefs(void)
 		return;
 	}
 
-	node = prefs_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("prefs.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	if (prefs_full_sync) {
+		node = prefs_to_xmlnode();
+		purple_config_journal_replace(prefs_journal, NULL, node);
+		purple_xmlnode_free(node);
+
+		prefs_full_sync = FALSE;
+	} else {
+		/* Only the root's own attributes, its children are left alone. */
+		node = purple_xmlnode_new("pref");
+		purple_xmlnode_set_attrib(node, "version", "1");
+		purple_xmlnode_set_attrib(node, "name", "/");
+		purple_config_journal_set(prefs_journal, NULL, node);
+		purple_xmlnode_free(node);
+
+		g_hash_table_iter_init(&iter, dirty_prefs);
+		while (g_hash_table_iter_next(&iter, &pref, NULL))
+			sync_pref(pref);
+	}
+
+	g_hash_table_remove_all(dirty_prefs);
+
+	purple_config_journal_save(prefs_journal);
 }
 
 static gboolean
@@ -398,6 +484,16 @@ purple_prefs_load(void)
 	GMarkupParseContext *context;
 	GError *error = NULL;
 
+	if (prefs_journal == NULL) {
+		prefs_journal = purple_config_journal_new("prefs.xml",
+		                                          prefs_journal_key);
+		dirty_prefs = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+	purple_config_journal_recover(prefs_journal);
+
+	/* Whatever is in memory when prefs.xml can't be read replaces it. */
+	prefs_full_sync = TRUE;
+
 	filename = g_build_filename(purple_config_dir(), "prefs.xml", NULL);
 
 	if (!filename) {
@@ -454,9 +550,12 @@ purple_prefs_load(void)
 		purple_debug_misc("prefs", "Finished reading %s", filename);
 	g_markup_parse_context_free(context);
 	g_free(contents);
-	g_free(filename);
 	prefs_loaded = TRUE;
 
+	/* The system wide prefs still need to be written out for the user. */
+	prefs_full_sync = !g_str_has_prefix(filename, purple_config_dir());
+	g_free(filename);
+
 	return TRUE;
 }
 
@@ -471,6 +570,7 @@ prefs_save_cb(const char *name, G_GNUC_UNUSED PurplePrefType type,
 
 	purple_debug_misc("prefs", "%s changed, scheduling save.\n", name);
 
+	mark_pref_dirty(find_pref(name));
 	schedule_prefs_save();
 }
 
@@ -607,6 +707,12 @@ add_pref(PurplePrefType type, const char *name)
 
 	g_hash_table_insert(prefs_hash, g_strdup(name), (gpointer)me);
 
+	/* A pref without children is stored on its own, so it has to be written
+	 * again once it has one. */
+	if (parent->first_child == me)
+		mark_pref_dirty(parent);
+	mark_pref_dirty(me);
+
 	return me;
 }
 
@@ -723,6 +829,9 @@ free_pref(struct purple_pref *pref)
 	g_hash_table_remove(prefs_hash, name);
 	g_free(name);
 
+	if (dirty_prefs != NULL)
+		g_hash_table_remove(dirty_prefs, pref);
+
 	free_pref_value(pref);
 
 	g_slist_free_full(pref->callbacks, g_free);
@@ -765,6 +874,19 @@ remove_pref(struct purple_pref *pref)
 		return;
 	}
 
+	if (prefs_loaded) {
+		const gchar **path = pref_journal_path(pref);
+		guint depth = g_strv_length((gchar **)path);
+
+		path = g_renew(const gchar *, path, depth + 2);
+		path[depth] = pref->name;
+		path[depth + 1] = NULL;
+		purple_config_journal_remove(prefs_journal, path);
+		g_free(path);
+
+		schedule_prefs_save();
+	}
+
 	if (pref->parent->first_child == pref) {
 		pref->parent->first_child = pref->sibling;
 	} else {
@@ -1486,4 +1608,7 @@ purple_prefs_uninit(void)
 	prefs_loaded = FALSE;
 	purple_prefs_destroy();
 	g_clear_pointer(&prefs_hash, g_hash_table_destroy);
+
+	g_clear_pointer(&prefs_journal, purple_config_journal_free);
+	g_clear_pointer(&dirty_prefs, g_hash_table_destroy);
 }
@@ -112,6 +112,8 @@ bonjour_login(G_GNUC_UNUSED PurpleProtocol *protocol, PurpleAccount *account) {
 	purple_connection_set_flags(gc, PURPLE_CONNECTION_FLAG_HTML |
 		PURPLE_CONNECTION_FLAG_NO_IMAGES);
 	bd = g_new0(BonjourData, 1);
+	bd->xfers_by_sid = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                         NULL);
 	purple_connection_set_protocol_data(gc, bd);
 
 	/* Start waiting for xmpp connections (iChat style) */
@@ -197,8 +199,10 @@ bonjour_close(G_GNUC_UNUSED PurpleProtocol *protocol,
 		purple_xfer_cancel_local(bd->xfer_lists->data);
 	}
 
-	if (bd != NULL)
+	if (bd != NULL) {
 		g_free(bd->jid);
+		g_clear_pointer(&bd->xfers_by_sid, g_hash_table_destroy);
+	}
 	g_free(bd);
 	purple_connection_set_protocol_data(connection, NULL);
 }
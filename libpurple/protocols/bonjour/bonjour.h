@@ -51,6 +51,7 @@ typedef struct
 	BonjourDnsSd *dns_sd_data;
 	BonjourXMPP *xmpp_data;
 	GSList *xfer_lists;
+	GHashTable *xfers_by_sid;
 	gchar *jid;
 } BonjourData;
 
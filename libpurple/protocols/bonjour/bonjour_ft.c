@@ -147,34 +147,75 @@ static void bonjour_xfer_end(PurpleXfer *xfer)
 	}
 }
 
-static PurpleXfer*
+/* The key for xfers_by_sid. \x1f can't appear in a sid or a buddy name. */
+static gchar *
+bonjour_si_xfer_key(const char *sid, const char *from)
+{
+	return g_strconcat(sid, "\x1f", from, NULL);
+}
+
+static void
+bonjour_si_xfer_index(XepXfer *xf)
+{
+	BonjourData *bd = xf->data;
+	const char *who = purple_xfer_get_remote_user(PURPLE_XFER(xf));
+
+	if (bd == NULL || bd->xfers_by_sid == NULL || xf->sid == NULL ||
+			who == NULL) {
+		return;
+	}
+
+	g_hash_table_replace(bd->xfers_by_sid, bonjour_si_xfer_key(xf->sid, who),
+	                     xf);
+}
+
+static void
+bonjour_si_xfer_unindex(XepXfer *xf)
+{
+	BonjourData *bd = xf->data;
+	const char *who = purple_xfer_get_remote_user(PURPLE_XFER(xf));
+	gchar *key;
+
+	if (bd == NULL || bd->xfers_by_sid == NULL || xf->sid == NULL ||
+			who == NULL) {
+		return;
+	}
+
+	key = bonjour_si_xfer_key(xf->sid, who);
+	if (g_hash_table_lookup(bd->xfers_by_sid, key) == xf) {
+		g_hash_table_remove(bd->xfers_by_sid, key);
+	}
+	g_free(key);
+}
+
+void
+bonjour_si_xfer_set_sid(XepXfer *xf, const char *sid)
+{
+	bonjour_si_xfer_unindex(xf);
+	g_free(xf->sid);
+	xf->sid = g_strdup(sid);
+	bonjour_si_xfer_index(xf);
+}
+
+PurpleXfer*
 bonjour_si_xfer_find(BonjourData *bd, const char *sid, const char *from)
 {
-	GSList *xfers;
 	PurpleXfer *xfer;
-	XepXfer *xf;
+	gchar *key;
 
-	if(!sid || !from || !bd)
+	if(!sid || !from || !bd || !bd->xfers_by_sid)
 		return NULL;
 
-	purple_debug_info("bonjour", "Look for sid=%s from=%s xferlists.\n",
-			  sid, from);
+	key = bonjour_si_xfer_key(sid, from);
+	xfer = g_hash_table_lookup(bd->xfers_by_sid, key);
+	g_free(key);
 
-	for(xfers = bd->xfer_lists; xfers; xfers = xfers->next) {
-		xfer = xfers->data;
-		if(xfer == NULL)
-			break;
-		xf = XEP_XFER(xfer);
-		if(xf == NULL)
-			break;
-		if(xf->sid && purple_xfer_get_remote_user(xfer) && purple_strequal(xf->sid, sid) &&
-				purple_strequal(purple_xfer_get_remote_user(xfer), from))
-			return xfer;
+	if (xfer == NULL) {
+		purple_debug_info("bonjour", "No xfer with sid=%s from=%s\n", sid,
+		                  from);
 	}
 
-	purple_debug_info("bonjour", "Look for xfer list fail\n");
-
-	return NULL;
+	return xfer;
 }
 
 static void
@@ -206,8 +247,7 @@ xep_ft_si_offer(PurpleXfer *xfer, const gchar *to)
 	si_node = purple_xmlnode_new_child(iq->node, "si");
 	purple_xmlnode_set_namespace(si_node, "http://jabber.org/protocol/si");
 	purple_xmlnode_set_attrib(si_node, "profile", "http://jabber.org/protocol/si/profile/file-transfer");
-	g_free(xf->sid);
-	xf->sid = g_strdup(xf->iq_id);
+	bonjour_si_xfer_set_sid(xf, xf->iq_id);
 	purple_xmlnode_set_attrib(si_node, "id", xf->sid);
 
 	file = purple_xmlnode_new_child(si_node, "file");
@@ -333,7 +373,7 @@ bonjour_new_xfer(G_GNUC_UNUSED PurpleProtocolXfer *prplxfer,
 	xep_xfer->mode = XEP_BYTESTREAMS;
 	xep_xfer->sid = NULL;
 
-	bd->xfer_lists = g_slist_append(bd->xfer_lists, xfer);
+	bd->xfer_lists = g_slist_prepend(bd->xfer_lists, xfer);
 
 	return xfer;
 }
@@ -751,12 +791,12 @@ bonjour_xfer_receive(PurpleConnection *pc, const char *id, const char *sid,
 	xf->data = bd;
 	purple_xfer_set_filename(xfer, filename);
 	xf->iq_id = g_strdup(id);
-	xf->sid = g_strdup(sid);
 
 	if(filesize > 0)
 		purple_xfer_set_size(xfer, filesize);
 
-	bd->xfer_lists = g_slist_append(bd->xfer_lists, xfer);
+	bd->xfer_lists = g_slist_prepend(bd->xfer_lists, xfer);
+	bonjour_si_xfer_set_sid(xf, sid);
 
 	purple_xfer_request(xfer);
 }
@@ -1181,6 +1221,7 @@ xep_xfer_finalize(GObject *obj) {
 
 	if(bd != NULL) {
 		bd->xfer_lists = g_slist_remove(bd->xfer_lists, PURPLE_XFER(xf));
+		bonjour_si_xfer_unindex(xf);
 		purple_debug_misc("bonjour", "B free xfer from lists(%p).\n", bd->xfer_lists);
 	}
 	g_cancellable_cancel(xf->cancellable);
@@ -24,6 +24,8 @@
 
 #include <purple.h>
 
+#include "bonjour.h"
+
 G_BEGIN_DECLS
 
 #define XEP_TYPE_XFER (xep_xfer_get_type())
@@ -52,6 +54,24 @@ PurpleXfer *bonjour_new_xfer(PurpleProtocolXfer *prplxfer, PurpleConnection *gc,
  */
 void bonjour_send_file(PurpleProtocolXfer *prplxfer, PurpleConnection *gc, const char *who, const char *file);
 
+/**
+ * Set the stream id of a transfer, which also indexes it for
+ * bonjour_si_xfer_find().
+ *
+ * @param xf The transfer.
+ * @param sid The stream id.
+ */
+void bonjour_si_xfer_set_sid(XepXfer *xf, const char *sid);
+
+/**
+ * Find a transfer by its stream id and the buddy it is with.
+ *
+ * @param bd The BonjourData of the connection.
+ * @param sid The stream id.
+ * @param from The name of the buddy.
+ */
+PurpleXfer *bonjour_si_xfer_find(BonjourData *bd, const char *sid, const char *from);
+
 void xep_si_parse(PurpleConnection *pc, PurpleXmlNode *packet, PurpleContact *contact);
 void xep_bytestreams_parse(PurpleConnection *pc, PurpleXmlNode *packet, PurpleContact *contact);
 
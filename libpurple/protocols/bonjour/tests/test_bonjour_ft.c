@@ -0,0 +1,200 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/bonjour/bonjour.h"
+#include "protocols/bonjour/bonjour_ft.h"
+
+#define TEST_BONJOUR_FT_ALICE "alice@alices-machine"
+#define TEST_BONJOUR_FT_BOB "bob@bobs-machine"
+
+/******************************************************************************
+ * TestBonjourFtModule, to register the dynamic transfer type with
+ *****************************************************************************/
+static GType test_bonjour_ft_module_get_type(void);
+
+typedef struct {
+	GTypeModule parent;
+} TestBonjourFtModule;
+
+typedef struct {
+	GTypeModuleClass parent;
+} TestBonjourFtModuleClass;
+
+G_DEFINE_TYPE(TestBonjourFtModule, test_bonjour_ft_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+test_bonjour_ft_module_load(G_GNUC_UNUSED GTypeModule *module) {
+	return TRUE;
+}
+
+static void
+test_bonjour_ft_module_unload(G_GNUC_UNUSED GTypeModule *module) {
+}
+
+static void
+test_bonjour_ft_module_init(G_GNUC_UNUSED TestBonjourFtModule *module) {
+}
+
+static void
+test_bonjour_ft_module_class_init(TestBonjourFtModuleClass *klass) {
+	GTypeModuleClass *module_class = G_TYPE_MODULE_CLASS(klass);
+
+	module_class->load = test_bonjour_ft_module_load;
+	module_class->unload = test_bonjour_ft_module_unload;
+}
+
+/******************************************************************************
+ * TestBonjourFtProtocol
+ *****************************************************************************/
+static GType test_bonjour_ft_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestBonjourFtProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestBonjourFtProtocolClass;
+
+G_DEFINE_TYPE(TestBonjourFtProtocol, test_bonjour_ft_protocol,
+              PURPLE_TYPE_PROTOCOL)
+
+static void
+test_bonjour_ft_protocol_init(G_GNUC_UNUSED TestBonjourFtProtocol *protocol) {
+}
+
+static void
+test_bonjour_ft_protocol_class_init(G_GNUC_UNUSED TestBonjourFtProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleConnection *connection;
+	BonjourData *bd;
+} TestBonjourFtFixture;
+
+static void
+test_bonjour_ft_setup(TestBonjourFtFixture *fixture,
+                      G_GNUC_UNUSED gconstpointer data)
+{
+	fixture->protocol = g_object_new(test_bonjour_ft_protocol_get_type(),
+	                                 "id", "prpl-test-bonjour-ft", NULL);
+	fixture->connection = g_object_new(PURPLE_TYPE_CONNECTION,
+	                                   "protocol", fixture->protocol, NULL);
+
+	fixture->bd = g_new0(BonjourData, 1);
+	fixture->bd->xfers_by_sid = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                                  g_free, NULL);
+	purple_connection_set_protocol_data(fixture->connection, fixture->bd);
+}
+
+static void
+test_bonjour_ft_teardown(TestBonjourFtFixture *fixture,
+                         G_GNUC_UNUSED gconstpointer data)
+{
+	g_assert_null(fixture->bd->xfer_lists);
+
+	g_hash_table_destroy(fixture->bd->xfers_by_sid);
+	g_free(fixture->bd);
+
+	g_clear_object(&fixture->connection);
+	g_clear_object(&fixture->protocol);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_bonjour_ft_find(TestBonjourFtFixture *fixture,
+                     G_GNUC_UNUSED gconstpointer data)
+{
+	BonjourData *bd = fixture->bd;
+	PurpleXfer *alice = NULL, *bob = NULL;
+
+	alice = bonjour_new_xfer(NULL, fixture->connection,
+	                         TEST_BONJOUR_FT_ALICE);
+	bob = bonjour_new_xfer(NULL, fixture->connection, TEST_BONJOUR_FT_BOB);
+
+	/* Nothing can be found before it has a stream id. */
+	g_assert_null(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_ALICE));
+
+	/* The same stream id from different buddies is a different transfer. */
+	bonjour_si_xfer_set_sid(XEP_XFER(alice), "1");
+	bonjour_si_xfer_set_sid(XEP_XFER(bob), "1");
+	g_assert_true(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_ALICE) ==
+	              alice);
+	g_assert_true(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_BOB) == bob);
+	g_assert_null(bonjour_si_xfer_find(bd, "2", TEST_BONJOUR_FT_ALICE));
+	g_assert_null(bonjour_si_xfer_find(bd, "1", "carol@carols-machine"));
+
+	/* A new stream id replaces the old one. */
+	bonjour_si_xfer_set_sid(XEP_XFER(alice), "2");
+	g_assert_null(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_ALICE));
+	g_assert_true(bonjour_si_xfer_find(bd, "2", TEST_BONJOUR_FT_ALICE) ==
+	              alice);
+	g_assert_true(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_BOB) == bob);
+
+	/* A transfer is dropped from the index when it goes away. */
+	g_object_unref(alice);
+	g_assert_null(bonjour_si_xfer_find(bd, "2", TEST_BONJOUR_FT_ALICE));
+	g_assert_true(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_BOB) == bob);
+
+	g_object_unref(bob);
+	g_assert_null(bonjour_si_xfer_find(bd, "1", TEST_BONJOUR_FT_BOB));
+	g_assert_cmpuint(g_hash_table_size(bd->xfers_by_sid), ==, 0);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	GTypeModule *module = NULL;
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	purple_signals_init();
+	purple_connections_init();
+
+	/* Type modules can't be freed, so this is never unreffed. */
+	module = g_object_new(test_bonjour_ft_module_get_type(), NULL);
+	xep_xfer_register(module);
+
+	g_test_add("/bonjour/ft/find", TestBonjourFtFixture, NULL,
+	           test_bonjour_ft_setup, test_bonjour_ft_find,
+	           test_bonjour_ft_teardown);
+
+	ret = g_test_run();
+
+	purple_connections_uninit();
+	purple_signals_uninit();
+
+	return ret;
+}
@@ -23,11 +23,22 @@
 #include "purpleircv3messagehandlers.h"
 #include "purpleircv3sasl.h"
 
+/* The parser tokenizes each line in place, so it needs somewhere to copy the
+ * line to and somewhere to put the results. These are kept around between
+ * calls so that parsing a line doesn't allocate once they have grown large
+ * enough.
+ */
+typedef struct {
+	GString *line;
+	GPtrArray *params;
+	GHashTable *tags;
+} PurpleIRCv3ParserScratch;
+
 struct _PurpleIRCv3Parser {
 	GObject parent;
 
-	GRegex *regex_message;
-	GRegex *regex_tags;
+	PurpleIRCv3ParserScratch scratch;
+	gboolean parsing;
 
 	PurpleIRCv3MessageHandler fallback_handler;
 	GHashTable *handlers;
@@ -38,178 +49,216 @@ G_DEFINE_TYPE(PurpleIRCv3Parser, purple_ircv3_parser, G_TYPE_OBJECT)
 /******************************************************************************
  * Helpers
  *****************************************************************************/
-static char *
-purple_ircv3_parser_unescape_tag_value(const char *value) {
-	GString *unescaped = g_string_new("");
-	gboolean escaping = FALSE;
+static void
+purple_ircv3_parser_scratch_init(PurpleIRCv3ParserScratch *scratch) {
+	scratch->line = g_string_sized_new(512);
+	scratch->params = g_ptr_array_sized_new(16);
 
-	/* Walk the string and replace escaped values according to
-	 * https://ircv3.net/specs/extensions/message-tags.html#escaping-values
-	 */
-	for(int i = 0; value[i] != '\0'; i++) {
-		if(escaping) {
-			/* Set the replacement to the current character which will fall
-			 * through for everything, including '\\'
-			 */
-			char replacement = value[i];
-
-			if(value[i] == ':') {
-				replacement = ';';
-			} else if(value[i] == 's') {
-				replacement = ' ';
-			} else if(value[i] == 'r') {
-				replacement = '\r';
-			} else if(value[i] == 'n') {
-				replacement = '\n';
-			}
+	/* The keys and values point into line, so there's nothing to free. */
+	scratch->tags = g_hash_table_new(g_str_hash, g_str_equal);
+}
 
-			g_string_append_c(unescaped, replacement);
-			escaping = FALSE;
-		} else {
-			if(value[i] == '\\') {
-				escaping = TRUE;
-			} else {
-				g_string_append_c(unescaped, value[i]);
-			}
-		}
+static void
+purple_ircv3_parser_scratch_clear(PurpleIRCv3ParserScratch *scratch) {
+	if(scratch->line != NULL) {
+		g_string_free(scratch->line, TRUE);
+		scratch->line = NULL;
 	}
 
-	return g_string_free(unescaped, FALSE);
+	g_clear_pointer(&scratch->params, g_ptr_array_unref);
+	g_clear_pointer(&scratch->tags, g_hash_table_destroy);
 }
 
-static GHashTable *
-purple_ircv3_parser_parse_tags(PurpleIRCv3Parser *parser,
-                               const gchar *tags_string, GError **error)
-{
-	GError *local_error = NULL;
-	GHashTable *tags = NULL;
-	GMatchInfo *info = NULL;
-	gboolean matches = FALSE;
-
-	tags = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
-
-	/* tags_string can never be NULL, because g_match_info_fetch_named always
-	 * returns a string. So if we were passed an empty string, just return the
-	 * empty hash table.
-	 */
-	if(*tags_string == '\0') {
-		return tags;
-	}
+/* Unescapes value in place according to
+ * https://ircv3.net/specs/extensions/message-tags.html#escaping-values
+ * The unescaped value is never longer than the escaped one.
+ */
+static void
+purple_ircv3_parser_unescape_tag_value(char *value) {
+	char *write = value;
 
-	matches = g_regex_match_full(parser->regex_tags, tags_string, -1, 0, 0,
-	                             &info, &local_error);
+	for(char *read = value; *read != '\0'; read++) {
+		if(*read != '\\') {
+			*write++ = *read;
 
-	if(local_error != NULL) {
-		g_propagate_error(error, local_error);
+			continue;
+		}
 
-		g_match_info_unref(info);
+		/* Move to the escaped character. A trailing backslash is dropped. */
+		read++;
+		if(*read == '\0') {
+			break;
+		}
 
-		return tags;
+		/* Unknown escapes, including '\\', are replaced with the character
+		 * itself.
+		 */
+		switch(*read) {
+			case ':':
+				*write++ = ';';
+				break;
+			case 's':
+				*write++ = ' ';
+				break;
+			case 'r':
+				*write++ = '\r';
+				break;
+			case 'n':
+				*write++ = '\n';
+				break;
+			default:
+				*write++ = *read;
+				break;
+		}
 	}
 
-	if(!matches) {
-		g_set_error_literal(error, PURPLE_IRCV3_DOMAIN, 0,
-		                    "failed to parse tags: unknown error");
-
-		g_match_info_unref(info);
-
-		return tags;
-	}
+	*write = '\0';
+}
 
-	while(g_match_info_matches(info)) {
-		char *key = NULL;
-		char *value = NULL;
-		char *unescaped = NULL;
+/* Splits tags_string in place into tags. Tags without a value get an empty
+ * string and the last value wins for duplicate keys.
+ */
+static void
+purple_ircv3_parser_parse_tags(GHashTable *tags, char *tags_string) {
+	char *tag = tags_string;
 
-		key = g_match_info_fetch_named(info, "key");
-		value = g_match_info_fetch_named(info, "value");
+	while(tag != NULL) {
+		char *next = strchr(tag, ';');
+		const char *value = "";
 
-		unescaped = purple_ircv3_parser_unescape_tag_value(value);
-		g_free(value);
+		if(next != NULL) {
+			*next++ = '\0';
+		}
 
-		/* the hash table is created with destroy notifies for both key and
-		 * value, so there's no need to free the allocated memory right now.
-		 */
-		g_hash_table_insert(tags, key, unescaped);
-		g_match_info_next(info, &local_error);
+		if(*tag != '\0') {
+			char *equals = strchr(tag, '=');
 
-		if(local_error != NULL) {
-			g_propagate_error(error, local_error);
+			if(equals != NULL) {
+				*equals = '\0';
+				value = equals + 1;
+				purple_ircv3_parser_unescape_tag_value(equals + 1);
+			}
 
-			break;
+			g_hash_table_insert(tags, tag, (gpointer)value);
 		}
+
+		tag = next;
 	}
+}
 
-	g_match_info_unref(info);
+static inline char *
+purple_ircv3_parser_skip_spaces(char *str) {
+	while(*str == ' ') {
+		str++;
+	}
 
-	return tags;
+	return str;
 }
 
-static guint
-purple_ircv3_parser_extract_params(G_GNUC_UNUSED PurpleIRCv3Parser *parser,
-                                   GStrvBuilder *builder, const gchar *str)
-{
-	gchar *ptr = NULL;
-	guint count = 0;
+/* Terminates the space delimited token that starts at str and returns the
+ * start of whatever follows it.
+ */
+static inline char *
+purple_ircv3_parser_next_token(char *str) {
+	char *space = strchr(str, ' ');
 
-	/* Loop through str finding each space separated string. */
-	while(str != NULL && *str != '\0') {
-		/* Look for a space. */
-		ptr = strchr(str, ' ');
+	if(space == NULL) {
+		return str + strlen(str);
+	}
 
-		/* If we found one, set it to null terminator and add the string to our
-		 * builder.
-		 */
-		if(ptr != NULL) {
-			*ptr = '\0';
-			g_strv_builder_add(builder, str);
+	*space = '\0';
 
-			/* Move str to the next character as we know there's another
-			 * character which might be another null terminator.
-			 */
-			str = ptr + 1;
+	return space + 1;
+}
 
-			/* And don't forget to increment the count... ah ah ah! */
-			count++;
-		} else {
-			/* Add the remaining string. */
-			g_strv_builder_add(builder, str);
+/* Splits what follows the command into params, treating everything after a
+ * parameter starting with ':' as a single trailing parameter. params is left
+ * NULL terminated so that its pdata can be used as a GStrv.
+ */
+static void
+purple_ircv3_parser_extract_params(GPtrArray *params, char *str) {
+	while(TRUE) {
+		str = purple_ircv3_parser_skip_spaces(str);
+		if(*str == '\0') {
+			break;
+		}
 
-			/* Give the count another one, ah ah ah! */
-			count++;
+		if(*str == ':') {
+			g_ptr_array_add(params, str + 1);
 
-			/* Finally break out of the loop. */
 			break;
 		}
+
+		g_ptr_array_add(params, str);
+		str = purple_ircv3_parser_next_token(str);
 	}
 
-	return count;
+	g_ptr_array_add(params, NULL);
 }
 
-static GStrv
-purple_ircv3_parser_build_params(PurpleIRCv3Parser *parser,
-                                 const gchar *middle, const gchar *coda,
-                                 const gchar *trailing, guint *n_params)
+static gboolean
+purple_ircv3_parser_parse_with_scratch(PurpleIRCv3Parser *parser,
+                                       PurpleIRCv3ParserScratch *scratch,
+                                       const char *buffer, GError **error,
+                                       gpointer data)
 {
-	GStrvBuilder *builder = g_strv_builder_new();
-	GStrv result = NULL;
-	guint count = 0;
+	PurpleIRCv3MessageHandler handler = NULL;
+	char *command = NULL;
+	char *ptr = NULL;
+	const char *source = "";
+	char *tags_string = NULL;
+
+	g_string_assign(scratch->line, buffer);
+	ptr = scratch->line->str;
+
+	/* The line is laid out as [@tags ][:source ]command[ params]. */
+	if(*ptr == '@') {
+		tags_string = ptr + 1;
+		ptr = purple_ircv3_parser_next_token(ptr);
+		ptr = purple_ircv3_parser_skip_spaces(ptr);
+	}
+
+	if(*ptr == ':') {
+		source = ptr + 1;
+		ptr = purple_ircv3_parser_next_token(ptr);
+		ptr = purple_ircv3_parser_skip_spaces(ptr);
+	}
+
+	command = ptr;
+	ptr = purple_ircv3_parser_next_token(ptr);
+	if(*command == '\0' || *command == ':') {
+		g_set_error(error, PURPLE_IRCV3_DOMAIN, 0,
+		            "failed to parse buffer '%s'", buffer);
 
-	*n_params = 0;
+		return FALSE;
+	}
+
+	/* Find the handler before doing anything else, so we don't do any more
+	 * work than we need to on a line that we can't handle.
+	 */
+	handler = g_hash_table_lookup(parser->handlers, command);
+	if(handler == NULL) {
+		if(parser->fallback_handler == NULL) {
+			g_set_error(error, PURPLE_IRCV3_DOMAIN, 0,
+			            "no handler found for command %s and no default "
+			            "handler set.", command);
 
-	count = purple_ircv3_parser_extract_params(parser, builder, middle);
-	*n_params = *n_params + count;
+			return FALSE;
+		}
 
-	if(*coda != '\0') {
-		g_strv_builder_add(builder, trailing);
-		*n_params = *n_params + 1;
+		handler = parser->fallback_handler;
 	}
 
-	result = g_strv_builder_end(builder);
+	g_hash_table_remove_all(scratch->tags);
+	if(tags_string != NULL) {
+		purple_ircv3_parser_parse_tags(scratch->tags, tags_string);
+	}
 
-	g_strv_builder_unref(builder);
+	g_ptr_array_set_size(scratch->params, 0);
+	purple_ircv3_parser_extract_params(scratch->params, ptr);
 
-	return result;
+	return handler(scratch->tags, source, command, scratch->params->len - 1,
+	               (GStrv)scratch->params->pdata, error, data);
 }
 
 /******************************************************************************
@@ -237,8 +286,7 @@ static void
 purple_ircv3_parser_finalize(GObject *obj) {
 	PurpleIRCv3Parser *parser = PURPLE_IRCV3_PARSER(obj);
 
-	g_clear_pointer(&parser->regex_message, g_regex_unref);
-	g_clear_pointer(&parser->regex_tags, g_regex_unref);
+	purple_ircv3_parser_scratch_clear(&parser->scratch);
 
 	g_hash_table_destroy(parser->handlers);
 
@@ -247,21 +295,7 @@ purple_ircv3_parser_finalize(GObject *obj) {
 
 static void
 purple_ircv3_parser_init(PurpleIRCv3Parser *parser) {
-	parser->regex_message =  g_regex_new("(?:@(?<tags>[^ ]+) )?"
-	                                     "(?::(?<source>[^ ]+) +)?"
-	                                     "(?<command>[^ :]+)"
-	                                     "(?: +(?<middle>(?:[^ :]+(?: +[^ :]+)*)))*"
-	                                     "(?<coda> +:(?<trailing>.*)?)?",
-	                                     0, 0, NULL);
-	g_assert(parser->regex_message != NULL);
-
-	parser->regex_tags = g_regex_new("(?<key>(?<client_prefix>\\+?)"
-	                                        "(?:(?<vendor>[A-Za-z0-9-\\.]+)\\/)?"
-	                                        "(?<key_name>[A-Za-z0-9-]+)"
-	                                 ")"
-	                                 "(?:=(?<value>[^\r\n;]*))?(?:;|$)",
-	                                 0, 0, NULL);
-	g_assert(parser->regex_tags != NULL);
+	purple_ircv3_parser_scratch_init(&parser->scratch);
 
 	parser->fallback_handler = purple_ircv3_fallback_handler;
 	parser->handlers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
@@ -296,89 +330,29 @@ gboolean
 purple_ircv3_parser_parse(PurpleIRCv3Parser *parser, const gchar *buffer,
                           GError **error, gpointer data)
 {
-	PurpleIRCv3MessageHandler handler = NULL;
-	GError *local_error = NULL;
-	GHashTable *tags = NULL;
-	GMatchInfo *info = NULL;
-	GStrv params = NULL;
-	gchar *coda = NULL;
-	gchar *command = NULL;
-	gchar *middle = NULL;
-	gchar *source = NULL;
-	gchar *tags_string = NULL;
-	gchar *trailing = NULL;
-	gboolean matches = FALSE;
+	PurpleIRCv3ParserScratch scratch;
 	gboolean result = FALSE;
-	guint n_params = 0;
 
 	g_return_val_if_fail(PURPLE_IRCV3_IS_PARSER(parser), FALSE);
 	g_return_val_if_fail(buffer != NULL, FALSE);
 
-	/* Check if the buffer matches our regex for messages. */
-	matches = g_regex_match(parser->regex_message, buffer, 0, &info);
-	if(!matches) {
-		g_set_error(error, PURPLE_IRCV3_DOMAIN, 0,
-		            "failed to parser buffer '%s'", buffer);
-
-		g_match_info_unref(info);
-
-		return FALSE;
-	}
-
-	/* Extract the command from the buffer, so we can find the handler. */
-	command = g_match_info_fetch_named(info, "command");
-	handler = g_hash_table_lookup(parser->handlers, command);
-	if(handler == NULL) {
-		if(parser->fallback_handler == NULL) {
-			g_set_error(error, PURPLE_IRCV3_DOMAIN, 0,
-			            "no handler found for command %s and no default "
-			            "handler set.", command);
-
-			g_free(command);
-			g_match_info_unref(info);
-
-			return FALSE;
-		}
+	if(!parser->parsing) {
+		parser->parsing = TRUE;
+		result = purple_ircv3_parser_parse_with_scratch(parser,
+		                                                &parser->scratch,
+		                                                buffer, error, data);
+		parser->parsing = FALSE;
 
-		handler = parser->fallback_handler;
+		return result;
 	}
 
-	/* If we made it this far, we have our handler, so lets get the rest of the
-	 * parameters and call the handler.
+	/* A handler is parsing another line while we're still in the middle of
+	 * this one, so the shared scratch space is in use and we need our own.
 	 */
-	tags_string = g_match_info_fetch_named(info, "tags");
-	tags = purple_ircv3_parser_parse_tags(parser, tags_string, &local_error);
-	g_free(tags_string);
-	if(local_error != NULL) {
-		g_propagate_error(error, local_error);
-
-		g_free(command);
-		g_hash_table_destroy(tags);
-		g_match_info_unref(info);
-
-		return FALSE;
-	}
-
-	source = g_match_info_fetch_named(info, "source");
-	middle = g_match_info_fetch_named(info, "middle");
-	coda = g_match_info_fetch_named(info, "coda");
-	trailing = g_match_info_fetch_named(info, "trailing");
-
-	params = purple_ircv3_parser_build_params(parser, middle, coda, trailing,
-	                                          &n_params);
-
-	/* Call the handler. */
-	result = handler(tags, source, command, n_params, params, error, data);
-
-	/* Cleanup everything. */
-	g_free(source);
-	g_free(command);
-	g_free(middle);
-	g_free(coda);
-	g_free(trailing);
-	g_strfreev(params);
-	g_hash_table_destroy(tags);
-	g_match_info_unref(info);
+	purple_ircv3_parser_scratch_init(&scratch);
+	result = purple_ircv3_parser_parse_with_scratch(parser, &scratch, buffer,
+	                                                error, data);
+	purple_ircv3_parser_scratch_clear(&scratch);
 
 	return result;
 }
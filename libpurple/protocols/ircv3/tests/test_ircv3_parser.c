@@ -707,6 +707,216 @@ test_purple_ircv3_parser_message_tags_labeled_response(void) {
 	test_purple_ircv3_parser(msg, &data);
 
 }
+
+/******************************************************************************
+ * Reentrancy
+ *****************************************************************************/
+static gboolean
+test_purple_ircv3_reentrant_inner_handler(G_GNUC_UNUSED GHashTable *tags,
+                                          const gchar *source,
+                                          G_GNUC_UNUSED const gchar *command,
+                                          guint n_params, GStrv params,
+                                          G_GNUC_UNUSED GError **error,
+                                          G_GNUC_UNUSED gpointer data)
+{
+	g_assert_cmpstr(source, ==, "inner");
+	g_assert_cmpuint(n_params, ==, 1);
+	g_assert_cmpstr(params[0], ==, "second");
+
+	return TRUE;
+}
+
+static gboolean
+test_purple_ircv3_reentrant_outer_handler(GHashTable *tags,
+                                          const gchar *source,
+                                          G_GNUC_UNUSED const gchar *command,
+                                          guint n_params, GStrv params,
+                                          GError **error, gpointer data)
+{
+	PurpleIRCv3Parser *parser = data;
+	gboolean result = FALSE;
+
+	/* Parse another line from inside of the handler and make sure it didn't
+	 * clobber what we were given.
+	 */
+	result = purple_ircv3_parser_parse(parser, "@b=2 :inner INNER second",
+	                                   error, parser);
+	g_assert_true(result);
+
+	g_assert_cmpstr(g_hash_table_lookup(tags, "a"), ==, "1");
+	g_assert_null(g_hash_table_lookup(tags, "b"));
+	g_assert_cmpstr(source, ==, "outer");
+	g_assert_cmpuint(n_params, ==, 2);
+	g_assert_cmpstr(params[0], ==, "first");
+	g_assert_cmpstr(params[1], ==, "trailing words");
+
+	return TRUE;
+}
+
+static void
+test_purple_ircv3_parser_reentrant(void) {
+	PurpleIRCv3Parser *parser = purple_ircv3_parser_new();
+	GError *error = NULL;
+	gboolean result = FALSE;
+
+	purple_ircv3_parser_add_handler(parser, "OUTER",
+	                                test_purple_ircv3_reentrant_outer_handler);
+	purple_ircv3_parser_add_handler(parser, "INNER",
+	                                test_purple_ircv3_reentrant_inner_handler);
+
+	result = purple_ircv3_parser_parse(parser,
+	                                   "@a=1 :outer OUTER first :trailing words",
+	                                   &error, parser);
+	g_assert_no_error(error);
+	g_assert_true(result);
+
+	g_clear_object(&parser);
+}
+
+static GHashTable *
+test_purple_ircv3_parser_tags(const gchar *key, const gchar *value) {
+	GHashTable *tags = g_hash_table_new(g_str_hash, g_str_equal);
+
+	if(key != NULL) {
+		g_hash_table_insert(tags, (gpointer)key, (gpointer)value);
+	}
+
+	return tags;
+}
+
+static void
+test_purple_ircv3_parser_sequence(void) {
+	PurpleIRCv3Parser *parser = purple_ircv3_parser_new();
+	const gchar *lines[] = {
+		"@msgid=abc123 :nick!user@example.com PRIVMSG #channel :tagged",
+		":other!user@example.com JOIN #channel",
+		":irc.example.com 353 me = #channel :alice bob carol",
+		"PING :irc.example.com",
+		"@label=123 :nick!user@example.com TAGMSG #channel",
+	};
+	TestPurpleIRCv3ParserData data[] = {
+		{
+			.source = "nick!user@example.com",
+			.command = "PRIVMSG",
+			.n_params = 2,
+			.params = {"#channel", "tagged"},
+		}, {
+			.source = "other!user@example.com",
+			.command = "JOIN",
+			.n_params = 1,
+			.params = {"#channel"},
+		}, {
+			.source = "irc.example.com",
+			.command = "353",
+			.n_params = 4,
+			.params = {"me", "=", "#channel", "alice bob carol"},
+		}, {
+			.command = "PING",
+			.n_params = 1,
+			.params = {"irc.example.com"},
+		}, {
+			.source = "nick!user@example.com",
+			.command = "TAGMSG",
+			.n_params = 1,
+			.params = {"#channel"},
+		},
+	};
+
+	/* Untagged lines must not see the tags of the line before them. */
+	data[0].tags = test_purple_ircv3_parser_tags("msgid", "abc123");
+	data[1].tags = test_purple_ircv3_parser_tags(NULL, NULL);
+	data[2].tags = test_purple_ircv3_parser_tags(NULL, NULL);
+	data[3].tags = test_purple_ircv3_parser_tags(NULL, NULL);
+	data[4].tags = test_purple_ircv3_parser_tags("label", "123");
+
+	purple_ircv3_parser_set_fallback_handler(parser,
+	                                         test_purple_ircv3_test_handler);
+
+	/* The same parser is used for every line, like it is for a connection. */
+	for(guint i = 0; i < G_N_ELEMENTS(lines); i++) {
+		GError *error = NULL;
+		gboolean result = FALSE;
+
+		result = purple_ircv3_parser_parse(parser, lines[i], &error, &data[i]);
+		g_assert_no_error(error);
+		g_assert_true(result);
+
+		/* The handler frees the expected tags once it has checked them. */
+		g_assert_null(data[i].tags);
+	}
+
+	g_clear_object(&parser);
+}
+
+/******************************************************************************
+ * Performance
+ *****************************************************************************/
+#define TEST_PURPLE_IRCV3_PARSER_PERF_LINES (1000000)
+
+static gboolean
+test_purple_ircv3_perf_handler(G_GNUC_UNUSED GHashTable *tags,
+                               G_GNUC_UNUSED const gchar *source,
+                               G_GNUC_UNUSED const gchar *command,
+                               G_GNUC_UNUSED guint n_params,
+                               G_GNUC_UNUSED GStrv params,
+                               G_GNUC_UNUSED GError **error,
+                               gpointer data)
+{
+	guint *count = data;
+
+	*count = *count + 1;
+
+	return TRUE;
+}
+
+static void
+test_purple_ircv3_parser_perf_throughput(void) {
+	PurpleIRCv3Parser *parser = NULL;
+	/* A mix of what a busy channel looks like. */
+	const char *lines[] = {
+		":nick!user@example.com PRIVMSG #channel :Hello everyone, how's it going?",
+		"@time=2023-01-01T00:00:00.000Z;msgid=abc123;account=nick "
+		":nick!user@example.com PRIVMSG #channel :tagged message",
+		":other!user@example.com JOIN #channel",
+		":other!user@example.com PART #channel :Leaving",
+		":irc.example.com 353 me = #channel :alice bob carol dave eve mallory",
+		"PING :irc.example.com",
+		"@label=123;+example-client-tag=example-value "
+		":nick!user@example.com TAGMSG #channel",
+		":SomeOp MODE #channel +oo SomeUser :AnotherUser",
+	};
+	double elapsed = 0;
+	guint count = 0;
+
+	if(!g_test_perf()) {
+		g_test_skip("performance tests are only run with -m perf");
+
+		return;
+	}
+
+	parser = purple_ircv3_parser_new();
+	purple_ircv3_parser_set_fallback_handler(parser,
+	                                         test_purple_ircv3_perf_handler);
+
+	g_test_timer_start();
+
+	for(guint i = 0; i < TEST_PURPLE_IRCV3_PARSER_PERF_LINES; i++) {
+		const char *line = lines[i % G_N_ELEMENTS(lines)];
+
+		g_assert_true(purple_ircv3_parser_parse(parser, line, NULL, &count));
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_assert_cmpuint(count, ==, TEST_PURPLE_IRCV3_PARSER_PERF_LINES);
+
+	g_test_maximized_result(TEST_PURPLE_IRCV3_PARSER_PERF_LINES / elapsed,
+	                        "%.0f lines/sec",
+	                        TEST_PURPLE_IRCV3_PARSER_PERF_LINES / elapsed);
+
+	g_clear_object(&parser);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -818,5 +1028,13 @@ main(gint argc, gchar *argv[]) {
 	g_test_add_func("/ircv3/parser/message-tags/labeled-message",
 	                test_purple_ircv3_parser_message_tags_labeled_response);
 
+	g_test_add_func("/ircv3/parser/reentrant",
+	                test_purple_ircv3_parser_reentrant);
+	g_test_add_func("/ircv3/parser/sequence",
+	                test_purple_ircv3_parser_sequence);
+
+	g_test_add_func("/ircv3/parser/perf/throughput",
+	                test_purple_ircv3_parser_perf_throughput);
+
 	return g_test_run();
 }
@@ -25,6 +25,7 @@
 #include <purple.h>
 
 #include "auth.h"
+#include "auth_scram.h"
 #include "disco.h"
 #include "jabber.h"
 #include "jutil.h"
@@ -554,4 +555,5 @@ void jabber_auth_init(void)
 void jabber_auth_uninit(void)
 {
 	g_clear_slist(&auth_mechs, NULL);
+	jabber_scram_cache_clear();
 }
@@ -49,7 +49,7 @@ static const JabberScramHash *mech_to_hash(const char *mech)
 guchar *jabber_scram_hi(const JabberScramHash *hash, const GString *str,
                         GString *salt, guint iterations)
 {
-	GHmac *hmac;
+	GHmac *keyed, *hmac;
 	gsize digest_len;
 	guchar *result;
 	guint i;
@@ -65,13 +65,16 @@ guchar *jabber_scram_hi(const JabberScramHash *hash, const GString *str,
 	tmp    = g_new0(guchar, digest_len);
 	result = g_new0(guchar, digest_len);
 
-	hmac = g_hmac_new(hash->type, (guchar *)str->str, str->len);
+	/* Every round is keyed with the password, so set up the key once and
+	 * start each round from a copy of it. */
+	keyed = g_hmac_new(hash->type, (guchar *)str->str, str->len);
 
 	/* Append INT(1), a four-octet encoding of the integer 1, most significant
 	 * octet first. */
 	g_string_append_len(salt, "\0\0\0\1", 4);
 
 	/* Compute U0 */
+	hmac = g_hmac_copy(keyed);
 	g_hmac_update(hmac, (guchar *)salt->str, salt->len);
 	g_hmac_get_digest(hmac, result, &digest_len);
 	g_hmac_unref(hmac);
@@ -81,7 +84,7 @@ guchar *jabber_scram_hi(const JabberScramHash *hash, const GString *str,
 	/* Compute U1...Ui */
 	for (i = 1; i < iterations; ++i) {
 		guint j;
-		hmac = g_hmac_new(hash->type, (guchar *)str->str, str->len);
+		hmac = g_hmac_copy(keyed);
 		g_hmac_update(hmac, prev, digest_len);
 		g_hmac_get_digest(hmac, tmp, &digest_len);
 		g_hmac_unref(hmac);
@@ -92,6 +95,10 @@ guchar *jabber_scram_hi(const JabberScramHash *hash, const GString *str,
 		memcpy(prev, tmp, digest_len);
 	}
 
+	g_hmac_unref(keyed);
+
+	memset(tmp, 0, digest_len);
+	memset(prev, 0, digest_len);
 	g_free(tmp);
 	g_free(prev);
 	return result;
@@ -130,41 +137,62 @@ jabber_scram_hash(const JabberScramHash *hash, guchar *out, const guchar *data)
 	g_checksum_free(checksum);
 }
 
-gboolean
-jabber_scram_calc_proofs(JabberScramData *data, GString *salt, guint iterations)
+guchar *
+jabber_scram_derive_keys(const JabberScramHash *hash, const gchar *password,
+                         const GString *salt, guint iterations)
 {
-	guint hash_len = g_checksum_type_get_length(data->hash->type);
-	guint i;
-
-	GString *pass = g_string_new(data->password);
-
+	guint hash_len = g_checksum_type_get_length(hash->type);
+	GString *pass, *salt_copy;
 	guchar *salted_password;
-	guchar *client_key, *stored_key, *client_signature, *server_key;
+	guchar *keys;
 
-	data->client_proof = g_string_sized_new(hash_len);
-	data->client_proof->len = hash_len;
-	data->server_signature = g_string_sized_new(hash_len);
-	data->server_signature->len = hash_len;
+	pass = g_string_new(password);
+	/* jabber_scram_hi() appends to the salt. */
+	salt_copy = g_string_new_len(salt->str, salt->len);
 
-	salted_password = jabber_scram_hi(data->hash, pass, salt, iterations);
+	salted_password = jabber_scram_hi(hash, pass, salt_copy, iterations);
 
 	memset(pass->str, 0, pass->allocated_len);
 	g_string_free(pass, TRUE);
+	g_string_free(salt_copy, TRUE);
 
 	if (!salted_password)
-		return FALSE;
+		return NULL;
 
-	client_key = g_new0(guchar, hash_len);
-	stored_key = g_new0(guchar, hash_len);
-	client_signature = g_new0(guchar, hash_len);
-	server_key = g_new0(guchar, hash_len);
+	keys = g_new0(guchar, 2 * hash_len);
 
 	/* client_key = HMAC(salted_password, "Client Key") */
-	jabber_scram_hmac(data->hash, client_key, salted_password, "Client Key");
+	jabber_scram_hmac(hash, keys, salted_password, "Client Key");
 	/* server_key = HMAC(salted_password, "Server Key") */
-	jabber_scram_hmac(data->hash, server_key, salted_password, "Server Key");
+	jabber_scram_hmac(hash, keys + hash_len, salted_password, "Server Key");
+
+	memset(salted_password, 0, hash_len);
 	g_free(salted_password);
 
+	return keys;
+}
+
+void
+jabber_scram_calc_proofs_from_keys(JabberScramData *data, const guchar *keys)
+{
+	guint hash_len = g_checksum_type_get_length(data->hash->type);
+	const guchar *client_key = keys;
+	const guchar *server_key = keys + hash_len;
+	guchar *stored_key, *client_signature;
+	guint i;
+
+	if (data->client_proof == NULL) {
+		data->client_proof = g_string_sized_new(hash_len);
+	}
+	data->client_proof->len = hash_len;
+	if (data->server_signature == NULL) {
+		data->server_signature = g_string_sized_new(hash_len);
+	}
+	data->server_signature->len = hash_len;
+
+	stored_key = g_new0(guchar, hash_len);
+	client_signature = g_new0(guchar, hash_len);
+
 	/* stored_key = HASH(client_key) */
 	jabber_scram_hash(data->hash, stored_key, client_key);
 
@@ -177,14 +205,194 @@ jabber_scram_calc_proofs(JabberScramData *data, GString *salt, guint iterations)
 	for (i = 0; i < hash_len; ++i)
 		data->client_proof->str[i] = client_key[i] ^ client_signature[i];
 
-	g_free(server_key);
 	g_free(client_signature);
 	g_free(stored_key);
-	g_free(client_key);
+}
+
+gboolean
+jabber_scram_calc_proofs(JabberScramData *data, GString *salt, guint iterations)
+{
+	guint hash_len = g_checksum_type_get_length(data->hash->type);
+	guchar *keys;
+
+	keys = jabber_scram_derive_keys(data->hash, data->password, salt,
+	                                iterations);
+	if (!keys)
+		return FALSE;
+
+	jabber_scram_calc_proofs_from_keys(data, keys);
+
+	memset(keys, 0, 2 * hash_len);
+	g_free(keys);
 
 	return TRUE;
 }
 
+/*
+ * Deriving the keys runs PBKDF2 for as many rounds as the server asks for, so
+ * it is done in a worker thread.
+ */
+typedef struct {
+	const JabberScramHash *hash;
+	gchar *password;
+	GString *salt;
+	guint iterations;
+} JabberScramDerive;
+
+static void
+jabber_scram_derive_free(JabberScramDerive *derive)
+{
+	memset(derive->password, 0, strlen(derive->password));
+	g_free(derive->password);
+	g_string_free(derive->salt, TRUE);
+	g_free(derive);
+}
+
+static void
+jabber_scram_derive_keys_thread(GTask *task,
+                                G_GNUC_UNUSED gpointer source_object,
+                                gpointer task_data,
+                                G_GNUC_UNUSED GCancellable *cancellable)
+{
+	JabberScramDerive *derive = task_data;
+	guchar *keys;
+
+	keys = jabber_scram_derive_keys(derive->hash, derive->password,
+	                                derive->salt, derive->iterations);
+	if (keys == NULL) {
+		g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED,
+		                        _("Unable to calculate SCRAM keys"));
+		return;
+	}
+
+	g_task_return_pointer(task, keys, g_free);
+}
+
+void
+jabber_scram_derive_keys_async(const JabberScramHash *hash,
+                               const gchar *password, const GString *salt,
+                               guint iterations, GCancellable *cancellable,
+                               GAsyncReadyCallback callback, gpointer data)
+{
+	JabberScramDerive *derive;
+	GTask *task;
+
+	derive = g_new0(JabberScramDerive, 1);
+	derive->hash = hash;
+	derive->password = g_strdup(password);
+	derive->salt = g_string_new_len(salt->str, salt->len);
+	derive->iterations = iterations;
+
+	task = g_task_new(NULL, cancellable, callback, data);
+	g_task_set_source_tag(task, jabber_scram_derive_keys_async);
+	g_task_set_task_data(task, derive,
+	                     (GDestroyNotify)jabber_scram_derive_free);
+	g_task_run_in_thread(task, jabber_scram_derive_keys_thread);
+	g_object_unref(task);
+}
+
+guchar *
+jabber_scram_derive_keys_finish(GAsyncResult *result, GError **error)
+{
+	g_return_val_if_fail(G_IS_TASK(result), NULL);
+	g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) ==
+	                     jabber_scram_derive_keys_async, NULL);
+
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/*
+ * RFC 5802 allows the client to keep ClientKey and ServerKey for as long as
+ * the server's salt and iteration count stay the same, which lets reconnects
+ * skip PBKDF2 entirely. Entries are keyed by account, mechanism, iteration
+ * count and salt, and remember which password they were derived from.
+ */
+typedef struct {
+	gchar *password_digest;
+	guchar *keys;
+	gsize keys_len;
+} JabberScramCacheEntry;
+
+static GHashTable *scram_cache = NULL;
+
+static void
+jabber_scram_cache_entry_free(JabberScramCacheEntry *entry)
+{
+	memset(entry->keys, 0, entry->keys_len);
+	g_free(entry->keys);
+	g_free(entry->password_digest);
+	g_free(entry);
+}
+
+static gchar *
+jabber_scram_cache_key(JabberStream *js, const JabberScramData *data,
+                       const GString *salt, guint iterations)
+{
+	gchar *bare_jid, *salt64, *key;
+
+	bare_jid = jabber_id_get_bare_jid(js->user);
+	salt64 = g_base64_encode((guchar *)salt->str, salt->len);
+	key = g_strdup_printf("%s %s %u %s", bare_jid, data->hash->mech_substr,
+	                      iterations, salt64);
+	g_free(salt64);
+	g_free(bare_jid);
+
+	return key;
+}
+
+static const guchar *
+jabber_scram_cache_lookup(const JabberScramData *data)
+{
+	JabberScramCacheEntry *entry;
+	gchar *digest;
+	gboolean valid;
+
+	if (scram_cache == NULL)
+		return NULL;
+
+	entry = g_hash_table_lookup(scram_cache, data->cache_key);
+	if (entry == NULL)
+		return NULL;
+
+	digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256, data->password,
+	                                       -1);
+	valid = purple_strequal(digest, entry->password_digest);
+	g_free(digest);
+
+	/* The password was changed since the keys were derived. */
+	if (!valid) {
+		g_hash_table_remove(scram_cache, data->cache_key);
+		return NULL;
+	}
+
+	return entry->keys;
+}
+
+static void
+jabber_scram_cache_store(const JabberScramData *data, const guchar *keys)
+{
+	JabberScramCacheEntry *entry;
+
+	if (scram_cache == NULL) {
+		scram_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                    (GDestroyNotify)jabber_scram_cache_entry_free);
+	}
+
+	entry = g_new0(JabberScramCacheEntry, 1);
+	entry->keys_len = 2 * g_checksum_type_get_length(data->hash->type);
+	entry->keys = g_memdup2(keys, entry->keys_len);
+	entry->password_digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256,
+	                                                       data->password, -1);
+
+	g_hash_table_replace(scram_cache, g_strdup(data->cache_key), entry);
+}
+
+void
+jabber_scram_cache_clear(void)
+{
+	g_clear_pointer(&scram_cache, g_hash_table_destroy);
+}
+
 static gboolean
 parse_server_step1(JabberScramData *data, const char *challenge,
                    gchar **out_nonce, GString **out_salt, guint *out_iterations)
@@ -273,6 +481,44 @@ parse_server_step2(G_GNUC_UNUSED JabberScramData *data, const char *challenge,
 	return TRUE;
 }
 
+/* Parses the server's first message and adds our reply to the auth message,
+ * which is then ready for calculating the proofs. */
+static gboolean
+jabber_scram_start_step1(JabberScramData *data, const gchar *in,
+                         GString **out_salt, guint *out_iterations)
+{
+	gchar *nonce;
+
+	if (!parse_server_step1(data, in, &nonce, out_salt, out_iterations))
+		return FALSE;
+
+	g_string_append_c(data->auth_message, ',');
+
+	/* "biws" is the base64 encoding of "n,,". I promise. */
+	g_string_append_printf(data->auth_message, "c=%s,r=%s", "biws", nonce);
+#ifdef CHANNEL_BINDING
+#error fix this
+#endif
+
+	g_free(data->nonce);
+	data->nonce = nonce;
+
+	return TRUE;
+}
+
+/* Builds our reply to the server's first message once the proofs are known. */
+static gchar *
+jabber_scram_finish_step1(JabberScramData *data)
+{
+	gchar *proof, *out;
+
+	proof = g_base64_encode((guchar *)data->client_proof->str, data->client_proof->len);
+	out = g_strdup_printf("c=%s,r=%s,p=%s", "biws", data->nonce, proof);
+	g_free(proof);
+
+	return out;
+}
+
 gboolean
 jabber_scram_feed_parser(JabberScramData *data, gchar *in, gchar **out)
 {
@@ -284,35 +530,21 @@ jabber_scram_feed_parser(JabberScramData *data, gchar *in, gchar **out)
 	g_string_append(data->auth_message, in);
 
 	if (data->step == 1) {
-		gchar *nonce, *proof;
 		GString *salt;
 		guint iterations;
 
-		ret = parse_server_step1(data, in, &nonce, &salt, &iterations);
+		ret = jabber_scram_start_step1(data, in, &salt, &iterations);
 		if (!ret)
 			return FALSE;
 
-		g_string_append_c(data->auth_message, ',');
-
-		/* "biws" is the base64 encoding of "n,,". I promise. */
-		g_string_append_printf(data->auth_message, "c=%s,r=%s", "biws", nonce);
-#ifdef CHANNEL_BINDING
-#error fix this
-#endif
-
 		ret = jabber_scram_calc_proofs(data, salt, iterations);
 
 		g_string_free(salt, TRUE);
 		salt = NULL;
-		if (!ret) {
-			g_free(nonce);
+		if (!ret)
 			return FALSE;
-		}
 
-		proof = g_base64_encode((guchar *)data->client_proof->str, data->client_proof->len);
-		*out = g_strdup_printf("c=%s,r=%s,p=%s", "biws", nonce, proof);
-		g_free(nonce);
-		g_free(proof);
+		*out = jabber_scram_finish_step1(data);
 	} else if (data->step == 2) {
 		gchar *server_sig, *enc_server_sig;
 		gsize len;
@@ -335,6 +567,11 @@ jabber_scram_feed_parser(JabberScramData *data, gchar *in, gchar **out)
 		}
 		g_free(server_sig);
 
+		/* The server knows the same ServerKey, so the keys are worth
+		 * keeping for the next time. */
+		if (data->cache_key != NULL && data->keys != NULL)
+			jabber_scram_cache_store(data, data->keys);
+
 		*out = NULL;
 	} else {
 		purple_debug_error("jabber", "SCRAM: There is no step %d\n", data->step);
@@ -388,6 +625,7 @@ scram_start(JabberStream *js, G_GNUC_UNUSED PurpleXmlNode *mechanisms,
 	data = js->auth_mech_data = g_new0(JabberScramData, 1);
 	data->hash = mech_to_hash(js->auth_mech->name);
 	data->password = prepped_pass;
+	data->cancellable = g_cancellable_new();
 
 #ifdef CHANNEL_BINDING
 	if (strstr(js->auth_mech_name, "-PLUS"))
@@ -421,6 +659,110 @@ scram_start(JabberStream *js, G_GNUC_UNUSED PurpleXmlNode *mechanisms,
 	return JABBER_SASL_STATE_CONTINUE;
 }
 
+static void
+scram_send_response(JabberStream *js, const gchar *dec_out)
+{
+	PurpleXmlNode *reply;
+	gchar *enc_out;
+
+	purple_debug_misc("jabber", "decoded response: %s\n", dec_out);
+
+	reply = purple_xmlnode_new("response");
+	purple_xmlnode_set_namespace(reply, NS_XMPP_SASL);
+
+	enc_out = g_base64_encode((guchar *)dec_out, strlen(dec_out));
+	purple_xmlnode_insert_data(reply, enc_out, -1);
+	g_free(enc_out);
+
+	jabber_send(js, reply);
+	purple_xmlnode_free(reply);
+}
+
+static void
+scram_set_keys(JabberScramData *data, guchar *keys)
+{
+	if (data->keys != NULL) {
+		memset(data->keys, 0,
+		       2 * g_checksum_type_get_length(data->hash->type));
+		g_free(data->keys);
+	}
+
+	data->keys = keys;
+}
+
+static void
+scram_derive_keys_cb(G_GNUC_UNUSED GObject *source, GAsyncResult *result,
+                     gpointer user_data)
+{
+	JabberStream *js = user_data;
+	JabberScramData *data;
+	GError *error = NULL;
+	guchar *keys;
+	gchar *dec_out;
+
+	keys = jabber_scram_derive_keys_finish(result, &error);
+	if (keys == NULL) {
+		/* If it was cancelled, the exchange (and maybe js) is gone. */
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			purple_connection_error(js->gc,
+				PURPLE_CONNECTION_ERROR_AUTHENTICATION_IMPOSSIBLE,
+				error->message);
+		}
+		g_clear_error(&error);
+		return;
+	}
+
+	data = js->auth_mech_data;
+	scram_set_keys(data, keys);
+	jabber_scram_calc_proofs_from_keys(data, data->keys);
+
+	dec_out = jabber_scram_finish_step1(data);
+	scram_send_response(js, dec_out);
+	g_free(dec_out);
+}
+
+/*
+ * Handles the server's first message. If the keys for this salt and
+ * iteration count are cached, the reply is returned in out right away.
+ * Otherwise out is set to NULL and the reply is sent once the keys have been
+ * derived in a worker thread.
+ */
+static gboolean
+scram_handle_step1(JabberStream *js, JabberScramData *data, gchar *in,
+                   gchar **out)
+{
+	GString *salt;
+	guint iterations;
+	const guchar *keys;
+
+	g_string_append_c(data->auth_message, ',');
+	g_string_append(data->auth_message, in);
+
+	if (!jabber_scram_start_step1(data, in, &salt, &iterations))
+		return FALSE;
+
+	g_free(data->cache_key);
+	data->cache_key = jabber_scram_cache_key(js, data, salt, iterations);
+
+	keys = jabber_scram_cache_lookup(data);
+	if (keys != NULL) {
+		purple_debug_misc("jabber", "SCRAM: using cached keys\n");
+		scram_set_keys(data, g_memdup2(keys,
+			2 * g_checksum_type_get_length(data->hash->type)));
+		jabber_scram_calc_proofs_from_keys(data, data->keys);
+		*out = jabber_scram_finish_step1(data);
+	} else {
+		*out = NULL;
+		jabber_scram_derive_keys_async(data->hash, data->password, salt,
+		                               iterations, data->cancellable,
+		                               scram_derive_keys_cb, js);
+	}
+
+	g_string_free(salt, TRUE);
+
+	return TRUE;
+}
+
 static JabberSaslState
 scram_handle_challenge(JabberStream *js, PurpleXmlNode *challenge, PurpleXmlNode **out, char **error)
 {
@@ -429,6 +771,7 @@ scram_handle_challenge(JabberStream *js, PurpleXmlNode *challenge, PurpleXmlNode
 	gchar *enc_in, *dec_in = NULL;
 	gchar *enc_out = NULL, *dec_out = NULL;
 	gsize len;
+	gboolean ret;
 	JabberSaslState state = JABBER_SASL_STATE_FAIL;
 
 	enc_in = purple_xmlnode_get_data(challenge);
@@ -452,7 +795,12 @@ scram_handle_challenge(JabberStream *js, PurpleXmlNode *challenge, PurpleXmlNode
 
 	purple_debug_misc("jabber", "decoded challenge: %s\n", dec_in);
 
-	if (!jabber_scram_feed_parser(data, dec_in, &dec_out)) {
+	if (data->step == 1)
+		ret = scram_handle_step1(js, data, dec_in, &dec_out);
+	else
+		ret = jabber_scram_feed_parser(data, dec_in, &dec_out);
+
+	if (!ret) {
 		reply = purple_xmlnode_new("abort");
 		purple_xmlnode_set_namespace(reply, NS_XMPP_SASL);
 		data->step = -1;
@@ -462,6 +810,13 @@ scram_handle_challenge(JabberStream *js, PurpleXmlNode *challenge, PurpleXmlNode
 
 	data->step += 1;
 
+	if (data->step == 2 && dec_out == NULL) {
+		/* scram_derive_keys_cb() will send the reply. */
+		reply = NULL;
+		state = JABBER_SASL_STATE_CONTINUE;
+		goto out;
+	}
+
 	reply = purple_xmlnode_new("response");
 	purple_xmlnode_set_namespace(reply, NS_XMPP_SASL);
 
@@ -538,6 +893,17 @@ scram_handle_success(JabberStream *js, PurpleXmlNode *packet, char **error)
 
 void jabber_scram_data_destroy(JabberScramData *data)
 {
+	if (data->cancellable) {
+		/* Stops scram_derive_keys_cb() from touching data. */
+		g_cancellable_cancel(data->cancellable);
+		g_object_unref(data->cancellable);
+	}
+	if (data->keys) {
+		memset(data->keys, 0, 2 * g_checksum_type_get_length(data->hash->type));
+		g_free(data->keys);
+	}
+	g_free(data->cache_key);
+	g_free(data->nonce);
 	g_free(data->cnonce);
 	if (data->auth_message)
 		g_string_free(data->auth_message, TRUE);
@@ -553,6 +919,20 @@ void jabber_scram_data_destroy(JabberScramData *data)
 	g_free(data);
 }
 
+static JabberSaslState
+scram_handle_failure(JabberStream *js, G_GNUC_UNUSED PurpleXmlNode *packet,
+                     G_GNUC_UNUSED PurpleXmlNode **reply,
+                     G_GNUC_UNUSED char **error)
+{
+	JabberScramData *data = js->auth_mech_data;
+
+	/* Don't try the same keys again if they were rejected. */
+	if (data != NULL && data->cache_key != NULL && scram_cache != NULL)
+		g_hash_table_remove(scram_cache, data->cache_key);
+
+	return JABBER_SASL_STATE_FAIL;
+}
+
 static void scram_dispose(JabberStream *js)
 {
 	if (js->auth_mech_data) {
@@ -567,7 +947,7 @@ static JabberSaslMech scram_sha1_mech = {
 	scram_start,
 	scram_handle_challenge,
 	scram_handle_success,
-	NULL, /* handle_failure */
+	scram_handle_failure,
 	scram_dispose
 };
 
@@ -579,7 +959,7 @@ static JabberSaslMech scram_sha1_plus_mech = {
 	scram_start,
 	scram_handle_challenge,
 	scram_handle_success,
-	NULL, /* handle_failure */
+	scram_handle_failure,
 	scram_dispose
 };
 #endif
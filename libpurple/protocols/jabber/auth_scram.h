@@ -49,6 +49,15 @@ typedef struct {
 	gchar *password;
 	gboolean channel_binding;
 	int step;
+
+	/* The server's nonce, kept until the client proof is ready. */
+	gchar *nonce;
+	/* ClientKey followed by ServerKey, once they are known. */
+	guchar *keys;
+	/* Where the keys are kept between connections. */
+	gchar *cache_key;
+	/* Cancels deriving the keys when the exchange is dropped. */
+	GCancellable *cancellable;
 } JabberScramData;
 
 #include "auth.h"
@@ -82,6 +91,58 @@ guchar *jabber_scram_hi(const JabberScramHash *hash, const GString *str,
 gboolean jabber_scram_calc_proofs(JabberScramData *data, GString *salt,
                                   guint iterations);
 
+/**
+ * Derives ClientKey and ServerKey from the password, as described in Section
+ * 3 of the SASL-SCRAM I-D.
+ *
+ * @param hash       The struct corresponding to the hash function to be used.
+ * @param password   The prepared password.
+ * @param salt       The salt (as specified by the server). It is not changed.
+ * @param iterations The number of iterations to perform.
+ *
+ * @returns A newly allocated buffer holding ClientKey followed by ServerKey,
+ *          each the length of the binary output of the hash function, or
+ *          NULL on error.
+ */
+guchar *jabber_scram_derive_keys(const JabberScramHash *hash,
+                                 const gchar *password, const GString *salt,
+                                 guint iterations);
+
+/**
+ * Runs jabber_scram_derive_keys() in a worker thread. @callback is called in
+ * the thread-default main context once it is done and should call
+ * jabber_scram_derive_keys_finish().
+ */
+void jabber_scram_derive_keys_async(const JabberScramHash *hash,
+                                    const gchar *password,
+                                    const GString *salt, guint iterations,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer data);
+
+/**
+ * Gets the result of jabber_scram_derive_keys_async().
+ *
+ * @returns The same as jabber_scram_derive_keys(), or NULL with @error set.
+ */
+guchar *jabber_scram_derive_keys_finish(GAsyncResult *result, GError **error);
+
+/**
+ * Calculates the proofs from keys returned by jabber_scram_derive_keys().
+ *
+ * @param data A JabberScramData structure. hash and auth_message must be
+ *             set. client_proof and server_signature will be set as a result
+ *             of this function.
+ * @param keys ClientKey followed by ServerKey.
+ */
+void jabber_scram_calc_proofs_from_keys(JabberScramData *data,
+                                        const guchar *keys);
+
+/**
+ * Forgets every key that was kept for reconnecting.
+ */
+void jabber_scram_cache_clear(void);
+
 /**
  * Feed the algorithm with the data from the server.
  */
@@ -83,21 +83,24 @@ JabberBuddy *jabber_buddy_find(JabberStream *js, const char *name,
 		gboolean create)
 {
 	JabberBuddy *jb;
-	char *realname;
+	const JabberID *jid;
+	const char *realname;
 
 	if (js->buddies == NULL)
 		return NULL;
 
-	if(!(realname = jabber_get_bare_jid(name)))
+	if(!(jid = jabber_id_intern(name)))
 		return NULL;
 
+	realname = jabber_id_intern_get_bare_jid(jid);
 	jb = g_hash_table_lookup(js->buddies, realname);
 
 	if(!jb && create) {
 		jb = g_new0(JabberBuddy, 1);
-		g_hash_table_insert(js->buddies, realname, jb);
-	} else
-		g_free(realname);
+		g_hash_table_insert(js->buddies, g_strdup(realname), jb);
+	}
+
+	jabber_id_release(jid);
 
 	return jb;
 }
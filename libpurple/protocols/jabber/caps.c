@@ -134,64 +134,74 @@ schedule_caps_save(void)
 		save_timer = g_timeout_add_seconds(5, do_jabber_caps_store, NULL);
 }
 
+typedef struct {
+	gboolean valid;
+} JabberCapsLoadData;
+
 static void
-jabber_caps_load(void)
+jabber_caps_load_client(PurpleXmlNode *client, gpointer data)
 {
-	PurpleXmlNode *capsdata = purple_util_read_xml_from_cache_file(JABBER_CAPS_FILENAME, "XMPP capabilities cache");
-	PurpleXmlNode *client;
+	JabberCapsLoadData *load = data;
+	JabberCapsClientInfo *value;
+	JabberCapsTuple *key;
+	PurpleXmlNode *child;
 
-	if(!capsdata)
+	if (client->parent == NULL) {
+		/* The root element is passed in before any of the clients. */
+		load->valid = purple_strequal(client->name, "capabilities");
 		return;
+	}
 
-	if (!purple_strequal(capsdata->name, "capabilities")) {
-		purple_xmlnode_free(capsdata);
+	if (!load->valid || !purple_strequal(client->name, "client"))
 		return;
-	}
 
-	for (client = capsdata->child; client; client = client->next) {
-		if (client->type != PURPLE_XMLNODE_TYPE_TAG)
+	value = g_new0(JabberCapsClientInfo, 1);
+	key = (JabberCapsTuple*)&value->tuple;
+	key->node = g_strdup(purple_xmlnode_get_attrib(client,"node"));
+	key->ver  = g_strdup(purple_xmlnode_get_attrib(client,"ver"));
+	key->hash = g_strdup(purple_xmlnode_get_attrib(client,"hash"));
+
+	for (child = client->child; child; child = child->next) {
+		if (child->type != PURPLE_XMLNODE_TYPE_TAG)
 			continue;
-		if (purple_strequal(client->name, "client")) {
-			JabberCapsClientInfo *value = g_new0(JabberCapsClientInfo, 1);
-			JabberCapsTuple *key = (JabberCapsTuple*)&value->tuple;
-			PurpleXmlNode *child;
-			key->node = g_strdup(purple_xmlnode_get_attrib(client,"node"));
-			key->ver  = g_strdup(purple_xmlnode_get_attrib(client,"ver"));
-			key->hash = g_strdup(purple_xmlnode_get_attrib(client,"hash"));
-
-			for (child = client->child; child; child = child->next) {
-				if (child->type != PURPLE_XMLNODE_TYPE_TAG)
-					continue;
-				if (purple_strequal(child->name, "feature")) {
-					const char *var = purple_xmlnode_get_attrib(child, "var");
-					if(!var)
-						continue;
-					value->features = g_list_append(value->features,g_strdup(var));
-				} else if (purple_strequal(child->name, "identity")) {
-					const char *category = purple_xmlnode_get_attrib(child, "category");
-					const char *type = purple_xmlnode_get_attrib(child, "type");
-					const char *name = purple_xmlnode_get_attrib(child, "name");
-					const char *lang = purple_xmlnode_get_attrib(child, "lang");
-					JabberIdentity *id;
-
-					if (!category || !type)
-						continue;
-
-					id = jabber_identity_new(category, type, lang, name);
-					value->identities = g_list_append(value->identities,id);
-				} else if (purple_strequal(child->name, "x")) {
-					/* TODO: See #7814 -- this might cause problems if anyone
-					 * ever actually specifies forms. In fact, for this to
-					 * work properly, that bug needs to be fixed in
-					 * purple_xmlnode_from_str, not the output version... */
-					value->forms = g_list_append(value->forms, purple_xmlnode_copy(child));
-				}
-			}
+		if (purple_strequal(child->name, "feature")) {
+			const char *var = purple_xmlnode_get_attrib(child, "var");
+			if(!var)
+				continue;
+			value->features = g_list_append(value->features,g_strdup(var));
+		} else if (purple_strequal(child->name, "identity")) {
+			const char *category = purple_xmlnode_get_attrib(child, "category");
+			const char *type = purple_xmlnode_get_attrib(child, "type");
+			const char *name = purple_xmlnode_get_attrib(child, "name");
+			const char *lang = purple_xmlnode_get_attrib(child, "lang");
+			JabberIdentity *id;
 
-			g_hash_table_replace(capstable, key, value);
+			if (!category || !type)
+				continue;
+
+			id = jabber_identity_new(category, type, lang, name);
+			value->identities = g_list_append(value->identities,id);
+		} else if (purple_strequal(child->name, "x")) {
+			/* TODO: See #7814 -- this might cause problems if anyone
+			 * ever actually specifies forms. In fact, for this to
+			 * work properly, that bug needs to be fixed in
+			 * purple_xmlnode_from_str, not the output version... */
+			value->forms = g_list_append(value->forms, purple_xmlnode_copy(child));
 		}
 	}
-	purple_xmlnode_free(capsdata);
+
+	g_hash_table_replace(capstable, key, value);
+}
+
+static void
+jabber_caps_load(void)
+{
+	JabberCapsLoadData load = { FALSE };
+
+	/* Clients are added to the table one at a time as they are read. */
+	purple_util_stream_xml_from_cache_file(JABBER_CAPS_FILENAME,
+	                                       "XMPP capabilities cache", 1,
+	                                       jabber_caps_load_client, &load);
 }
 
 void jabber_caps_init(void)
@@ -102,10 +102,20 @@ JabberChat *jabber_chat_find(JabberStream *js, const char *room,
 
 	if(NULL != js->chats)
 	{
-		char *room_jid = g_strdup_printf("%s@%s", room, server);
+		/* Room and server are at most 1023 bytes each once validated, so
+		 * this lookup normally doesn't need to allocate. */
+		char buf[2048];
+		char *room_jid = buf;
+
+		if ((gsize)g_snprintf(buf, sizeof(buf), "%s@%s", room, server) >=
+				sizeof(buf)) {
+			room_jid = g_strdup_printf("%s@%s", room, server);
+		}
 
 		chat = g_hash_table_lookup(js->chats, room_jid);
-		g_free(room_jid);
+		if (room_jid != buf) {
+			g_free(room_jid);
+		}
 	}
 
 	return chat;
@@ -247,6 +257,7 @@ jabber_chat_new(JabberStream *js, const char *room, const char *server,
 
 	chat->members = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
 			(GDestroyNotify)jabber_chat_member_free);
+	chat->pending_members = g_ptr_array_new_with_free_func(g_object_unref);
 
 	jid = g_strdup_printf("%s@%s", room, server);
 	g_hash_table_insert(js->chats, jid, chat);
@@ -407,6 +418,7 @@ void jabber_chat_free(JabberChat *chat)
 	g_free(chat->server);
 	g_free(chat->handle);
 	g_hash_table_destroy(chat->members);
+	g_ptr_array_free(chat->pending_members, TRUE);
 	g_hash_table_destroy(chat->components);
 
 	g_clear_pointer(&chat->joined, g_date_time_unref);
@@ -467,19 +479,19 @@ jabber_chat_room_configure_cb(JabberStream *js, const char *from,
 	PurpleXmlNode *query, *x;
 	char *msg;
 	JabberChat *chat;
-	JabberID *jid;
+	const JabberID *jid;
 
 	if (!from)
 		return;
 
 	if (type == JABBER_IQ_RESULT) {
-		jid = jabber_id_new(from);
+		jid = jabber_id_intern(from);
 
 		if(!jid)
 			return;
 
 		chat = jabber_chat_find(js, jid->node, jid->domain);
-		jabber_id_free(jid);
+		jabber_id_release(jid);
 
 		if(!chat)
 			return;
@@ -621,19 +633,19 @@ jabber_chat_register_cb(JabberStream *js, const char *from, JabberIqType type,
 	PurpleXmlNode *query, *x;
 	char *msg;
 	JabberChat *chat;
-	JabberID *jid;
+	const JabberID *jid;
 
 	if (!from)
 		return;
 
 	if (type == JABBER_IQ_RESULT) {
-		jid = jabber_id_new(from);
+		jid = jabber_id_intern(from);
 
 		if(!jid)
 			return;
 
 		chat = jabber_chat_find(js, jid->node, jid->domain);
-		jabber_id_free(jid);
+		jabber_id_release(jid);
 
 		if(!chat)
 			return;
@@ -930,6 +942,7 @@ void jabber_chat_member_free(JabberChatMember *jcm)
 {
 	g_free(jcm->handle);
 	g_free(jcm->jid);
+	g_clear_object(&jcm->info);
 	g_free(jcm);
 }
 
@@ -938,10 +951,22 @@ jabber_chat_track_handle(JabberChat *chat, const char *handle, const char *jid,
                          G_GNUC_UNUSED const char *affiliation,
                          G_GNUC_UNUSED const char *role)
 {
-	JabberChatMember *jcm = g_new0(JabberChatMember, 1);
+	JabberChatMember *jcm = g_hash_table_lookup(chat->members, handle);
 
+	/* Presence updates for someone we already know about keep their contact
+	 * info so that they stay the same conversation member.
+	 */
+	if (jcm != NULL) {
+		g_free(jcm->jid);
+		jcm->jid = g_strdup(jid);
+		return;
+	}
+
+	jcm = g_new0(JabberChatMember, 1);
 	jcm->handle = g_strdup(handle);
 	jcm->jid = g_strdup(jid);
+	jcm->info = purple_contact_info_new(NULL);
+	purple_contact_info_set_username(jcm->info, handle);
 
 	g_hash_table_replace(chat->members, jcm->handle, jcm);
 
@@ -950,9 +975,58 @@ jabber_chat_track_handle(JabberChat *chat, const char *handle, const char *jid,
 
 void jabber_chat_remove_handle(JabberChat *chat, const char *handle)
 {
+	JabberChatMember *jcm = g_hash_table_lookup(chat->members, handle);
+
+	if (jcm == NULL)
+		return;
+
+	g_ptr_array_remove(chat->pending_members, jcm->info);
+
+	if (chat->conv != NULL) {
+		PurpleConversation *conv = PURPLE_CONVERSATION(chat->conv);
+		PurpleConversationMember *member = NULL;
+
+		member = purple_conversation_find_member(conv, jcm->info);
+		if (member != NULL)
+			purple_conversation_remove_member(conv, member, FALSE, NULL);
+	}
+
 	g_hash_table_remove(chat->members, handle);
 }
 
+/* The room sends the presence of everyone that is already there before our
+ * own, so until we have joined the occupants are collected and then added to
+ * the conversation all at once by jabber_chat_add_pending_members().
+ */
+void
+jabber_chat_add_member(JabberChat *chat, const char *handle, gboolean announce)
+{
+	JabberChatMember *jcm = g_hash_table_lookup(chat->members, handle);
+
+	if (jcm == NULL || chat->conv == NULL)
+		return;
+
+	if (chat->joined == NULL) {
+		if (!g_ptr_array_find(chat->pending_members, jcm->info, NULL))
+			g_ptr_array_add(chat->pending_members, g_object_ref(jcm->info));
+		return;
+	}
+
+	purple_conversation_add_member(PURPLE_CONVERSATION(chat->conv), jcm->info,
+	                               announce, NULL);
+}
+
+void
+jabber_chat_add_pending_members(JabberChat *chat)
+{
+	if (chat->conv == NULL || chat->pending_members->len == 0)
+		return;
+
+	purple_conversation_add_members(PURPLE_CONVERSATION(chat->conv),
+	                                chat->pending_members, FALSE, NULL);
+	g_ptr_array_set_size(chat->pending_members, 0);
+}
+
 gboolean jabber_chat_ban_user(JabberChat *chat, const char *who, const char *why)
 {
 	JabberChatMember *jcm;
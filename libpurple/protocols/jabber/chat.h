@@ -32,6 +32,7 @@
 typedef struct {
 	char *handle;
 	char *jid;
+	PurpleContactInfo *info;
 } JabberChatMember;
 
 
@@ -48,6 +49,7 @@ typedef struct {
 	PurpleRequestType config_dialog_type;
 	void *config_dialog_handle;
 	GHashTable *members;
+	GPtrArray *pending_members;
 	gboolean left;
 	GDateTime *joined;
 } JabberChat;
@@ -78,6 +80,9 @@ void jabber_chat_part(JabberChat *chat, const char *msg);
 void jabber_chat_track_handle(JabberChat *chat, const char *handle,
 		const char *jid, const char *affiliation, const char *role);
 void jabber_chat_remove_handle(JabberChat *chat, const char *handle);
+void jabber_chat_add_member(JabberChat *chat, const char *handle,
+		gboolean announce);
+void jabber_chat_add_pending_members(JabberChat *chat);
 gboolean jabber_chat_ban_user(JabberChat *chat, const char *who,
 		const char *why);
 gboolean jabber_chat_affiliate_user(JabberChat *chat, const char *who,
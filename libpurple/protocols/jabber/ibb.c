@@ -29,11 +29,49 @@
 
 #define JABBER_IBB_SESSION_DEFAULT_BLOCK_SIZE 4096
 
+/* how many times a block is resent after the receiver asked us to wait */
+#define JABBER_IBB_SESSION_MAX_RETRIES 3
+
+/* a data block that has been sent and is waiting to be acknowledged, kept
+  around so it can be resent. iq_id is NULL while the block waits to be
+  resent. */
+typedef struct {
+	guint16 seq;
+	gchar *iq_id;
+	GBytes *data;
+	guint retries;
+	gboolean acked;
+} JabberIBBBlock;
+
 static GHashTable *jabber_ibb_sessions = NULL;
 static GList *open_handlers = NULL;
 
 static JabberStream *jabber_ibb_session_get_js(JabberIBBSession *sess);
 
+static void
+jabber_ibb_block_free(JabberIBBBlock *block)
+{
+	g_free(block->iq_id);
+	g_bytes_unref(block->data);
+	g_free(block);
+}
+
+/* forget about all blocks that are waiting to be acknowledged */
+static void
+jabber_ibb_session_clear_in_flight(JabberIBBSession *sess)
+{
+	JabberIBBBlock *block;
+
+	while ((block = g_queue_pop_head(&sess->in_flight))) {
+		if (block->iq_id) {
+			purple_debug_info("jabber", "IBB: removing callback for <iq/> %s\n",
+				block->iq_id);
+			jabber_iq_remove_callback_by_id(sess->js, block->iq_id);
+		}
+		jabber_ibb_block_free(block);
+	}
+}
+
 JabberIBBSession *
 jabber_ibb_session_create(JabberStream *js, const gchar *sid, const gchar *who,
 	gpointer user_data)
@@ -49,6 +87,9 @@ jabber_ibb_session_create(JabberStream *js, const gchar *sid, const gchar *who,
 	sess->block_size = JABBER_IBB_SESSION_DEFAULT_BLOCK_SIZE;
 	sess->state = JABBER_IBB_SESSION_NOT_OPENED;
 	sess->user_data = user_data;
+	sess->window_size = JABBER_IBB_SESSION_DEFAULT_WINDOW_SIZE;
+	g_queue_init(&sess->in_flight);
+	sess->base64 = g_string_new(NULL);
 
 	g_hash_table_insert(jabber_ibb_sessions, sess->sid, sess);
 
@@ -93,14 +134,8 @@ jabber_ibb_session_destroy(JabberIBBSession *sess)
 		jabber_ibb_session_close(sess);
 	}
 
-	if (sess->last_iq_id) {
-		purple_debug_info("jabber", "IBB: removing callback for <iq/> %s\n",
-			sess->last_iq_id);
-		jabber_iq_remove_callback_by_id(jabber_ibb_session_get_js(sess),
-			sess->last_iq_id);
-		g_free(sess->last_iq_id);
-		sess->last_iq_id = NULL;
-	}
+	jabber_ibb_session_clear_in_flight(sess);
+	g_string_free(sess->base64, TRUE);
 
 	g_hash_table_remove(jabber_ibb_sessions, sess->sid);
 	g_free(sess->id);
@@ -163,6 +198,31 @@ jabber_ibb_session_get_user_data(JabberIBBSession *sess)
 	return sess->user_data;
 }
 
+gboolean
+jabber_ibb_session_can_send(const JabberIBBSession *sess)
+{
+	return jabber_ibb_session_get_state(sess) == JABBER_IBB_SESSION_OPENED &&
+		jabber_ibb_session_get_in_flight(sess) < sess->window_size;
+}
+
+guint
+jabber_ibb_session_get_in_flight(const JabberIBBSession *sess)
+{
+	return g_queue_get_length((GQueue *)&sess->in_flight);
+}
+
+void
+jabber_ibb_session_set_window_size(JabberIBBSession *sess, guint size)
+{
+	sess->window_size = MAX(size, 1);
+}
+
+guint
+jabber_ibb_session_get_window_size(const JabberIBBSession *sess)
+{
+	return sess->window_size;
+}
+
 void
 jabber_ibb_session_set_opened_callback(JabberIBBSession *sess,
 	JabberIBBOpenedCallback *cb)
@@ -266,37 +326,204 @@ jabber_ibb_session_close(JabberIBBSession *sess)
 	}
 }
 
+static void jabber_ibb_session_send_acknowledge_cb(JabberStream *js,
+	const char *from, JabberIqType type, const char *id, PurpleXmlNode *packet,
+	gpointer data);
+
+static void
+jabber_ibb_session_send_block(JabberIBBSession *sess, JabberIBBBlock *block)
+{
+	JabberIq *set = jabber_iq_new(jabber_ibb_session_get_js(sess),
+		JABBER_IQ_SET);
+	PurpleXmlNode *data_element = purple_xmlnode_new("data");
+	gconstpointer data;
+	gsize size, len;
+	gint state = 0, save = 0;
+	char seq[10];
+
+	/* encode straight into the session's buffer rather than allocating a
+	  new string for every block */
+	data = g_bytes_get_data(block->data, &size);
+	g_string_set_size(sess->base64, (size / 3 + 1) * 4 + 4);
+	len = g_base64_encode_step(data, size, FALSE, sess->base64->str, &state,
+		&save);
+	len += g_base64_encode_close(FALSE, sess->base64->str + len, &state, &save);
+
+	g_snprintf(seq, sizeof(seq), "%u", block->seq);
+
+	purple_xmlnode_set_attrib(set->node, "to", jabber_ibb_session_get_who(sess));
+	purple_xmlnode_set_namespace(data_element, NS_IBB);
+	purple_xmlnode_set_attrib(data_element, "sid", jabber_ibb_session_get_sid(sess));
+	purple_xmlnode_set_attrib(data_element, "seq", seq);
+	purple_xmlnode_insert_data(data_element, sess->base64->str, len);
+
+	purple_xmlnode_insert_child(set->node, data_element);
+
+	jabber_iq_set_callback(set, jabber_ibb_session_send_acknowledge_cb, sess);
+	g_free(block->iq_id);
+	block->iq_id = g_strdup(purple_xmlnode_get_attrib(set->node, "id"));
+	purple_debug_misc("jabber", "IBB: sent block %u of session %s as <iq/> %s\n",
+		block->seq, sess->sid, block->iq_id);
+	jabber_iq_send(set);
+}
+
+static GList *
+jabber_ibb_session_find_block(JabberIBBSession *sess, const char *id)
+{
+	for (GList *l = sess->in_flight.head; l; l = l->next) {
+		JabberIBBBlock *block = l->data;
+
+		if (purple_strequal(block->iq_id, id)) {
+			return l;
+		}
+	}
+
+	return NULL;
+}
+
+/* a temporary error, like <resource-constraint/>, is worth another try */
+static gboolean
+jabber_ibb_error_is_temporary(PurpleXmlNode *packet)
+{
+	PurpleXmlNode *error = purple_xmlnode_get_child(packet, "error");
+
+	return error != NULL &&
+		purple_strequal(purple_xmlnode_get_attrib(error, "type"), "wait");
+}
+
+/* whether a block before link is waiting to be resent, in which case the
+  receiver could not have taken the block at link in order */
+static gboolean
+jabber_ibb_session_has_failed_before(JabberIBBSession *sess, GList *link)
+{
+	for (GList *l = sess->in_flight.head; l && l != link; l = l->next) {
+		JabberIBBBlock *block = l->data;
+
+		if (!block->acked && !block->iq_id) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* once every outstanding block has been answered, resend the failed ones in
+  order, no more than the window at a time */
+static void
+jabber_ibb_session_resend_blocks(JabberIBBSession *sess)
+{
+	guint outstanding = 0;
+
+	for (GList *l = sess->in_flight.head; l; l = l->next) {
+		JabberIBBBlock *block = l->data;
+
+		if (block->iq_id) {
+			outstanding++;
+		}
+	}
+
+	if (sess->draining) {
+		if (outstanding > 0) {
+			return;
+		}
+		sess->draining = FALSE;
+	}
+
+	for (GList *l = sess->in_flight.head;
+	     l && outstanding < sess->window_size; l = l->next)
+	{
+		JabberIBBBlock *block = l->data;
+
+		if (block->acked || block->iq_id) {
+			continue;
+		}
+
+		purple_debug_info("jabber", "IBB: resending block %u of session %s\n",
+			block->seq, sess->sid);
+		jabber_ibb_session_send_block(sess, block);
+		outstanding++;
+	}
+}
+
 static void
 jabber_ibb_session_send_acknowledge_cb(G_GNUC_UNUSED JabberStream *js,
                                        G_GNUC_UNUSED const char *from,
                                        JabberIqType type,
-                                       G_GNUC_UNUSED const char *id,
-                                       G_GNUC_UNUSED PurpleXmlNode *packet,
+                                       const char *id,
+                                       PurpleXmlNode *packet,
                                        gpointer data)
 {
 	JabberIBBSession *sess = (JabberIBBSession *) data;
+	JabberIBBBlock *block;
+	GList *link;
+	gboolean acked = FALSE;
 
-	if (sess) {
-		/* reset callback */
-		g_free(sess->last_iq_id);
-		sess->last_iq_id = NULL;
-
-		if (type == JABBER_IQ_ERROR) {
-			jabber_ibb_session_close(sess);
-			sess->state = JABBER_IBB_SESSION_ERROR;
-
-			if (sess->error_cb) {
-				sess->error_cb(sess);
-			}
-		} else {
-			if (sess->data_sent_cb) {
-				sess->data_sent_cb(sess);
-			}
-		}
-	} else {
+	if (!sess) {
 		/* the session has gone away, it was probably cancelled */
 		purple_debug_info("jabber",
 			"got response from send data, but IBB session is no longer active\n");
+		return;
+	}
+
+	link = jabber_ibb_session_find_block(sess, id);
+	if (!link) {
+		purple_debug_info("jabber",
+			"IBB: got response for <iq/> %s that is no longer pending\n", id);
+		return;
+	}
+
+	block = link->data;
+	g_clear_pointer(&block->iq_id, g_free);
+
+	if (type == JABBER_IQ_ERROR) {
+		if (jabber_ibb_error_is_temporary(packet) &&
+		    block->retries < JABBER_IBB_SESSION_MAX_RETRIES)
+		{
+			/* the receiver is out of resources, so stop, let the blocks
+			  that are still outstanding come back, and then go on one
+			  block at a time */
+			purple_debug_info("jabber",
+				"IBB: receiver asked to wait at block %u of session %s\n",
+				block->seq, sess->sid);
+			block->retries++;
+			sess->window_size = 1;
+			sess->draining = TRUE;
+			jabber_ibb_session_resend_blocks(sess);
+
+			return;
+		}
+
+		if (sess->draining && jabber_ibb_session_has_failed_before(sess, link)) {
+			/* the receiver checks that blocks arrive in order, so this one
+			  was refused because of the block that failed before it */
+			jabber_ibb_session_resend_blocks(sess);
+
+			return;
+		}
+
+		jabber_ibb_session_clear_in_flight(sess);
+		jabber_ibb_session_close(sess);
+		sess->state = JABBER_IBB_SESSION_ERROR;
+
+		if (sess->error_cb) {
+			sess->error_cb(sess);
+		}
+
+		return;
+	}
+
+	/* acknowledgements could in theory come back out of order, so only
+	  retire blocks once everything before them has been acknowledged too */
+	block->acked = TRUE;
+	while ((block = g_queue_peek_head(&sess->in_flight)) && block->acked) {
+		jabber_ibb_block_free(g_queue_pop_head(&sess->in_flight));
+		acked = TRUE;
+	}
+
+	jabber_ibb_session_resend_blocks(sess);
+
+	if (acked && sess->data_sent_cb) {
+		sess->data_sent_cb(sess);
 	}
 }
 
@@ -315,32 +542,18 @@ jabber_ibb_session_send_data(JabberIBBSession *sess, gconstpointer data,
 	} else if (size > jabber_ibb_session_get_max_data_size(sess)) {
 		purple_debug_error("jabber",
 			"trying to send a too large packet in the IBB session\n");
+	} else if (!jabber_ibb_session_can_send(sess)) {
+		purple_debug_error("jabber",
+			"trying to send more IBB blocks than the window allows\n");
 	} else {
-		JabberIq *set = jabber_iq_new(jabber_ibb_session_get_js(sess),
-			JABBER_IQ_SET);
-		PurpleXmlNode *data_element = purple_xmlnode_new("data");
-		char *base64 = g_base64_encode(data, size);
-		char seq[10];
-		g_snprintf(seq, sizeof(seq), "%u", jabber_ibb_session_get_send_seq(sess));
-
-		purple_xmlnode_set_attrib(set->node, "to", jabber_ibb_session_get_who(sess));
-		purple_xmlnode_set_namespace(data_element, NS_IBB);
-		purple_xmlnode_set_attrib(data_element, "sid", jabber_ibb_session_get_sid(sess));
-		purple_xmlnode_set_attrib(data_element, "seq", seq);
-		purple_xmlnode_insert_data(data_element, base64, -1);
+		JabberIBBBlock *block = g_new0(JabberIBBBlock, 1);
 
-		purple_xmlnode_insert_child(set->node, data_element);
+		block->seq = jabber_ibb_session_get_send_seq(sess);
+		block->data = g_bytes_new(data, size);
+		g_queue_push_tail(&sess->in_flight, block);
 
-		purple_debug_info("jabber",
-			"IBB: setting send <iq/> callback for session %p %s\n", sess,
-			sess->sid);
-		jabber_iq_set_callback(set, jabber_ibb_session_send_acknowledge_cb, sess);
-		sess->last_iq_id = g_strdup(purple_xmlnode_get_attrib(set->node, "id"));
-		purple_debug_info("jabber", "IBB: set sess->last_iq_id: %s\n",
-			sess->last_iq_id);
-		jabber_iq_send(set);
+		jabber_ibb_session_send_block(sess, block);
 
-		g_free(base64);
 		(sess->send_seq)++;
 	}
 }
@@ -27,6 +27,8 @@
 #include "jabber.h"
 #include "iq.h"
 
+#define JABBER_IBB_SESSION_DEFAULT_WINDOW_SIZE 8
+
 typedef struct _JabberIBBSession JabberIBBSession;
 
 typedef void
@@ -70,8 +72,16 @@ struct _JabberIBBSession {
 	JabberIBBDataCallback *data_received_cb;
 	JabberIBBErrorCallback *error_cb;
 
-	/* store the last sent IQ (to permit cancel of callback) */
-	gchar *last_iq_id;
+	/* the data blocks that have been sent but not yet acknowledged, oldest
+	  first, and how many of them may be outstanding at once */
+	GQueue in_flight;
+	guint window_size;
+	/* set after the receiver asked us to wait, until every outstanding block
+	  has been answered and the failed ones can be resent */
+	gboolean draining;
+
+	/* reused to BASE64 encode each block */
+	GString *base64;
 };
 
 JabberIBBSession *jabber_ibb_session_create(JabberStream *js, const gchar *sid,
@@ -97,6 +107,18 @@ void jabber_ibb_session_close(JabberIBBSession *sess);
 void jabber_ibb_session_send_data(JabberIBBSession *sess, gconstpointer data,
 	gsize size);
 
+/* whether another data block may be sent right now, that is, the session is
+ open and fewer than window-size blocks are waiting to be acknowledged */
+gboolean jabber_ibb_session_can_send(const JabberIBBSession *sess);
+
+/* number of data blocks that have been sent but not yet acknowledged */
+guint jabber_ibb_session_get_in_flight(const JabberIBBSession *sess);
+
+/* maximum number of unacknowledged data blocks, defaults to
+ JABBER_IBB_SESSION_DEFAULT_WINDOW_SIZE, 1 waits for every block */
+void jabber_ibb_session_set_window_size(JabberIBBSession *sess, guint size);
+guint jabber_ibb_session_get_window_size(const JabberIBBSession *sess);
+
 JabberIBBSessionState jabber_ibb_session_get_state(const JabberIBBSession *sess);
 
 gsize jabber_ibb_session_get_block_size(const JabberIBBSession *sess);
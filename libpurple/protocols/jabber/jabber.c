@@ -67,6 +67,19 @@
  */
 #define DEFAULT_INACTIVITY_TIME 120
 
+/* The receive buffer starts out small and doubles every time a read fills it,
+ * up to the maximum. It drops back to the minimum once the socket drains.
+ */
+#define JABBER_RECV_BUFFER_MIN (4 * 1024)
+#define JABBER_RECV_BUFFER_MAX (256 * 1024)
+
+/* How much data and time a single dispatch of jabber_recv_cb may consume
+ * before it yields back to the main loop. Anything left on the socket is
+ * picked up on the next dispatch.
+ */
+#define JABBER_RECV_BATCH_BYTES (1024 * 1024)
+#define JABBER_RECV_BATCH_TIME (20 * G_TIME_SPAN_MILLISECOND)
+
 GList *jabber_features = NULL;
 GList *jabber_identities = NULL;
 
@@ -384,36 +397,42 @@ jabber_push_bytes_cb(GObject *source, GAsyncResult *res, gpointer data)
 	}
 }
 
-static gboolean do_jabber_send_raw(JabberStream *js, const char *data, int len)
+static void
+do_jabber_send_bytes(JabberStream *js, GBytes *output)
 {
-	GBytes *output;
-	gboolean success = TRUE;
-
-	g_return_val_if_fail(len > 0, FALSE);
-
 	if (js->state == JABBER_STREAM_CONNECTED)
 		jabber_stream_restart_inactivity_timer(js);
 
-	output = g_bytes_new(data, len);
 	purple_queued_output_stream_push_bytes_async(
 	        js->output, output, G_PRIORITY_DEFAULT, js->cancellable,
 	        jabber_push_bytes_cb, js);
+}
+
+static gboolean do_jabber_send_raw(JabberStream *js, const char *data, int len)
+{
+	GBytes *output;
+
+	g_return_val_if_fail(len > 0, FALSE);
+
+	output = g_bytes_new(data, len);
+	do_jabber_send_bytes(js, output);
 	g_bytes_unref(output);
 
-	return success;
+	return TRUE;
 }
 
 static void
-jabber_send_raw(G_GNUC_UNUSED PurpleProtocolServer *protocol_server,
-                JabberStream *js, const char *data, gint len)
+jabber_send_debug(JabberStream *js, const char *data)
 {
-	PurpleConnection *gc;
-	PurpleAccount *account;
-
-	gc = js->gc;
-	account = purple_connection_get_account(gc);
+	PurpleConnection *gc = js->gc;
+	PurpleAccount *account = purple_connection_get_account(gc);
 
-	g_return_if_fail(data != NULL);
+	/* Everything below, especially looking for passwords to hide, is only
+	 * done for the debug output, so skip it when nobody will see it.
+	 */
+	if (!purple_debug_is_enabled(PURPLE_DEBUG_MISC, "jabber")) {
+		return;
+	}
 
 	/* because printing a tab to debug every minute gets old */
 	if (!purple_strequal(data, "\t")) {
@@ -456,6 +475,17 @@ jabber_send_raw(G_GNUC_UNUSED PurpleProtocolServer *protocol_server,
 
 		g_free(text);
 	}
+}
+
+static void
+jabber_send_raw(G_GNUC_UNUSED PurpleProtocolServer *protocol_server,
+                JabberStream *js, const char *data, gint len)
+{
+	PurpleConnection *gc = js->gc;
+
+	g_return_if_fail(data != NULL);
+
+	jabber_send_debug(js, data);
 
 	purple_signal_emit(purple_connection_get_protocol(gc), "jabber-sending-text", gc, &data);
 	if (data == NULL)
@@ -491,8 +521,8 @@ jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
                       G_GNUC_UNUSED gpointer unused)
 {
 	JabberStream *js;
-	char *txt;
-	int len;
+	GString *buffer;
+	const char *data;
 
 	if (NULL == packet)
 		return;
@@ -509,9 +539,39 @@ jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
 				purple_strequal((*packet)->name, "iq") ||
 				purple_strequal((*packet)->name, "presence"))
 			purple_xmlnode_set_namespace(*packet, NS_XMPP_CLIENT);
-	txt = purple_xmlnode_to_str(*packet, &len);
-	jabber_send_raw(NULL, js, txt, len);
-	g_free(txt);
+
+	/* Serialize the stanza straight into the buffer that is handed to the
+	 * output stream, rather than going through jabber_send_raw which would
+	 * copy it again.
+	 */
+	buffer = g_string_sized_new(256);
+	purple_xmlnode_write_to_string(*packet, buffer);
+	data = buffer->str;
+
+	jabber_send_debug(js, data);
+
+	purple_signal_emit(purple_connection_get_protocol(pc), "jabber-sending-text", pc, &data);
+	if (data == NULL) {
+		g_string_free(buffer, TRUE);
+		return;
+	}
+
+	if (js->bosh) {
+		jabber_bosh_connection_send(js->bosh, data);
+	} else if (data != buffer->str) {
+		/* A signal handler replaced the text, so send theirs instead. */
+		do_jabber_send_raw(js, data, strlen(data));
+	} else if (buffer->len > 0) {
+		GBytes *output = g_string_free_to_bytes(buffer);
+
+		buffer = NULL;
+		do_jabber_send_bytes(js, output);
+		g_bytes_unref(output);
+	}
+
+	if (buffer != NULL) {
+		g_string_free(buffer, TRUE);
+	}
 }
 
 void jabber_send(JabberStream *js, PurpleXmlNode *packet)
@@ -553,15 +613,25 @@ jabber_recv_cb(GObject *stream, gpointer data)
 	PurpleConnection *gc = data;
 	JabberStream *js = purple_connection_get_protocol_data(gc);
 	gssize len;
-	gchar buf[4096];
+	gsize total = 0;
+	gint64 deadline;
 	GError *error = NULL;
 
 	PURPLE_ASSERT_CONNECTION_IS_VALID(gc);
 
+	if(js->recv_buffer == NULL) {
+		js->recv_buffer_size = JABBER_RECV_BUFFER_MIN;
+		js->recv_buffer = g_malloc(js->recv_buffer_size);
+	}
+
+	deadline = g_get_monotonic_time() + JABBER_RECV_BATCH_TIME;
+
 	do {
+		char *buf = (char *)js->recv_buffer;
+
 		len = g_pollable_input_stream_read_nonblocking(
-		        G_POLLABLE_INPUT_STREAM(stream), buf, sizeof(buf) - 1,
-		        js->cancellable, &error);
+		        G_POLLABLE_INPUT_STREAM(stream), buf,
+		        js->recv_buffer_size - 1, js->cancellable, &error);
 		if (len == 0) {
 			purple_connection_error(js->gc,
 			                        PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
@@ -571,6 +641,14 @@ jabber_recv_cb(GObject *stream, gpointer data)
 		} else if (len < 0) {
 			if (error->code == G_IO_ERROR_WOULD_BLOCK) {
 				g_error_free(error);
+
+				/* The burst is over, so give back the memory. */
+				if(js->recv_buffer_size > JABBER_RECV_BUFFER_MIN) {
+					js->recv_buffer_size = JABBER_RECV_BUFFER_MIN;
+					js->recv_buffer = g_realloc(js->recv_buffer,
+					                            js->recv_buffer_size);
+				}
+
 				return G_SOURCE_CONTINUE;
 			} else if (error->code == G_IO_ERROR_CANCELLED) {
 				g_error_free(error);
@@ -585,11 +663,31 @@ jabber_recv_cb(GObject *stream, gpointer data)
 
 		purple_connection_update_last_received(gc);
 		buf[len] = '\0';
-		purple_debug_misc("jabber", "Recv (%" G_GSSIZE_FORMAT "): %s", len,
-		                  buf);
+		if(purple_debug_is_enabled(PURPLE_DEBUG_MISC, "jabber")) {
+			purple_debug_misc("jabber", "Recv (%" G_GSSIZE_FORMAT "): %s",
+			                  len, buf);
+		}
 		jabber_parser_process(js, buf, len);
 		if(js->reinit)
 			jabber_stream_init(js);
+
+		/* A full read means there is more waiting, so read more at once. */
+		if((gsize)len == js->recv_buffer_size - 1 &&
+		   js->recv_buffer_size < JABBER_RECV_BUFFER_MAX) {
+			js->recv_buffer_size *= 2;
+			js->recv_buffer = g_realloc(js->recv_buffer,
+			                            js->recv_buffer_size);
+		}
+
+		/* Stanzas are handled as the parser completes them, so stopping here
+		 * hands control back to the main loop between whole batches of them.
+		 * The source is still ready, so we'll be called again right away.
+		 */
+		total += len;
+		if(total >= JABBER_RECV_BATCH_BYTES ||
+		   g_get_monotonic_time() >= deadline) {
+			break;
+		}
 	} while (len > 0);
 
 	return G_SOURCE_CONTINUE;
@@ -861,6 +959,8 @@ jabber_stream_new(PurpleAccount *account)
 			g_free, (GDestroyNotify)jabber_iq_callbackdata_free);
 	js->chats = g_hash_table_new_full(g_str_hash, g_str_equal,
 			g_free, (GDestroyNotify)jabber_chat_free);
+	js->file_transfers_by_sid = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
 	js->next_id = g_random_int();
 	js->keepalive_timeout = 0;
 	js->max_inactivity = DEFAULT_INACTIVITY_TIME;
@@ -1020,10 +1120,13 @@ jabber_close(G_GNUC_UNUSED PurpleProtocol *protocol, PurpleConnection *gc) {
 	jabber_buddy_remove_all_pending_buddy_info_requests(js);
 
 	jabber_parser_free(js);
+	g_clear_pointer(&js->recv_buffer, g_free);
+	js->recv_buffer_size = 0;
 
 	g_clear_pointer(&js->iq_callbacks, g_hash_table_destroy);
 	g_clear_pointer(&js->buddies, g_hash_table_destroy);
 	g_clear_pointer(&js->chats, g_hash_table_destroy);
+	g_clear_pointer(&js->file_transfers_by_sid, g_hash_table_destroy);
 
 	g_list_free_full(js->chat_servers, g_free);
 
@@ -2973,6 +3076,7 @@ jabber_do_uninit(void)
 	                                     jabber_caps_broadcast_change, NULL);
 
 	jabber_auth_uninit();
+	jabber_id_cache_clear();
 	g_clear_list(&jabber_features, (GDestroyNotify)jabber_feature_free);
 	g_clear_list(&jabber_identities, (GDestroyNotify)jabber_identity_free);
 
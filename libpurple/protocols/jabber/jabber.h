@@ -163,6 +163,7 @@ struct _JabberStream
 	GList *bs_proxies;
 	GList *oob_file_transfers;
 	GList *file_transfers;
+	GHashTable *file_transfers_by_sid;
 
 	time_t idle;
 	time_t old_idle;
@@ -176,6 +177,10 @@ struct _JabberStream
 	GInputStream *input;
 	PurpleQueuedOutputStream *output;
 
+	/* Grows while the server is sending a lot, see jabber_recv_cb. */
+	guint8 *recv_buffer;
+	gsize recv_buffer_size;
+
 	char *initial_avatar_hash;
 	char *avatar_hash;
 	GSList *pending_avatar_requests;
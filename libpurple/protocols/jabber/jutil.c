@@ -33,6 +33,22 @@
 #include <stringprep.h>
 static char idn_buffer[1024];
 
+/* The number of JIDs kept by jabber_id_intern() once nobody else uses them. */
+#define JABBER_ID_CACHE_SIZE 4096
+
+typedef struct {
+	JabberID jid; /* must be first, interned JIDs are handed out as this */
+	gint ref_count;
+	char *str;
+	char *bare;
+	GList link;
+} JabberIDCacheEntry;
+
+/* Maps the unparsed JID string to its JabberIDCacheEntry. */
+static GHashTable *jid_cache = NULL;
+/* The entries of jid_cache, most recently used first. */
+static GQueue jid_cache_lru = G_QUEUE_INIT;
+
 static gboolean jabber_nodeprep(char *str, size_t buflen)
 {
 	return stringprep_xmpp_nodeprep(str, buflen) == STRINGPREP_OK;
@@ -400,16 +416,109 @@ jabber_id_equal(const JabberID *jid1, const JabberID *jid2)
 			purple_strequal(jid1->resource, jid2->resource);
 }
 
+static void
+jabber_id_cache_entry_unref(JabberIDCacheEntry *entry)
+{
+	if (--entry->ref_count > 0) {
+		return;
+	}
+
+	g_free(entry->jid.node);
+	g_free(entry->jid.domain);
+	g_free(entry->jid.resource);
+	g_free(entry->str);
+	g_free(entry->bare);
+	g_free(entry);
+}
+
+const JabberID *
+jabber_id_intern(const char *str)
+{
+	JabberIDCacheEntry *entry;
+	JabberID *jid;
+
+	if (str == NULL) {
+		return NULL;
+	}
+
+	if (jid_cache == NULL) {
+		jid_cache = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+
+	entry = g_hash_table_lookup(jid_cache, str);
+	if (entry != NULL) {
+		g_queue_unlink(&jid_cache_lru, &entry->link);
+		g_queue_push_head_link(&jid_cache_lru, &entry->link);
+		entry->ref_count++;
+
+		return &entry->jid;
+	}
+
+	jid = jabber_id_new(str);
+	if (jid == NULL) {
+		return NULL;
+	}
+
+	entry = g_new0(JabberIDCacheEntry, 1);
+	entry->jid = *jid;
+	g_free(jid);
+	/* One reference for the cache and one for the caller. */
+	entry->ref_count = 2;
+	entry->str = g_strdup(str);
+	entry->bare = jabber_id_get_bare_jid(&entry->jid);
+	entry->link.data = entry;
+
+	g_hash_table_insert(jid_cache, entry->str, entry);
+	g_queue_push_head_link(&jid_cache_lru, &entry->link);
+
+	while (jid_cache_lru.length > JABBER_ID_CACHE_SIZE) {
+		JabberIDCacheEntry *old = g_queue_pop_tail_link(&jid_cache_lru)->data;
+
+		g_hash_table_remove(jid_cache, old->str);
+		jabber_id_cache_entry_unref(old);
+	}
+
+	return &entry->jid;
+}
+
+void
+jabber_id_release(const JabberID *jid)
+{
+	if (jid != NULL) {
+		jabber_id_cache_entry_unref((JabberIDCacheEntry *)jid);
+	}
+}
+
+const char *
+jabber_id_intern_get_bare_jid(const JabberID *jid)
+{
+	g_return_val_if_fail(jid != NULL, NULL);
+
+	return ((const JabberIDCacheEntry *)jid)->bare;
+}
+
+void
+jabber_id_cache_clear(void)
+{
+	GList *link;
+
+	while ((link = g_queue_pop_head_link(&jid_cache_lru)) != NULL) {
+		jabber_id_cache_entry_unref(link->data);
+	}
+
+	g_clear_pointer(&jid_cache, g_hash_table_destroy);
+}
+
 char *jabber_get_resource(const char *in)
 {
-	JabberID *jid = jabber_id_new(in);
+	const JabberID *jid = jabber_id_intern(in);
 	char *out;
 
 	if(!jid)
 		return NULL;
 
 	out = g_strdup(jid->resource);
-	jabber_id_free(jid);
+	jabber_id_release(jid);
 
 	return out;
 }
@@ -417,13 +526,13 @@ char *jabber_get_resource(const char *in)
 char *
 jabber_get_bare_jid(const char *in)
 {
-	JabberID *jid = jabber_id_new(in);
+	const JabberID *jid = jabber_id_intern(in);
 	char *out;
 
 	if (!jid)
 		return NULL;
-	out = jabber_id_get_bare_jid(jid);
-	jabber_id_free(jid);
+	out = g_strdup(jabber_id_intern_get_bare_jid(jid));
+	jabber_id_release(jid);
 
 	return out;
 }
@@ -477,7 +586,8 @@ const char *jabber_normalize(const PurpleAccount *account, const char *in)
 	PurpleConnection *gc = NULL;
 	JabberStream *js = NULL;
 	static char buf[3072]; /* maximum legal length of a jabber jid */
-	JabberID *jid;
+	const JabberID *jid;
+	JabberID *parsed = NULL;
 
 	if (account) {
 		gc = purple_account_get_connection((PurpleAccount *)account);
@@ -485,19 +595,28 @@ const char *jabber_normalize(const PurpleAccount *account, const char *in)
 	if (gc)
 		js = purple_connection_get_protocol_data(gc);
 
-	jid = jabber_id_new_internal(in, TRUE);
-	if(!jid)
-		return NULL;
+	/* Only a JID with a terminating slash needs the uncached parser. */
+	jid = jabber_id_intern(in);
+	if(!jid) {
+		jid = parsed = jabber_id_new_internal(in, TRUE);
+		if(!jid)
+			return NULL;
+	}
 
 	if(js && jid->node && jid->resource &&
 			jabber_chat_find(js, jid->node, jid->domain))
 		g_snprintf(buf, sizeof(buf), "%s@%s/%s", jid->node, jid->domain,
 				jid->resource);
+	else if(parsed == NULL)
+		g_strlcpy(buf, jabber_id_intern_get_bare_jid(jid), sizeof(buf));
 	else
 		g_snprintf(buf, sizeof(buf), "%s%s%s", jid->node ? jid->node : "",
 				jid->node ? "@" : "", jid->domain);
 
-	jabber_id_free(jid);
+	if(parsed)
+		jabber_id_free(parsed);
+	else
+		jabber_id_release(jid);
 
 	return buf;
 }
@@ -505,7 +624,7 @@ const char *jabber_normalize(const PurpleAccount *account, const char *in)
 gboolean
 jabber_is_own_account(JabberStream *js, const char *str)
 {
-	JabberID *jid;
+	const JabberID *jid;
 	gboolean equal;
 
 	if (str == NULL)
@@ -513,7 +632,7 @@ jabber_is_own_account(JabberStream *js, const char *str)
 
 	g_return_val_if_fail(*str != '\0', FALSE);
 
-	jid = jabber_id_new(str);
+	jid = jabber_id_intern(str);
 	if (!jid)
 		return FALSE;
 
@@ -521,7 +640,7 @@ jabber_is_own_account(JabberStream *js, const char *str)
 	         purple_strequal(jid->domain, js->user->domain) &&
 	         (jid->resource == NULL ||
 	             purple_strequal(jid->resource, js->user->resource)));
-	jabber_id_free(jid);
+	jabber_id_release(jid);
 	return equal;
 }
 
@@ -54,6 +54,38 @@ gboolean jabber_id_equal(const JabberID *jid1, const JabberID *jid2);
 
 void jabber_id_free(JabberID *jid);
 
+/**
+ * Parse a JID through a bounded cache of recently seen JIDs.
+ *
+ * Repeated lookups of the same string (e.g. presence floods from a large
+ * MUC) return the same, already split and normalized JabberID without
+ * parsing or allocating again.
+ *
+ * @param str  The JID to parse.
+ *
+ * @returns A reference to a read-only JabberID, which must be released with
+ *          jabber_id_release() and never passed to jabber_id_free(), or NULL
+ *          if @str is not a valid JID.
+ */
+const JabberID *jabber_id_intern(const char *str);
+
+/**
+ * Release a reference returned by jabber_id_intern().
+ */
+void jabber_id_release(const JabberID *jid);
+
+/**
+ * Returns the bare JID of a JabberID returned by jabber_id_intern(), suitable
+ * as a hash table key.  The string is owned by @jid.
+ */
+const char *jabber_id_intern_get_bare_jid(const JabberID *jid);
+
+/**
+ * Drop the cache used by jabber_id_intern().  JabberIDs that are still
+ * referenced stay valid until they are released.
+ */
+void jabber_id_cache_clear(void);
+
 char *jabber_get_resource(const char *jid);
 char *jabber_get_bare_jid(const char *jid);
 char *jabber_id_get_bare_jid(const JabberID *jid);
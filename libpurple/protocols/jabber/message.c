@@ -98,7 +98,7 @@ void jabber_message_free(JabberMessage *jm)
 static void handle_chat(JabberMessage *jm)
 {
 	const gchar *contact = jm->outgoing ? jm->to : jm->from;
-	JabberID *jid = jabber_id_new(contact);
+	const JabberID *jid = jabber_id_intern(contact);
 
 	PurpleConnection *gc;
 	PurpleConversationManager *manager;
@@ -210,7 +210,7 @@ static void handle_chat(JabberMessage *jm)
 		                   (time_t)g_date_time_to_unix(jm->sent));
 	}
 
-	jabber_id_free(jid);
+	jabber_id_release(jid);
 
 	if(body)
 		g_string_free(body, TRUE);
@@ -236,7 +236,7 @@ static void handle_headline(JabberMessage *jm)
 
 static void handle_groupchat(JabberMessage *jm)
 {
-	JabberID *jid = jabber_id_new(jm->from);
+	const JabberID *jid = jabber_id_intern(jm->from);
 	JabberChat *chat;
 	PurpleMessageFlags messageFlags = 0;
 
@@ -245,8 +245,10 @@ static void handle_groupchat(JabberMessage *jm)
 
 	chat = jabber_chat_find(jm->js, jid->node, jid->domain);
 
-	if(!chat)
+	if(!chat) {
+		jabber_id_release(jid);
 		return;
+	}
 
 	if(jm->subject) {
 		purple_chat_conversation_set_topic(chat->conv, jid->resource,
@@ -282,13 +284,13 @@ static void handle_groupchat(JabberMessage *jm)
 		}
 	}
 
-	jabber_id_free(jid);
+	jabber_id_release(jid);
 }
 
 static void handle_groupchat_invite(JabberMessage *jm)
 {
 	GHashTable *components;
-	JabberID *jid = jabber_id_new(jm->to);
+	const JabberID *jid = jabber_id_intern(jm->to);
 
 	if(!jid)
 		return;
@@ -300,7 +302,7 @@ static void handle_groupchat_invite(JabberMessage *jm)
 	g_hash_table_replace(components, "handle", g_strdup(jm->js->user->node));
 	g_hash_table_replace(components, "password", g_strdup(jm->password));
 
-	jabber_id_free(jid);
+	jabber_id_release(jid);
 	purple_serv_got_chat_invite(jm->js->gc, jm->to, jm->from, jm->body, components);
 }
 
@@ -107,35 +107,50 @@ jabber_parser_element_start_libxml(void *user_data,
 		}
 	} else {
 
-		if(js->current)
+		if(js->current) {
 			node = purple_xmlnode_new_child(js->current, (const char*) element_name);
-		else
-			node = purple_xmlnode_new((const char*) element_name);
+		} else {
+			/* Every stanza gets its own arena so that building it and freeing
+			 * it after it has been processed only takes a handful of
+			 * allocations. The stanza holds the only reference we need.
+			 */
+			PurpleXmlNodeArena *arena = purple_xmlnode_arena_new();
+
+			node = purple_xmlnode_new_in_arena(arena, (const char*) element_name);
+			purple_xmlnode_arena_unref(arena);
+		}
 		purple_xmlnode_set_namespace(node, (const char*) namespace);
 		purple_xmlnode_set_prefix(node, (const char *)prefix);
 
-		if (nb_namespaces != 0) {
-			node->namespace_map = g_hash_table_new_full(
-				g_str_hash, g_str_equal, g_free, g_free);
+		/* Most elements only redeclare their own default namespace, e.g.
+		 * <query xmlns='jabber:iq:roster'/>, which the node already knows
+		 * about, so skip building a namespace map for them.
+		 */
+		if(nb_namespaces == 1 && prefix == NULL && namespaces[0] == NULL &&
+		   purple_strequal((const char *)namespaces[1], (const char *)namespace))
+		{
+			nb_namespaces = 0;
+		}
 
-			for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
-				const char *key = (const char *)namespaces[j];
-				const char *val = (const char *)namespaces[j + 1];
-				g_hash_table_insert(node->namespace_map,
-					g_strdup(key ? key : ""), g_strdup(val ? val : ""));
-			}
+		for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
+			purple_xmlnode_declare_namespace(node,
+			                                 (const char *)namespaces[j],
+			                                 (const char *)namespaces[j + 1]);
 		}
 		for(i=0; i < nb_attributes * 5; i+=5) {
 			const char *name = (const char *)attributes[i];
 			const char *prefix = (const char *)attributes[i+1];
 			const char *attrib_ns = (const char *)attributes[i+2];
-			char *txt;
 			int attrib_len = attributes[i+4] - attributes[i+3];
 			char *attrib = g_strndup((gchar *)attributes[i+3], attrib_len);
 
-			txt = attrib;
-			attrib = purple_unescape_text(txt);
-			g_free(txt);
+			/* Only pay for unescaping when there is something to unescape. */
+			if(strchr(attrib, '&') != NULL) {
+				char *txt = attrib;
+
+				attrib = purple_unescape_text(txt);
+				g_free(txt);
+			}
 			purple_xmlnode_set_attrib_full(node, name, attrib_ns, prefix, attrib);
 			g_free(attrib);
 		}
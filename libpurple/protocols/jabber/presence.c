@@ -567,12 +567,20 @@ handle_presence_chat(JabberStream *js, JabberPresence *presence, PurpleXmlNode *
 			purple_chat_conversation_add_user(chat->conv,
 			                                  presence->jid_from->resource,
 			                                  jid, flags, new_arrival);
+			jabber_chat_add_member(chat, presence->jid_from->resource,
+			                       new_arrival);
 		} else {
 			purple_chat_user_set_flags(purple_chat_conversation_find_user(chat->conv, presence->jid_from->resource),
 					flags);
+
+			/* A nick change renames the user but tracks a new handle. */
+			jabber_chat_add_member(chat, presence->jid_from->resource, FALSE);
 		}
 
 		if (is_our_resource && chat->joined == NULL) {
+			/* Everyone that was already in the room has been sent by now. */
+			jabber_chat_add_pending_members(chat);
+
 			chat->joined = g_date_time_new_now_utc();
 		}
 
@@ -738,11 +746,12 @@ handle_presence_contact(JabberStream *js, JabberPresence *presence)
 	JabberBuddyResource *jbr;
 	PurpleAccount *account;
 	PurpleBuddy *b;
-	char *buddy_name;
+	const char *buddy_name;
 	PurpleConversation *im;
 	PurpleConversationManager *manager;
 
-	buddy_name = jabber_id_get_bare_jid(presence->jid_from);
+	/* Owned by jid_from, which came from jabber_id_intern(). */
+	buddy_name = jabber_id_intern_get_bare_jid(presence->jid_from);
 
 	account = purple_connection_get_account(js->gc);
 	b = purple_blist_find_buddy(account, buddy_name);
@@ -768,7 +777,6 @@ handle_presence_contact(JabberStream *js, JabberPresence *presence)
 			                     buddy_name,
 			                     purple_contact_info_get_username(info),
 			                     account);
-			g_free(buddy_name);
 			return FALSE;
 		} else {
 			/* this is a different resource of our own account. Resume even when this account isn't on our blist */
@@ -831,7 +839,6 @@ handle_presence_contact(JabberStream *js, JabberPresence *presence)
 				presence->status ? "message" : NULL, presence->status,
 				NULL);
 	}
-	g_free(buddy_name);
 
 	return TRUE;
 }
@@ -857,7 +864,7 @@ void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet)
 	presence.jb = jabber_buddy_find(js, presence.from, TRUE);
 	g_return_if_fail(presence.jb != NULL);
 
-	presence.jid_from = jabber_id_new(presence.from);
+	presence.jid_from = jabber_id_intern(presence.from);
 	if (presence.jid_from == NULL) {
 		purple_debug_error("jabber", "Ignoring presence with malformed 'from' "
 		                   "JID: %s\n", presence.from);
@@ -1021,7 +1028,7 @@ out:
 	g_free(presence.status);
 	g_free(presence.vcard_avatar_hash);
 	g_free(presence.nickname);
-	jabber_id_free(presence.jid_from);
+	jabber_id_release(presence.jid_from);
 	g_clear_pointer(&presence.sent, g_date_time_unref);
 }
 
@@ -53,7 +53,7 @@ struct _JabberPresenceChatInfo {
 
 struct _JabberPresence {
 	JabberPresenceType type;
-	JabberID *jid_from;
+	const JabberID *jid_from;
 	const char *from;
 	const char *to;
 	const char *id;
@@ -79,23 +79,68 @@ G_DEFINE_DYNAMIC_TYPE(JabberSIXfer, jabber_si_xfer, PURPLE_TYPE_XFER);
 /* some forward declarations */
 static void jabber_si_xfer_ibb_send_init(JabberStream *js, PurpleXfer *xfer);
 
-static PurpleXfer*
+/* Stream ids are only unique per peer, so file_transfers_by_sid uses both. */
+static gchar *
+jabber_si_xfer_key(const char *sid, const char *from)
+{
+	return g_strconcat(sid, "\x1f", from, NULL);
+}
+
+static void
+jabber_si_xfer_index(JabberSIXfer *jsx)
+{
+	const char *who = purple_xfer_get_remote_user(PURPLE_XFER(jsx));
+
+	if (jsx->stream_id == NULL || who == NULL ||
+			jsx->js->file_transfers_by_sid == NULL) {
+		return;
+	}
+
+	g_hash_table_replace(jsx->js->file_transfers_by_sid,
+	                     jabber_si_xfer_key(jsx->stream_id, who), jsx);
+}
+
+static void
+jabber_si_xfer_unindex(JabberSIXfer *jsx)
+{
+	const char *who = purple_xfer_get_remote_user(PURPLE_XFER(jsx));
+	gchar *key;
+
+	if (jsx->stream_id == NULL || who == NULL ||
+			jsx->js->file_transfers_by_sid == NULL) {
+		return;
+	}
+
+	key = jabber_si_xfer_key(jsx->stream_id, who);
+	if (g_hash_table_lookup(jsx->js->file_transfers_by_sid, key) == jsx) {
+		g_hash_table_remove(jsx->js->file_transfers_by_sid, key);
+	}
+	g_free(key);
+}
+
+void
+jabber_si_xfer_set_stream_id(JabberSIXfer *jsx, const char *stream_id)
+{
+	jabber_si_xfer_unindex(jsx);
+	g_free(jsx->stream_id);
+	jsx->stream_id = g_strdup(stream_id);
+	jabber_si_xfer_index(jsx);
+}
+
+PurpleXfer*
 jabber_si_xfer_find(JabberStream *js, const char *sid, const char *from)
 {
-	GList *xfers;
+	PurpleXfer *xfer;
+	gchar *key;
 
-	if(!sid || !from)
+	if(!sid || !from || !js->file_transfers_by_sid)
 		return NULL;
 
-	for(xfers = js->file_transfers; xfers; xfers = xfers->next) {
-		PurpleXfer *xfer = xfers->data;
-		JabberSIXfer *jsx = JABBER_SI_XFER(xfer);
-		if(jsx->stream_id && purple_xfer_get_remote_user(xfer) &&
-				purple_strequal(jsx->stream_id, sid) && purple_strequal(purple_xfer_get_remote_user(xfer), from))
-			return xfer;
-	}
+	key = jabber_si_xfer_key(sid, from);
+	xfer = g_hash_table_lookup(js->file_transfers_by_sid, key);
+	g_free(key);
 
-	return NULL;
+	return xfer;
 }
 
 
@@ -179,6 +224,8 @@ jabber_si_bytestreams_connect_cb(GObject *source, GAsyncResult *result,
 
 	jsx->local_streamhost_conn = G_SOCKET_CONNECTION(stream);
 	socket = g_socket_connection_get_socket(jsx->local_streamhost_conn);
+	/* bytestreams write straight to the socket, see jabber_si_xfer_ibb_write */
+	purple_xfer_set_passthrough(xfer, TRUE);
 	purple_xfer_start(xfer, g_socket_get_fd(socket), NULL, -1);
 }
 
@@ -849,6 +896,7 @@ jabber_si_connect_proxy_cb(JabberStream *js, const char *from,
 			sock = g_socket_connection_get_socket(jsx->local_streamhost_conn);
 			fd = g_socket_get_fd(sock);
 			_purple_network_set_common_socket_flags(fd);
+			purple_xfer_set_passthrough(xfer, TRUE);
 			purple_xfer_start(xfer, fd, NULL, -1);
 		} else {
 			/* if available, try to revert to IBB... */
@@ -1178,6 +1226,12 @@ jabber_si_xfer_ibb_write(PurpleXfer *xfer, const guchar *buffer, size_t len)
 		return PURPLE_XFER_CLASS(jabber_si_xfer_parent_class)->write(xfer, buffer, len);
 	}
 
+	/* the window is full, the data will be offered again once some of it has
+	 * been acknowledged */
+	if (!jabber_ibb_session_can_send(sess)) {
+		return 0;
+	}
+
 	packet_size = MIN(len, jabber_ibb_session_get_max_data_size(sess));
 
 	jabber_ibb_session_send_data(sess, buffer, packet_size);
@@ -1185,6 +1239,33 @@ jabber_si_xfer_ibb_write(PurpleXfer *xfer, const guchar *buffer, size_t len)
 	return packet_size;
 }
 
+/* Keep handing blocks to the IBB session until its window is full, so that
+ * several of them are on the wire at once instead of one per round trip.
+ */
+static void
+jabber_si_xfer_ibb_fill_window(PurpleXfer *xfer, JabberIBBSession *sess)
+{
+	g_object_ref(xfer);
+
+	while (jabber_ibb_session_can_send(sess) &&
+	       purple_xfer_get_bytes_remaining(xfer) > 0 &&
+	       !purple_xfer_is_completed(xfer) &&
+	       !purple_xfer_is_cancelled(xfer))
+	{
+		guint in_flight = jabber_ibb_session_get_in_flight(sess);
+
+		purple_xfer_protocol_ready(xfer);
+
+		/* the UI may not have any data for us right now, it'll let us know
+		 * when it does */
+		if (jabber_ibb_session_get_in_flight(sess) <= in_flight) {
+			break;
+		}
+	}
+
+	g_object_unref(xfer);
+}
+
 static void
 jabber_si_xfer_ibb_sent_cb(JabberIBBSession *sess)
 {
@@ -1192,13 +1273,16 @@ jabber_si_xfer_ibb_sent_cb(JabberIBBSession *sess)
 	goffset remaining = purple_xfer_get_bytes_remaining(xfer);
 
 	if (remaining == 0) {
-		/* close the session */
-		jabber_ibb_session_close(sess);
-		purple_xfer_set_completed(xfer, TRUE);
-		purple_xfer_end(xfer);
+		/* wait until every block has been acknowledged */
+		if (jabber_ibb_session_get_in_flight(sess) == 0) {
+			/* close the session */
+			jabber_ibb_session_close(sess);
+			purple_xfer_set_completed(xfer, TRUE);
+			purple_xfer_end(xfer);
+		}
 	} else {
 		/* send more... */
-		purple_xfer_protocol_ready(xfer);
+		jabber_si_xfer_ibb_fill_window(xfer, sess);
 	}
 }
 
@@ -1209,7 +1293,7 @@ jabber_si_xfer_ibb_opened_cb(JabberIBBSession *sess)
 
 	if (jabber_ibb_session_get_state(sess) == JABBER_IBB_SESSION_OPENED) {
 		purple_xfer_start(xfer, -1, NULL, 0);
-		purple_xfer_protocol_ready(xfer);
+		jabber_si_xfer_ibb_fill_window(xfer, sess);
 	} else {
 		/* error */
 		purple_xfer_end(xfer);
@@ -1311,6 +1395,7 @@ static void jabber_si_xfer_send_request(PurpleXfer *xfer)
 	JabberIq *iq;
 	PurpleXmlNode *si, *file, *feature, *x, *field, *option, *value;
 	char buf[32];
+	char *stream_id;
 #if ENABLE_FT_THUMBNAILS
 	gconstpointer thumb;
 	gsize thumb_size;
@@ -1323,7 +1408,9 @@ static void jabber_si_xfer_send_request(PurpleXfer *xfer)
 	purple_xmlnode_set_attrib(iq->node, "to", purple_xfer_get_remote_user(xfer));
 	si = purple_xmlnode_new_child(iq->node, "si");
 	purple_xmlnode_set_namespace(si, "http://jabber.org/protocol/si");
-	jsx->stream_id = jabber_get_next_id(jsx->js);
+	stream_id = jabber_get_next_id(jsx->js);
+	jabber_si_xfer_set_stream_id(jsx, stream_id);
+	g_free(stream_id);
 	purple_xmlnode_set_attrib(si, "id", jsx->stream_id);
 	purple_xmlnode_set_attrib(si, "profile", NS_SI_FILE_TRANSFER);
 
@@ -1675,7 +1762,7 @@ jabber_si_new_xfer(G_GNUC_UNUSED PurpleProtocolXfer *prplxfer,
 	);
 
 	jsx->js = js;
-	js->file_transfers = g_list_append(js->file_transfers, jsx);
+	js->file_transfers = g_list_prepend(js->file_transfers, jsx);
 
 	return PURPLE_XFER(jsx);
 }
@@ -1787,7 +1874,7 @@ jabber_si_parse(JabberStream *js, const char *from,
 	}
 
 	jsx->js = js;
-	jsx->stream_id = g_strdup(stream_id);
+	jabber_si_xfer_set_stream_id(jsx, stream_id);
 	jsx->iq_id = g_strdup(id);
 
 	purple_xfer_set_filename(PURPLE_XFER(jsx), filename);
@@ -1795,7 +1882,7 @@ jabber_si_parse(JabberStream *js, const char *from,
 		purple_xfer_set_size(PURPLE_XFER(jsx), filesize);
 	}
 
-	js->file_transfers = g_list_append(js->file_transfers, jsx);
+	js->file_transfers = g_list_prepend(js->file_transfers, jsx);
 
 #if ENABLE_FT_THUMBNAILS
 	/* if there is a thumbnail, we should request it... */
@@ -1829,6 +1916,7 @@ jabber_si_xfer_finalize(GObject *obj) {
 	JabberStream *js = jsx->js;
 
 	js->file_transfers = g_list_remove(js->file_transfers, jsx);
+	jabber_si_xfer_unindex(jsx);
 
 	g_cancellable_cancel(jsx->cancellable);
 	g_clear_object(&jsx->cancellable);
@@ -38,6 +38,8 @@ void jabber_bytestreams_parse(JabberStream *js, const char *from,
                               JabberIqType type, const char *id, PurpleXmlNode *query);
 PurpleXfer *jabber_si_new_xfer(PurpleProtocolXfer *prplxfer, PurpleConnection *gc, const char *who);
 void jabber_si_xfer_send(PurpleProtocolXfer *prplxfer, PurpleConnection *gc, const char *who, const char *file);
+void jabber_si_xfer_set_stream_id(JabberSIXfer *jsx, const char *stream_id);
+PurpleXfer *jabber_si_xfer_find(JabberStream *js, const char *sid, const char *from);
 
 void jabber_si_xfer_register(GTypeModule *module);
 
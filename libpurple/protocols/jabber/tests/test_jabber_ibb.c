@@ -0,0 +1,325 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/ibb.h"
+#include "protocols/jabber/iq.h"
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/namespaces.h"
+
+#define TEST_JABBER_IBB_WHO "peer@example.com/test"
+
+/******************************************************************************
+ * TestJabberIBBProtocol
+ *****************************************************************************/
+static GType test_jabber_ibb_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestJabberIBBProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestJabberIBBProtocolClass;
+
+G_DEFINE_TYPE(TestJabberIBBProtocol, test_jabber_ibb_protocol,
+              PURPLE_TYPE_PROTOCOL)
+
+static void
+test_jabber_ibb_protocol_init(G_GNUC_UNUSED TestJabberIBBProtocol *protocol) {
+}
+
+static void
+test_jabber_ibb_protocol_class_init(G_GNUC_UNUSED TestJabberIBBProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleConnection *connection;
+	JabberStream *js;
+	JabberIBBSession *sess;
+
+	/* the <data/> iqs that were sent, oldest first */
+	GPtrArray *sent;
+	guint data_sent;
+	guint errors;
+} TestJabberIBBFixture;
+
+static void
+test_jabber_ibb_sending_cb(G_GNUC_UNUSED PurpleConnection *connection,
+                           PurpleXmlNode **packet, gpointer data)
+{
+	TestJabberIBBFixture *fixture = data;
+
+	if(purple_xmlnode_get_child_with_namespace(*packet, "data", NS_IBB)) {
+		g_ptr_array_add(fixture->sent, purple_xmlnode_copy(*packet));
+	}
+}
+
+static void
+test_jabber_ibb_data_sent_cb(JabberIBBSession *sess) {
+	TestJabberIBBFixture *fixture = jabber_ibb_session_get_user_data(sess);
+
+	fixture->data_sent++;
+}
+
+static void
+test_jabber_ibb_error_cb(JabberIBBSession *sess) {
+	TestJabberIBBFixture *fixture = jabber_ibb_session_get_user_data(sess);
+
+	fixture->errors++;
+}
+
+static void
+test_jabber_ibb_setup(TestJabberIBBFixture *fixture,
+                      G_GNUC_UNUSED gconstpointer data)
+{
+	fixture->protocol = g_object_new(test_jabber_ibb_protocol_get_type(),
+	                                 "id", "prpl-test-jabber-ibb", NULL);
+	fixture->connection = g_object_new(PURPLE_TYPE_CONNECTION,
+	                                   "protocol", fixture->protocol, NULL);
+
+	purple_signal_register(fixture->protocol, "jabber-sending-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+	purple_signal_register(fixture->protocol, "jabber-receiving-iq",
+	                       purple_marshal_BOOLEAN__POINTER_POINTER_POINTER_POINTER_POINTER,
+	                       G_TYPE_BOOLEAN, 5, PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+	                       PURPLE_TYPE_XMLNODE);
+	purple_signal_connect(fixture->protocol, "jabber-sending-xmlnode",
+	                      fixture, G_CALLBACK(test_jabber_ibb_sending_cb),
+	                      fixture);
+
+	fixture->js = g_new0(JabberStream, 1);
+	fixture->js->gc = fixture->connection;
+	fixture->js->iq_callbacks = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                                  g_free,
+	                                                  (GDestroyNotify)jabber_iq_callbackdata_free);
+
+	fixture->sent = g_ptr_array_new_with_free_func((GDestroyNotify)purple_xmlnode_free);
+
+	fixture->sess = jabber_ibb_session_create(fixture->js, NULL,
+	                                          TEST_JABBER_IBB_WHO, fixture);
+	fixture->sess->state = JABBER_IBB_SESSION_OPENED;
+	jabber_ibb_session_set_data_sent_callback(fixture->sess,
+	                                          test_jabber_ibb_data_sent_cb);
+	jabber_ibb_session_set_error_callback(fixture->sess,
+	                                      test_jabber_ibb_error_cb);
+}
+
+static void
+test_jabber_ibb_teardown(TestJabberIBBFixture *fixture,
+                         G_GNUC_UNUSED gconstpointer data)
+{
+	/* Don't send a <close/> for the session. */
+	fixture->sess->state = JABBER_IBB_SESSION_CLOSED;
+	jabber_ibb_session_destroy(fixture->sess);
+
+	g_ptr_array_free(fixture->sent, TRUE);
+	g_hash_table_destroy(fixture->js->iq_callbacks);
+	g_free(fixture->js);
+
+	purple_signals_disconnect_by_handle(fixture);
+	purple_signals_unregister_by_instance(fixture->protocol);
+	g_clear_object(&fixture->connection);
+	g_clear_object(&fixture->protocol);
+}
+
+static void
+test_jabber_ibb_send(TestJabberIBBFixture *fixture, guint count) {
+	for(guint i = 0; i < count; i++) {
+		jabber_ibb_session_send_data(fixture->sess, "data", 4);
+	}
+}
+
+/* Returns the seq of the index'th <data/> that was sent. */
+static guint
+test_jabber_ibb_sent_seq(TestJabberIBBFixture *fixture, guint index) {
+	PurpleXmlNode *data = NULL;
+
+	g_assert_cmpuint(index, <, fixture->sent->len);
+
+	data = purple_xmlnode_get_child_with_namespace(fixture->sent->pdata[index],
+	                                               "data", NS_IBB);
+
+	return atoi(purple_xmlnode_get_attrib(data, "seq"));
+}
+
+/* Answers the index'th <data/> that was sent. error_type is NULL for a
+ * result. */
+static void
+test_jabber_ibb_answer(TestJabberIBBFixture *fixture, guint index,
+                       const gchar *error_type, const gchar *condition)
+{
+	PurpleXmlNode *iq = NULL, *error = NULL, *child = NULL;
+	const gchar *id = NULL;
+
+	g_assert_cmpuint(index, <, fixture->sent->len);
+	id = purple_xmlnode_get_attrib(fixture->sent->pdata[index], "id");
+
+	iq = purple_xmlnode_new("iq");
+	purple_xmlnode_set_attrib(iq, "from", TEST_JABBER_IBB_WHO);
+	purple_xmlnode_set_attrib(iq, "id", id);
+
+	if(error_type == NULL) {
+		purple_xmlnode_set_attrib(iq, "type", "result");
+	} else {
+		purple_xmlnode_set_attrib(iq, "type", "error");
+		error = purple_xmlnode_new_child(iq, "error");
+		purple_xmlnode_set_attrib(error, "type", error_type);
+		child = purple_xmlnode_new_child(error, condition);
+		purple_xmlnode_set_namespace(child, NS_XMPP_STANZAS);
+	}
+
+	jabber_iq_parse(fixture->js, iq);
+	purple_xmlnode_free(iq);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_ibb_window(TestJabberIBBFixture *fixture,
+                       G_GNUC_UNUSED gconstpointer data)
+{
+	jabber_ibb_session_set_window_size(fixture->sess, 2);
+
+	test_jabber_ibb_send(fixture, 2);
+	g_assert_cmpuint(fixture->sent->len, ==, 2);
+	g_assert_cmpuint(jabber_ibb_session_get_in_flight(fixture->sess), ==, 2);
+	g_assert_false(jabber_ibb_session_can_send(fixture->sess));
+
+	/* An acknowledgement out of order doesn't retire anything. */
+	test_jabber_ibb_answer(fixture, 1, NULL, NULL);
+	g_assert_cmpuint(jabber_ibb_session_get_in_flight(fixture->sess), ==, 2);
+	g_assert_cmpuint(fixture->data_sent, ==, 0);
+
+	test_jabber_ibb_answer(fixture, 0, NULL, NULL);
+	g_assert_cmpuint(jabber_ibb_session_get_in_flight(fixture->sess), ==, 0);
+	g_assert_cmpuint(fixture->data_sent, ==, 1);
+	g_assert_true(jabber_ibb_session_can_send(fixture->sess));
+}
+
+static void
+test_jabber_ibb_wait_drains(TestJabberIBBFixture *fixture,
+                            G_GNUC_UNUSED gconstpointer data)
+{
+	jabber_ibb_session_set_window_size(fixture->sess, 4);
+	test_jabber_ibb_send(fixture, 3);
+	g_assert_cmpuint(fixture->sent->len, ==, 3);
+
+	/* The receiver asks us to wait on the first block, so nothing is sent
+	 * until the other two have been answered. */
+	test_jabber_ibb_answer(fixture, 0, "wait", "resource-constraint");
+	g_assert_cmpuint(fixture->sent->len, ==, 3);
+	g_assert_cmpuint(jabber_ibb_session_get_window_size(fixture->sess), ==, 1);
+	g_assert_false(jabber_ibb_session_can_send(fixture->sess));
+
+	/* The blocks after it are refused since they are out of order. */
+	test_jabber_ibb_answer(fixture, 1, "cancel", "unexpected-request");
+	g_assert_cmpuint(fixture->sent->len, ==, 3);
+	test_jabber_ibb_answer(fixture, 2, "cancel", "unexpected-request");
+	g_assert_cmpuint(fixture->errors, ==, 0);
+	g_assert_cmpint(jabber_ibb_session_get_state(fixture->sess), ==,
+	                JABBER_IBB_SESSION_OPENED);
+
+	/* Now they are resent one at a time. */
+	g_assert_cmpuint(fixture->sent->len, ==, 4);
+	g_assert_cmpuint(test_jabber_ibb_sent_seq(fixture, 3), ==, 0);
+
+	test_jabber_ibb_answer(fixture, 3, NULL, NULL);
+	g_assert_cmpuint(fixture->data_sent, ==, 1);
+	g_assert_cmpuint(fixture->sent->len, ==, 5);
+	g_assert_cmpuint(test_jabber_ibb_sent_seq(fixture, 4), ==, 1);
+
+	test_jabber_ibb_answer(fixture, 4, NULL, NULL);
+	g_assert_cmpuint(fixture->sent->len, ==, 6);
+	g_assert_cmpuint(test_jabber_ibb_sent_seq(fixture, 5), ==, 2);
+
+	test_jabber_ibb_answer(fixture, 5, NULL, NULL);
+	g_assert_cmpuint(fixture->sent->len, ==, 6);
+	g_assert_cmpuint(fixture->data_sent, ==, 3);
+	g_assert_cmpuint(jabber_ibb_session_get_in_flight(fixture->sess), ==, 0);
+	g_assert_true(jabber_ibb_session_can_send(fixture->sess));
+}
+
+static void
+test_jabber_ibb_wait_gives_up(TestJabberIBBFixture *fixture,
+                              G_GNUC_UNUSED gconstpointer data)
+{
+	test_jabber_ibb_send(fixture, 1);
+
+	/* The first answer plus three retries. */
+	for(guint i = 0; i < 4; i++) {
+		g_assert_cmpuint(fixture->sent->len, ==, i + 1);
+		g_assert_cmpuint(test_jabber_ibb_sent_seq(fixture, i), ==, 0);
+		test_jabber_ibb_answer(fixture, i, "wait", "resource-constraint");
+	}
+
+	g_assert_cmpuint(fixture->sent->len, ==, 4);
+	g_assert_cmpuint(fixture->errors, ==, 1);
+	g_assert_cmpint(jabber_ibb_session_get_state(fixture->sess), ==,
+	                JABBER_IBB_SESSION_ERROR);
+	g_assert_cmpuint(jabber_ibb_session_get_in_flight(fixture->sess), ==, 0);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	purple_signals_init();
+	purple_connections_init();
+	jabber_iq_init();
+	jabber_ibb_init();
+
+	g_test_add("/jabber/ibb/window", TestJabberIBBFixture, NULL,
+	           test_jabber_ibb_setup, test_jabber_ibb_window,
+	           test_jabber_ibb_teardown);
+	g_test_add("/jabber/ibb/wait-drains", TestJabberIBBFixture, NULL,
+	           test_jabber_ibb_setup, test_jabber_ibb_wait_drains,
+	           test_jabber_ibb_teardown);
+	g_test_add("/jabber/ibb/wait-gives-up", TestJabberIBBFixture, NULL,
+	           test_jabber_ibb_setup, test_jabber_ibb_wait_gives_up,
+	           test_jabber_ibb_teardown);
+
+	ret = g_test_run();
+
+	jabber_ibb_uninit();
+	jabber_iq_uninit();
+	purple_connections_uninit();
+	purple_signals_uninit();
+
+	return ret;
+}
@@ -205,6 +205,67 @@ test_jabber_util_jid_parts(void) {
 	assert_jid_parts("noone", "өexample.com", "noone@Өexample.com");
 }
 
+static void
+test_jabber_util_id_intern(void) {
+	const JabberID *jid1 = NULL, *jid2 = NULL;
+
+	jid1 = jabber_id_intern("NoOne@Example.com/Resource");
+	g_assert_nonnull(jid1);
+	g_assert_cmpstr(jid1->node, ==, "noone");
+	g_assert_cmpstr(jid1->domain, ==, "example.com");
+	g_assert_cmpstr(jid1->resource, ==, "Resource");
+	g_assert_cmpstr(jabber_id_intern_get_bare_jid(jid1), ==,
+	                "noone@example.com");
+
+	/* The same string gives back the same parsed JID. */
+	jid2 = jabber_id_intern("NoOne@Example.com/Resource");
+	g_assert_true(jid1 == jid2);
+	jabber_id_release(jid2);
+
+	g_assert_null(jabber_id_intern("noone@"));
+	g_assert_null(jabber_id_intern(NULL));
+
+	/* Clearing the cache must not invalidate JIDs that are still in use. */
+	jabber_id_cache_clear();
+	g_assert_cmpstr(jid1->node, ==, "noone");
+
+	jid2 = jabber_id_intern("NoOne@Example.com/Resource");
+	g_assert_true(jid1 != jid2);
+	g_assert_cmpstr(jabber_id_intern_get_bare_jid(jid2), ==,
+	                "noone@example.com");
+
+	jabber_id_release(jid1);
+	jabber_id_release(jid2);
+	jabber_id_cache_clear();
+}
+
+static void
+test_jabber_util_id_intern_evict(void) {
+	const JabberID *first = NULL, *again = NULL;
+	gint i;
+
+	first = jabber_id_intern("first@example.com");
+	g_assert_nonnull(first);
+
+	/* Push the first JID out of the cache. */
+	for (i = 0; i < 8192; i++) {
+		gchar *str = g_strdup_printf("user%d@example.com", i);
+
+		jabber_id_release(jabber_id_intern(str));
+		g_free(str);
+	}
+
+	g_assert_cmpstr(jabber_id_intern_get_bare_jid(first), ==,
+	                "first@example.com");
+
+	again = jabber_id_intern("first@example.com");
+	g_assert_true(first != again);
+
+	jabber_id_release(first);
+	jabber_id_release(again);
+	jabber_id_cache_clear();
+}
+
 PurpleTestStringData test_jabber_util_jabber_normalize_data[] = {
         {"NoOnE@ExAMplE.com", "noone@example.com"},
         {"NoOnE@ExampLE.cOM/", "noone@example.com"},
@@ -278,6 +339,11 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/jabber/util/id_new/jid_parts",
 	                test_jabber_util_jid_parts);
 
+	g_test_add_func("/jabber/util/id_intern/basic",
+	                test_jabber_util_id_intern);
+	g_test_add_func("/jabber/util/id_intern/evict",
+	                test_jabber_util_id_intern_evict);
+
 	for (i = 0; test_jabber_util_jabber_normalize_data[i].input; i++) {
 		test_name = g_strdup_printf("/jabber/util/normalize/%d", i);
 		g_test_add_data_func(test_name,
@@ -54,6 +54,70 @@ test_jabber_scram_proofs(void) {
 	jabber_scram_data_destroy(data);
 }
 
+static void
+test_jabber_scram_proofs_from_keys(void) {
+	JabberScramData *data = g_new0(JabberScramData, 1);
+	GString *salt;
+	guchar *keys;
+	const char *client_proof;
+
+	data->hash = &sha1_mech;
+	data->password = g_strdup("password");
+	data->auth_message = g_string_new("n=username@jabber.org,r=8jLxB5515dhFxBil5A0xSXMH,"
+			"r=8jLxB5515dhFxBil5A0xSXMHabc,s=c2FsdA==,i=1,"
+			"c=biws,r=8jLxB5515dhFxBil5A0xSXMHabc");
+	client_proof = "\x48\x61\x30\xa5\x61\x0b\xae\xb9\xe4\x11\xa8\xfd\xa5\xcd\x34\x1d\x8a\x3c\x28\x17";
+
+	salt = g_string_new("salt");
+	keys = jabber_scram_derive_keys(&sha1_mech, data->password, salt, 1);
+	g_assert_nonnull(keys);
+
+	/* The salt is left alone so it can be used again. */
+	g_assert_cmpstr(salt->str, ==, "salt");
+	g_assert_cmpuint(salt->len, ==, 4);
+
+	jabber_scram_calc_proofs_from_keys(data, keys);
+	g_assert_cmpmem(client_proof, 20, data->client_proof->str, 20);
+
+	g_free(keys);
+	g_string_free(salt, TRUE);
+
+	jabber_scram_data_destroy(data);
+}
+
+static void
+test_jabber_scram_derive_keys_async_cb(G_GNUC_UNUSED GObject *source,
+                                       GAsyncResult *result, gpointer data)
+{
+	guchar **keys = data;
+	GError *error = NULL;
+
+	*keys = jabber_scram_derive_keys_finish(result, &error);
+	g_assert_no_error(error);
+}
+
+static void
+test_jabber_scram_derive_keys_async(void) {
+	GString *salt = g_string_new("salt");
+	guchar *expected, *keys = NULL;
+
+	expected = jabber_scram_derive_keys(&sha1_mech, "password", salt, 4096);
+	g_assert_nonnull(expected);
+
+	jabber_scram_derive_keys_async(&sha1_mech, "password", salt, 4096, NULL,
+	                               test_jabber_scram_derive_keys_async_cb,
+	                               &keys);
+	while(keys == NULL) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_assert_cmpmem(keys, 40, expected, 40);
+
+	g_free(keys);
+	g_free(expected);
+	g_string_free(salt, TRUE);
+}
+
 #define assert_successful_exchange(pw, nonce, start_data, challenge1, response1, success) { \
 	JabberScramData *data = g_new0(JabberScramData, 1); \
 	gboolean ret; \
@@ -102,6 +166,10 @@ main(gint argc, gchar **argv) {
 	                test_jabber_scram_pbkdf2);
 	g_test_add_func("/jabber/scram/proofs",
 	                test_jabber_scram_proofs);
+	g_test_add_func("/jabber/scram/proofs_from_keys",
+	                test_jabber_scram_proofs_from_keys);
+	g_test_add_func("/jabber/scram/derive_keys_async",
+	                test_jabber_scram_derive_keys_async);
 	g_test_add_func("/jabber/scram/exchange",
 	                test_jabber_scram_exchange);
 
@@ -0,0 +1,202 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/si.h"
+
+#define TEST_JABBER_SI_ALICE "alice@example.com/test"
+#define TEST_JABBER_SI_BOB "bob@example.com/test"
+
+/******************************************************************************
+ * TestJabberSIModule, to register the dynamic transfer type with
+ *****************************************************************************/
+static GType test_jabber_si_module_get_type(void);
+
+typedef struct {
+	GTypeModule parent;
+} TestJabberSIModule;
+
+typedef struct {
+	GTypeModuleClass parent;
+} TestJabberSIModuleClass;
+
+G_DEFINE_TYPE(TestJabberSIModule, test_jabber_si_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+test_jabber_si_module_load(G_GNUC_UNUSED GTypeModule *module) {
+	return TRUE;
+}
+
+static void
+test_jabber_si_module_unload(G_GNUC_UNUSED GTypeModule *module) {
+}
+
+static void
+test_jabber_si_module_init(G_GNUC_UNUSED TestJabberSIModule *module) {
+}
+
+static void
+test_jabber_si_module_class_init(TestJabberSIModuleClass *klass) {
+	GTypeModuleClass *module_class = G_TYPE_MODULE_CLASS(klass);
+
+	module_class->load = test_jabber_si_module_load;
+	module_class->unload = test_jabber_si_module_unload;
+}
+
+/******************************************************************************
+ * TestJabberSIProtocol
+ *****************************************************************************/
+static GType test_jabber_si_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestJabberSIProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestJabberSIProtocolClass;
+
+G_DEFINE_TYPE(TestJabberSIProtocol, test_jabber_si_protocol,
+              PURPLE_TYPE_PROTOCOL)
+
+static void
+test_jabber_si_protocol_init(G_GNUC_UNUSED TestJabberSIProtocol *protocol) {
+}
+
+static void
+test_jabber_si_protocol_class_init(G_GNUC_UNUSED TestJabberSIProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleConnection *connection;
+	JabberStream *js;
+} TestJabberSIFixture;
+
+static void
+test_jabber_si_setup(TestJabberSIFixture *fixture,
+                     G_GNUC_UNUSED gconstpointer data)
+{
+	fixture->protocol = g_object_new(test_jabber_si_protocol_get_type(),
+	                                 "id", "prpl-test-jabber-si", NULL);
+	fixture->connection = g_object_new(PURPLE_TYPE_CONNECTION,
+	                                   "protocol", fixture->protocol, NULL);
+
+	fixture->js = g_new0(JabberStream, 1);
+	fixture->js->gc = fixture->connection;
+	fixture->js->file_transfers_by_sid = g_hash_table_new_full(g_str_hash,
+	                                                           g_str_equal,
+	                                                           g_free, NULL);
+	purple_connection_set_protocol_data(fixture->connection, fixture->js);
+}
+
+static void
+test_jabber_si_teardown(TestJabberSIFixture *fixture,
+                        G_GNUC_UNUSED gconstpointer data)
+{
+	g_assert_null(fixture->js->file_transfers);
+
+	g_hash_table_destroy(fixture->js->file_transfers_by_sid);
+	g_free(fixture->js);
+
+	g_clear_object(&fixture->connection);
+	g_clear_object(&fixture->protocol);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_si_find(TestJabberSIFixture *fixture,
+                    G_GNUC_UNUSED gconstpointer data)
+{
+	JabberStream *js = fixture->js;
+	PurpleXfer *alice = NULL, *bob = NULL;
+
+	alice = jabber_si_new_xfer(NULL, fixture->connection,
+	                           TEST_JABBER_SI_ALICE);
+	bob = jabber_si_new_xfer(NULL, fixture->connection, TEST_JABBER_SI_BOB);
+
+	/* Nothing can be found before it has a stream id. */
+	g_assert_null(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_ALICE));
+
+	/* The same stream id from different peers is a different transfer. */
+	jabber_si_xfer_set_stream_id(JABBER_SI_XFER(alice), "sid");
+	jabber_si_xfer_set_stream_id(JABBER_SI_XFER(bob), "sid");
+	g_assert_true(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_ALICE) ==
+	              alice);
+	g_assert_true(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_BOB) == bob);
+	g_assert_null(jabber_si_xfer_find(js, "other", TEST_JABBER_SI_ALICE));
+	g_assert_null(jabber_si_xfer_find(js, "sid", "carol@example.com/test"));
+
+	/* A new stream id replaces the old one. */
+	jabber_si_xfer_set_stream_id(JABBER_SI_XFER(alice), "new");
+	g_assert_null(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_ALICE));
+	g_assert_true(jabber_si_xfer_find(js, "new", TEST_JABBER_SI_ALICE) ==
+	              alice);
+	g_assert_true(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_BOB) == bob);
+
+	/* A transfer is dropped from the index when it goes away. */
+	g_object_unref(alice);
+	g_assert_null(jabber_si_xfer_find(js, "new", TEST_JABBER_SI_ALICE));
+	g_assert_true(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_BOB) == bob);
+
+	g_object_unref(bob);
+	g_assert_null(jabber_si_xfer_find(js, "sid", TEST_JABBER_SI_BOB));
+	g_assert_cmpuint(g_hash_table_size(js->file_transfers_by_sid), ==, 0);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	GTypeModule *module = NULL;
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	purple_signals_init();
+	purple_connections_init();
+
+	/* Type modules can't be freed, so this is never unreffed. */
+	module = g_object_new(test_jabber_si_module_get_type(), NULL);
+	jabber_si_xfer_register(module);
+
+	g_test_add("/jabber/si/find", TestJabberSIFixture, NULL,
+	           test_jabber_si_setup, test_jabber_si_find,
+	           test_jabber_si_teardown);
+
+	ret = g_test_run();
+
+	purple_connections_uninit();
+	purple_signals_uninit();
+
+	return ret;
+}
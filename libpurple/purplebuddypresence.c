@@ -153,8 +153,8 @@ purple_buddy_presence_update_idle(PurplePresence *presence, gboolean old_idle)
 	 * connect to buddy-[un]idle signals and update from there
 	 */
 
-	purple_blist_update_node(purple_blist_get_default(),
-	                         PURPLE_BLIST_NODE(buddy));
+	purple_blist_queue_update_node(purple_blist_get_default(),
+	                               PURPLE_BLIST_NODE(buddy));
 
 	g_date_time_unref(current_time);
 }
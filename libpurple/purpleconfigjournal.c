@@ -0,0 +1,1488 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "purpleconfigjournal.h"
+
+#include "debug.h"
+#include "purplepath.h"
+#include "purpleprivate.h"
+
+/* The journal is folded into the file once it is larger than the file, but
+ * not before it has reached this size. */
+#define JOURNAL_MIN_COMPACT_SIZE (64 * 1024)
+
+#define XML_HEADER "<?xml version='1.0' encoding='UTF-8' ?>\n\n"
+
+/*
+ * Every record in the journal is one line:
+ *
+ *     <op> <path count> <extra count>( <length>:<bytes>)*\n
+ *
+ * The path fields come first, followed by the extra fields for the op:
+ *
+ *     C  container: its opening tag with unkeyed children, and closing tag
+ *     L  leaf: the element
+ *     D  delete: nothing
+ *     O  order: the keys of the children
+ */
+#define RECORD_CONTAINER 'C'
+#define RECORD_LEAF      'L'
+#define RECORD_DELETE    'D'
+#define RECORD_ORDER     'O'
+
+typedef struct _JournalEntry JournalEntry;
+
+struct _JournalEntry {
+	gchar *key;
+
+	/* For leaves the whole element, for containers the opening tag and the
+	 * children the key function doesn't know about. */
+	GBytes *data;
+
+	/* The closing tag for containers, NULL for leaves. */
+	GBytes *close;
+
+	GQueue children;
+	GHashTable *index;           /* key -> GList link in children */
+
+	gboolean mark;
+};
+
+/* Shared with the threads that rewrite the file. */
+typedef struct {
+	GMutex lock;
+	guint64 next_seq;
+	guint64 rotated_seq;
+	guint64 written_seq;
+} JournalState;
+
+struct _PurpleConfigJournal {
+	gchar *filename;
+	gchar *path;
+	gchar *journal_path;
+	gchar *old_path;
+	PurpleConfigJournalKeyFunc key_func;
+
+	gboolean loaded;
+	JournalEntry *root;
+
+	GString *pending;
+	GString *scratch;
+	FILE *fp;
+	gsize journal_size;
+	gsize base_size;
+
+	/* A write to the journal failed part way, so it can't be appended to. */
+	gboolean damaged;
+
+	JournalState *state;
+	GCancellable *cancellable;
+	gboolean compacting;
+};
+
+typedef struct {
+	JournalState *state;
+	guint64 seq;
+	gchar *path;
+	gchar *old_path;
+	GPtrArray *pieces;
+	gsize size;
+} JournalCompactData;
+
+/* A container that is open while the file is being streamed in. */
+typedef struct {
+	JournalEntry *entry;
+
+	/* The attributes and the unkeyed children seen so far. */
+	PurpleXmlNode *shallow;
+} JournalLoadLevel;
+
+typedef struct {
+	PurpleConfigJournal *journal;
+	GPtrArray *levels;
+} JournalLoadData;
+
+/******************************************************************************
+ * Entries
+ *****************************************************************************/
+static JournalEntry *
+journal_entry_new(const gchar *key)
+{
+	JournalEntry *entry = g_new0(JournalEntry, 1);
+
+	entry->key = g_strdup(key);
+	g_queue_init(&entry->children);
+
+	return entry;
+}
+
+static void
+journal_entry_free(JournalEntry *entry)
+{
+	g_queue_clear_full(&entry->children,
+	                   (GDestroyNotify)journal_entry_free);
+	g_clear_pointer(&entry->index, g_hash_table_destroy);
+	g_clear_pointer(&entry->data, g_bytes_unref);
+	g_clear_pointer(&entry->close, g_bytes_unref);
+	g_free(entry->key);
+	g_free(entry);
+}
+
+static void
+journal_entry_clear_children(JournalEntry *entry)
+{
+	if (entry->index != NULL) {
+		g_hash_table_remove_all(entry->index);
+	}
+	g_queue_clear_full(&entry->children,
+	                   (GDestroyNotify)journal_entry_free);
+	g_queue_init(&entry->children);
+}
+
+static GList *
+journal_entry_find_link(JournalEntry *entry, const gchar *key)
+{
+	if (entry->index == NULL) {
+		return NULL;
+	}
+
+	return g_hash_table_lookup(entry->index, key);
+}
+
+static JournalEntry *
+journal_entry_get_child(JournalEntry *entry, const gchar *key)
+{
+	GList *link = journal_entry_find_link(entry, key);
+
+	return (link != NULL) ? link->data : NULL;
+}
+
+static JournalEntry *
+journal_entry_add_child(JournalEntry *entry, const gchar *key)
+{
+	JournalEntry *child = journal_entry_new(key);
+
+	if (entry->index == NULL) {
+		entry->index = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+
+	g_queue_push_tail(&entry->children, child);
+	g_hash_table_insert(entry->index, child->key, entry->children.tail);
+
+	return child;
+}
+
+static void
+journal_entry_remove_child(JournalEntry *entry, const gchar *key)
+{
+	GList *link = journal_entry_find_link(entry, key);
+	JournalEntry *child = NULL;
+
+	if (link == NULL) {
+		return;
+	}
+
+	child = link->data;
+	g_hash_table_remove(entry->index, child->key);
+	g_queue_delete_link(&entry->children, link);
+	journal_entry_free(child);
+}
+
+/* Returns @key, or @key with a "#2", "#3", ... suffix if @taken already has
+ * it, so that siblings with the same key are kept apart. */
+static gchar *
+journal_unique_key(GHashTable *taken, const gchar *key)
+{
+	gchar *unique = NULL;
+	guint n = 2;
+
+	if (taken == NULL || !g_hash_table_contains(taken, key)) {
+		return g_strdup(key);
+	}
+
+	do {
+		g_free(unique);
+		unique = g_strdup_printf("%s#%u", key, n++);
+	} while (g_hash_table_contains(taken, unique));
+
+	return unique;
+}
+
+static gboolean
+journal_entry_order_equal(JournalEntry *entry, const gchar * const *keys,
+                          gsize n_keys)
+{
+	GList *link = entry->children.head;
+
+	if (entry->children.length != n_keys) {
+		return FALSE;
+	}
+
+	for (gsize i = 0; i < n_keys; i++, link = link->next) {
+		JournalEntry *child = link->data;
+
+		if (!g_str_equal(child->key, keys[i])) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * The in-memory copy of the file
+ *****************************************************************************/
+static JournalEntry *
+journal_lookup(PurpleConfigJournal *journal, const gchar * const *path,
+               gsize n)
+{
+	JournalEntry *entry = journal->root;
+
+	for (gsize i = 0; i < n && entry != NULL; i++) {
+		entry = journal_entry_get_child(entry, path[i]);
+	}
+
+	return entry;
+}
+
+static gboolean
+journal_apply_container(PurpleConfigJournal *journal,
+                        const gchar * const *path, gsize n, GBytes *head,
+                        GBytes *close)
+{
+	JournalEntry *entry = NULL;
+
+	if (n == 0) {
+		if (journal->root == NULL) {
+			journal->root = journal_entry_new("");
+		}
+		entry = journal->root;
+	} else {
+		JournalEntry *parent = journal_lookup(journal, path, n - 1);
+
+		if (parent == NULL || parent->close == NULL) {
+			return FALSE;
+		}
+
+		entry = journal_entry_get_child(parent, path[n - 1]);
+		if (entry == NULL) {
+			entry = journal_entry_add_child(parent, path[n - 1]);
+		}
+	}
+
+	g_clear_pointer(&entry->data, g_bytes_unref);
+	g_clear_pointer(&entry->close, g_bytes_unref);
+	entry->data = g_bytes_ref(head);
+	entry->close = g_bytes_ref(close);
+
+	return TRUE;
+}
+
+static gboolean
+journal_apply_leaf(PurpleConfigJournal *journal, const gchar * const *path,
+                   gsize n, GBytes *data)
+{
+	JournalEntry *parent = NULL, *entry = NULL;
+
+	if (n == 0) {
+		return FALSE;
+	}
+
+	parent = journal_lookup(journal, path, n - 1);
+	if (parent == NULL || parent->close == NULL) {
+		return FALSE;
+	}
+
+	entry = journal_entry_get_child(parent, path[n - 1]);
+	if (entry == NULL) {
+		entry = journal_entry_add_child(parent, path[n - 1]);
+	}
+
+	journal_entry_clear_children(entry);
+	g_clear_pointer(&entry->close, g_bytes_unref);
+	g_clear_pointer(&entry->data, g_bytes_unref);
+	entry->data = g_bytes_ref(data);
+
+	return TRUE;
+}
+
+static gboolean
+journal_apply_remove(PurpleConfigJournal *journal, const gchar * const *path,
+                     gsize n)
+{
+	JournalEntry *parent = NULL;
+
+	if (n == 0) {
+		g_clear_pointer(&journal->root, journal_entry_free);
+		return TRUE;
+	}
+
+	parent = journal_lookup(journal, path, n - 1);
+	if (parent == NULL) {
+		return FALSE;
+	}
+
+	journal_entry_remove_child(parent, path[n - 1]);
+
+	return TRUE;
+}
+
+static gboolean
+journal_apply_order(PurpleConfigJournal *journal, const gchar * const *path,
+                    gsize n, const gchar * const *keys, gsize n_keys)
+{
+	JournalEntry *entry = journal_lookup(journal, path, n);
+	GQueue order = G_QUEUE_INIT;
+
+	if (entry == NULL || entry->close == NULL) {
+		return FALSE;
+	}
+
+	for (gsize i = 0; i < n_keys; i++) {
+		GList *link = journal_entry_find_link(entry, keys[i]);
+		JournalEntry *child = NULL;
+
+		if (link == NULL) {
+			continue;
+		}
+
+		child = link->data;
+		if (child->mark) {
+			continue;
+		}
+
+		child->mark = TRUE;
+		g_queue_unlink(&entry->children, link);
+		g_queue_push_tail_link(&order, link);
+	}
+
+	/* Whatever is left wasn't listed, so it's gone. */
+	while (!g_queue_is_empty(&entry->children)) {
+		JournalEntry *child = g_queue_pop_head(&entry->children);
+
+		g_hash_table_remove(entry->index, child->key);
+		journal_entry_free(child);
+	}
+
+	entry->children = order;
+	for (GList *l = entry->children.head; l != NULL; l = l->next) {
+		JournalEntry *child = l->data;
+
+		child->mark = FALSE;
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Records
+ *****************************************************************************/
+static void
+journal_record_field(GString *record, const gchar *data, gsize size)
+{
+	g_string_append_printf(record, " %" G_GSIZE_FORMAT ":", size);
+	g_string_append_len(record, data, size);
+}
+
+static void
+journal_record_start(GString *record, gchar op, const gchar * const *path,
+                     gsize n, gsize n_extra)
+{
+	g_string_append_printf(record, "%c %" G_GSIZE_FORMAT " %" G_GSIZE_FORMAT,
+	                       op, n, n_extra);
+
+	for (gsize i = 0; i < n; i++) {
+		journal_record_field(record, path[i], strlen(path[i]));
+	}
+}
+
+static void
+journal_record_bytes(GString *record, GBytes *bytes)
+{
+	gsize size = 0;
+	const gchar *data = g_bytes_get_data(bytes, &size);
+
+	journal_record_field(record, data, size);
+}
+
+static gboolean
+journal_parse_size(const gchar **p, const gchar *end, gsize *value)
+{
+	gsize v = 0;
+
+	if (*p >= end || !g_ascii_isdigit(**p)) {
+		return FALSE;
+	}
+
+	while (*p < end && g_ascii_isdigit(**p)) {
+		if (v > (G_MAXSIZE - 9) / 10) {
+			return FALSE;
+		}
+		v = v * 10 + (**p - '0');
+		(*p)++;
+	}
+
+	*value = v;
+
+	return TRUE;
+}
+
+static gboolean
+journal_expect(const gchar **p, const gchar *end, gchar c)
+{
+	if (*p >= end || **p != c) {
+		return FALSE;
+	}
+
+	(*p)++;
+
+	return TRUE;
+}
+
+static gboolean
+journal_apply_record(PurpleConfigJournal *journal, gchar op, GPtrArray *fields,
+                     gsize n_path)
+{
+	const gchar * const *path = (const gchar * const *)fields->pdata;
+	const gchar * const *extra = path + n_path;
+	gsize n_extra = fields->len - n_path;
+	GBytes *a = NULL, *b = NULL;
+	gboolean ret = FALSE;
+
+	switch (op) {
+		case RECORD_CONTAINER:
+			if (n_extra != 2) {
+				return FALSE;
+			}
+			a = g_bytes_new(extra[0], strlen(extra[0]));
+			b = g_bytes_new(extra[1], strlen(extra[1]));
+			ret = journal_apply_container(journal, path, n_path, a, b);
+			g_bytes_unref(a);
+			g_bytes_unref(b);
+			break;
+		case RECORD_LEAF:
+			if (n_extra != 1) {
+				return FALSE;
+			}
+			a = g_bytes_new(extra[0], strlen(extra[0]));
+			ret = journal_apply_leaf(journal, path, n_path, a);
+			g_bytes_unref(a);
+			break;
+		case RECORD_DELETE:
+			ret = journal_apply_remove(journal, path, n_path);
+			break;
+		case RECORD_ORDER:
+			ret = journal_apply_order(journal, path, n_path, extra, n_extra);
+			break;
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+/* Applies the records in @buffer and returns how many there were. A record
+ * that was only partly written when the program stopped ends the replay. */
+static guint
+journal_replay_buffer(PurpleConfigJournal *journal, const gchar *buffer,
+                      gsize size)
+{
+	const gchar *p = buffer, *end = buffer + size;
+	guint count = 0;
+
+	while (p < end) {
+		GPtrArray *fields = NULL;
+		const gchar *start = p;
+		gsize n_path = 0, n_extra = 0;
+		gboolean ok = TRUE;
+		gchar op = *p++;
+
+		if (!journal_expect(&p, end, ' ') ||
+				!journal_parse_size(&p, end, &n_path) ||
+				!journal_expect(&p, end, ' ') ||
+				!journal_parse_size(&p, end, &n_extra) ||
+				n_path > size || n_extra > size - n_path) {
+			p = start;
+			break;
+		}
+
+		fields = g_ptr_array_new_with_free_func(g_free);
+		for (gsize i = 0; ok && i < n_path + n_extra; i++) {
+			gsize length = 0;
+
+			ok = journal_expect(&p, end, ' ') &&
+			     journal_parse_size(&p, end, &length) &&
+			     journal_expect(&p, end, ':') &&
+			     length <= (gsize)(end - p);
+			if (ok) {
+				g_ptr_array_add(fields, g_strndup(p, length));
+				p += length;
+			}
+		}
+
+		if (!ok || !journal_expect(&p, end, '\n')) {
+			g_ptr_array_free(fields, TRUE);
+			p = start;
+			break;
+		}
+
+		if (!journal_apply_record(journal, op, fields, n_path)) {
+			purple_debug_warning("config-journal",
+			                     "Skipping a record in %s that doesn't "
+			                     "apply", journal->journal_path);
+		}
+
+		g_ptr_array_free(fields, TRUE);
+		count++;
+	}
+
+	if (p < end) {
+		purple_debug_warning("config-journal",
+		                     "Ignoring the damaged end of the journal "
+		                     "for %s", journal->filename);
+	}
+
+	return count;
+}
+
+static guint
+journal_replay_file(PurpleConfigJournal *journal, const gchar *filename)
+{
+	gchar *contents = NULL;
+	gsize size = 0;
+	guint count = 0;
+
+	if (!g_file_get_contents(filename, &contents, &size, NULL)) {
+		return 0;
+	}
+
+	count = journal_replay_buffer(journal, contents, size);
+	g_free(contents);
+
+	return count;
+}
+
+/******************************************************************************
+ * Serializing
+ *****************************************************************************/
+static gboolean
+journal_is_blank(PurpleXmlNode *node)
+{
+	for (gsize i = 0; i < node->data_sz; i++) {
+		if (!g_ascii_isspace(node->data[i])) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+journal_copy_namespace(gpointer key, gpointer value, gpointer data)
+{
+	purple_xmlnode_declare_namespace(data, key, value);
+}
+
+/* Splits @node into its opening tag, with the children that aren't tracked
+ * separately, and its closing tag. */
+static void
+journal_serialize_container(PurpleConfigJournal *journal, PurpleXmlNode *node,
+                            guint depth, GBytes **head, GBytes **close)
+{
+	PurpleXmlNode *shallow = purple_xmlnode_new(node->name);
+	GString *scratch = journal->scratch;
+	gchar *end_tag = NULL;
+	gsize end_length = 0;
+
+	purple_xmlnode_set_namespace(shallow, node->xmlns);
+	purple_xmlnode_set_prefix(shallow, node->prefix);
+	if (node->namespace_map != NULL) {
+		g_hash_table_foreach(node->namespace_map, journal_copy_namespace,
+		                     shallow);
+	}
+
+	for (PurpleXmlNode *child = node->child; child; child = child->next) {
+		if (child->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			purple_xmlnode_set_attrib_full(shallow, child->name, child->xmlns,
+			                               child->prefix, child->data);
+		} else if (child->type == PURPLE_XMLNODE_TYPE_TAG) {
+			gboolean container = FALSE;
+			gchar *key = journal->key_func(child, depth + 1, &container);
+
+			if (key == NULL) {
+				purple_xmlnode_insert_child(shallow,
+				                            purple_xmlnode_copy(child));
+			}
+			g_free(key);
+		} else if (!journal_is_blank(child)) {
+			purple_xmlnode_insert_data(shallow, child->data, child->data_sz);
+		}
+	}
+
+	if (node->prefix != NULL) {
+		end_tag = g_strdup_printf("</%s:%s>", node->prefix, node->name);
+	} else {
+		end_tag = g_strdup_printf("</%s>", node->name);
+	}
+	end_length = strlen(end_tag);
+
+	g_string_truncate(scratch, 0);
+	purple_xmlnode_write_to_string(shallow, scratch);
+	if (g_str_has_suffix(scratch->str, "/>")) {
+		g_string_truncate(scratch, scratch->len - 2);
+		g_string_append_c(scratch, '>');
+	} else {
+		g_string_truncate(scratch, scratch->len - end_length);
+	}
+
+	*head = g_bytes_new(scratch->str, scratch->len);
+	*close = g_bytes_new_take(end_tag, end_length);
+
+	purple_xmlnode_free(shallow);
+}
+
+static GBytes *
+journal_serialize_leaf(PurpleConfigJournal *journal, PurpleXmlNode *node)
+{
+	g_string_truncate(journal->scratch, 0);
+	purple_xmlnode_write_to_string(node, journal->scratch);
+
+	return g_bytes_new(journal->scratch->str, journal->scratch->len);
+}
+
+/* Fills in @entry from @node as it was read from the file. */
+static void
+journal_build_entry(PurpleConfigJournal *journal, JournalEntry *entry,
+                    PurpleXmlNode *node, guint depth, gboolean container)
+{
+	if (!container) {
+		entry->data = journal_serialize_leaf(journal, node);
+		return;
+	}
+
+	journal_serialize_container(journal, node, depth, &entry->data,
+	                            &entry->close);
+
+	for (PurpleXmlNode *child = node->child; child; child = child->next) {
+		JournalEntry *child_entry = NULL;
+		gboolean child_container = FALSE;
+		gchar *key = NULL, *unique = NULL;
+
+		if (child->type != PURPLE_XMLNODE_TYPE_TAG) {
+			continue;
+		}
+
+		key = journal->key_func(child, depth + 1, &child_container);
+		if (key == NULL) {
+			continue;
+		}
+
+		/* Siblings can share a key, so tell them apart the same way
+		 * purple_config_journal_unique_key() does for the caller. */
+		unique = journal_unique_key(entry->index, key);
+		child_entry = journal_entry_add_child(entry, unique);
+		journal_build_entry(journal, child_entry, child, depth + 1,
+		                    child_container);
+		g_free(unique);
+		g_free(key);
+	}
+}
+
+/******************************************************************************
+ * Loading
+ *****************************************************************************/
+/* Finishes the containers that are deeper than @depth. */
+static void
+journal_load_close_levels(JournalLoadData *load, guint depth)
+{
+	while (load->levels->len > depth) {
+		JournalLoadLevel *level = NULL;
+
+		level = g_ptr_array_steal_index(load->levels, load->levels->len - 1);
+		journal_serialize_container(load->journal, level->shallow,
+		                            load->levels->len, &level->entry->data,
+		                            &level->entry->close);
+
+		purple_xmlnode_free(level->shallow);
+		g_free(level);
+	}
+}
+
+/* Containers are descended into, everything else is handed over whole to
+ * journal_load_element(). */
+static gboolean
+journal_load_start(PurpleXmlNode *node, guint depth, gpointer data)
+{
+	JournalLoadData *load = data;
+	JournalLoadLevel *level = NULL;
+	JournalEntry *entry = NULL;
+	gboolean container = FALSE;
+	gchar *key = NULL;
+
+	journal_load_close_levels(load, depth);
+
+	key = load->journal->key_func(node, depth, &container);
+
+	if (depth == 0) {
+		entry = journal_entry_new("");
+		load->journal->root = entry;
+	} else if (key != NULL && container && load->levels->len == depth) {
+		JournalLoadLevel *parent = g_ptr_array_index(load->levels, depth - 1);
+		gchar *unique = journal_unique_key(parent->entry->index, key);
+
+		entry = journal_entry_add_child(parent->entry, unique);
+		g_free(unique);
+	} else {
+		g_free(key);
+
+		return FALSE;
+	}
+
+	g_free(key);
+
+	level = g_new0(JournalLoadLevel, 1);
+	level->entry = entry;
+	level->shallow = purple_xmlnode_copy(node);
+	g_ptr_array_add(load->levels, level);
+
+	return TRUE;
+}
+
+static void
+journal_load_element(PurpleXmlNode *node, gpointer data)
+{
+	JournalLoadData *load = data;
+	JournalLoadLevel *parent = NULL;
+	JournalEntry *entry = NULL;
+	gboolean container = FALSE;
+	gchar *key = NULL, *unique = NULL;
+	guint depth = 0;
+
+	for (PurpleXmlNode *p = node->parent; p != NULL; p = p->parent) {
+		depth++;
+	}
+
+	journal_load_close_levels(load, depth);
+	if (depth == 0 || load->levels->len != depth) {
+		return;
+	}
+
+	parent = g_ptr_array_index(load->levels, depth - 1);
+
+	key = load->journal->key_func(node, depth, &container);
+	if (key == NULL) {
+		purple_xmlnode_insert_child(parent->shallow,
+		                            purple_xmlnode_copy(node));
+		return;
+	}
+
+	unique = journal_unique_key(parent->entry->index, key);
+	entry = journal_entry_add_child(parent->entry, unique);
+	journal_build_entry(load->journal, entry, node, depth, container);
+	g_free(unique);
+	g_free(key);
+}
+
+/* Reads the file a keyed element at a time, so only the largest of them is
+ * ever held as a tree. */
+static void
+journal_ensure_loaded(PurpleConfigJournal *journal)
+{
+	GStatBuf st;
+
+	if (journal->loaded) {
+		return;
+	}
+	journal->loaded = TRUE;
+
+	if (g_stat(journal->path, &st) == 0) {
+		JournalLoadData load = { journal, NULL };
+		gboolean ret = FALSE;
+
+		load.levels = g_ptr_array_new();
+		ret = purple_xmlnode_stream_from_file_full(purple_config_dir(),
+		                                           journal->filename,
+		                                           "config-journal",
+		                                           journal_load_start,
+		                                           journal_load_element,
+		                                           &load);
+		journal_load_close_levels(&load, 0);
+		g_ptr_array_free(load.levels, TRUE);
+
+		if (ret) {
+			journal->base_size = st.st_size;
+		} else {
+			/* Don't build on part of a file. */
+			g_clear_pointer(&journal->root, journal_entry_free);
+		}
+	}
+
+	journal_replay_file(journal, journal->old_path);
+	journal_replay_file(journal, journal->journal_path);
+
+	if (g_stat(journal->journal_path, &st) == 0) {
+		journal->journal_size = st.st_size;
+	}
+}
+
+/******************************************************************************
+ * Writing
+ *****************************************************************************/
+static void
+journal_write_pending(PurpleConfigJournal *journal)
+{
+	if (journal->pending->len == 0) {
+		return;
+	}
+
+	if (journal->fp == NULL) {
+		gchar *dir = g_path_get_dirname(journal->journal_path);
+
+		g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+		g_free(dir);
+
+		journal->fp = g_fopen(journal->journal_path, "ab");
+		if (journal->fp == NULL) {
+			purple_debug_error("config-journal", "Unable to open %s: %s",
+			                   journal->journal_path, g_strerror(errno));
+			return;
+		}
+	}
+
+	if (fwrite(journal->pending->str, 1, journal->pending->len,
+	           journal->fp) != journal->pending->len ||
+			fflush(journal->fp) != 0 || g_fsync(fileno(journal->fp)) != 0)
+	{
+		purple_debug_error("config-journal", "Unable to write to %s: %s",
+		                   journal->journal_path, g_strerror(errno));
+
+		/* Part of the records may have reached the disk, and a replay stops
+		 * at the first damaged record, so anything appended after them
+		 * would be lost. The changes are already in memory, so the file is
+		 * rewritten from there instead. */
+		g_clear_pointer(&journal->fp, fclose);
+		journal->damaged = TRUE;
+	} else {
+		journal->journal_size += journal->pending->len;
+	}
+
+	g_string_truncate(journal->pending, 0);
+}
+
+static void
+journal_snapshot_entry(JournalEntry *entry, GPtrArray *pieces, GBytes *newline,
+                       gsize *size)
+{
+	g_ptr_array_add(pieces, g_bytes_ref(entry->data));
+	*size += g_bytes_get_size(entry->data);
+
+	if (entry->close == NULL) {
+		return;
+	}
+
+	g_ptr_array_add(pieces, g_bytes_ref(newline));
+	*size += 1;
+
+	for (GList *l = entry->children.head; l != NULL; l = l->next) {
+		journal_snapshot_entry(l->data, pieces, newline, size);
+		g_ptr_array_add(pieces, g_bytes_ref(newline));
+		*size += 1;
+	}
+
+	g_ptr_array_add(pieces, g_bytes_ref(entry->close));
+	*size += g_bytes_get_size(entry->close);
+}
+
+static JournalState *
+journal_state_ref(JournalState *state)
+{
+	return g_atomic_rc_box_acquire(state);
+}
+
+static void
+journal_state_clear(JournalState *state)
+{
+	g_mutex_clear(&state->lock);
+}
+
+static void
+journal_state_unref(JournalState *state)
+{
+	g_atomic_rc_box_release_full(state, (GDestroyNotify)journal_state_clear);
+}
+
+static void
+journal_compact_data_free(JournalCompactData *data)
+{
+	journal_state_unref(data->state);
+	g_free(data->path);
+	g_free(data->old_path);
+	g_ptr_array_free(data->pieces, TRUE);
+	g_free(data);
+}
+
+/* Runs in a worker thread, except when shutting down. */
+static gboolean
+journal_compact_write(JournalCompactData *data, GError **error)
+{
+	GString *contents = NULL;
+	gchar *dir = NULL;
+	gboolean ret = TRUE;
+
+	g_mutex_lock(&data->state->lock);
+
+	/* A newer copy has already been written. */
+	if (data->seq < data->state->written_seq) {
+		g_mutex_unlock(&data->state->lock);
+		return TRUE;
+	}
+
+	contents = g_string_sized_new(data->size + 1);
+	for (guint i = 0; i < data->pieces->len; i++) {
+		GBytes *piece = g_ptr_array_index(data->pieces, i);
+		gsize size = 0;
+		const gchar *str = g_bytes_get_data(piece, &size);
+
+		g_string_append_len(contents, str, size);
+	}
+
+	dir = g_path_get_dirname(data->path);
+	g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+	g_free(dir);
+
+	ret = g_file_set_contents(data->path, contents->str, contents->len, error);
+	if (ret) {
+		data->state->written_seq = data->seq;
+
+		/* The old journal now only holds what's in the file, unless a newer
+		 * compaction has added to it since we started. */
+		if (data->state->rotated_seq == data->seq) {
+			g_unlink(data->old_path);
+		}
+	}
+
+	g_mutex_unlock(&data->state->lock);
+	g_string_free(contents, TRUE);
+
+	return ret;
+}
+
+static void
+journal_compact_thread(GTask *task, G_GNUC_UNUSED gpointer source,
+                       gpointer task_data,
+                       G_GNUC_UNUSED GCancellable *cancellable)
+{
+	GError *error = NULL;
+
+	if (journal_compact_write(task_data, &error)) {
+		g_task_return_boolean(task, TRUE);
+	} else {
+		g_task_return_error(task, error);
+	}
+}
+
+static void
+journal_compact_cb(G_GNUC_UNUSED GObject *source, GAsyncResult *result,
+                   gpointer data)
+{
+	PurpleConfigJournal *journal = NULL;
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean(G_TASK(result), &error) &&
+			g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	{
+		/* The journal has been freed. */
+		g_error_free(error);
+		return;
+	}
+
+	journal = data;
+	journal->compacting = FALSE;
+
+	if (error != NULL) {
+		purple_debug_error("config-journal", "Unable to write %s: %s",
+		                   journal->filename, error->message);
+		g_error_free(error);
+	}
+}
+
+/* Moves the journal out of the way so new records can be written while the
+ * file is rewritten. */
+static guint64
+journal_rotate(PurpleConfigJournal *journal)
+{
+	JournalState *state = journal->state;
+	guint64 seq;
+
+	journal_write_pending(journal);
+	g_clear_pointer(&journal->fp, fclose);
+	journal->journal_size = 0;
+	journal->damaged = FALSE;
+
+	g_mutex_lock(&state->lock);
+
+	seq = ++state->next_seq;
+
+	if (g_file_test(journal->journal_path, G_FILE_TEST_EXISTS)) {
+		if (g_file_test(journal->old_path, G_FILE_TEST_EXISTS)) {
+			gchar *contents = NULL;
+			gsize size = 0;
+
+			/* An earlier compaction didn't finish, so keep both. */
+			if (g_file_get_contents(journal->journal_path, &contents, &size,
+			                        NULL))
+			{
+				FILE *fp = g_fopen(journal->old_path, "ab");
+
+				if (fp != NULL) {
+					if (fwrite(contents, 1, size, fp) == size) {
+						g_unlink(journal->journal_path);
+					}
+					fclose(fp);
+				}
+				g_free(contents);
+			}
+		} else if (g_rename(journal->journal_path, journal->old_path) != 0) {
+			purple_debug_error("config-journal", "Unable to rename %s: %s",
+			                   journal->journal_path, g_strerror(errno));
+		}
+	}
+
+	state->rotated_seq = seq;
+
+	g_mutex_unlock(&state->lock);
+
+	return seq;
+}
+
+static void
+journal_compact(PurpleConfigJournal *journal, gboolean sync)
+{
+	JournalCompactData *data = NULL;
+	GBytes *newline = NULL;
+
+	/* The file couldn't be read and nothing has replaced it yet, so leave it
+	 * alone. */
+	if (journal->root == NULL) {
+		return;
+	}
+
+	data = g_new0(JournalCompactData, 1);
+	data->state = journal_state_ref(journal->state);
+	data->seq = journal_rotate(journal);
+	data->path = g_strdup(journal->path);
+	data->old_path = g_strdup(journal->old_path);
+	data->pieces = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+
+	/* Only references are taken here, the copying happens in the thread. */
+	g_ptr_array_add(data->pieces,
+	                g_bytes_new_static(XML_HEADER, sizeof(XML_HEADER) - 1));
+	data->size = sizeof(XML_HEADER) - 1;
+
+	newline = g_bytes_new_static("\n", 1);
+	journal_snapshot_entry(journal->root, data->pieces, newline, &data->size);
+	g_ptr_array_add(data->pieces, newline);
+	data->size += 1;
+
+	journal->base_size = data->size;
+
+	if (sync) {
+		GError *error = NULL;
+
+		if (!journal_compact_write(data, &error)) {
+			purple_debug_error("config-journal", "Unable to write %s: %s",
+			                   journal->filename, error->message);
+			g_error_free(error);
+		}
+
+		journal_compact_data_free(data);
+	} else {
+		GTask *task = g_task_new(NULL, journal->cancellable,
+		                         journal_compact_cb, journal);
+
+		g_task_set_task_data(task, data,
+		                     (GDestroyNotify)journal_compact_data_free);
+		g_task_run_in_thread(task, journal_compact_thread);
+		g_object_unref(task);
+
+		journal->compacting = TRUE;
+	}
+}
+
+/******************************************************************************
+ * Changes
+ *****************************************************************************/
+static void
+journal_set_order_internal(PurpleConfigJournal *journal,
+                           const gchar * const *path, gsize n,
+                           const gchar * const *keys, gsize n_keys)
+{
+	JournalEntry *entry = journal_lookup(journal, path, n);
+
+	if (entry == NULL || entry->close == NULL ||
+			journal_entry_order_equal(entry, keys, n_keys))
+	{
+		return;
+	}
+
+	journal_apply_order(journal, path, n, keys, n_keys);
+
+	journal_record_start(journal->pending, RECORD_ORDER, path, n, n_keys);
+	for (gsize i = 0; i < n_keys; i++) {
+		journal_record_field(journal->pending, keys[i], strlen(keys[i]));
+	}
+	g_string_append_c(journal->pending, '\n');
+}
+
+static void
+journal_set_node(PurpleConfigJournal *journal, GPtrArray *path,
+                 PurpleXmlNode *node, guint depth, gboolean container,
+                 gboolean prune)
+{
+	JournalEntry *entry = NULL;
+	const gchar * const *keys = (const gchar * const *)path->pdata;
+	gsize n = path->len;
+
+	if (n > 0 && journal_lookup(journal, keys, n - 1) == NULL) {
+		purple_debug_warning("config-journal",
+		                     "Not saving %s in %s, its parent is missing",
+		                     keys[n - 1], journal->filename);
+	} else if (container) {
+		GHashTable *siblings = NULL;
+		GPtrArray *child_keys = NULL;
+		GBytes *head = NULL, *close = NULL;
+
+		journal_serialize_container(journal, node, depth, &head, &close);
+
+		entry = journal_lookup(journal, keys, n);
+		if (entry == NULL || entry->close == NULL ||
+				!g_bytes_equal(entry->data, head) ||
+				!g_bytes_equal(entry->close, close))
+		{
+			journal_apply_container(journal, keys, n, head, close);
+
+			journal_record_start(journal->pending, RECORD_CONTAINER, keys, n,
+			                     2);
+			journal_record_bytes(journal->pending, head);
+			journal_record_bytes(journal->pending, close);
+			g_string_append_c(journal->pending, '\n');
+		}
+
+		g_bytes_unref(head);
+		g_bytes_unref(close);
+
+		if (prune) {
+			child_keys = g_ptr_array_new_with_free_func(g_free);
+		}
+
+		siblings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                 NULL);
+
+		for (PurpleXmlNode *child = node->child; child; child = child->next) {
+			gboolean child_container = FALSE;
+			gchar *child_key = NULL;
+
+			if (child->type != PURPLE_XMLNODE_TYPE_TAG) {
+				continue;
+			}
+
+			child_key = journal->key_func(child, depth + 1, &child_container);
+			if (child_key == NULL) {
+				continue;
+			}
+
+			/* Keep siblings with the same key apart like the file does. */
+			if (g_hash_table_contains(siblings, child_key)) {
+				gchar *unique = journal_unique_key(siblings, child_key);
+
+				g_free(child_key);
+				child_key = unique;
+			}
+			g_hash_table_add(siblings, g_strdup(child_key));
+
+			g_ptr_array_add(path, child_key);
+			journal_set_node(journal, path, child, depth + 1, child_container,
+			                 prune);
+			g_ptr_array_remove_index(path, path->len - 1);
+
+			if (child_keys != NULL) {
+				g_ptr_array_add(child_keys, child_key);
+			} else {
+				g_free(child_key);
+			}
+		}
+
+		if (child_keys != NULL) {
+			/* Adding to path may have moved its array. */
+			keys = (const gchar * const *)path->pdata;
+			journal_set_order_internal(journal, keys, n,
+			                           (const gchar * const *)child_keys->pdata,
+			                           child_keys->len);
+			g_ptr_array_free(child_keys, TRUE);
+		}
+
+		g_hash_table_destroy(siblings);
+	} else {
+		GBytes *data = journal_serialize_leaf(journal, node);
+
+		entry = journal_lookup(journal, keys, n);
+		if (entry == NULL || entry->close != NULL ||
+				!g_bytes_equal(entry->data, data))
+		{
+			journal_apply_leaf(journal, keys, n, data);
+
+			journal_record_start(journal->pending, RECORD_LEAF, keys, n, 1);
+			journal_record_bytes(journal->pending, data);
+			g_string_append_c(journal->pending, '\n');
+		}
+
+		g_bytes_unref(data);
+	}
+}
+
+static void
+journal_set_common(PurpleConfigJournal *journal, const gchar * const *parent,
+                   const gchar *node_key, PurpleXmlNode *node, gboolean prune)
+{
+	GPtrArray *path = NULL;
+	gboolean container = FALSE;
+	gchar *key = NULL;
+	guint depth = 0;
+
+	journal_ensure_loaded(journal);
+
+	path = g_ptr_array_new();
+	if (parent != NULL) {
+		for (; parent[depth] != NULL; depth++) {
+			g_ptr_array_add(path, (gpointer)parent[depth]);
+		}
+		depth++;
+	}
+
+	key = journal->key_func(node, depth, &container);
+	if (depth > 0 && node_key != NULL) {
+		g_free(key);
+		key = g_strdup(node_key);
+	}
+
+	if (depth == 0) {
+		container = TRUE;
+	} else if (key != NULL) {
+		g_ptr_array_add(path, key);
+	}
+
+	if (depth == 0 || key != NULL) {
+		journal_set_node(journal, path, node, depth, container, prune);
+	}
+
+	g_ptr_array_free(path, TRUE);
+	g_free(key);
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PurpleConfigJournal *
+purple_config_journal_new(const gchar *filename,
+                          PurpleConfigJournalKeyFunc key_func)
+{
+	PurpleConfigJournal *journal = NULL;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+	g_return_val_if_fail(key_func != NULL, NULL);
+
+	journal = g_new0(PurpleConfigJournal, 1);
+	journal->filename = g_strdup(filename);
+	journal->path = g_build_filename(purple_config_dir(), filename, NULL);
+	journal->journal_path = g_strconcat(journal->path, ".journal", NULL);
+	journal->old_path = g_strconcat(journal->path, ".journal.old", NULL);
+	journal->key_func = key_func;
+
+	journal->pending = g_string_new(NULL);
+	journal->scratch = g_string_new(NULL);
+
+	journal->state = g_atomic_rc_box_new0(JournalState);
+	g_mutex_init(&journal->state->lock);
+	journal->cancellable = g_cancellable_new();
+
+	return journal;
+}
+
+void
+purple_config_journal_free(PurpleConfigJournal *journal)
+{
+	if (journal == NULL) {
+		return;
+	}
+
+	if (journal->loaded) {
+		journal_write_pending(journal);
+
+		if (journal->journal_size > 0 || journal->damaged ||
+				g_file_test(journal->old_path, G_FILE_TEST_EXISTS))
+		{
+			journal_compact(journal, TRUE);
+		}
+	}
+
+	g_cancellable_cancel(journal->cancellable);
+	g_clear_object(&journal->cancellable);
+
+	g_clear_pointer(&journal->fp, fclose);
+	g_clear_pointer(&journal->root, journal_entry_free);
+	journal_state_unref(journal->state);
+
+	g_string_free(journal->pending, TRUE);
+	g_string_free(journal->scratch, TRUE);
+	g_free(journal->filename);
+	g_free(journal->path);
+	g_free(journal->journal_path);
+	g_free(journal->old_path);
+	g_free(journal);
+}
+
+gboolean
+purple_config_journal_recover(PurpleConfigJournal *journal)
+{
+	g_return_val_if_fail(journal != NULL, FALSE);
+
+	if (!g_file_test(journal->journal_path, G_FILE_TEST_EXISTS) &&
+			!g_file_test(journal->old_path, G_FILE_TEST_EXISTS))
+	{
+		return FALSE;
+	}
+
+	purple_debug_info("config-journal", "Recovering changes to %s",
+	                  journal->filename);
+
+	journal_ensure_loaded(journal);
+	journal_compact(journal, TRUE);
+
+	return journal->root != NULL;
+}
+
+void
+purple_config_journal_set(PurpleConfigJournal *journal,
+                          const gchar * const *parent, PurpleXmlNode *node)
+{
+	g_return_if_fail(journal != NULL);
+	g_return_if_fail(node != NULL);
+
+	journal_set_common(journal, parent, NULL, node, FALSE);
+}
+
+void
+purple_config_journal_set_with_key(PurpleConfigJournal *journal,
+                                   const gchar * const *parent,
+                                   const gchar *key, PurpleXmlNode *node)
+{
+	g_return_if_fail(journal != NULL);
+	g_return_if_fail(parent != NULL);
+	g_return_if_fail(key != NULL);
+	g_return_if_fail(node != NULL);
+
+	journal_set_common(journal, parent, key, node, FALSE);
+}
+
+void
+purple_config_journal_replace(PurpleConfigJournal *journal,
+                              const gchar * const *parent, PurpleXmlNode *node)
+{
+	g_return_if_fail(journal != NULL);
+	g_return_if_fail(node != NULL);
+
+	journal_set_common(journal, parent, NULL, node, TRUE);
+}
+
+void
+purple_config_journal_remove(PurpleConfigJournal *journal,
+                             const gchar * const *path)
+{
+	gsize n = 0;
+
+	g_return_if_fail(journal != NULL);
+	g_return_if_fail(path != NULL);
+
+	journal_ensure_loaded(journal);
+
+	n = g_strv_length((gchar **)path);
+	if (journal_lookup(journal, path, n) == NULL) {
+		return;
+	}
+
+	journal_apply_remove(journal, path, n);
+
+	journal_record_start(journal->pending, RECORD_DELETE, path, n, 0);
+	g_string_append_c(journal->pending, '\n');
+}
+
+void
+purple_config_journal_set_order(PurpleConfigJournal *journal,
+                                const gchar * const *path,
+                                const gchar * const *keys)
+{
+	g_return_if_fail(journal != NULL);
+	g_return_if_fail(path != NULL);
+	g_return_if_fail(keys != NULL);
+
+	journal_ensure_loaded(journal);
+
+	journal_set_order_internal(journal, path, g_strv_length((gchar **)path),
+	                           keys, g_strv_length((gchar **)keys));
+}
+
+void
+purple_config_journal_save(PurpleConfigJournal *journal)
+{
+	g_return_if_fail(journal != NULL);
+
+	journal_write_pending(journal);
+
+	if (!journal->compacting &&
+			(journal->damaged ||
+			 journal->journal_size > MAX(JOURNAL_MIN_COMPACT_SIZE,
+			                             journal->base_size)))
+	{
+		journal_compact(journal, FALSE);
+	}
+}
+
+const gchar *
+purple_config_journal_unique_key(GHashTable *siblings, const gchar *key)
+{
+	gchar *unique = NULL;
+
+	g_return_val_if_fail(siblings != NULL, NULL);
+	g_return_val_if_fail(key != NULL, NULL);
+
+	unique = journal_unique_key(siblings, key);
+	g_hash_table_add(siblings, unique);
+
+	return unique;
+}
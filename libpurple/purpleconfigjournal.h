@@ -0,0 +1,219 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PURPLE_GLOBAL_HEADER_INSIDE) && !defined(PURPLE_COMPILATION)
+# error "only <purple.h> may be included directly"
+#endif
+
+#ifndef PURPLE_CONFIG_JOURNAL_H
+#define PURPLE_CONFIG_JOURNAL_H
+
+#include <glib.h>
+
+#include "xmlnode.h"
+
+G_BEGIN_DECLS
+
+/**
+ * PurpleConfigJournal:
+ *
+ * Keeps an XML file in the config directory up to date without rewriting it
+ * on every change.
+ *
+ * The file is seen as a tree of keyed elements. Changes are compared against
+ * what is already on disk, and only the elements that differ are appended to
+ * a journal next to the file. Once the journal grows larger than the file,
+ * the file is rewritten from memory in a separate thread and the journal is
+ * discarded. If the program stops before that happens, the journal is
+ * replayed by purple_config_journal_recover() the next time the file is read.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleConfigJournal PurpleConfigJournal;
+
+/**
+ * PurpleConfigJournalKeyFunc:
+ * @node: The element.
+ * @depth: How deep @node is in the file, where the root element is 0.
+ * @container: (out): Return location for whether the children of @node are
+ *             tracked on their own.
+ *
+ * Identifies an element among its siblings. Elements that are containers
+ * only have their attributes and unkeyed children stored together, so a
+ * change to one of their keyed children doesn't rewrite the others.
+ *
+ * The root element must be reported as a container.
+ *
+ * Siblings that get the same key are told apart by appending "#2", "#3", and
+ * so on in document order. See purple_config_journal_unique_key().
+ *
+ * Returns: (transfer full) (nullable): A key for @node, or %NULL if @node is
+ *          part of its parent.
+ *
+ * Since: 3.0.0
+ */
+typedef gchar *(*PurpleConfigJournalKeyFunc)(PurpleXmlNode *node, guint depth, gboolean *container);
+
+/**
+ * purple_config_journal_new:
+ * @filename: The basename of the file in the purple config directory.
+ * @key_func: The function that identifies elements in the file.
+ *
+ * Creates a journal for @filename. Nothing is read until the journal is
+ * first changed or recovered.
+ *
+ * Returns: (transfer full): The new journal.
+ *
+ * Since: 3.0.0
+ */
+PurpleConfigJournal *purple_config_journal_new(const gchar *filename, PurpleConfigJournalKeyFunc key_func);
+
+/**
+ * purple_config_journal_free:
+ * @journal: The journal.
+ *
+ * Writes out any outstanding changes, folds the journal into the file, and
+ * frees @journal.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_free(PurpleConfigJournal *journal);
+
+/**
+ * purple_config_journal_recover:
+ * @journal: The journal.
+ *
+ * Applies a journal left behind by an earlier run to the file. This should be
+ * called before the file is read.
+ *
+ * Returns: %TRUE if changes were recovered.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_config_journal_recover(PurpleConfigJournal *journal);
+
+/**
+ * purple_config_journal_set:
+ * @journal: The journal.
+ * @parent: (array zero-terminated=1) (nullable): The keys leading to the
+ *          parent of @node, starting below the root, or %NULL if @node is the
+ *          root element.
+ * @node: The new contents of the element.
+ *
+ * Stores @node under @parent, replacing any element with the same key. If
+ * @node is a container, only the children it has are stored, and any others
+ * that are already stored are kept.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_set(PurpleConfigJournal *journal, const gchar * const *parent, PurpleXmlNode *node);
+
+/**
+ * purple_config_journal_set_with_key:
+ * @journal: The journal.
+ * @parent: (array zero-terminated=1): The keys leading to the parent of
+ *          @node, starting below the root.
+ * @key: The key to store @node under.
+ * @node: The new contents of the element.
+ *
+ * Like purple_config_journal_set(), but stores @node under @key instead of
+ * the key that the key function gives it. This is for elements whose key
+ * depends on their siblings, see purple_config_journal_unique_key().
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_set_with_key(PurpleConfigJournal *journal, const gchar * const *parent, const gchar *key, PurpleXmlNode *node);
+
+/**
+ * purple_config_journal_replace:
+ * @journal: The journal.
+ * @parent: (array zero-terminated=1) (nullable): The keys leading to the
+ *          parent of @node, starting below the root, or %NULL if @node is the
+ *          root element.
+ * @node: The new contents of the element.
+ *
+ * Like purple_config_journal_set(), but children of containers that are not
+ * in @node are removed and the rest are put in the order of @node.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_replace(PurpleConfigJournal *journal, const gchar * const *parent, PurpleXmlNode *node);
+
+/**
+ * purple_config_journal_remove:
+ * @journal: The journal.
+ * @path: (array zero-terminated=1): The keys leading to the element,
+ *        starting below the root.
+ *
+ * Removes an element and everything below it.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_remove(PurpleConfigJournal *journal, const gchar * const *path);
+
+/**
+ * purple_config_journal_set_order:
+ * @journal: The journal.
+ * @path: (array zero-terminated=1): The keys leading to a container, starting
+ *        below the root. An empty array is the root.
+ * @keys: (array zero-terminated=1): The keys of the children of the
+ *        container, in order.
+ *
+ * Puts the children of a container in the order of @keys. Children that are
+ * not in @keys are removed.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_set_order(PurpleConfigJournal *journal, const gchar * const *path, const gchar * const *keys);
+
+/**
+ * purple_config_journal_save:
+ * @journal: The journal.
+ *
+ * Appends the changes made since the last save to the journal on disk, and
+ * starts folding the journal into the file if it has grown large enough.
+ *
+ * Since: 3.0.0
+ */
+void purple_config_journal_save(PurpleConfigJournal *journal);
+
+/**
+ * purple_config_journal_unique_key:
+ * @siblings: (element-type utf8 utf8): A set of the keys of the earlier
+ *            siblings, created with g_str_hash(), g_str_equal() and g_free()
+ *            for its keys.
+ * @key: The key that the key function gave the next sibling.
+ *
+ * Tells siblings with the same key apart the same way the journal does when
+ * it reads the file, by appending "#2", "#3", and so on. The returned key is
+ * added to @siblings.
+ *
+ * Returns: (transfer none): The key for the sibling, which is owned by
+ *          @siblings.
+ *
+ * Since: 3.0.0
+ */
+const gchar *purple_config_journal_unique_key(GHashTable *siblings, const gchar *key);
+
+G_END_DECLS
+
+#endif /* PURPLE_CONFIG_JOURNAL_H */
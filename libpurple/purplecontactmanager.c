@@ -42,6 +42,54 @@ struct _PurpleContactManager {
 	GPtrArray *people;
 };
 
+/* The keys that a contact was indexed under when it was added or last
+ * changed, and its place in the contacts of its account. We need to keep the
+ * keys around because by the time we're notified of a change the contact no
+ * longer knows its old values.
+ */
+typedef struct {
+	char *id;
+	char *username;
+
+	GSequenceIter *iter;
+} PurpleContactManagerKeys;
+
+/* The list model of the contacts of a single account. The contacts are kept
+ * in a sequence that owns them, so a contact whose place is known can be
+ * removed without walking the list.
+ */
+typedef struct {
+	GObject parent;
+
+	GSequence *items;
+} PurpleContactManagerContacts;
+
+typedef struct {
+	GObjectClass parent;
+} PurpleContactManagerContactsClass;
+
+static GType purple_contact_manager_contacts_get_type(void);
+
+#define PURPLE_TYPE_CONTACT_MANAGER_CONTACTS \
+	(purple_contact_manager_contacts_get_type())
+#define PURPLE_CONTACT_MANAGER_CONTACTS(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), PURPLE_TYPE_CONTACT_MANAGER_CONTACTS, \
+	                            PurpleContactManagerContacts))
+
+/* The contacts for a single account. The contacts model owns the references,
+ * the hash tables just index into it. keys maps each contact to its keys and
+ * its place in the model. ids and usernames map each key to a queue of the
+ * contacts that have it, in the order they appear in the model, so the one
+ * that is found is the one that a linear search of the model would find.
+ */
+typedef struct {
+	PurpleContactManagerContacts *contacts;
+
+	GHashTable *ids;
+	GHashTable *usernames;
+	GHashTable *keys;
+} PurpleContactManagerAccount;
+
 static PurpleContactManager *default_manager = NULL;
 
 /* Necessary prototype. */
@@ -49,35 +97,284 @@ static void purple_contact_manager_contact_person_changed_cb(GObject *obj,
                                                              GParamSpec *pspec,
                                                              gpointer data);
 
+/******************************************************************************
+ * Contacts
+ *****************************************************************************/
+static void
+purple_contact_manager_contacts_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE(PurpleContactManagerContacts,
+                              purple_contact_manager_contacts, G_TYPE_OBJECT,
+                              G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                                    purple_contact_manager_contacts_list_model_init));
+
+static GType
+purple_contact_manager_contacts_get_item_type(G_GNUC_UNUSED GListModel *model) {
+	return PURPLE_TYPE_CONTACT;
+}
+
+static guint
+purple_contact_manager_contacts_get_n_items(GListModel *model) {
+	PurpleContactManagerContacts *contacts = NULL;
+
+	contacts = PURPLE_CONTACT_MANAGER_CONTACTS(model);
+
+	return g_sequence_get_length(contacts->items);
+}
+
+static gpointer
+purple_contact_manager_contacts_get_item(GListModel *model, guint position) {
+	PurpleContactManagerContacts *contacts = NULL;
+	GSequenceIter *iter = NULL;
+
+	contacts = PURPLE_CONTACT_MANAGER_CONTACTS(model);
+
+	iter = g_sequence_get_iter_at_pos(contacts->items, position);
+	if(g_sequence_iter_is_end(iter)) {
+		return NULL;
+	}
+
+	return g_object_ref(g_sequence_get(iter));
+}
+
+static void
+purple_contact_manager_contacts_list_model_init(GListModelInterface *iface) {
+	iface->get_item_type = purple_contact_manager_contacts_get_item_type;
+	iface->get_n_items = purple_contact_manager_contacts_get_n_items;
+	iface->get_item = purple_contact_manager_contacts_get_item;
+}
+
+static void
+purple_contact_manager_contacts_finalize(GObject *obj) {
+	PurpleContactManagerContacts *contacts = NULL;
+
+	contacts = PURPLE_CONTACT_MANAGER_CONTACTS(obj);
+
+	g_sequence_free(contacts->items);
+
+	G_OBJECT_CLASS(purple_contact_manager_contacts_parent_class)->finalize(obj);
+}
+
+static void
+purple_contact_manager_contacts_init(PurpleContactManagerContacts *contacts) {
+	contacts->items = g_sequence_new(g_object_unref);
+}
+
+static void
+purple_contact_manager_contacts_class_init(PurpleContactManagerContactsClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->finalize = purple_contact_manager_contacts_finalize;
+}
+
 /******************************************************************************
  * Helpers
  *****************************************************************************/
-static gboolean
-purple_contact_manager_find_with_username_helper(gconstpointer a,
-                                                 gconstpointer b)
+static void
+purple_contact_manager_keys_free(gpointer data) {
+	PurpleContactManagerKeys *keys = data;
+
+	g_free(keys->id);
+	g_free(keys->username);
+
+	g_free(keys);
+}
+
+static PurpleContactManagerAccount *
+purple_contact_manager_account_new(void) {
+	PurpleContactManagerAccount *account = NULL;
+
+	account = g_new0(PurpleContactManagerAccount, 1);
+	account->contacts = g_object_new(PURPLE_TYPE_CONTACT_MANAGER_CONTACTS,
+	                                 NULL);
+	account->ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                     (GDestroyNotify)g_queue_free);
+	account->usernames = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                           g_free,
+	                                           (GDestroyNotify)g_queue_free);
+	account->keys = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                      purple_contact_manager_keys_free);
+
+	return account;
+}
+
+static void
+purple_contact_manager_account_free(gpointer data) {
+	PurpleContactManagerAccount *account = data;
+
+	/* The indexes don't hold references so they have to go before the
+	 * contacts do.
+	 */
+	g_clear_pointer(&account->ids, g_hash_table_destroy);
+	g_clear_pointer(&account->usernames, g_hash_table_destroy);
+	g_clear_pointer(&account->keys, g_hash_table_destroy);
+	g_clear_object(&account->contacts);
+
+	g_free(account);
+}
+
+static PurpleContactManagerAccount *
+purple_contact_manager_get_account(PurpleContactManager *manager,
+                                   PurpleAccount *account)
 {
-	PurpleContactInfo *info_a = PURPLE_CONTACT_INFO((gpointer)a);
-	PurpleContactInfo *info_b = PURPLE_CONTACT_INFO((gpointer)b);
-	const gchar *username_a = NULL;
-	const gchar *username_b = NULL;
+	return g_hash_table_lookup(manager->accounts, account);
+}
 
-	username_a = purple_contact_info_get_username(info_a);
-	username_b = purple_contact_info_get_username(info_b);
+/* Inserts contact into index under key, behind the contacts with the same key
+ * that come before it in the model.
+ */
+static void
+purple_contact_manager_index_insert(PurpleContactManagerAccount *account,
+                                    GHashTable *index, const char *key,
+                                    PurpleContactManagerKeys *keys,
+                                    PurpleContact *contact)
+{
+	GQueue *holders = NULL;
+	GList *sibling = NULL;
+
+	if(key == NULL) {
+		return;
+	}
 
-	return purple_strequal(username_a, username_b);
+	holders = g_hash_table_lookup(index, key);
+	if(holders == NULL) {
+		holders = g_queue_new();
+		g_hash_table_insert(index, g_strdup(key), holders);
+	}
+
+	for(sibling = holders->head; sibling != NULL; sibling = sibling->next) {
+		PurpleContactManagerKeys *other = NULL;
+
+		other = g_hash_table_lookup(account->keys, sibling->data);
+		if(g_sequence_iter_compare(keys->iter, other->iter) < 0) {
+			break;
+		}
+	}
+
+	g_queue_insert_before(holders, sibling, contact);
 }
 
-static gboolean
-purple_contact_manager_find_with_id_helper(gconstpointer a, gconstpointer b) {
-	PurpleContactInfo *info_a = PURPLE_CONTACT_INFO((gpointer)a);
-	PurpleContactInfo *info_b = PURPLE_CONTACT_INFO((gpointer)b);
-	const gchar *id_a = NULL;
-	const gchar *id_b = NULL;
+/* Removes contact from index under key. If another contact has the same key,
+ * the next one in the model takes its place.
+ */
+static void
+purple_contact_manager_index_remove(GHashTable *index, const char *key,
+                                    PurpleContact *contact)
+{
+	GQueue *holders = NULL;
 
-	id_a = purple_contact_info_get_id(info_a);
-	id_b = purple_contact_info_get_id(info_b);
+	if(key == NULL) {
+		return;
+	}
+
+	holders = g_hash_table_lookup(index, key);
+	if(holders == NULL) {
+		return;
+	}
+
+	g_queue_remove(holders, contact);
+	if(g_queue_is_empty(holders)) {
+		g_hash_table_remove(index, key);
+	}
+}
+
+static PurpleContact *
+purple_contact_manager_index_lookup(GHashTable *index, const char *key) {
+	GQueue *holders = g_hash_table_lookup(index, key);
+
+	return (holders != NULL) ? g_queue_peek_head(holders) : NULL;
+}
+
+/* Usernames are indexed in their normalized form so that lookups are not
+ * tripped up by differences that the protocol considers insignificant.
+ */
+static void
+purple_contact_manager_index_contact(PurpleContactManagerAccount *account,
+                                     PurpleContact *contact)
+{
+	PurpleContactInfo *info = PURPLE_CONTACT_INFO(contact);
+	PurpleContactManagerKeys *keys = NULL;
+	const char *username = NULL;
+
+	keys = g_hash_table_lookup(account->keys, contact);
+	keys->id = g_strdup(purple_contact_info_get_id(info));
+
+	username = purple_contact_info_get_username(info);
+	if(username != NULL) {
+		PurpleAccount *purple_account = purple_contact_get_account(contact);
+
+		keys->username = g_strdup(purple_normalize(purple_account, username));
+	}
+
+	purple_contact_manager_index_insert(account, account->ids, keys->id, keys,
+	                                    contact);
+	purple_contact_manager_index_insert(account, account->usernames,
+	                                    keys->username, keys, contact);
+}
+
+static void
+purple_contact_manager_unindex_contact(PurpleContactManagerAccount *account,
+                                       PurpleContact *contact)
+{
+	PurpleContactManagerKeys *keys = NULL;
+
+	keys = g_hash_table_lookup(account->keys, contact);
+	if(keys == NULL) {
+		return;
+	}
+
+	purple_contact_manager_index_remove(account->ids, keys->id, contact);
+	purple_contact_manager_index_remove(account->usernames, keys->username,
+	                                    contact);
+
+	g_clear_pointer(&keys->id, g_free);
+	g_clear_pointer(&keys->username, g_free);
+}
+
+/* Appends contact to the contacts of account, taking a reference, and indexes
+ * it. The caller makes sure it isn't one of them already.
+ */
+static void
+purple_contact_manager_account_append(PurpleContactManagerAccount *account,
+                                      PurpleContact *contact)
+{
+	PurpleContactManagerKeys *keys = NULL;
+	guint position = 0;
+
+	position = g_sequence_get_length(account->contacts->items);
+
+	keys = g_new0(PurpleContactManagerKeys, 1);
+	keys->iter = g_sequence_append(account->contacts->items,
+	                               g_object_ref(contact));
+	g_hash_table_insert(account->keys, contact, keys);
+
+	purple_contact_manager_index_contact(account, contact);
+
+	g_list_model_items_changed(G_LIST_MODEL(account->contacts), position, 0,
+	                           1);
+}
+
+/* Removes contact, which must be one of the contacts of account, through its
+ * place in the model. This drops the reference that the model held.
+ */
+static void
+purple_contact_manager_account_remove(PurpleContactManagerAccount *account,
+                                      PurpleContact *contact)
+{
+	PurpleContactManagerKeys *keys = NULL;
+	GSequenceIter *iter = NULL;
+	guint position = 0;
 
-	return purple_strequal(id_a, id_b);
+	keys = g_hash_table_lookup(account->keys, contact);
+	iter = keys->iter;
+	position = g_sequence_iter_get_position(iter);
+
+	purple_contact_manager_unindex_contact(account, contact);
+	g_hash_table_remove(account->keys, contact);
+	g_sequence_remove(iter);
+
+	g_list_model_items_changed(G_LIST_MODEL(account->contacts), position, 1,
+	                           0);
 }
 
 static gboolean
@@ -156,6 +453,25 @@ purple_contact_manager_protocol_roster_update(PurpleContact *contact) {
 /******************************************************************************
  * Callbacks
  *****************************************************************************/
+static void
+purple_contact_manager_contact_keys_changed_cb(GObject *obj,
+                                               G_GNUC_UNUSED GParamSpec *pspec,
+                                               gpointer data)
+{
+	PurpleContact *contact = PURPLE_CONTACT(obj);
+	PurpleContactManager *manager = data;
+	PurpleContactManagerAccount *account = NULL;
+
+	account = purple_contact_manager_get_account(manager,
+	                                             purple_contact_get_account(contact));
+	if(account == NULL || !g_hash_table_contains(account->keys, contact)) {
+		return;
+	}
+
+	purple_contact_manager_unindex_contact(account, contact);
+	purple_contact_manager_index_contact(account, contact);
+}
+
 static void
 purple_contact_manager_contact_update_cb(GObject *obj,
                                          G_GNUC_UNUSED GParamSpec *pspec,
@@ -272,7 +588,8 @@ purple_contact_manager_finalize(GObject *obj) {
 static void
 purple_contact_manager_init(PurpleContactManager *manager) {
 	manager->accounts = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-	                                          g_object_unref, g_object_unref);
+	                                          g_object_unref,
+	                                          purple_contact_manager_account_free);
 
 	/* 100 Seems like a reasonable default of the number people on your contact
 	 * list. - gk 20221109
@@ -410,23 +727,23 @@ purple_contact_manager_add(PurpleContactManager *manager,
                            PurpleContact *contact)
 {
 	PurpleAccount *account = NULL;
-	GListStore *contacts = NULL;
+	PurpleContactManagerAccount *contacts = NULL;
 	gboolean added = FALSE;
 
 	g_return_if_fail(PURPLE_IS_CONTACT_MANAGER(manager));
 	g_return_if_fail(PURPLE_IS_CONTACT(contact));
 
 	account = purple_contact_get_account(contact);
-	contacts = g_hash_table_lookup(manager->accounts, account);
-	if(!G_IS_LIST_STORE(contacts)) {
-		contacts = g_list_store_new(PURPLE_TYPE_CONTACT);
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts == NULL) {
+		contacts = purple_contact_manager_account_new();
 		g_hash_table_insert(manager->accounts, g_object_ref(account), contacts);
 
-		g_list_store_append(contacts, contact);
+		purple_contact_manager_account_append(contacts, contact);
 
 		added = TRUE;
 	} else {
-		if(g_list_store_find(contacts, contact, NULL)) {
+		if(g_hash_table_contains(contacts->keys, contact)) {
 			PurpleContactInfo *info = PURPLE_CONTACT_INFO(contact);
 			const gchar *username = purple_contact_info_get_username(info);
 			const gchar *id = purple_contact_info_get_id(info);
@@ -436,7 +753,7 @@ purple_contact_manager_add(PurpleContactManager *manager,
 			return;
 		}
 
-		g_list_store_append(contacts, contact);
+		purple_contact_manager_account_append(contacts, contact);
 		added = TRUE;
 	}
 
@@ -455,6 +772,12 @@ purple_contact_manager_add(PurpleContactManager *manager,
 		tags = purple_contact_info_get_tags(info);
 
 		/* Add some notify signals to track changes. */
+		g_signal_connect_object(contact, "notify::id",
+		                        G_CALLBACK(purple_contact_manager_contact_keys_changed_cb),
+		                        manager, 0);
+		g_signal_connect_object(contact, "notify::username",
+		                        G_CALLBACK(purple_contact_manager_contact_keys_changed_cb),
+		                        manager, 0);
 		g_signal_connect_object(contact, "notify::alias",
 		                        G_CALLBACK(purple_contact_manager_contact_update_cb),
 		                        manager, 0);
@@ -480,59 +803,48 @@ purple_contact_manager_remove(PurpleContactManager *manager,
                               PurpleContact *contact)
 {
 	PurpleAccount *account = NULL;
-	GListStore *contacts = NULL;
-	guint position = 0;
+	PurpleContactManagerAccount *contacts = NULL;
+	PurpleTags *tags = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONTACT(contact), FALSE);
 
 	account = purple_contact_get_account(contact);
-	contacts = g_hash_table_lookup(manager->accounts, account);
-	if(!G_IS_LIST_STORE(contacts)) {
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts == NULL || !g_hash_table_contains(contacts->keys, contact)) {
 		return FALSE;
 	}
 
-	if(g_list_store_find(contacts, contact, &position)) {
-		PurpleTags *tags = NULL;
-		gboolean removed = FALSE;
-		guint len = 0;
-
-		/* Ref the contact to make sure that the instance is valid when we emit
-		 * the removed signal.
-		 */
-		g_object_ref(contact);
-
-		len = g_list_model_get_n_items(G_LIST_MODEL(contacts));
-		g_list_store_remove(contacts, position);
-		if(g_list_model_get_n_items(G_LIST_MODEL(contacts)) < len) {
-			removed = TRUE;
-		}
+	/* Ref the contact to make sure that the instance is valid when we emit
+	 * the removed signal.
+	 */
+	g_object_ref(contact);
 
-		/* Remove the signals for the contact's tags changing as we're no
-		 * longer tracking the contact they belong to.
-		 */
-		tags = purple_contact_info_get_tags(PURPLE_CONTACT_INFO(contact));
-		g_signal_handlers_disconnect_by_func(tags,
-		                                     purple_contact_manager_tags_changed_cb,
-		                                     contact);
+	purple_contact_manager_account_remove(contacts, contact);
+	g_signal_handlers_disconnect_by_func(contact,
+	                                     purple_contact_manager_contact_keys_changed_cb,
+	                                     manager);
 
-		if(removed) {
-			g_signal_emit(manager, signals[SIG_REMOVED], 0, contact);
-		}
+	/* Remove the signals for the contact's tags changing as we're no longer
+	 * tracking the contact they belong to.
+	 */
+	tags = purple_contact_info_get_tags(PURPLE_CONTACT_INFO(contact));
+	g_signal_handlers_disconnect_by_func(tags,
+	                                     purple_contact_manager_tags_changed_cb,
+	                                     contact);
 
-		g_object_unref(contact);
+	g_signal_emit(manager, signals[SIG_REMOVED], 0, contact);
 
-		return removed;
-	}
+	g_object_unref(contact);
 
-	return FALSE;
+	return TRUE;
 }
 
 gboolean
 purple_contact_manager_remove_all(PurpleContactManager *manager,
                                   PurpleAccount *account)
 {
-	GListStore *contacts = NULL;
+	PurpleContactManagerAccount *contacts = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), FALSE);
@@ -540,16 +852,21 @@ purple_contact_manager_remove_all(PurpleContactManager *manager,
 	/* If there are any contacts for this account, manually iterate them and
 	 * emit the removed signal. This is more efficient than calling remove on
 	 * each one individually as that would require updating the backing
-	 * GListStore for each individual removal.
+	 * model and the indexes for each individual removal.
 	 */
-	contacts = g_hash_table_lookup(manager->accounts, account);
-	if(G_IS_LIST_STORE(contacts)) {
-		guint n_items = g_list_model_get_n_items(G_LIST_MODEL(contacts));
-		for(guint i = 0; i < n_items; i++) {
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts != NULL) {
+		GSequenceIter *iter = NULL;
+
+		iter = g_sequence_get_begin_iter(contacts->contacts->items);
+		for(; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
 			PurpleContact *contact = NULL;
 
-			contact = g_list_model_get_item(G_LIST_MODEL(contacts), i);
+			contact = g_object_ref(g_sequence_get(iter));
 
+			g_signal_handlers_disconnect_by_func(contact,
+			                                     purple_contact_manager_contact_keys_changed_cb,
+			                                     manager);
 			g_signal_emit(manager, signals[SIG_REMOVED], 0, contact);
 
 			g_clear_object(&contact);
@@ -563,10 +880,17 @@ GListModel *
 purple_contact_manager_get_all(PurpleContactManager *manager,
                                PurpleAccount *account)
 {
+	PurpleContactManagerAccount *contacts = NULL;
+
 	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), FALSE);
 
-	return g_hash_table_lookup(manager->accounts, account);
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts == NULL) {
+		return NULL;
+	}
+
+	return G_LIST_MODEL(contacts->contacts);
 }
 
 PurpleContact *
@@ -574,29 +898,23 @@ purple_contact_manager_find_with_username(PurpleContactManager *manager,
                                           PurpleAccount *account,
                                           const gchar *username)
 {
-	PurpleContact *needle = NULL;
-	GListStore *contacts = NULL;
-	guint position = 0;
-	gboolean found = FALSE;
+	PurpleContactManagerAccount *contacts = NULL;
+	PurpleContact *contact = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), FALSE);
 	g_return_val_if_fail(username != NULL, FALSE);
 
-	contacts = g_hash_table_lookup(manager->accounts, account);
-	if(!G_IS_LIST_STORE(contacts)) {
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts == NULL) {
 		return NULL;
 	}
 
-	needle = purple_contact_new(account, NULL);
-	purple_contact_info_set_username(PURPLE_CONTACT_INFO(needle), username);
-	found = g_list_store_find_with_equal_func(contacts, needle,
-	                                          purple_contact_manager_find_with_username_helper,
-	                                          &position);
-	g_clear_object(&needle);
-
-	if(found) {
-		return g_list_model_get_item(G_LIST_MODEL(contacts), position);
+	contact = purple_contact_manager_index_lookup(contacts->usernames,
+	                                              purple_normalize(account,
+	                                                               username));
+	if(contact != NULL) {
+		return g_object_ref(contact);
 	}
 
 	return NULL;
@@ -606,28 +924,21 @@ PurpleContact *
 purple_contact_manager_find_with_id(PurpleContactManager *manager,
                                     PurpleAccount *account, const gchar *id)
 {
-	PurpleContact *needle = NULL;
-	GListStore *contacts = NULL;
-	guint position = 0;
-	gboolean found = FALSE;
+	PurpleContactManagerAccount *contacts = NULL;
+	PurpleContact *contact = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), FALSE);
 	g_return_val_if_fail(id != NULL, FALSE);
 
-	contacts = g_hash_table_lookup(manager->accounts, account);
-	if(!G_IS_LIST_STORE(contacts)) {
+	contacts = purple_contact_manager_get_account(manager, account);
+	if(contacts == NULL) {
 		return NULL;
 	}
 
-	needle = purple_contact_new(account, id);
-	found = g_list_store_find_with_equal_func(contacts, needle,
-	                                          purple_contact_manager_find_with_id_helper,
-	                                          &position);
-	g_clear_object(&needle);
-
-	if(found) {
-		return g_list_model_get_item(G_LIST_MODEL(contacts), position);
+	contact = purple_contact_manager_index_lookup(contacts->ids, id);
+	if(contact != NULL) {
+		return g_object_ref(contact);
 	}
 
 	return NULL;
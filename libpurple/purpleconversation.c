@@ -22,6 +22,7 @@
 
 #include "conversations.h"
 #include "debug.h"
+#include "prefs.h"
 #include "purpleconversationmanager.h"
 #include "purpleconversationmember.h"
 #include "purpleenums.h"
@@ -31,6 +32,25 @@
 #include "purpletags.h"
 #include "server.h"
 
+typedef struct {
+	GObject parent;
+
+	GSequence *items;
+	GHashTable *index;
+} PurpleConversationMembers;
+
+typedef struct {
+	GObjectClass parent;
+} PurpleConversationMembersClass;
+
+static GType purple_conversation_members_get_type(void);
+
+#define PURPLE_TYPE_CONVERSATION_MEMBERS \
+	(purple_conversation_members_get_type())
+#define PURPLE_CONVERSATION_MEMBERS(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST((obj), PURPLE_TYPE_CONVERSATION_MEMBERS, \
+	                            PurpleConversationMembers))
+
 typedef struct {
 	char *id;
 	PurpleAccount *account;
@@ -52,9 +72,14 @@ typedef struct {
 	GDateTime *created_on;
 	PurpleContactInfo *creator;
 	PurpleTags *tags;
-	GListStore *members;
+	PurpleConversationMembers *members;
 
 	GListStore *messages;
+	guint message_limit;
+	guint64 message_size_limit;
+	guint64 messages_size;
+	guint n_older_messages;
+	guint64 older_messages_size;
 } PurpleConversationPrivate;
 
 enum {
@@ -76,6 +101,8 @@ enum {
 	PROP_TAGS,
 	PROP_MEMBERS,
 	PROP_MESSAGES,
+	PROP_MESSAGE_LIMIT,
+	PROP_MESSAGE_SIZE_LIMIT,
 	N_PROPERTIES
 };
 static GParamSpec *properties[N_PROPERTIES] = { NULL, };
@@ -90,6 +117,200 @@ static guint signals[N_SIGNALS] = {0, };
 G_DEFINE_TYPE_WITH_PRIVATE(PurpleConversation, purple_conversation,
                            G_TYPE_OBJECT);
 
+/**************************************************************************
+ * Members
+ **************************************************************************/
+/* The list model of the members of a conversation. The members are kept in a
+ * sequence that owns them, and index maps the contact info of each member to
+ * its place in the sequence, so a member can be found, located, and removed
+ * without walking the list.
+ */
+static void
+purple_conversation_members_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE(PurpleConversationMembers,
+                              purple_conversation_members, G_TYPE_OBJECT,
+                              G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                                    purple_conversation_members_list_model_init));
+
+static GType
+purple_conversation_members_get_item_type(G_GNUC_UNUSED GListModel *model) {
+	return PURPLE_TYPE_CONVERSATION_MEMBER;
+}
+
+static guint
+purple_conversation_members_get_n_items(GListModel *model) {
+	PurpleConversationMembers *members = PURPLE_CONVERSATION_MEMBERS(model);
+
+	return g_sequence_get_length(members->items);
+}
+
+static gpointer
+purple_conversation_members_get_item(GListModel *model, guint position) {
+	PurpleConversationMembers *members = PURPLE_CONVERSATION_MEMBERS(model);
+	GSequenceIter *iter = NULL;
+
+	iter = g_sequence_get_iter_at_pos(members->items, position);
+	if(g_sequence_iter_is_end(iter)) {
+		return NULL;
+	}
+
+	return g_object_ref(g_sequence_get(iter));
+}
+
+static void
+purple_conversation_members_list_model_init(GListModelInterface *iface) {
+	iface->get_item_type = purple_conversation_members_get_item_type;
+	iface->get_n_items = purple_conversation_members_get_n_items;
+	iface->get_item = purple_conversation_members_get_item;
+}
+
+static void
+purple_conversation_members_finalize(GObject *obj) {
+	PurpleConversationMembers *members = PURPLE_CONVERSATION_MEMBERS(obj);
+
+	g_hash_table_destroy(members->index);
+	g_sequence_free(members->items);
+
+	G_OBJECT_CLASS(purple_conversation_members_parent_class)->finalize(obj);
+}
+
+static void
+purple_conversation_members_init(PurpleConversationMembers *members) {
+	members->items = g_sequence_new(g_object_unref);
+	members->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void
+purple_conversation_members_class_init(PurpleConversationMembersClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->finalize = purple_conversation_members_finalize;
+}
+
+/* Returns the member for info, or NULL if it isn't a member. */
+static PurpleConversationMember *
+purple_conversation_members_lookup(PurpleConversationMembers *members,
+                                   PurpleContactInfo *info)
+{
+	GSequenceIter *iter = g_hash_table_lookup(members->index, info);
+
+	return (iter != NULL) ? g_sequence_get(iter) : NULL;
+}
+
+/* Returns the position of member, or FALSE if it isn't a member. */
+static gboolean
+purple_conversation_members_find(PurpleConversationMembers *members,
+                                 PurpleConversationMember *member,
+                                 guint *position)
+{
+	PurpleContactInfo *info = NULL;
+	GSequenceIter *iter = NULL;
+
+	info = purple_conversation_member_get_contact_info(member);
+	iter = g_hash_table_lookup(members->index, info);
+	if(iter == NULL || g_sequence_get(iter) != member) {
+		return FALSE;
+	}
+
+	if(position != NULL) {
+		*position = g_sequence_iter_get_position(iter);
+	}
+
+	return TRUE;
+}
+
+/* Appends the members in added, taking a reference to each, with a single
+ * items-changed emission. The caller makes sure none of them are members
+ * already.
+ */
+static void
+purple_conversation_members_append(PurpleConversationMembers *members,
+                                   GPtrArray *added)
+{
+	guint position = g_sequence_get_length(members->items);
+
+	for(guint i = 0; i < added->len; i++) {
+		PurpleConversationMember *member = g_ptr_array_index(added, i);
+		PurpleContactInfo *info = NULL;
+		GSequenceIter *iter = NULL;
+
+		info = purple_conversation_member_get_contact_info(member);
+		iter = g_sequence_append(members->items, g_object_ref(member));
+		g_hash_table_insert(members->index, info, iter);
+	}
+
+	if(added->len > 0) {
+		g_list_model_items_changed(G_LIST_MODEL(members), position, 0,
+		                           added->len);
+	}
+}
+
+/* Sorts sequence iterators from the last position to the first. */
+static gint
+purple_conversation_members_compare_iters(gconstpointer a, gconstpointer b) {
+	GSequenceIter *iter_a = *(GSequenceIter **)a;
+	GSequenceIter *iter_b = *(GSequenceIter **)b;
+
+	return g_sequence_iter_compare(iter_b, iter_a);
+}
+
+/* Removes the members in doomed, which must all be members, with one
+ * items-changed emission for each run of adjacent members. The runs are
+ * removed from the end of the list backwards so that the positions of the
+ * runs that are still to come don't change.
+ */
+static void
+purple_conversation_members_remove(PurpleConversationMembers *members,
+                                   GPtrArray *doomed)
+{
+	GPtrArray *iters = NULL;
+	guint i = 0;
+
+	if(doomed->len == 0) {
+		return;
+	}
+
+	iters = g_ptr_array_sized_new(doomed->len);
+	for(i = 0; i < doomed->len; i++) {
+		PurpleConversationMember *member = g_ptr_array_index(doomed, i);
+		PurpleContactInfo *info = NULL;
+
+		info = purple_conversation_member_get_contact_info(member);
+		g_ptr_array_add(iters, g_hash_table_lookup(members->index, info));
+	}
+	g_ptr_array_sort(iters, purple_conversation_members_compare_iters);
+
+	i = 0;
+	while(i < iters->len) {
+		guint last = g_sequence_iter_get_position(g_ptr_array_index(iters, i));
+		guint n_run = 1;
+
+		while(i + n_run < iters->len &&
+		      g_sequence_iter_get_position(g_ptr_array_index(iters, i + n_run)) == last - n_run)
+		{
+			n_run++;
+		}
+
+		for(guint j = i; j < i + n_run; j++) {
+			GSequenceIter *iter = g_ptr_array_index(iters, j);
+			PurpleConversationMember *member = g_sequence_get(iter);
+			PurpleContactInfo *info = NULL;
+
+			info = purple_conversation_member_get_contact_info(member);
+			g_hash_table_remove(members->index, info);
+			g_sequence_remove(iter);
+		}
+
+		g_list_model_items_changed(G_LIST_MODEL(members), last - n_run + 1,
+		                           n_run, 0);
+
+		i += n_run;
+	}
+
+	g_ptr_array_free(iters, TRUE);
+}
+
 /**************************************************************************
  * Helpers
  **************************************************************************/
@@ -109,17 +330,111 @@ purple_conversation_set_id(PurpleConversation *conversation, const char *id) {
 	}
 }
 
+/* The number of bytes a message counts for against the message size limit. */
+static guint64
+purple_conversation_message_size(PurpleMessage *message) {
+	const char *contents = purple_message_get_contents(message);
+
+	return (contents != NULL) ? strlen(contents) : 0;
+}
+
+/* Evicts the oldest messages until the in-memory window fits within the
+ * configured limits. Everything is removed with a single splice so that users
+ * of the model only see one items-changed emission. The newest message is
+ * always kept, no matter how large it is.
+ *
+ * Messages that were loaded from the history don't count against the limits,
+ * but they are still the oldest, so new messages push them out one at a time
+ * instead of letting the list grow.
+ */
+static void
+purple_conversation_trim_messages(PurpleConversation *conversation) {
+	PurpleConversationPrivate *priv = NULL;
+	GListModel *model = NULL;
+	guint64 size = 0;
+	guint64 size_limit = 0;
+	guint64 older_size = 0;
+	guint limit = 0;
+	guint n_items = 0;
+	guint n_remove = 0;
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	model = G_LIST_MODEL(priv->messages);
+	n_items = g_list_model_get_n_items(model);
+	size = priv->messages_size;
+	older_size = priv->older_messages_size;
+
+	if(priv->message_limit != 0) {
+		limit = priv->message_limit + priv->n_older_messages;
+	}
+	if(priv->message_size_limit != 0) {
+		size_limit = priv->message_size_limit + older_size;
+	}
+
+	while(n_remove + 1 < n_items) {
+		PurpleMessage *message = NULL;
+		guint64 message_size = 0;
+
+		if((limit == 0 || n_items - n_remove <= limit) &&
+		   (size_limit == 0 || size <= size_limit))
+		{
+			break;
+		}
+
+		message = g_list_model_get_item(model, n_remove);
+		message_size = purple_conversation_message_size(message);
+		g_object_unref(message);
+
+		/* The contents of a message can change after it was added, so don't
+		 * let the totals wrap around.
+		 */
+		size -= MIN(size, message_size);
+		if(n_remove < priv->n_older_messages) {
+			older_size -= MIN(older_size, message_size);
+		}
+		n_remove++;
+	}
+
+	if(n_remove > 0) {
+		priv->messages_size = size;
+		priv->older_messages_size = older_size;
+		priv->n_older_messages -= MIN(priv->n_older_messages, n_remove);
+		g_list_store_splice(priv->messages, 0, n_remove, NULL, 0);
+	}
+}
+
+/* Appends a key:"value" term to a history query, doubling any quotes in value
+ * so that it can't end the term early or add terms of its own.
+ */
+static void
+purple_conversation_append_query_term(GString *query, const char *key,
+                                      const char *value)
+{
+	if(query->len > 0) {
+		g_string_append_c(query, ' ');
+	}
+
+	g_string_append_printf(query, "%s:\"", key);
+	for(const char *p = value; p != NULL && *p != '\0'; p++) {
+		if(*p == '"') {
+			g_string_append_c(query, '"');
+		}
+		g_string_append_c(query, *p);
+	}
+	g_string_append_c(query, '"');
+}
+
+/* Returns TRUE if member is currently in the conversation. */
 static gboolean
-purple_conversation_check_member_equal(gconstpointer a, gconstpointer b) {
-	PurpleConversationMember *member_a = (PurpleConversationMember *)a;
-	PurpleConversationMember *member_b = (PurpleConversationMember *)b;
-	PurpleContactInfo *info_a = NULL;
-	PurpleContactInfo *info_b = NULL;
+purple_conversation_is_member(PurpleConversationPrivate *priv,
+                              PurpleConversationMember *member)
+{
+	PurpleContactInfo *info = NULL;
 
-	info_a = purple_conversation_member_get_contact_info(member_a);
-	info_b = purple_conversation_member_get_contact_info(member_b);
+	info = purple_conversation_member_get_contact_info(member);
 
-	return (purple_contact_info_compare(info_a, info_b) == 0);
+	return (purple_conversation_members_lookup(priv->members, info) == member);
 }
 
 static void
@@ -320,6 +635,14 @@ purple_conversation_set_property(GObject *obj, guint param_id,
 		case PROP_CREATOR:
 			purple_conversation_set_creator(conv, g_value_get_object(value));
 			break;
+		case PROP_MESSAGE_LIMIT:
+			purple_conversation_set_message_limit(conv,
+			                                      g_value_get_uint(value));
+			break;
+		case PROP_MESSAGE_SIZE_LIMIT:
+			purple_conversation_set_message_size_limit(conv,
+			                                           g_value_get_uint64(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -389,6 +712,14 @@ purple_conversation_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_MESSAGES:
 			g_value_set_object(value, purple_conversation_get_messages(conv));
 			break;
+		case PROP_MESSAGE_LIMIT:
+			g_value_set_uint(value,
+			                 purple_conversation_get_message_limit(conv));
+			break;
+		case PROP_MESSAGE_SIZE_LIMIT:
+			g_value_set_uint64(value,
+			                   purple_conversation_get_message_size_limit(conv));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -402,8 +733,23 @@ purple_conversation_init(PurpleConversation *conv) {
 	priv = purple_conversation_get_instance_private(conv);
 
 	priv->tags = purple_tags_new();
-	priv->members = g_list_store_new(PURPLE_TYPE_CONVERSATION_MEMBER);
+	priv->members = g_object_new(PURPLE_TYPE_CONVERSATION_MEMBERS, NULL);
 	priv->messages = g_list_store_new(PURPLE_TYPE_MESSAGE);
+
+	/* These are read here rather than being construct properties so that
+	 * values passed to g_object_new still take precedence. The prefs are
+	 * registered by purple_conversations_init, so conversations that are
+	 * created before that keep the defaults.
+	 */
+	priv->message_limit = PURPLE_CONVERSATION_DEFAULT_MESSAGE_LIMIT;
+	if(purple_prefs_exists("/purple/conversations/message_limit")) {
+		priv->message_limit = MAX(0, purple_prefs_get_int("/purple/conversations/message_limit"));
+	}
+
+	if(purple_prefs_exists("/purple/conversations/message_size_limit")) {
+		priv->message_size_limit = MAX(0, purple_prefs_get_int("/purple/conversations/message_size_limit"));
+		priv->message_size_limit *= 1024;
+	}
 }
 
 static void
@@ -725,6 +1071,47 @@ purple_conversation_class_init(PurpleConversationClass *klass) {
 		G_TYPE_LIST_MODEL,
 		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+	/**
+	 * PurpleConversation:message-limit:
+	 *
+	 * The maximum number of messages to keep in
+	 * [property@Conversation:messages], or 0 for no limit.
+	 *
+	 * When the limit is exceeded, the oldest messages are removed. They can be
+	 * loaded again from the history with
+	 * [method@Conversation.load_older_messages].
+	 *
+	 * The default comes from the `/purple/conversations/message_limit`
+	 * preference.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_MESSAGE_LIMIT] = g_param_spec_uint(
+		"message-limit", "message-limit",
+		"The maximum number of messages to keep in memory.",
+		0, G_MAXUINT, PURPLE_CONVERSATION_DEFAULT_MESSAGE_LIMIT,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+	/**
+	 * PurpleConversation:message-size-limit:
+	 *
+	 * The maximum number of bytes of message contents to keep in
+	 * [property@Conversation:messages], or 0 for no limit.
+	 *
+	 * This works the same way as [property@Conversation:message-limit] and
+	 * both limits are applied if both are set.
+	 *
+	 * The default comes from the `/purple/conversations/message_size_limit`
+	 * preference, which is in kibibytes.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_MESSAGE_SIZE_LIMIT] = g_param_spec_uint64(
+		"message-size-limit", "message-size-limit",
+		"The maximum number of bytes of messages to keep in memory.",
+		0, G_MAXUINT64, 0,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
 
 	/**
@@ -1074,6 +1461,16 @@ _purple_conversation_write_common(PurpleConversation *conv,
 		PurpleHistoryManager *manager = NULL;
 
 		manager = purple_history_manager_get_default();
+		/* Make sure the message has an id so that it can be found in the
+		 * history again after it has been evicted from memory.
+		 */
+		if(purple_message_get_id(pmsg) == NULL) {
+			char *id = g_uuid_string_random();
+
+			purple_message_set_id(pmsg, id);
+			g_free(id);
+		}
+
 		/* We should probably handle this error somehow, but I don't think that
 		 * spamming purple_debug_warning is necessarily the right call.
 		 */
@@ -1085,6 +1482,8 @@ _purple_conversation_write_common(PurpleConversation *conv,
 	}
 
 	g_list_store_append(priv->messages, pmsg);
+	priv->messages_size += purple_conversation_message_size(pmsg);
+	purple_conversation_trim_messages(conv);
 
 	if(ops) {
 		if (PURPLE_IS_CHAT_CONVERSATION(conv) && ops->write_chat) {
@@ -1534,48 +1933,33 @@ purple_conversation_has_member(PurpleConversation *conversation,
                                PurpleContactInfo *info, guint *position)
 {
 	PurpleConversationPrivate *priv = NULL;
-	PurpleConversationMember *needle = NULL;
-	gboolean found = FALSE;
+	PurpleConversationMember *member = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONTACT_INFO(info), FALSE);
 
 	priv = purple_conversation_get_instance_private(conversation);
 
-	needle = purple_conversation_member_new(info);
-	found = g_list_store_find_with_equal_func(priv->members, needle,
-	                                          purple_conversation_check_member_equal,
-	                                          position);
-
-	g_clear_object(&needle);
+	member = purple_conversation_members_lookup(priv->members, info);
+	if(member == NULL) {
+		return FALSE;
+	}
 
-	return found;
+	return purple_conversation_members_find(priv->members, member, position);
 }
 
 PurpleConversationMember *
 purple_conversation_find_member(PurpleConversation *conversation,
                                 PurpleContactInfo *info)
 {
-	PurpleConversationMember *member = NULL;
-	guint position = 0;
+	PurpleConversationPrivate *priv = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), NULL);
 	g_return_val_if_fail(PURPLE_IS_CONTACT_INFO(info), NULL);
 
-	if(purple_conversation_has_member(conversation, info, &position)) {
-		PurpleConversationPrivate *priv = NULL;
-
-		priv = purple_conversation_get_instance_private(conversation);
-
-		member = g_list_model_get_item(G_LIST_MODEL(priv->members), position);
-
-		/* We don't return a reference, but get_item does, so we need to get
-		 * rid of that.
-		 */
-		g_object_unref(member);
-	}
+	priv = purple_conversation_get_instance_private(conversation);
 
-	return member;
+	return purple_conversation_members_lookup(priv->members, info);
 }
 
 PurpleConversationMember *
@@ -1585,19 +1969,24 @@ purple_conversation_add_member(PurpleConversation *conversation,
 {
 	PurpleConversationMember *member = NULL;
 	PurpleConversationPrivate *priv = NULL;
+	GPtrArray *added = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), NULL);
 	g_return_val_if_fail(PURPLE_IS_CONTACT_INFO(info), NULL);
 
 	priv = purple_conversation_get_instance_private(conversation);
 
-	member = purple_conversation_find_member(conversation, info);
+	member = purple_conversation_members_lookup(priv->members, info);
 	if(PURPLE_IS_CONVERSATION_MEMBER(member)) {
 		return member;
 	}
 
 	member = purple_conversation_member_new(info);
-	g_list_store_append(priv->members, member);
+
+	added = g_ptr_array_new();
+	g_ptr_array_add(added, member);
+	purple_conversation_members_append(priv->members, added);
+	g_ptr_array_free(added, TRUE);
 
 	g_signal_emit(conversation, signals[SIG_MEMBER_ADDED], 0, member, announce,
 	              message);
@@ -1607,20 +1996,70 @@ purple_conversation_add_member(PurpleConversation *conversation,
 	return member;
 }
 
+void
+purple_conversation_add_members(PurpleConversation *conversation,
+                                GPtrArray *infos, gboolean announce,
+                                const char *message)
+{
+	PurpleConversationPrivate *priv = NULL;
+	GPtrArray *added = NULL;
+	GHashTable *seen = NULL;
+
+	g_return_if_fail(PURPLE_IS_CONVERSATION(conversation));
+	g_return_if_fail(infos != NULL);
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	added = g_ptr_array_new_full(infos->len, g_object_unref);
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	for(guint i = 0; i < infos->len; i++) {
+		PurpleContactInfo *info = g_ptr_array_index(infos, i);
+		PurpleConversationMember *member = NULL;
+
+		if(!PURPLE_IS_CONTACT_INFO(info)) {
+			g_warning("purple_conversation_add_members: ignoring an item "
+			          "that is not a PurpleContactInfo");
+			continue;
+		}
+
+		if(purple_conversation_members_lookup(priv->members, info) != NULL ||
+		   g_hash_table_contains(seen, info))
+		{
+			continue;
+		}
+
+		g_hash_table_add(seen, info);
+		member = purple_conversation_member_new(info);
+		g_ptr_array_add(added, member);
+	}
+
+	purple_conversation_members_append(priv->members, added);
+
+	for(guint i = 0; i < added->len; i++) {
+		g_signal_emit(conversation, signals[SIG_MEMBER_ADDED], 0,
+		              g_ptr_array_index(added, i), announce, message);
+	}
+
+	g_hash_table_destroy(seen);
+
+	g_ptr_array_free(added, TRUE);
+}
+
 gboolean
 purple_conversation_remove_member(PurpleConversation *conversation,
                                   PurpleConversationMember *member,
                                   gboolean announce, const char *message)
 {
 	PurpleConversationPrivate *priv = NULL;
-	guint position = 0;
+	GPtrArray *doomed = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MEMBER(member), FALSE);
 
 	priv = purple_conversation_get_instance_private(conversation);
 
-	if(!g_list_store_find(priv->members, member, &position)) {
+	if(!purple_conversation_is_member(priv, member)) {
 		return FALSE;
 	}
 
@@ -1629,7 +2068,10 @@ purple_conversation_remove_member(PurpleConversation *conversation,
 	 */
 	g_object_ref(member);
 
-	g_list_store_remove(priv->members, position);
+	doomed = g_ptr_array_new();
+	g_ptr_array_add(doomed, member);
+	purple_conversation_members_remove(priv->members, doomed);
+	g_ptr_array_free(doomed, TRUE);
 
 	g_signal_emit(conversation, signals[SIG_MEMBER_REMOVED], 0, member,
 	              announce, message);
@@ -1639,6 +2081,52 @@ purple_conversation_remove_member(PurpleConversation *conversation,
 	return TRUE;
 }
 
+guint
+purple_conversation_remove_members(PurpleConversation *conversation,
+                                   GPtrArray *members, gboolean announce,
+                                   const char *message)
+{
+	PurpleConversationPrivate *priv = NULL;
+	GHashTable *seen = NULL;
+	GPtrArray *removed = NULL;
+	guint n_removed = 0;
+
+	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), 0);
+	g_return_val_if_fail(members != NULL, 0);
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	removed = g_ptr_array_new_full(members->len, g_object_unref);
+
+	for(guint i = 0; i < members->len; i++) {
+		PurpleConversationMember *member = g_ptr_array_index(members, i);
+
+		if(PURPLE_IS_CONVERSATION_MEMBER(member) &&
+		   purple_conversation_is_member(priv, member) &&
+		   g_hash_table_add(seen, member))
+		{
+			/* Keep the member around long enough to emit the signal. */
+			g_ptr_array_add(removed, g_object_ref(member));
+		}
+	}
+
+	/* This emits items-changed once for each run of adjacent members. */
+	purple_conversation_members_remove(priv->members, removed);
+
+	for(guint i = 0; i < removed->len; i++) {
+		g_signal_emit(conversation, signals[SIG_MEMBER_REMOVED], 0,
+		              g_ptr_array_index(removed, i), announce, message);
+	}
+
+	n_removed = removed->len;
+
+	g_ptr_array_free(removed, TRUE);
+	g_hash_table_destroy(seen);
+
+	return n_removed;
+}
+
 GListModel *
 purple_conversation_get_messages(PurpleConversation *conversation) {
 	PurpleConversationPrivate *priv = NULL;
@@ -1653,3 +2141,180 @@ purple_conversation_get_messages(PurpleConversation *conversation) {
 
 	return NULL;
 }
+
+guint
+purple_conversation_get_message_limit(PurpleConversation *conversation) {
+	PurpleConversationPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), 0);
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	return priv->message_limit;
+}
+
+void
+purple_conversation_set_message_limit(PurpleConversation *conversation,
+                                      guint limit)
+{
+	PurpleConversationPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_CONVERSATION(conversation));
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	if(priv->message_limit != limit) {
+		priv->message_limit = limit;
+
+		purple_conversation_trim_messages(conversation);
+
+		g_object_notify_by_pspec(G_OBJECT(conversation),
+		                         properties[PROP_MESSAGE_LIMIT]);
+	}
+}
+
+guint64
+purple_conversation_get_message_size_limit(PurpleConversation *conversation) {
+	PurpleConversationPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), 0);
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	return priv->message_size_limit;
+}
+
+void
+purple_conversation_set_message_size_limit(PurpleConversation *conversation,
+                                           guint64 limit)
+{
+	PurpleConversationPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_CONVERSATION(conversation));
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	if(priv->message_size_limit != limit) {
+		priv->message_size_limit = limit;
+
+		purple_conversation_trim_messages(conversation);
+
+		g_object_notify_by_pspec(G_OBJECT(conversation),
+		                         properties[PROP_MESSAGE_SIZE_LIMIT]);
+	}
+}
+
+guint
+purple_conversation_load_older_messages(PurpleConversation *conversation,
+                                        guint count, GError **error)
+{
+	PurpleConversationPrivate *priv = NULL;
+	PurpleAccount *account = NULL;
+	PurpleHistoryCursor *cursor = NULL;
+	PurpleHistoryManager *manager = NULL;
+	PurpleMessage *message = NULL;
+	GError *local_error = NULL;
+	GListModel *model = NULL;
+	GPtrArray *loaded = NULL;
+	GString *query = NULL;
+	char *anchor = NULL;
+	guint64 size = 0;
+	guint n_items = 0;
+	guint n_loaded = 0;
+
+	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), 0);
+	g_return_val_if_fail(count > 0, 0);
+
+	priv = purple_conversation_get_instance_private(conversation);
+	g_return_val_if_fail(PURPLE_IS_ACCOUNT(priv->account), 0);
+
+	/* Don't let paging back grow the list without a limit either. */
+	if(priv->message_limit != 0) {
+		if(priv->n_older_messages >= priv->message_limit) {
+			return 0;
+		}
+
+		count = MIN(count, priv->message_limit - priv->n_older_messages);
+	}
+
+	model = G_LIST_MODEL(priv->messages);
+
+	/* Page backwards from the oldest message we have that was logged. If we
+	 * don't have any, we'll get the most recent messages instead.
+	 */
+	n_items = g_list_model_get_n_items(model);
+	for(guint i = 0; i < n_items && anchor == NULL; i++) {
+		message = g_list_model_get_item(model, i);
+
+		if(!(purple_message_get_flags(message) & PURPLE_MESSAGE_NO_LOG)) {
+			anchor = g_strdup(purple_message_get_id(message));
+		}
+
+		g_clear_object(&message);
+	}
+
+	/* Conversations with the same name on other accounts are different
+	 * conversations.
+	 */
+	account = priv->account;
+	query = g_string_new(NULL);
+	purple_conversation_append_query_term(query, "in", priv->name);
+	purple_conversation_append_query_term(query, "account",
+	                                      purple_contact_info_get_username(PURPLE_CONTACT_INFO(account)));
+	purple_conversation_append_query_term(query, "protocol",
+	                                      purple_account_get_protocol_name(account));
+	manager = purple_history_manager_get_default();
+	cursor = purple_history_manager_query_cursor(manager, query->str, anchor,
+	                                             count, error);
+	g_string_free(query, TRUE);
+	g_free(anchor);
+
+	if(cursor == NULL) {
+		return 0;
+	}
+
+	loaded = g_ptr_array_new_full(count, g_object_unref);
+	while((message = purple_history_cursor_next(cursor, &local_error)) != NULL) {
+		size += purple_conversation_message_size(message);
+		g_ptr_array_add(loaded, message);
+	}
+	g_object_unref(cursor);
+
+	if(local_error != NULL) {
+		g_propagate_error(error, local_error);
+		g_ptr_array_unref(loaded);
+
+		return 0;
+	}
+
+	/* The cursor returns the messages oldest first, so they can be inserted
+	 * at the front as is.
+	 */
+	n_loaded = loaded->len;
+	if(n_loaded > 0) {
+		g_list_store_splice(priv->messages, 0, 0, loaded->pdata, n_loaded);
+		priv->messages_size += size;
+		priv->n_older_messages += n_loaded;
+		priv->older_messages_size += size;
+	}
+
+	g_ptr_array_unref(loaded);
+
+	return n_loaded;
+}
+
+void
+purple_conversation_release_older_messages(PurpleConversation *conversation) {
+	PurpleConversationPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_CONVERSATION(conversation));
+
+	priv = purple_conversation_get_instance_private(conversation);
+
+	if(priv->n_older_messages > 0) {
+		priv->n_older_messages = 0;
+		priv->older_messages_size = 0;
+
+		purple_conversation_trim_messages(conversation);
+	}
+}
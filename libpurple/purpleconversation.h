@@ -664,6 +664,30 @@ PurpleConversationMember *purple_conversation_find_member(PurpleConversation *co
  */
 PurpleConversationMember *purple_conversation_add_member(PurpleConversation *conversation, PurpleContactInfo *info, gboolean announce, const char *message);
 
+/**
+ * purple_conversation_add_members:
+ * @conversation: The instance.
+ * @infos: (element-type PurpleContactInfo) (transfer none): The
+ *         [class@Purple.ContactInfo]'s of the people joining.
+ * @announce: Whether these additions should be announced or not.
+ * @message: (nullable): An optional message to be used with @announce.
+ *
+ * Adds a [class@Purple.ConversationMember] for each item in @infos that is not
+ * already a member of @conversation. This is the bulk version of
+ * [method@Purple.Conversation.add_member] and is meant for things like the
+ * initial member list when joining a channel.
+ *
+ * [signal@GIO.ListModel::items-changed] is only emitted once on
+ * [property@Purple.Conversation:members], after which
+ * [signal@Purple.Conversation::member-added] is emitted for each new member.
+ *
+ * > This method is intended to be called by a protocol plugin to directly
+ * > manage the membership state of the @conversation.
+ *
+ * Since: 3.0.0
+ */
+void purple_conversation_add_members(PurpleConversation *conversation, GPtrArray *infos, gboolean announce, const char *message);
+
 /**
  * purple_conversation_remove_member:
  * @conversation: The instance.
@@ -686,11 +710,42 @@ PurpleConversationMember *purple_conversation_add_member(PurpleConversation *con
  */
 gboolean purple_conversation_remove_member(PurpleConversation *conversation, PurpleConversationMember *member, gboolean announce, const char *message);
 
+/**
+ * purple_conversation_remove_members:
+ * @conversation: The instance.
+ * @members: (element-type PurpleConversationMember) (transfer none): The
+ *           members to remove.
+ * @announce: Whether or not these removals should be announced.
+ * @message: (nullable): An optional message for the announcements.
+ *
+ * Removes every member in @members that is in @conversation. This is the bulk
+ * version of [method@Purple.Conversation.remove_member] and is meant for
+ * things like a netsplit where a lot of members leave at once.
+ *
+ * [signal@GIO.ListModel::items-changed] is emitted once on
+ * [property@Purple.Conversation:members] for each run of members that were
+ * next to each other, after which [signal@Purple.Conversation::member-removed]
+ * is emitted for each member that was removed.
+ *
+ * > This method is intended to be called by a protocol plugin to directly
+ * > manage the membership state of the @conversation.
+ *
+ * Returns: The number of members that were removed.
+ *
+ * Since: 3.0.0
+ */
+guint purple_conversation_remove_members(PurpleConversation *conversation, GPtrArray *members, gboolean announce, const char *message);
+
 /**
  * purple_conversation_get_messages:
  * @conversation: The instance.
  *
- * Gets the list of all messages in @conversation.
+ * Gets the list of messages in @conversation that are currently in memory.
+ *
+ * Older messages are removed from the list as new ones arrive according to
+ * [property@Conversation:message-limit] and
+ * [property@Conversation:message-size-limit]. Use
+ * [method@Conversation.load_older_messages] to get them back.
  *
  * Returns: (transfer none): The list of messages.
  *
@@ -698,6 +753,100 @@ gboolean purple_conversation_remove_member(PurpleConversation *conversation, Pur
  */
 GListModel *purple_conversation_get_messages(PurpleConversation *conversation);
 
+/**
+ * purple_conversation_get_message_limit:
+ * @conversation: The instance.
+ *
+ * Gets the maximum number of messages that @conversation keeps in memory.
+ *
+ * Returns: The maximum number of messages, or 0 for no limit.
+ *
+ * Since: 3.0.0
+ */
+guint purple_conversation_get_message_limit(PurpleConversation *conversation);
+
+/**
+ * purple_conversation_set_message_limit:
+ * @conversation: The instance.
+ * @limit: The maximum number of messages, or 0 for no limit.
+ *
+ * Sets the maximum number of messages that @conversation keeps in memory. If
+ * there are currently more messages than @limit, the oldest ones are removed
+ * right away.
+ *
+ * Since: 3.0.0
+ */
+void purple_conversation_set_message_limit(PurpleConversation *conversation, guint limit);
+
+/**
+ * purple_conversation_get_message_size_limit:
+ * @conversation: The instance.
+ *
+ * Gets the maximum number of bytes of message contents that @conversation
+ * keeps in memory.
+ *
+ * Returns: The maximum number of bytes, or 0 for no limit.
+ *
+ * Since: 3.0.0
+ */
+guint64 purple_conversation_get_message_size_limit(PurpleConversation *conversation);
+
+/**
+ * purple_conversation_set_message_size_limit:
+ * @conversation: The instance.
+ * @limit: The maximum number of bytes, or 0 for no limit.
+ *
+ * Sets the maximum number of bytes of message contents that @conversation
+ * keeps in memory. If the current messages are larger than @limit, the oldest
+ * ones are removed right away. The newest message is always kept.
+ *
+ * Since: 3.0.0
+ */
+void purple_conversation_set_message_size_limit(PurpleConversation *conversation, guint64 limit);
+
+/**
+ * purple_conversation_load_older_messages:
+ * @conversation: The instance.
+ * @count: The maximum number of messages to load.
+ * @error: Return address for a #GError, or %NULL.
+ *
+ * Loads up to @count messages that are older than the oldest message in
+ * [property@Conversation:messages] from the default
+ * [class@Purple.HistoryManager] and adds them to the front of the list.
+ *
+ * This is meant to be called by user interfaces when the user scrolls back
+ * past the messages that are in memory. Only messages that were logged by the
+ * account of @conversation are loaded.
+ *
+ * Loaded messages don't count against the limits of @conversation, but at
+ * most [property@Conversation:message-limit] of them are kept at a time and
+ * new messages still push out the oldest ones. Call
+ * [method@Conversation.release_older_messages] once they are no longer being
+ * shown.
+ *
+ * Returns: The number of messages that were loaded, which will be 0 if there
+ *          are no older messages, if as many as can be kept are already
+ *          loaded, or on error with @error set.
+ *
+ * Since: 3.0.0
+ */
+guint purple_conversation_load_older_messages(PurpleConversation *conversation, guint count, GError **error);
+
+/**
+ * purple_conversation_release_older_messages:
+ * @conversation: The instance.
+ *
+ * Lets the messages that were added by
+ * [method@Conversation.load_older_messages] be removed again. Any messages
+ * over the limits of @conversation are removed right away.
+ *
+ * This is meant to be called by user interfaces when the user has scrolled
+ * back to the newest messages.
+ *
+ * Since: 3.0.0
+ */
+void purple_conversation_release_older_messages(PurpleConversation *conversation);
+
 G_END_DECLS
 
 #endif /* PURPLE_CONVERSATION_H */
@@ -34,8 +34,30 @@ struct _PurpleConversationManager {
 	GObject parent;
 
 	GHashTable *conversations;
+	GHashTable *indexes;
 };
 
+/* The values a conversation was indexed with. We keep these around so that we
+ * can find the conversation in the indexes after those values have changed.
+ */
+typedef struct {
+	PurpleAccount *account;
+	char *name;
+	char *id;
+	gint chat_id;
+	gboolean is_chat;
+} PurpleConversationManagerKeys;
+
+/* The indexes for a single account. Each of these maps a key to a GPtrArray
+ * of the conversations with that key, as nothing stops two conversations from
+ * sharing a name.
+ */
+typedef struct {
+	GHashTable *names;
+	GHashTable *chat_ids;
+	GHashTable *ids;
+} PurpleConversationManagerIndex;
+
 static PurpleConversationManager *default_manager = NULL;
 
 G_DEFINE_TYPE(PurpleConversationManager, purple_conversation_manager,
@@ -60,64 +82,191 @@ purple_conversation_is_chat(PurpleConversation *conversation,
 	return PURPLE_IS_CHAT_CONVERSATION(conversation);
 }
 
-static gboolean
-purple_conversation_chat_has_id(PurpleConversation *conversation,
-                                gpointer userdata)
+static void
+purple_conversation_manager_keys_free(gpointer data) {
+	PurpleConversationManagerKeys *keys = data;
+
+	g_clear_object(&keys->account);
+	g_free(keys->name);
+	g_free(keys->id);
+
+	g_free(keys);
+}
+
+static PurpleConversationManagerIndex *
+purple_conversation_manager_index_new(void) {
+	PurpleConversationManagerIndex *index = NULL;
+
+	index = g_new0(PurpleConversationManagerIndex, 1);
+	index->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                     (GDestroyNotify)g_ptr_array_unref);
+	index->chat_ids = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                        NULL,
+	                                        (GDestroyNotify)g_ptr_array_unref);
+	index->ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                   (GDestroyNotify)g_ptr_array_unref);
+
+	return index;
+}
+
+static void
+purple_conversation_manager_index_free(gpointer data) {
+	PurpleConversationManagerIndex *index = data;
+
+	g_clear_pointer(&index->names, g_hash_table_destroy);
+	g_clear_pointer(&index->chat_ids, g_hash_table_destroy);
+	g_clear_pointer(&index->ids, g_hash_table_destroy);
+
+	g_free(index);
+}
+
+/* Adds conversation to the bucket for key in table. copy is used to make a
+ * copy of key if a new bucket needs to be created.
+ */
+static void
+purple_conversation_manager_bucket_add(GHashTable *table, gpointer key,
+                                       GBoxedCopyFunc copy,
+                                       PurpleConversation *conversation)
 {
-	PurpleChatConversation *chat = NULL;
-	gint id = GPOINTER_TO_INT(userdata);
+	GPtrArray *bucket = g_hash_table_lookup(table, key);
+
+	if(bucket == NULL) {
+		bucket = g_ptr_array_new();
+		g_hash_table_insert(table, copy != NULL ? copy(key) : key, bucket);
+	}
+
+	g_ptr_array_add(bucket, conversation);
+}
 
+static void
+purple_conversation_manager_bucket_remove(GHashTable *table, gpointer key,
+                                          PurpleConversation *conversation)
+{
+	GPtrArray *bucket = g_hash_table_lookup(table, key);
 
-	if(!PURPLE_IS_CHAT_CONVERSATION(conversation)) {
-		return FALSE;
+	if(bucket == NULL) {
+		return;
 	}
 
-	chat = PURPLE_CHAT_CONVERSATION(conversation);
+	g_ptr_array_remove(bucket, conversation);
+	if(bucket->len == 0) {
+		g_hash_table_remove(table, key);
+	}
+}
 
-	return (purple_chat_conversation_get_id(chat) == id);
+static void
+purple_conversation_manager_index_conversation(PurpleConversationManager *manager,
+                                               PurpleConversation *conversation,
+                                               PurpleConversationManagerKeys *keys)
+{
+	PurpleConversationManagerIndex *index = NULL;
+	PurpleAccount *account = NULL;
+
+	account = purple_conversation_get_account(conversation);
+	if(!PURPLE_IS_ACCOUNT(account)) {
+		return;
+	}
+
+	index = g_hash_table_lookup(manager->indexes, account);
+	if(index == NULL) {
+		index = purple_conversation_manager_index_new();
+		g_hash_table_insert(manager->indexes, g_object_ref(account), index);
+	}
+
+	keys->account = g_object_ref(account);
+	keys->name = g_strdup(purple_conversation_get_name(conversation));
+	keys->id = g_strdup(purple_conversation_get_id(conversation));
+	keys->is_chat = PURPLE_IS_CHAT_CONVERSATION(conversation);
+
+	if(keys->name != NULL) {
+		purple_conversation_manager_bucket_add(index->names, keys->name,
+		                                       (GBoxedCopyFunc)g_strdup,
+		                                       conversation);
+	}
+
+	if(keys->id != NULL) {
+		purple_conversation_manager_bucket_add(index->ids, keys->id,
+		                                       (GBoxedCopyFunc)g_strdup,
+		                                       conversation);
+	}
+
+	if(keys->is_chat) {
+		PurpleChatConversation *chat = PURPLE_CHAT_CONVERSATION(conversation);
+
+		keys->chat_id = purple_chat_conversation_get_id(chat);
+		purple_conversation_manager_bucket_add(index->chat_ids,
+		                                       GINT_TO_POINTER(keys->chat_id),
+		                                       NULL, conversation);
+	}
 }
 
-static gboolean
-purple_conversation_has_id(PurpleConversation *conversation, gpointer data) {
-	const char *needle = data;
-	const char *haystack = NULL;
+static void
+purple_conversation_manager_unindex_conversation(PurpleConversationManager *manager,
+                                                 PurpleConversation *conversation,
+                                                 PurpleConversationManagerKeys *keys)
+{
+	PurpleConversationManagerIndex *index = NULL;
 
-	if(!PURPLE_IS_CONVERSATION(conversation)) {
-		return FALSE;
+	if(keys->account == NULL) {
+		return;
 	}
 
-	haystack = purple_conversation_get_id(conversation);
+	index = g_hash_table_lookup(manager->indexes, keys->account);
+	if(index != NULL) {
+		if(keys->name != NULL) {
+			purple_conversation_manager_bucket_remove(index->names, keys->name,
+			                                          conversation);
+		}
 
-	return purple_strequal(needle, haystack);
+		if(keys->id != NULL) {
+			purple_conversation_manager_bucket_remove(index->ids, keys->id,
+			                                          conversation);
+		}
+
+		if(keys->is_chat) {
+			purple_conversation_manager_bucket_remove(index->chat_ids,
+			                                          GINT_TO_POINTER(keys->chat_id),
+			                                          conversation);
+		}
+	}
+
+	g_clear_object(&keys->account);
+	g_clear_pointer(&keys->name, g_free);
+	g_clear_pointer(&keys->id, g_free);
+	keys->chat_id = 0;
+	keys->is_chat = FALSE;
 }
 
+/* Looks up the bucket for key in the table at table_offset in the index for
+ * account and returns the first conversation in it that func accepts.
+ */
 static PurpleConversation *
 purple_conversation_manager_find_internal(PurpleConversationManager *manager,
                                           PurpleAccount *account,
-                                          const gchar *name,
+                                          gsize table_offset,
+                                          gconstpointer key,
                                           PurpleConversationManagerCompareFunc func,
                                           gpointer userdata)
 {
-	GHashTableIter iter;
-	gpointer key;
+	PurpleConversationManagerIndex *index = NULL;
+	GHashTable *table = NULL;
+	GPtrArray *bucket = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
-	g_hash_table_iter_init(&iter, manager->conversations);
-	while(g_hash_table_iter_next(&iter, &key, NULL)) {
-		PurpleConversation *conversation = PURPLE_CONVERSATION(key);
-
-		if(name != NULL) {
-			const gchar *conv_name = purple_conversation_get_name(conversation);
+	index = g_hash_table_lookup(manager->indexes, account);
+	if(index == NULL) {
+		return NULL;
+	}
 
-			if(!purple_strequal(conv_name, name)) {
-				continue;
-			}
-		}
+	table = G_STRUCT_MEMBER(GHashTable *, index, table_offset);
+	bucket = g_hash_table_lookup(table, key);
+	if(bucket == NULL) {
+		return NULL;
+	}
 
-		if(purple_conversation_get_account(conversation) != account) {
-			continue;
-		}
+	for(guint i = 0; i < bucket->len; i++) {
+		PurpleConversation *conversation = g_ptr_array_index(bucket, i);
 
 		if(func != NULL && !func(conversation, userdata)) {
 			continue;
@@ -139,6 +288,29 @@ purple_conversation_manager_conversation_changed_cb(GObject *source,
                                                     GParamSpec *pspec,
                                                     gpointer data)
 {
+	PurpleConversationManager *manager = data;
+	const char *name = g_param_spec_get_name(pspec);
+
+	/* Update the indexes before anyone else hears about the change so that
+	 * lookups from their handlers find the conversation.
+	 */
+	if(purple_strequal(name, "account") || purple_strequal(name, "name") ||
+	   purple_strequal(name, "id") || purple_strequal(name, "chat-id"))
+	{
+		PurpleConversation *conversation = PURPLE_CONVERSATION(source);
+		PurpleConversationManagerKeys *keys = NULL;
+
+		keys = g_hash_table_lookup(manager->conversations, conversation);
+		if(keys != NULL) {
+			purple_conversation_manager_unindex_conversation(manager,
+			                                                 conversation,
+			                                                 keys);
+			purple_conversation_manager_index_conversation(manager,
+			                                               conversation,
+			                                               keys);
+		}
+	}
+
 	g_signal_emit(data, signals[SIG_CONVERSATION_CHANGED],
 	              g_param_spec_get_name_quark(pspec),
 	              source, pspec);
@@ -151,13 +323,18 @@ static void
 purple_conversation_manager_init(PurpleConversationManager *manager) {
 	manager->conversations = g_hash_table_new_full(g_direct_hash,
 	                                               g_direct_equal,
-	                                               g_object_unref, NULL);
+	                                               g_object_unref,
+	                                               purple_conversation_manager_keys_free);
+	manager->indexes = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                         g_object_unref,
+	                                         purple_conversation_manager_index_free);
 }
 
 static void
 purple_conversation_manager_finalize(GObject *obj) {
 	PurpleConversationManager *manager = PURPLE_CONVERSATION_MANAGER(obj);
 
+	g_hash_table_destroy(manager->indexes);
 	g_hash_table_destroy(manager->conversations);
 
 	G_OBJECT_CLASS(purple_conversation_manager_parent_class)->finalize(obj);
@@ -268,19 +445,21 @@ gboolean
 purple_conversation_manager_register(PurpleConversationManager *manager,
                                      PurpleConversation *conversation)
 {
+	PurpleConversationManagerKeys *keys = NULL;
 	gboolean registered = FALSE;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 
-	/* g_hash_table_add calls the key_destroy_func if the key already exists
-	 * which means we don't need to worry about the reference we're creating
-	 * during the addition.
-	 */
-	registered = g_hash_table_add(manager->conversations,
-	                              g_object_ref(conversation));
+	registered = !g_hash_table_contains(manager->conversations, conversation);
 
 	if(registered) {
+		keys = g_new0(PurpleConversationManagerKeys, 1);
+		g_hash_table_insert(manager->conversations, g_object_ref(conversation),
+		                    keys);
+		purple_conversation_manager_index_conversation(manager, conversation,
+		                                               keys);
+
 		/* Register our signals that need to be propagated. */
 		g_signal_connect_object(conversation, "notify",
 		                        G_CALLBACK(purple_conversation_manager_conversation_changed_cb),
@@ -297,11 +476,18 @@ gboolean
 purple_conversation_manager_unregister(PurpleConversationManager *manager,
                                        PurpleConversation *conversation)
 {
+	PurpleConversationManagerKeys *keys = NULL;
 	gboolean unregistered = FALSE;
 
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 
+	keys = g_hash_table_lookup(manager->conversations, conversation);
+	if(keys != NULL) {
+		purple_conversation_manager_unindex_conversation(manager, conversation,
+		                                                 keys);
+	}
+
 	unregistered = g_hash_table_remove(manager->conversations, conversation);
 	if(unregistered) {
 		/* Disconnect all the signals we added for propagation. */
@@ -359,8 +545,9 @@ purple_conversation_manager_find(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, name,
-	                                                 NULL, NULL);
+	return purple_conversation_manager_find_internal(manager, account,
+	                                                 G_STRUCT_OFFSET(PurpleConversationManagerIndex, names),
+	                                                 name, NULL, NULL);
 }
 
 PurpleConversation *
@@ -371,7 +558,9 @@ purple_conversation_manager_find_im(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, name,
+	return purple_conversation_manager_find_internal(manager, account,
+	                                                 G_STRUCT_OFFSET(PurpleConversationManagerIndex, names),
+	                                                 name,
 	                                                 purple_conversation_is_im,
 	                                                 NULL);
 }
@@ -385,7 +574,9 @@ purple_conversation_manager_find_chat(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, name,
+	return purple_conversation_manager_find_internal(manager, account,
+	                                                 G_STRUCT_OFFSET(PurpleConversationManagerIndex, names),
+	                                                 name,
 	                                                 purple_conversation_is_chat,
 	                                                 NULL);
 }
@@ -397,9 +588,10 @@ purple_conversation_manager_find_chat_by_id(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, NULL,
-	                                                 purple_conversation_chat_has_id,
-	                                                 GINT_TO_POINTER(id));
+	return purple_conversation_manager_find_internal(manager, account,
+	                                                 G_STRUCT_OFFSET(PurpleConversationManagerIndex, chat_ids),
+	                                                 GINT_TO_POINTER(id),
+	                                                 NULL, NULL);
 }
 
 PurpleConversation *
@@ -410,7 +602,11 @@ purple_conversation_manager_find_with_id(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, NULL,
-	                                                 purple_conversation_has_id,
-	                                                 (gpointer)id);
+	if(id == NULL) {
+		return NULL;
+	}
+
+	return purple_conversation_manager_find_internal(manager, account,
+	                                                 G_STRUCT_OFFSET(PurpleConversationManagerIndex, ids),
+	                                                 id, NULL, NULL);
 }
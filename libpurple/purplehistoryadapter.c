@@ -19,6 +19,7 @@
 #include "purplehistoryadapter.h"
 
 #include "purpleprivate.h"
+#include "util.h"
 
 typedef struct {
 	gchar *id;
@@ -255,6 +256,75 @@ purple_history_adapter_query(PurpleHistoryAdapter *adapter,
 	return NULL;
 }
 
+PurpleHistoryCursor *
+purple_history_adapter_query_cursor(PurpleHistoryAdapter *adapter,
+                                    const gchar *query, const gchar *before,
+                                    guint limit, GError **error)
+{
+	PurpleHistoryAdapterClass *klass = NULL;
+	GError *local_error = NULL;
+	GList *results = NULL;
+	GList *link = NULL;
+	guint length = 0;
+
+	g_return_val_if_fail(PURPLE_IS_HISTORY_ADAPTER(adapter), NULL);
+	g_return_val_if_fail(query != NULL, NULL);
+
+	klass = PURPLE_HISTORY_ADAPTER_GET_CLASS(adapter);
+	if(klass != NULL && klass->query_cursor != NULL) {
+		return klass->query_cursor(adapter, query, before, limit, error);
+	}
+
+	/* Fallback to the query function and do the paging ourselves. */
+	results = purple_history_adapter_query(adapter, query, &local_error);
+	if(local_error != NULL) {
+		g_propagate_error(error, local_error);
+		g_list_free_full(results, g_object_unref);
+
+		return NULL;
+	}
+
+	if(before != NULL) {
+		for(link = results; link != NULL; link = link->next) {
+			PurpleMessage *message = link->data;
+
+			if(purple_strequal(purple_message_get_id(message), before)) {
+				break;
+			}
+		}
+
+		if(link == NULL) {
+			g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+			            "message %s was not found", before);
+			g_list_free_full(results, g_object_unref);
+
+			return NULL;
+		}
+
+		/* Drop the message we were given and everything after it. */
+		if(link->prev != NULL) {
+			link->prev->next = NULL;
+			link->prev = NULL;
+		} else {
+			results = NULL;
+		}
+		g_list_free_full(link, g_object_unref);
+	}
+
+	length = g_list_length(results);
+	if(limit > 0 && length > limit) {
+		link = g_list_nth(results, length - limit);
+
+		link->prev->next = NULL;
+		link->prev = NULL;
+		g_list_free_full(results, g_object_unref);
+
+		results = link;
+	}
+
+	return purple_history_cursor_new_from_list(results);
+}
+
 gboolean
 purple_history_adapter_remove(PurpleHistoryAdapter *adapter,
                               const gchar *query,
@@ -28,6 +28,7 @@
 
 #include <purplemessage.h>
 #include <purpleconversation.h>
+#include <purplehistorycursor.h>
 
 G_BEGIN_DECLS
 
@@ -72,6 +73,7 @@ struct _PurpleHistoryAdapterClass {
 	GList* (*query)(PurpleHistoryAdapter *adapter, const gchar *query, GError **error);
 	gboolean (*remove)(PurpleHistoryAdapter *adapter, const gchar *query, GError **error);
 	gboolean (*write)(PurpleHistoryAdapter *adapter, PurpleConversation *conversation, PurpleMessage *message, GError **error);
+	PurpleHistoryCursor *(*query_cursor)(PurpleHistoryAdapter *adapter, const gchar *query, const gchar *before, guint limit, GError **error);
 
 	/*< private >*/
 
@@ -137,6 +139,38 @@ GList *purple_history_adapter_query(PurpleHistoryAdapter *adapter,
                                     const gchar *query,
                                     GError **error);
 
+/**
+ * purple_history_adapter_query_cursor:
+ * @adapter: The #PurpleHistoryAdapter instance.
+ * @query: The query to send to the @adapter.
+ * @before: (nullable): The id of a message to page backwards from.
+ * @limit: The maximum number of messages to return, or 0 for no limit.
+ * @error: A return address for a #GError.
+ *
+ * Runs @query against @adapter like purple_history_adapter_query() but
+ * returns a cursor that loads the matching messages as they are requested
+ * instead of all at once.
+ *
+ * If @before is set, only messages that were written before the message with
+ * that id are returned. Message ids are only unique within a conversation, so
+ * that message is looked for in the conversations, accounts, and protocols
+ * that @query is restricted to. If @limit is non-zero, at most @limit messages are
+ * returned and, unless @query contains keywords, they will be the @limit
+ * messages closest to @before. Together they allow paging backwards through a
+ * conversation with "in:conversation" as the query.
+ *
+ * Messages are returned in the same order as purple_history_adapter_query().
+ *
+ * Adapters that do not implement the query_cursor virtual function fall back
+ * to running purple_history_adapter_query() and walking its results.
+ *
+ * Returns: (transfer full): A cursor for the matching messages or %NULL with
+ *          @error set.
+ *
+ * Since: 3.0.0
+ */
+PurpleHistoryCursor *purple_history_adapter_query_cursor(PurpleHistoryAdapter *adapter, const gchar *query, const gchar *before, guint limit, GError **error);
+
 /**
  * purple_history_adapter_remove:
  * @adapter: The #PurpleHistoryAdapter instance.
@@ -0,0 +1,106 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "purplehistorycursor.h"
+
+typedef struct {
+	GList *messages;
+} PurpleHistoryCursorPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE(PurpleHistoryCursor, purple_history_cursor,
+                           G_TYPE_OBJECT)
+
+/******************************************************************************
+ * PurpleHistoryCursor Implementation
+ *****************************************************************************/
+static PurpleMessage *
+purple_history_cursor_real_next(PurpleHistoryCursor *cursor,
+                                G_GNUC_UNUSED GError **error)
+{
+	PurpleHistoryCursorPrivate *priv = NULL;
+	PurpleMessage *message = NULL;
+
+	priv = purple_history_cursor_get_instance_private(cursor);
+
+	if(priv->messages == NULL) {
+		return NULL;
+	}
+
+	message = priv->messages->data;
+	priv->messages = g_list_delete_link(priv->messages, priv->messages);
+
+	return message;
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+static void
+purple_history_cursor_finalize(GObject *obj) {
+	PurpleHistoryCursor *cursor = PURPLE_HISTORY_CURSOR(obj);
+	PurpleHistoryCursorPrivate *priv = NULL;
+
+	priv = purple_history_cursor_get_instance_private(cursor);
+
+	g_list_free_full(priv->messages, g_object_unref);
+
+	G_OBJECT_CLASS(purple_history_cursor_parent_class)->finalize(obj);
+}
+
+static void
+purple_history_cursor_init(G_GNUC_UNUSED PurpleHistoryCursor *cursor) {
+}
+
+static void
+purple_history_cursor_class_init(PurpleHistoryCursorClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->finalize = purple_history_cursor_finalize;
+
+	klass->next = purple_history_cursor_real_next;
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PurpleHistoryCursor *
+purple_history_cursor_new_from_list(GList *messages) {
+	PurpleHistoryCursor *cursor = NULL;
+	PurpleHistoryCursorPrivate *priv = NULL;
+
+	cursor = g_object_new(PURPLE_TYPE_HISTORY_CURSOR, NULL);
+	priv = purple_history_cursor_get_instance_private(cursor);
+
+	priv->messages = messages;
+
+	return cursor;
+}
+
+PurpleMessage *
+purple_history_cursor_next(PurpleHistoryCursor *cursor, GError **error) {
+	PurpleHistoryCursorClass *klass = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_HISTORY_CURSOR(cursor), NULL);
+
+	klass = PURPLE_HISTORY_CURSOR_GET_CLASS(cursor);
+	if(klass != NULL && klass->next != NULL) {
+		return klass->next(cursor, error);
+	}
+
+	return NULL;
+}
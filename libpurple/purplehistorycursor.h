@@ -0,0 +1,100 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PURPLE_GLOBAL_HEADER_INSIDE) && !defined(PURPLE_COMPILATION)
+# error "only <purple.h> may be included directly"
+#endif
+
+#ifndef PURPLE_HISTORY_CURSOR_H
+#define PURPLE_HISTORY_CURSOR_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <purplemessage.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PurpleHistoryCursor:
+ *
+ * #PurpleHistoryCursor is used to walk through the results of a history query
+ * one message at a time. History adapters can subclass it to only load
+ * messages from their storage as they are requested which keeps the memory
+ * usage of large queries bounded.
+ *
+ * Since: 3.0.0
+ */
+
+#define PURPLE_TYPE_HISTORY_CURSOR (purple_history_cursor_get_type())
+G_DECLARE_DERIVABLE_TYPE(PurpleHistoryCursor, purple_history_cursor, PURPLE,
+                         HISTORY_CURSOR, GObject)
+
+/**
+ * PurpleHistoryCursorClass:
+ * @next: Returns the next message or %NULL when the cursor is exhausted or an
+ *        error occurred. The default implementation walks the list that the
+ *        cursor was created with via purple_history_cursor_new_from_list().
+ *
+ * The class structure for #PurpleHistoryCursor.
+ *
+ * Since: 3.0.0
+ */
+struct _PurpleHistoryCursorClass {
+	/*< private >*/
+	GObjectClass parent;
+
+	/*< public >*/
+	PurpleMessage *(*next)(PurpleHistoryCursor *cursor, GError **error);
+
+	/*< private >*/
+	gpointer reserved[4];
+};
+
+/**
+ * purple_history_cursor_new_from_list:
+ * @messages: (element-type PurpleMessage) (transfer full): The messages.
+ *
+ * Creates a new cursor that returns each message in @messages in order. This
+ * is mostly useful for history adapters that can't load messages
+ * incrementally.
+ *
+ * Returns: (transfer full): The new cursor.
+ *
+ * Since: 3.0.0
+ */
+PurpleHistoryCursor *purple_history_cursor_new_from_list(GList *messages);
+
+/**
+ * purple_history_cursor_next:
+ * @cursor: The instance.
+ * @error: Return address for a #GError, or %NULL.
+ *
+ * Gets the next message from @cursor.
+ *
+ * Returns: (transfer full) (nullable): The next message, or %NULL if there
+ *          are no more messages or an error occurred, in which case @error
+ *          will be set.
+ *
+ * Since: 3.0.0
+ */
+PurpleMessage *purple_history_cursor_next(PurpleHistoryCursor *cursor, GError **error);
+
+G_END_DECLS
+
+#endif /* PURPLE_HISTORY_CURSOR_H */
@@ -344,6 +344,25 @@ purple_history_manager_query(PurpleHistoryManager *manager,
 	return purple_history_adapter_query(manager->active_adapter, query, error);
 }
 
+PurpleHistoryCursor *
+purple_history_manager_query_cursor(PurpleHistoryManager *manager,
+                                    const gchar *query,
+                                    const gchar *before,
+                                    guint limit,
+                                    GError **error)
+{
+	g_return_val_if_fail(PURPLE_IS_HISTORY_MANAGER(manager), NULL);
+
+	if(manager->active_adapter == NULL) {
+		g_set_error_literal(error, PURPLE_HISTORY_MANAGER_DOMAIN, 0,
+		                    _("no active history adapter"));
+		return NULL;
+	}
+
+	return purple_history_adapter_query_cursor(manager->active_adapter, query,
+	                                           before, limit, error);
+}
+
 gboolean
 purple_history_manager_remove(PurpleHistoryManager *manager,
                               const gchar *query,
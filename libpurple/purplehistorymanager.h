@@ -175,6 +175,25 @@ GList *purple_history_manager_get_all(PurpleHistoryManager *manager);
  */
 GList *purple_history_manager_query(PurpleHistoryManager *manager, const gchar *query, GError **error);
 
+/**
+ * purple_history_manager_query_cursor:
+ * @manager: The #PurpleHistoryManager instance.
+ * @query: A query to send to the @manager instance.
+ * @before: (nullable): The id of a message to page backwards from.
+ * @limit: The maximum number of messages to return, or 0 for no limit.
+ * @error: A return address for a #GError.
+ *
+ * Sends a query to the active #PurpleHistoryAdapter of @manager and returns a
+ * cursor over the matching messages. See
+ * purple_history_adapter_query_cursor() for the meaning of @before and
+ * @limit.
+ *
+ * Returns: (transfer full): The cursor, or %NULL with @error set.
+ *
+ * Since: 3.0.0
+ */
+PurpleHistoryCursor *purple_history_manager_query_cursor(PurpleHistoryManager *manager, const gchar *query, const gchar *before, guint limit, GError **error);
+
 /**
  * purple_history_manager_remove:
  * @manager: The #PurpleHistoryManager instance.
@@ -68,7 +68,7 @@ G_DEFINE_TYPE(PurpleMessage, purple_message, G_TYPE_OBJECT)
 /******************************************************************************
  * Helpers
  *****************************************************************************/
-static void
+void
 purple_message_set_id(PurpleMessage *message, const gchar *id) {
 	g_free(message->id);
 	message->id = g_strdup(id);
@@ -33,9 +33,19 @@
 #include "connection.h"
 #include "purplecredentialprovider.h"
 #include "purplehistoryadapter.h"
+#include "xmlnode.h"
 
 G_BEGIN_DECLS
 
+/**
+ * PURPLE_CONVERSATION_DEFAULT_MESSAGE_LIMIT:
+ *
+ * The default of the `/purple/conversations/message_limit` pref.
+ *
+ * Since: 3.0.0
+ */
+#define PURPLE_CONVERSATION_DEFAULT_MESSAGE_LIMIT (10000)
+
 /**
  * _purple_account_to_xmlnode:
  * @account:  The account
@@ -269,6 +279,16 @@ gboolean purple_history_adapter_activate(PurpleHistoryAdapter *adapter, GError *
  */
 gboolean purple_history_adapter_deactivate(PurpleHistoryAdapter *adapter, GError **error);
 
+/**
+ * purple_xmlnode_uninit:
+ *
+ * Frees the names that are shared between all [struct@Purple.XmlNodeArena]'s.
+ * No nodes in an arena may be left when this is called.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_uninit(void);
+
 /**
  * purple_history_manager_startup:
  *
@@ -338,6 +358,57 @@ void purple_whiteboard_manager_shutdown(void);
  */
 G_GNUC_INTERNAL void purple_account_set_enabled_plain(PurpleAccount *account, gboolean enabled);
 
+/**
+ * purple_message_set_id:
+ * @message: The instance.
+ * @id: (nullable): The new id of the message.
+ *
+ * Sets the id of @message. The id is normally only set when the message is
+ * created, but conversations give messages without one an id before they are
+ * logged so that they can be found in the history again.
+ *
+ * Since: 3.0.0
+ */
+G_GNUC_INTERNAL void purple_message_set_id(PurpleMessage *message, const char *id);
+
+/**
+ * PurpleXmlNodeStreamStartFunc:
+ * @node: The element, with its attributes but without its contents.
+ * @depth: How deep @node is, where the root element is 0.
+ * @data: The user data passed to purple_xmlnode_stream_from_file_full().
+ *
+ * Decides how an element of a file that is being streamed is handed over.
+ *
+ * Returns: %TRUE to be called for each of the children of @node, or %FALSE
+ *          to have @node handed to the #PurpleXmlNodeStreamFunc once it is
+ *          complete.
+ *
+ * Since: 3.0.0
+ */
+typedef gboolean (*PurpleXmlNodeStreamStartFunc)(PurpleXmlNode *node, guint depth, gpointer data);
+
+/**
+ * purple_xmlnode_stream_from_file_full:
+ * @dir: The directory where the file is located.
+ * @filename: The filename.
+ * @process: The subsystem that is calling this function. Used as the
+ *           category for debugging.
+ * @start_func: (scope call): The function that decides how each element is
+ *              handed over.
+ * @func: (scope call): The function to call with each complete element.
+ * @data: User data to pass to @start_func and @func.
+ *
+ * Like purple_xmlnode_stream_from_file(), but @start_func decides which
+ * elements are handed over whole instead of a fixed depth. Errors are only
+ * logged, so this is meant for files that have already been read once.
+ *
+ * Returns: %TRUE if the whole file was read, %FALSE if it doesn't exist or
+ *          an error occurred.
+ *
+ * Since: 3.0.0
+ */
+G_GNUC_INTERNAL gboolean purple_xmlnode_stream_from_file_full(const char *dir, const char *filename, const char *process, PurpleXmlNodeStreamStartFunc start_func, PurpleXmlNodeStreamFunc func, gpointer data);
+
 G_END_DECLS
 
 #endif /* PURPLE_PRIVATE_H */
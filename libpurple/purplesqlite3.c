@@ -20,6 +20,20 @@
 
 #include "purplesqlite3.h"
 
+/* Memory map up to 256MiB of the database file. */
+#define PURPLE_SQLITE3_MMAP_SIZE (256 * 1024 * 1024)
+
+/* A negative cache_size is in KiB rather than pages, this is 8MiB. */
+#define PURPLE_SQLITE3_CACHE_SIZE (-8 * 1024)
+
+/* How long to wait for another connection to release its lock. */
+#define PURPLE_SQLITE3_BUSY_TIMEOUT (5000)
+
+struct _PurpleSqlite3StatementCache {
+	sqlite3 *db;
+	GHashTable *statements;
+};
+
 /******************************************************************************
  * Helpers
  *****************************************************************************/
@@ -203,3 +217,95 @@ purple_sqlite3_run_migrations_from_resources(sqlite3 *db, const char *path,
 
 	return TRUE;
 }
+
+gboolean
+purple_sqlite3_apply_connection_profile(sqlite3 *db, GError **error) {
+	char *errmsg = NULL;
+	char *script = NULL;
+
+	g_return_val_if_fail(db != NULL, FALSE);
+
+	sqlite3_busy_timeout(db, PURPLE_SQLITE3_BUSY_TIMEOUT);
+
+	/* journal_mode returns the mode that is actually in use rather than
+	 * failing, so asking an in-memory database for WAL is harmless.
+	 */
+	script = g_strdup_printf("PRAGMA journal_mode=WAL;"
+	                         "PRAGMA synchronous=NORMAL;"
+	                         "PRAGMA mmap_size=%d;"
+	                         "PRAGMA cache_size=%d;"
+	                         "PRAGMA temp_store=MEMORY;",
+	                         PURPLE_SQLITE3_MMAP_SIZE,
+	                         PURPLE_SQLITE3_CACHE_SIZE);
+
+	sqlite3_exec(db, script, NULL, NULL, &errmsg);
+	g_free(script);
+
+	if(errmsg != NULL) {
+		g_set_error(error, PURPLE_SQLITE3_DOMAIN, 0,
+		            "failed to apply connection profile: %s", errmsg);
+
+		sqlite3_free(errmsg);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+PurpleSqlite3StatementCache *
+purple_sqlite3_statement_cache_new(sqlite3 *db) {
+	PurpleSqlite3StatementCache *cache = NULL;
+
+	g_return_val_if_fail(db != NULL, NULL);
+
+	cache = g_new0(PurpleSqlite3StatementCache, 1);
+	cache->db = db;
+	cache->statements = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                          (GDestroyNotify)sqlite3_finalize);
+
+	return cache;
+}
+
+void
+purple_sqlite3_statement_cache_free(PurpleSqlite3StatementCache *cache) {
+	g_return_if_fail(cache != NULL);
+
+	g_hash_table_destroy(cache->statements);
+	g_free(cache);
+}
+
+sqlite3_stmt *
+purple_sqlite3_statement_cache_get(PurpleSqlite3StatementCache *cache,
+                                   const char *sql, GError **error)
+{
+	sqlite3_stmt *stmt = NULL;
+
+	g_return_val_if_fail(cache != NULL, NULL);
+	g_return_val_if_fail(sql != NULL, NULL);
+
+	stmt = g_hash_table_lookup(cache->statements, sql);
+	if(stmt != NULL) {
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+
+		return stmt;
+	}
+
+	/* Let sqlite know that this statement will be around for a while so it
+	 * doesn't allocate it from its lookaside memory.
+	 */
+	sqlite3_prepare_v3(cache->db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt,
+	                   NULL);
+	if(stmt == NULL) {
+		g_set_error(error, PURPLE_SQLITE3_DOMAIN, 0,
+		            "error while creating prepared statement: %s",
+		            sqlite3_errmsg(cache->db));
+
+		return NULL;
+	}
+
+	g_hash_table_insert(cache->statements, g_strdup(sql), stmt);
+
+	return stmt;
+}
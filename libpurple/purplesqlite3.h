@@ -55,6 +55,37 @@ typedef gpointer PurpleSqlite3;
 typedef sqlite3 PurpleSqlite3;
 #endif
 
+/**
+ * PurpleSqlite3Statement:
+ *
+ * A sqlite3 prepared statement.
+ *
+ * This type alias exists for introspection purposes, and is no different from
+ * the `sqlite3_stmt` type.
+ *
+ * Since: 3.0.0
+ */
+#ifdef __GI_SCANNER__
+typedef gpointer PurpleSqlite3Statement;
+#else
+typedef sqlite3_stmt PurpleSqlite3Statement;
+#endif
+
+/**
+ * PurpleSqlite3StatementCache:
+ *
+ * A cache of prepared statements for a single sqlite3 connection keyed by
+ * their SQL.
+ *
+ * Preparing a statement means parsing and planning its SQL, which is often
+ * more expensive than running it. Components that run the same statements
+ * over and over should keep them in a cache instead of preparing and
+ * finalizing them every time.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleSqlite3StatementCache PurpleSqlite3StatementCache;
+
 /**
  * purple_sqlite3_get_schema_version:
  * @db: The sqlite3 connection.
@@ -136,6 +167,83 @@ gboolean purple_sqlite3_run_migrations_from_strings(PurpleSqlite3 *db, const cha
  */
 gboolean purple_sqlite3_run_migrations_from_resources(PurpleSqlite3 *db, const char *path, const char *migrations[], GError **error);
 
+/**
+ * purple_sqlite3_apply_connection_profile:
+ * @db: The sqlite3 connection.
+ * @error: Return address for a #GError, or %NULL.
+ *
+ * Configures @db the way libpurple expects its databases to be set up. This
+ * should be called right after the connection is opened and before any
+ * migrations are run.
+ *
+ * This switches the database to write-ahead logging with `synchronous=NORMAL`,
+ * which only syncs at checkpoints rather than on every commit, memory maps
+ * the database file, enlarges the page cache, and makes the connection wait
+ * for other connections to release their locks instead of failing
+ * immediately with `SQLITE_BUSY`.
+ *
+ * In-memory databases do not support write-ahead logging and are left in
+ * their default journal mode.
+ *
+ * Returns: %TRUE on success, or %FALSE on error with @error set.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_sqlite3_apply_connection_profile(PurpleSqlite3 *db, GError **error);
+
+/**
+ * purple_sqlite3_statement_cache_new:
+ * @db: The sqlite3 connection.
+ *
+ * Creates a new statement cache for @db.
+ *
+ * The cache must be freed with [func@Purple.sqlite3_statement_cache_free]
+ * before @db is closed, as sqlite3 will refuse to close a connection that
+ * still has prepared statements.
+ *
+ * Returns: (transfer full): The new cache.
+ *
+ * Since: 3.0.0
+ */
+PurpleSqlite3StatementCache *purple_sqlite3_statement_cache_new(PurpleSqlite3 *db);
+
+/**
+ * purple_sqlite3_statement_cache_free:
+ * @cache: The instance.
+ *
+ * Finalizes all of the statements in @cache and frees it.
+ *
+ * Since: 3.0.0
+ */
+void purple_sqlite3_statement_cache_free(PurpleSqlite3StatementCache *cache);
+
+/**
+ * purple_sqlite3_statement_cache_get:
+ * @cache: The instance.
+ * @sql: The SQL of the statement.
+ * @error: Return address for a #GError, or %NULL.
+ *
+ * Gets the prepared statement for @sql, preparing it if this is the first time
+ * it has been asked for.
+ *
+ * The statement is reset and has its bindings cleared before it is returned,
+ * so the caller can bind its parameters and step it right away. The caller
+ * must not finalize the statement, and should reset it when it is done with
+ * it so that it does not hold a read transaction open.
+ *
+ * Only statements whose SQL is the same every time should be cached. SQL that
+ * has values formatted into it would grow the cache without bound.
+ *
+ * Returns: (transfer none): The prepared statement or %NULL on error with
+ *          @error set.
+ *
+ * Since: 3.0.0
+ */
+PurpleSqlite3Statement *purple_sqlite3_statement_cache_get(PurpleSqlite3StatementCache *cache, const char *sql, GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PurpleSqlite3StatementCache,
+                              purple_sqlite3_statement_cache_free)
+
 G_END_DECLS
 
 #endif /* PURPLE_SQLITE3_H */
@@ -23,19 +23,98 @@
 #include "purplesqlitehistoryadapter.h"
 
 #include "account.h"
+#include "debug.h"
 #include "purpleprivate.h"
 #include "purplesqlite3.h"
 
+/* The maximum number of rows that the writer thread will insert in a single
+ * transaction.
+ */
+#define PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_SIZE (256)
+
+/* How long the writer thread will wait, in microseconds, for more rows to show
+ * up before committing a batch that isn't full yet.
+ */
+#define PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_DELAY (50 * G_TIME_SPAN_MILLISECOND)
+
+/* The maximum number of rows that can be waiting for the writer thread. Writes
+ * block once it is reached until the writer has caught up.
+ */
+#define PURPLE_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE (4 * PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_SIZE)
+
+/* The number of rowids the backfill thread looks at per transaction when
+ * adding messages that predate the full text index to it.
+ */
+#define PURPLE_SQLITE_HISTORY_ADAPTER_BACKFILL_SIZE (1000)
+
+/* The number of rows a cursor loads from the database at a time. */
+#define PURPLE_SQLITE_HISTORY_ADAPTER_PAGE_SIZE (256)
+
+/* Restricts a select query to a window of rows for paging. If message_id is
+ * set, the query instead looks for that message among the conversations,
+ * authors, accounts, and protocols the query is restricted to.
+ */
+typedef struct {
+	sqlite3_int64 after;
+	sqlite3_int64 before;
+	gboolean descending;
+	guint limit;
+	guint offset;
+	const char *message_id;
+} PurpleSqliteHistoryAdapterRange;
+
+/* A row of the message_log table. Rows that are waiting to be written have
+ * everything copied out of the conversation and message when they are created
+ * so that the writer thread never has to touch a GObject. Rows that are read
+ * by a cursor are only turned into a PurpleMessage when they are requested.
+ */
+typedef struct {
+	char *protocol;
+	char *account;
+	char *conversation_id;
+	char *message_id;
+	char *author;
+	char *author_name_color;
+	char *author_alias;
+	char *recipient;
+	const char *content_type;
+	char *content;
+	GDateTime *timestamp;
+} PurpleSqliteHistoryAdapterRow;
+
 struct _PurpleSqliteHistoryAdapter {
 	PurpleHistoryAdapter parent;
 
 	gchar *filename;
 	sqlite3 *db;
+	PurpleSqlite3StatementCache *statements;
+
+	/* Serializes access to db between the writer thread and everything
+	 * else.
+	 */
+	GMutex db_lock;
+
+	gboolean write_behind;
+	GThread *writer;
+
+	GThread *backfill;
+	gint backfill_cancelled;
+
+	/* Everything below is protected by queue_lock. */
+	GMutex queue_lock;
+	GCond queue_cond;
+	GQueue *queue;
+	GQueue *failed;
+	guint in_flight;
+	gboolean flushing;
+	gboolean stopping;
+	gint64 commit_latency;
 };
 
 enum {
 	PROP_0,
 	PROP_FILENAME,
+	PROP_WRITE_BEHIND,
 	N_PROPERTIES,
 };
 static GParamSpec *properties[N_PROPERTIES] = {NULL, };
@@ -43,6 +122,36 @@ static GParamSpec *properties[N_PROPERTIES] = {NULL, };
 G_DEFINE_TYPE(PurpleSqliteHistoryAdapter, purple_sqlite_history_adapter,
               PURPLE_TYPE_HISTORY_ADAPTER)
 
+#define PURPLE_TYPE_SQLITE_HISTORY_CURSOR (purple_sqlite_history_cursor_get_type())
+G_DECLARE_FINAL_TYPE(PurpleSqliteHistoryCursor, purple_sqlite_history_cursor,
+                     PURPLE, SQLITE_HISTORY_CURSOR, PurpleHistoryCursor)
+
+/* A cursor that loads a page of rows at a time. Chronological queries page
+ * with the rowid of the last row they've seen while ranked queries have to use
+ * an offset. No statement is kept open between pages, so the database can be
+ * written to and even closed while a cursor is alive.
+ */
+struct _PurpleSqliteHistoryCursor {
+	PurpleHistoryCursor parent;
+
+	PurpleSqliteHistoryAdapter *adapter;
+	char *query;
+
+	GQueue *rows;
+	sqlite3_int64 after;
+	sqlite3_int64 before;
+	guint offset;
+	gboolean ranked;
+
+	gboolean limited;
+	guint remaining;
+
+	gboolean done;
+};
+
+G_DEFINE_TYPE(PurpleSqliteHistoryCursor, purple_sqlite_history_cursor,
+              PURPLE_TYPE_HISTORY_CURSOR)
+
 /******************************************************************************
  * Helpers
  *****************************************************************************/
@@ -56,6 +165,42 @@ purple_sqlite_history_adapter_set_filename(PurpleSqliteHistoryAdapter *adapter,
 	g_object_notify_by_pspec(G_OBJECT(adapter), properties[PROP_FILENAME]);
 }
 
+static void
+purple_sqlite_history_adapter_set_write_behind(PurpleSqliteHistoryAdapter *adapter,
+                                               gboolean write_behind)
+{
+	adapter->write_behind = write_behind;
+
+	g_object_notify_by_pspec(G_OBJECT(adapter),
+	                         properties[PROP_WRITE_BEHIND]);
+}
+
+/* The build checks for fts5, but the sqlite3 we end up running against might
+ * not be the one we were built against. Without this check the migration that
+ * creates the full text index fails with a less helpful message.
+ */
+static gboolean
+purple_sqlite_history_adapter_check_fts5(PurpleSqliteHistoryAdapter *adapter,
+                                         GError **error)
+{
+	char *errmsg = NULL;
+
+	sqlite3_exec(adapter->db,
+	             "CREATE VIRTUAL TABLE temp.purple_fts5_check USING fts5(c);"
+	             "DROP TABLE temp.purple_fts5_check;",
+	             NULL, NULL, &errmsg);
+	if(errmsg != NULL) {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            _("SQLite was built without full text search (fts5): %s"),
+		            errmsg);
+		sqlite3_free(errmsg);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean
 purple_sqlite_history_adapter_run_migrations(PurpleSqliteHistoryAdapter *adapter,
                                              GError **error)
@@ -63,6 +208,8 @@ purple_sqlite_history_adapter_run_migrations(PurpleSqliteHistoryAdapter *adapter
 	const char *path = "/im/pidgin/libpurple/sqlitehistoryadapter";
 	const char *migrations[] = {
 		"01-schema.sql",
+		"02-fts.sql",
+		"03-indexes.sql",
 		NULL
 	};
 
@@ -70,6 +217,15 @@ purple_sqlite_history_adapter_run_migrations(PurpleSqliteHistoryAdapter *adapter
 	                                                    migrations, error);
 }
 
+/* Closes the database. The statement cache has to go first as sqlite won't
+ * close a connection that still has prepared statements.
+ */
+static void
+purple_sqlite_history_adapter_close(PurpleSqliteHistoryAdapter *adapter) {
+	g_clear_pointer(&adapter->statements, purple_sqlite3_statement_cache_free);
+	g_clear_pointer(&adapter->db, sqlite3_close);
+}
+
 static gchar *
 purple_sqlite_history_adapter_get_content_type(PurpleMessageContentType content_type) {
 	switch(content_type) {
@@ -109,143 +265,1042 @@ purple_sqlite_history_adapter_get_content_type_enum(const gchar *content_type)
 	return PURPLE_MESSAGE_CONTENT_TYPE_PLAIN;
 }
 
+/* Timestamps are stored as microseconds since the unix epoch so that they sort
+ * and compare as plain integers. They are read back in UTC, like they were
+ * written, and the user interface converts them to local time for display.
+ */
+static gint64
+purple_sqlite_history_adapter_timestamp_to_usec(GDateTime *timestamp) {
+	return g_date_time_to_unix(timestamp) * G_USEC_PER_SEC +
+	       g_date_time_get_microsecond(timestamp);
+}
+
+static GDateTime *
+purple_sqlite_history_adapter_timestamp_from_usec(gint64 usec) {
+	GDateTime *seconds = NULL;
+	GDateTime *timestamp = NULL;
+
+	seconds = g_date_time_new_from_unix_utc(usec / G_USEC_PER_SEC);
+	if(seconds == NULL) {
+		return NULL;
+	}
+
+	timestamp = g_date_time_add(seconds, usec % G_USEC_PER_SEC);
+	g_date_time_unref(seconds);
+
+	return timestamp;
+}
+
+static PurpleSqliteHistoryAdapterRow *
+purple_sqlite_history_adapter_row_new(PurpleConversation *conversation,
+                                      PurpleMessage *message)
+{
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	PurpleAccount *account = NULL;
+	PurpleContactInfo *info = NULL;
+	PurpleMessageContentType content_type;
+	const char *message_id = NULL;
+
+	account = purple_conversation_get_account(conversation);
+	info = PURPLE_CONTACT_INFO(account);
+
+	row = g_new0(PurpleSqliteHistoryAdapterRow, 1);
+	row->protocol = g_strdup(purple_account_get_protocol_name(account));
+	row->account = g_strdup(purple_contact_info_get_username(info));
+	row->conversation_id = g_strdup(purple_conversation_get_name(conversation));
+
+	message_id = purple_message_get_id(message);
+	if(message_id != NULL) {
+		row->message_id = g_strdup(message_id);
+	} else {
+		row->message_id = g_uuid_string_random();
+	}
+
+	row->author = g_strdup(purple_message_get_author(message));
+	row->author_name_color = g_strdup(purple_message_get_author_name_color(message));
+	row->author_alias = g_strdup(purple_message_get_author_alias(message));
+	row->recipient = g_strdup(purple_message_get_recipient(message));
+
+	content_type = purple_message_get_content_type(message);
+	row->content_type = purple_sqlite_history_adapter_get_content_type(content_type);
+	row->content = g_strdup(purple_message_get_contents(message));
+	row->timestamp = purple_message_get_timestamp(message);
+	if(row->timestamp != NULL) {
+		g_date_time_ref(row->timestamp);
+	}
+
+	return row;
+}
+
+static void
+purple_sqlite_history_adapter_row_free(gpointer data) {
+	PurpleSqliteHistoryAdapterRow *row = data;
+
+	g_free(row->protocol);
+	g_free(row->account);
+	g_free(row->conversation_id);
+	g_free(row->message_id);
+	g_free(row->author);
+	g_free(row->author_name_color);
+	g_free(row->author_alias);
+	g_free(row->recipient);
+	g_free(row->content);
+	g_clear_pointer(&row->timestamp, g_date_time_unref);
+
+	g_free(row);
+}
+
+/* Creates a row from the current result of a statement created by
+ * purple_sqlite_history_adapter_build_query and stores its rowid in rowid.
+ */
+static PurpleSqliteHistoryAdapterRow *
+purple_sqlite_history_adapter_row_new_from_statement(sqlite3_stmt *stmt,
+                                                     sqlite3_int64 *rowid)
+{
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	PurpleMessageContentType content_type;
+
+	row = g_new0(PurpleSqliteHistoryAdapterRow, 1);
+
+	*rowid = sqlite3_column_int64(stmt, 0);
+	row->message_id = g_strdup((const char *)sqlite3_column_text(stmt, 1));
+	row->author = g_strdup((const char *)sqlite3_column_text(stmt, 2));
+	row->author_name_color = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+	row->author_alias = g_strdup((const char *)sqlite3_column_text(stmt, 4));
+	row->recipient = g_strdup((const char *)sqlite3_column_text(stmt, 5));
+	content_type = purple_sqlite_history_adapter_get_content_type_enum((const char *)sqlite3_column_text(stmt, 6));
+	row->content_type = purple_sqlite_history_adapter_get_content_type(content_type);
+	row->content = g_strdup((const char *)sqlite3_column_text(stmt, 7));
+	if(sqlite3_column_type(stmt, 8) != SQLITE_NULL) {
+		gint64 usec = sqlite3_column_int64(stmt, 8);
+
+		row->timestamp = purple_sqlite_history_adapter_timestamp_from_usec(usec);
+	}
+
+	return row;
+}
+
+static PurpleMessage *
+purple_sqlite_history_adapter_row_to_message(PurpleSqliteHistoryAdapterRow *row)
+{
+	PurpleMessage *message = NULL;
+	PurpleMessageContentType content_type;
+
+	content_type = purple_sqlite_history_adapter_get_content_type_enum(row->content_type);
+
+	message = g_object_new(PURPLE_TYPE_MESSAGE,
+	                       "id", row->message_id,
+	                       "author", row->author,
+	                       "author_name_color", row->author_name_color,
+	                       "author_alias", row->author_alias,
+	                       "recipient", row->recipient,
+	                       "contents", row->content,
+	                       "content_type", content_type,
+	                       "timestamp", row->timestamp,
+	                       NULL);
+
+	return message;
+}
+
+/* Inserts all of the rows in the list starting at rows in a single
+ * transaction. The caller must be holding db_lock.
+ */
+static gboolean
+purple_sqlite_history_adapter_insert_rows(PurpleSqliteHistoryAdapter *adapter,
+                                          GList *rows, GError **error)
+{
+	sqlite3_stmt *prepared_statement = NULL;
+	const gchar *script = NULL;
+	gint result = 0;
+
+	/* A message that was already logged for this conversation is ignored
+	 * rather than failing the whole batch. Only that conflict is ignored, any
+	 * other constraint that a row violates is still an error.
+	 */
+	script = "INSERT INTO message_log(protocol, account, conversation_id, "
+			 "message_id, author, author_name_color, author_alias, "
+			 "recipient, content_type, content, client_timestamp) "
+	         "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+	         "ON CONFLICT(message_id, conversation_id, account, protocol) "
+	         "DO NOTHING";
+
+	prepared_statement = purple_sqlite3_statement_cache_get(adapter->statements,
+	                                                        script, error);
+	if(prepared_statement == NULL) {
+		return FALSE;
+	}
+
+	if(sqlite3_exec(adapter->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            "Error starting a transaction: %s",
+		            sqlite3_errmsg(adapter->db));
+
+		return FALSE;
+	}
+
+	for(GList *l = rows; l != NULL; l = l->next) {
+		PurpleSqliteHistoryAdapterRow *row = l->data;
+
+		sqlite3_bind_text(prepared_statement, 1, row->protocol, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 2, row->account, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 3, row->conversation_id, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 4, row->message_id, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 5, row->author, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 6, row->author_name_color, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 7, row->author_alias, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 8, row->recipient, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 9, row->content_type, -1,
+		                  SQLITE_STATIC);
+		sqlite3_bind_text(prepared_statement, 10, row->content, -1,
+		                  SQLITE_STATIC);
+		if(row->timestamp != NULL) {
+			gint64 usec = 0;
+
+			usec = purple_sqlite_history_adapter_timestamp_to_usec(row->timestamp);
+			sqlite3_bind_int64(prepared_statement, 11, usec);
+		}
+
+		result = sqlite3_step(prepared_statement);
+		if(result != SQLITE_DONE) {
+			g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+			            "Error writing to the database: %s",
+			            sqlite3_errmsg(adapter->db));
+
+			sqlite3_reset(prepared_statement);
+			sqlite3_exec(adapter->db, "ROLLBACK", NULL, NULL, NULL);
+
+			return FALSE;
+		}
+
+		sqlite3_reset(prepared_statement);
+		sqlite3_clear_bindings(prepared_statement);
+	}
+
+	if(sqlite3_exec(adapter->db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            "Error committing to the database: %s",
+		            sqlite3_errmsg(adapter->db));
+
+		sqlite3_exec(adapter->db, "ROLLBACK", NULL, NULL, NULL);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Inserts the rows in rows one transaction at a time after their batch
+ * failed, so that a bad row doesn't take everything it was batched with down
+ * too. Rows that are written are freed and rows that still fail are moved to
+ * failed. Returns the number of rows that failed, with error set to the last
+ * failure. The caller must be holding db_lock.
+ */
+static guint
+purple_sqlite_history_adapter_insert_each(PurpleSqliteHistoryAdapter *adapter,
+                                          GQueue *rows, GQueue *failed,
+                                          GError **error)
+{
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	guint n_failed = 0;
+
+	while((row = g_queue_pop_head(rows)) != NULL) {
+		GList single = { row, NULL, NULL };
+		GError *local_error = NULL;
+
+		if(purple_sqlite_history_adapter_insert_rows(adapter, &single,
+		                                             &local_error))
+		{
+			purple_sqlite_history_adapter_row_free(row);
+
+			continue;
+		}
+
+		g_queue_push_tail(failed, row);
+		n_failed++;
+
+		g_clear_error(error);
+		g_propagate_error(error, local_error);
+	}
+
+	return n_failed;
+}
+
+static gpointer
+purple_sqlite_history_adapter_writer_thread(gpointer data) {
+	PurpleSqliteHistoryAdapter *adapter = data;
+
+	g_mutex_lock(&adapter->queue_lock);
+
+	while(TRUE) {
+		GQueue batch = G_QUEUE_INIT;
+		GQueue failed = G_QUEUE_INIT;
+		GError *error = NULL;
+		gint64 deadline = 0;
+		gint64 start = 0;
+
+		while(g_queue_is_empty(adapter->queue) && !adapter->stopping) {
+			g_cond_wait(&adapter->queue_cond, &adapter->queue_lock);
+		}
+
+		/* We only exit once everything that was queued has been written. */
+		if(g_queue_is_empty(adapter->queue)) {
+			break;
+		}
+
+		/* Give bursts of messages a moment to pile up so that they end up in
+		 * the same transaction.
+		 */
+		deadline = g_get_monotonic_time() + PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_DELAY;
+		while(g_queue_get_length(adapter->queue) < PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_SIZE &&
+		      !adapter->flushing && !adapter->stopping)
+		{
+			if(!g_cond_wait_until(&adapter->queue_cond, &adapter->queue_lock,
+			                      deadline))
+			{
+				break;
+			}
+		}
+
+		while(batch.length < PURPLE_SQLITE_HISTORY_ADAPTER_BATCH_SIZE &&
+		      !g_queue_is_empty(adapter->queue))
+		{
+			g_queue_push_tail(&batch, g_queue_pop_head(adapter->queue));
+		}
+		adapter->in_flight = batch.length;
+
+		/* Wake up any writes that were waiting for room in the queue. */
+		g_cond_broadcast(&adapter->queue_cond);
+
+		g_mutex_unlock(&adapter->queue_lock);
+
+		start = g_get_monotonic_time();
+
+		g_mutex_lock(&adapter->db_lock);
+		if(!purple_sqlite_history_adapter_insert_rows(adapter, batch.head,
+		                                              &error))
+		{
+			guint n_rows = batch.length;
+			guint n_failed = 0;
+
+			purple_debug_warning("sqlite-history-adapter",
+			                     "failed to write a batch of %u messages, "
+			                     "retrying them one at a time: %s",
+			                     n_rows, error->message);
+			g_clear_error(&error);
+
+			n_failed = purple_sqlite_history_adapter_insert_each(adapter,
+			                                                     &batch,
+			                                                     &failed,
+			                                                     &error);
+			if(n_failed > 0) {
+				purple_debug_warning("sqlite-history-adapter",
+				                     "failed to write %u of %u messages, "
+				                     "keeping them for the next flush: %s",
+				                     n_failed, n_rows, error->message);
+				g_clear_error(&error);
+			}
+		}
+		g_mutex_unlock(&adapter->db_lock);
+
+		g_queue_clear_full(&batch, purple_sqlite_history_adapter_row_free);
+
+		g_mutex_lock(&adapter->queue_lock);
+
+		while(!g_queue_is_empty(&failed)) {
+			g_queue_push_tail(adapter->failed, g_queue_pop_head(&failed));
+		}
+
+		adapter->in_flight = 0;
+		adapter->commit_latency = g_get_monotonic_time() - start;
+
+		g_cond_broadcast(&adapter->queue_cond);
+	}
+
+	g_mutex_unlock(&adapter->queue_lock);
+
+	return NULL;
+}
+
+/* Blocks until the writer thread has tried to write everything that has been
+ * queued so far. Rows that it failed to write are left for
+ * purple_sqlite_history_adapter_flush() to deal with.
+ */
+static void
+purple_sqlite_history_adapter_wait_for_writer(PurpleSqliteHistoryAdapter *adapter)
+{
+	g_mutex_lock(&adapter->queue_lock);
+
+	/* Let the writer know it shouldn't wait around for a batch to fill up. */
+	adapter->flushing = TRUE;
+	g_cond_broadcast(&adapter->queue_cond);
+
+	while(!g_queue_is_empty(adapter->queue) || adapter->in_flight > 0) {
+		g_cond_wait(&adapter->queue_cond, &adapter->queue_lock);
+	}
+
+	adapter->flushing = FALSE;
+
+	g_mutex_unlock(&adapter->queue_lock);
+}
+
+static void
+purple_sqlite_history_adapter_stop_writer(PurpleSqliteHistoryAdapter *adapter) {
+	if(adapter->writer == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&adapter->queue_lock);
+	adapter->stopping = TRUE;
+	g_cond_broadcast(&adapter->queue_cond);
+	g_mutex_unlock(&adapter->queue_lock);
+
+	g_clear_pointer(&adapter->writer, g_thread_join);
+
+	adapter->stopping = FALSE;
+}
+
+/* Reads the next whitespace separated token from *cursor. Double quotes can
+ * be used to include whitespace in a token and are removed from the returned
+ * string. quoted is set if any part of the token was quoted and prefix is set
+ * if the token ended with an unquoted '*'.
+ */
+static char *
+purple_sqlite_history_adapter_next_token(const char **cursor,
+                                         gboolean *quoted, gboolean *prefix)
+{
+	GString *token = NULL;
+	const char *p = *cursor;
+	gboolean in_quotes = FALSE;
+
+	*quoted = FALSE;
+	*prefix = FALSE;
+
+	while(g_ascii_isspace(*p)) {
+		p++;
+	}
+
+	if(*p == '\0') {
+		*cursor = p;
+
+		return NULL;
+	}
+
+	token = g_string_new(NULL);
+
+	for(; *p != '\0'; p++) {
+		if(*p == '"' && in_quotes && p[1] == '"') {
+			/* A doubled quote inside of quotes is a literal quote. */
+			g_string_append_c(token, *p);
+			p++;
+		} else if(*p == '"') {
+			in_quotes = !in_quotes;
+			*quoted = TRUE;
+		} else if(!in_quotes && g_ascii_isspace(*p)) {
+			break;
+		} else {
+			g_string_append_c(token, *p);
+		}
+	}
+
+	*cursor = p;
+
+	/* A trailing '*' outside of quotes makes the token a prefix search. */
+	if(!in_quotes && token->len > 0 && token->str[token->len - 1] == '*' &&
+	   p[-1] == '*')
+	{
+		g_string_truncate(token, token->len - 1);
+		*prefix = TRUE;
+	}
+
+	return g_string_free(token, FALSE);
+}
+
+/* Appends term to the fts5 match expression in match. Every term is quoted as
+ * an fts5 string so that the user can't inject fts5 syntax, and a term that
+ * contains multiple words is matched as a phrase.
+ */
+static void
+purple_sqlite_history_adapter_append_match_term(GString *match,
+                                                const char *term,
+                                                gboolean prefix,
+                                                gboolean use_or)
+{
+	if(match->len > 0) {
+		g_string_append(match, use_or ? " OR " : " AND ");
+	}
+
+	g_string_append_c(match, '"');
+	for(const char *p = term; *p != '\0'; p++) {
+		if(*p == '"') {
+			g_string_append_c(match, '"');
+		}
+		g_string_append_c(match, *p);
+	}
+	g_string_append_c(match, '"');
+
+	if(prefix) {
+		g_string_append_c(match, '*');
+	}
+}
+
+/* Appends a condition that column is one of the values in terms. Each value
+ * gets a placeholder that is bound by purple_sqlite_history_adapter_bind_in().
+ */
+static void
+purple_sqlite_history_adapter_append_in(GString *query, const char *column,
+                                        GList *terms)
+{
+	if(terms == NULL) {
+		return;
+	}
+
+	g_string_append_printf(query, "AND (message_log.%s IN (", column);
+	for(GList *iter = terms; iter != NULL; iter = iter->next) {
+		if(iter != terms) {
+			g_string_append(query, ", ");
+		}
+		g_string_append(query, "?");
+	}
+	g_string_append(query, "))");
+}
+
+/* Binds and frees the values that were added by
+ * purple_sqlite_history_adapter_append_in().
+ */
+static void
+purple_sqlite_history_adapter_bind_in(sqlite3_stmt *stmt, gint *index,
+                                      GList *terms)
+{
+	while(terms != NULL) {
+		sqlite3_bind_text(stmt, (*index)++, (const char *)terms->data, -1,
+		                  g_free);
+		terms = g_list_delete_link(terms, terms);
+	}
+}
+
+/* Turns a search query into a prepared statement.
+ *
+ * The query language supports the following:
+ *   in:<conversation>  only match messages in the given conversation.
+ *   from:<author>      only match messages from the given author.
+ *   account:<username> only match messages logged by the given account.
+ *   protocol:<name>    only match messages logged by the given protocol.
+ *   word               match messages containing word.
+ *   word*              match messages containing a word starting with word.
+ *   "some words"       match messages containing the exact phrase.
+ *   "say ""hi"""      quotes can be used inside of quotes by doubling them.
+ *   a OR b             match messages containing either a or b.
+ *
+ * Multiple in: and from: terms are or'd together while keywords are and'd
+ * together unless separated by OR. Keyword searches are ranked by relevance,
+ * everything else is ordered by when it was written, and ranked is set
+ * accordingly.
+ *
+ * Select queries return the rowid as their first column and can be limited to
+ * a window of rows with range, or look for a single message by its id.
+ */
 static sqlite3_stmt *
 purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
                                           const gchar * search_query,
                                           gboolean remove,
+                                          const PurpleSqliteHistoryAdapterRange *range,
+                                          gboolean *ranked,
                                           GError **error)
 {
-	gchar **split = NULL;
-	gint i = 0;
 	GList *ins = NULL;
 	GList *froms = NULL;
-	GList *keywords = NULL;
+	GList *accounts = NULL;
+	GList *protocols = NULL;
+	GString *match = NULL;
 	GString *query = NULL;
-	GList *iter = NULL;
-	gboolean first = FALSE;
+	gboolean use_or = FALSE;
+	gboolean find = FALSE;
 	sqlite3_stmt *prepared_statement = NULL;
+	const char *cursor = search_query;
 	gint index = 1;
 	gint query_items = 0;
 
-	split = g_strsplit(search_query, " ", -1);
-	for(i = 0; split[i] != NULL; i++) {
-		if(g_str_has_prefix(split[i], "in:")) {
-			if(split[i][3] == '\0') {
-				continue;
+	find = (!remove && range != NULL && range->message_id != NULL);
+
+	match = g_string_new(NULL);
+
+	while(TRUE) {
+		char *token = NULL;
+		gboolean quoted = FALSE;
+		gboolean prefix = FALSE;
+		const char *start = NULL;
+
+		while(g_ascii_isspace(*cursor)) {
+			cursor++;
+		}
+		start = cursor;
+
+		token = purple_sqlite_history_adapter_next_token(&cursor, &quoted,
+		                                                 &prefix);
+		if(token == NULL) {
+			break;
+		}
+
+		if(g_str_has_prefix(start, "in:")) {
+			if(token[3] != '\0') {
+				ins = g_list_prepend(ins, g_strdup(token + 3));
+				query_items++;
 			}
-			ins = g_list_prepend(ins, g_strdup(split[i]+3));
-			query_items++;
-		} else if(g_str_has_prefix(split[i], "from:")) {
-			if(split[i][5] == '\0') {
-				continue;
+		} else if(g_str_has_prefix(start, "from:")) {
+			if(token[5] != '\0') {
+				froms = g_list_prepend(froms, g_strdup(token + 5));
+				query_items++;
 			}
-			froms = g_list_prepend(froms, g_strdup(split[i]+5));
-			query_items++;
-		} else {
-			if(split[i][0] == '\0') {
-				continue;
+		} else if(g_str_has_prefix(start, "account:")) {
+			if(token[8] != '\0') {
+				accounts = g_list_prepend(accounts, g_strdup(token + 8));
+				query_items++;
 			}
-			keywords = g_list_prepend(keywords,
-			                          g_strdup_printf("%%%s%%", split[i]));
+		} else if(g_str_has_prefix(start, "protocol:")) {
+			if(token[9] != '\0') {
+				protocols = g_list_prepend(protocols, g_strdup(token + 9));
+				query_items++;
+			}
+		} else if(!quoted && purple_strequal(token, "OR")) {
+			use_or = TRUE;
+		} else if(!quoted && purple_strequal(token, "AND")) {
+			use_or = FALSE;
+		} else if(find) {
+			/* The message being looked for doesn't have to match the
+			 * keywords. */
+		} else if(token[0] != '\0') {
+			purple_sqlite_history_adapter_append_match_term(match, token,
+			                                                prefix, use_or);
+			use_or = FALSE;
 			query_items++;
 		}
+
+		g_free(token);
+	}
+
+	if(remove) {
+		if(query_items != 0) {
+			query = g_string_new("DELETE FROM message_log WHERE TRUE\n");
+		} else {
+			g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+			            "Attempting to remove messages without "
+			            "query parameters.");
+
+			g_string_free(match, TRUE);
+
+			return NULL;
+		}
+	} else {
+		query = g_string_new("SELECT "
+		                     "message_log.rowid, "
+		                     "message_log.message_id, message_log.author, "
+		                     "message_log.author_name_color, "
+		                     "message_log.author_alias, "
+		                     "message_log.recipient, "
+		                     "message_log.content_type, "
+		                     "message_log.content, "
+		                     "message_log.client_timestamp "
+		                     "FROM message_log ");
+
+		if(match->len > 0) {
+			g_string_append(query,
+			                "INNER JOIN message_log_fts "
+			                "ON message_log_fts.rowid = message_log.rowid ");
+		}
+
+		g_string_append(query, "WHERE TRUE\n");
+	}
+
+	purple_sqlite_history_adapter_append_in(query, "conversation_id", ins);
+	purple_sqlite_history_adapter_append_in(query, "author", froms);
+	purple_sqlite_history_adapter_append_in(query, "account", accounts);
+	purple_sqlite_history_adapter_append_in(query, "protocol", protocols);
+
+	if(find) {
+		g_string_append(query, "AND (message_log.message_id = ?)\n");
+	}
+
+	if(match->len > 0) {
+		if(remove) {
+			g_string_append(query,
+			                "AND (rowid IN (SELECT rowid FROM message_log_fts "
+			                "WHERE message_log_fts MATCH ?))");
+		} else {
+			g_string_append(query, "AND (message_log_fts MATCH ?)\n");
+		}
+	}
+
+	if(!remove) {
+		if(range != NULL && range->after > 0) {
+			g_string_append_printf(query,
+			                       "AND (message_log.rowid > %" G_GINT64_FORMAT ")\n",
+			                       (gint64)range->after);
+		}
+
+		if(range != NULL && range->before > 0) {
+			g_string_append_printf(query,
+			                       "AND (message_log.rowid < %" G_GINT64_FORMAT ")\n",
+			                       (gint64)range->before);
+		}
+
+		if(match->len > 0) {
+			g_string_append(query,
+			                "ORDER BY message_log_fts.rank, message_log.rowid");
+		} else if(range != NULL && range->descending) {
+			g_string_append(query, "ORDER BY message_log.rowid DESC");
+		} else {
+			g_string_append(query, "ORDER BY message_log.rowid");
+		}
+
+		if(range != NULL && range->limit > 0) {
+			g_string_append_printf(query, " LIMIT %u OFFSET %u", range->limit,
+			                       range->offset);
+		}
+	}
+	g_string_append(query, ";");
+
+	if(ranked != NULL) {
+		*ranked = (match->len > 0);
+	}
+
+	sqlite3_prepare_v2(adapter->db, query->str, -1, &prepared_statement, NULL);
+
+	g_string_free(query, TRUE);
+
+	if(prepared_statement == NULL) {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            "Error creating the prepared statement: %s",
+		            sqlite3_errmsg(adapter->db));
+
+		g_list_free_full(ins, g_free);
+		g_list_free_full(froms, g_free);
+		g_list_free_full(accounts, g_free);
+		g_list_free_full(protocols, g_free);
+		g_string_free(match, TRUE);
+
+		return NULL;
+	}
+
+	purple_sqlite_history_adapter_bind_in(prepared_statement, &index, ins);
+	purple_sqlite_history_adapter_bind_in(prepared_statement, &index, froms);
+	purple_sqlite_history_adapter_bind_in(prepared_statement, &index, accounts);
+	purple_sqlite_history_adapter_bind_in(prepared_statement, &index,
+	                                      protocols);
+
+	if(find) {
+		sqlite3_bind_text(prepared_statement, index++, range->message_id, -1,
+		                  SQLITE_TRANSIENT);
+	}
+
+	if(match->len > 0) {
+		sqlite3_bind_text(prepared_statement, index++,
+		                  g_string_free(match, FALSE), -1, g_free);
+	} else {
+		g_string_free(match, TRUE);
+	}
+
+	return prepared_statement;
+}
+
+/* Indexes the next chunk of messages that were logged before the full text
+ * index existed. remaining is set to the number of rowids that still need to
+ * be looked at. The caller must be holding db_lock.
+ */
+static gboolean
+purple_sqlite_history_adapter_backfill_step(PurpleSqliteHistoryAdapter *adapter,
+                                            sqlite3_int64 *remaining,
+                                            GError **error)
+{
+	sqlite3_stmt *stmt = NULL;
+	char *errmsg = NULL;
+	char *script = NULL;
+
+	script = g_strdup_printf(
+		"BEGIN;"
+		"INSERT INTO message_log_fts(rowid, content) "
+		"SELECT rowid, content FROM message_log "
+		"WHERE rowid <= (SELECT next_rowid FROM message_log_fts_backfill) "
+		"AND rowid > (SELECT next_rowid FROM message_log_fts_backfill) - %d;"
+		"UPDATE message_log_fts_backfill "
+		"SET next_rowid = MAX(0, next_rowid - %d);"
+		"COMMIT;",
+		PURPLE_SQLITE_HISTORY_ADAPTER_BACKFILL_SIZE,
+		PURPLE_SQLITE_HISTORY_ADAPTER_BACKFILL_SIZE);
+
+	sqlite3_exec(adapter->db, script, NULL, NULL, &errmsg);
+	g_free(script);
+
+	if(errmsg != NULL) {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            "Error indexing existing messages: %s", errmsg);
+		sqlite3_free(errmsg);
+
+		sqlite3_exec(adapter->db, "ROLLBACK", NULL, NULL, NULL);
+
+		return FALSE;
+	}
+
+	stmt = purple_sqlite3_statement_cache_get(adapter->statements,
+	                                          "SELECT next_rowid FROM "
+	                                          "message_log_fts_backfill",
+	                                          error);
+	if(stmt == NULL) {
+		return FALSE;
+	}
+
+	*remaining = 0;
+	if(sqlite3_step(stmt) == SQLITE_ROW) {
+		*remaining = sqlite3_column_int64(stmt, 0);
+	}
+
+	sqlite3_reset(stmt);
+
+	return TRUE;
+}
+
+static gpointer
+purple_sqlite_history_adapter_backfill_thread(gpointer data) {
+	PurpleSqliteHistoryAdapter *adapter = data;
+
+	purple_debug_info("sqlite-history-adapter",
+	                  "indexing existing messages for full text search");
+
+	while(!g_atomic_int_get(&adapter->backfill_cancelled)) {
+		GError *error = NULL;
+		sqlite3_int64 remaining = 0;
+		gboolean success = FALSE;
+
+		/* The lock is dropped between chunks so that writes and queries can
+		 * make progress while we're working.
+		 */
+		g_mutex_lock(&adapter->db_lock);
+		success = purple_sqlite_history_adapter_backfill_step(adapter,
+		                                                      &remaining,
+		                                                      &error);
+		g_mutex_unlock(&adapter->db_lock);
+
+		if(!success) {
+			purple_debug_warning("sqlite-history-adapter", "%s",
+			                     error->message);
+			g_clear_error(&error);
+
+			break;
+		}
+
+		if(remaining == 0) {
+			purple_debug_info("sqlite-history-adapter",
+			                  "finished indexing existing messages");
+
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* Starts the backfill thread if the database has messages that were logged
+ * before the full text index was created.
+ */
+static gboolean
+purple_sqlite_history_adapter_start_backfill(PurpleSqliteHistoryAdapter *adapter,
+                                             GError **error)
+{
+	sqlite3_stmt *stmt = NULL;
+	sqlite3_int64 next_rowid = 0;
+
+	stmt = purple_sqlite3_statement_cache_get(adapter->statements,
+	                                          "SELECT next_rowid FROM "
+	                                          "message_log_fts_backfill",
+	                                          error);
+	if(stmt == NULL) {
+		return FALSE;
+	}
+
+	if(sqlite3_step(stmt) == SQLITE_ROW) {
+		next_rowid = sqlite3_column_int64(stmt, 0);
+	}
+
+	sqlite3_reset(stmt);
+
+	if(next_rowid <= 0) {
+		return TRUE;
 	}
 
-	g_clear_pointer(&split, g_strfreev);
+	g_atomic_int_set(&adapter->backfill_cancelled, FALSE);
+	adapter->backfill = g_thread_try_new("sqlite-history-backfill",
+	                                     purple_sqlite_history_adapter_backfill_thread,
+	                                     adapter, error);
 
-	if(remove) {
-		if(query_items != 0) {
-			query = g_string_new("DELETE FROM message_log WHERE TRUE\n");
-		} else {
-			g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
-			            "Attempting to remove messages without "
-			            "query parameters.");
+	return adapter->backfill != NULL;
+}
 
-			return NULL;
-		}
+static void
+purple_sqlite_history_adapter_stop_backfill(PurpleSqliteHistoryAdapter *adapter)
+{
+	if(adapter->backfill == NULL) {
+		return;
+	}
+
+	/* Whatever hasn't been indexed yet will be picked up the next time we're
+	 * activated.
+	 */
+	g_atomic_int_set(&adapter->backfill_cancelled, TRUE);
+	g_clear_pointer(&adapter->backfill, g_thread_join);
+}
+
+/******************************************************************************
+ * PurpleSqliteHistoryCursor Implementation
+ *****************************************************************************/
+static gboolean
+purple_sqlite_history_cursor_fetch(PurpleSqliteHistoryCursor *cursor,
+                                   GError **error)
+{
+	PurpleSqliteHistoryAdapter *adapter = cursor->adapter;
+	PurpleSqliteHistoryAdapterRange range = {
+		.before = cursor->before,
+		.limit = PURPLE_SQLITE_HISTORY_ADAPTER_PAGE_SIZE,
+	};
+	sqlite3_stmt *stmt = NULL;
+	guint fetched = 0;
+	gint result = 0;
+
+	if(cursor->limited) {
+		range.limit = MIN(range.limit, cursor->remaining);
+	}
+
+	/* Until the first page is loaded we don't know if the query is ranked,
+	 * but after and offset are both still 0 at that point.
+	 */
+	if(cursor->ranked) {
+		range.offset = cursor->offset;
 	} else {
-		query = g_string_new("SELECT "
-		                     "message_id, author, author_name_color, "
-		                     "author_alias, recipient, content_type, "
-		                     "content, client_timestamp "
-		                     "FROM message_log WHERE TRUE\n");
-	}
-
-	if(ins != NULL) {
-		first = TRUE;
-		g_string_append(query, "AND (conversation_id IN (");
-		for(iter = ins; iter != NULL; iter = iter->next) {
-			if(!first) {
-				g_string_append(query, ", ");
-			}
-			first = FALSE;
-			g_string_append(query, "?");
-		}
-		g_string_append(query, "))");
+		range.after = cursor->after;
 	}
 
-	if(froms != NULL) {
-		first = TRUE;
-		g_string_append(query, "AND (author IN (");
-		for(iter = froms; iter != NULL; iter = iter->next) {
-			if(!first) {
-				g_string_append(query, ", ");
-			}
-			first = FALSE;
-			g_string_append(query, "?");
-		}
-		g_string_append(query, "))");
+	g_mutex_lock(&adapter->db_lock);
+
+	if(adapter->db == NULL) {
+		g_mutex_unlock(&adapter->db_lock);
+
+		g_set_error_literal(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		                    _("Adapter has not been activated"));
+
+		return FALSE;
 	}
 
-	if(keywords != NULL) {
-		first = TRUE;
-		g_string_append(query, "AND (");
-		for(iter = keywords; iter != NULL; iter = iter->next) {
-			if(!first) {
-				g_string_append(query, " OR ");
-			}
-			first = FALSE;
-			g_string_append(query, " content LIKE ? ");
-		}
-		g_string_append(query, ")");
+	stmt = purple_sqlite_history_adapter_build_query(adapter, cursor->query,
+	                                                 FALSE, &range,
+	                                                 &cursor->ranked, error);
+	if(stmt == NULL) {
+		g_mutex_unlock(&adapter->db_lock);
+
+		return FALSE;
 	}
-	g_string_append(query, ";");
 
-	sqlite3_prepare_v2(adapter->db, query->str, -1, &prepared_statement, NULL);
+	while((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+		PurpleSqliteHistoryAdapterRow *row = NULL;
+		sqlite3_int64 rowid = 0;
 
-	g_string_free(query, TRUE);
+		row = purple_sqlite_history_adapter_row_new_from_statement(stmt,
+		                                                           &rowid);
+		g_queue_push_tail(cursor->rows, row);
 
-	if(prepared_statement == NULL) {
+		if(!cursor->ranked) {
+			cursor->after = rowid;
+		}
+
+		fetched++;
+	}
+
+	if(result != SQLITE_DONE) {
 		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
-		            "Error creating the prepared statement: %s",
+		            "Error reading from the database: %s",
 		            sqlite3_errmsg(adapter->db));
 
-		g_list_free_full(ins, g_free);
-		g_list_free_full(froms, g_free);
-		g_list_free_full(keywords, g_free);
+		sqlite3_finalize(stmt);
+		g_mutex_unlock(&adapter->db_lock);
 
-		return NULL;
+		return FALSE;
 	}
 
-	while(ins != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)ins->data, -1, g_free);
-		ins = g_list_delete_link(ins, ins);
+	sqlite3_finalize(stmt);
+
+	g_mutex_unlock(&adapter->db_lock);
+
+	cursor->offset += fetched;
+	if(cursor->limited) {
+		cursor->remaining -= fetched;
 	}
 
-	while(froms != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)froms->data, -1, g_free);
-		froms = g_list_delete_link(froms, froms);
+	if(fetched < range.limit || (cursor->limited && cursor->remaining == 0)) {
+		cursor->done = TRUE;
 	}
 
-	while(keywords != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)keywords->data, -1, g_free);
-		keywords = g_list_delete_link(keywords, keywords);
+	return TRUE;
+}
+
+static PurpleMessage *
+purple_sqlite_history_cursor_next(PurpleHistoryCursor *history_cursor,
+                                  GError **error)
+{
+	PurpleSqliteHistoryCursor *cursor = NULL;
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	PurpleMessage *message = NULL;
+
+	cursor = PURPLE_SQLITE_HISTORY_CURSOR(history_cursor);
+
+	if(g_queue_is_empty(cursor->rows) && !cursor->done) {
+		if(!purple_sqlite_history_cursor_fetch(cursor, error)) {
+			cursor->done = TRUE;
+
+			return NULL;
+		}
 	}
 
-	return prepared_statement;
+	row = g_queue_pop_head(cursor->rows);
+	if(row == NULL) {
+		return NULL;
+	}
+
+	message = purple_sqlite_history_adapter_row_to_message(row);
+	purple_sqlite_history_adapter_row_free(row);
+
+	return message;
+}
+
+static void
+purple_sqlite_history_cursor_finalize(GObject *obj) {
+	PurpleSqliteHistoryCursor *cursor = PURPLE_SQLITE_HISTORY_CURSOR(obj);
+
+	g_clear_object(&cursor->adapter);
+	g_clear_pointer(&cursor->query, g_free);
+	g_queue_free_full(cursor->rows, purple_sqlite_history_adapter_row_free);
+
+	G_OBJECT_CLASS(purple_sqlite_history_cursor_parent_class)->finalize(obj);
+}
+
+static void
+purple_sqlite_history_cursor_init(PurpleSqliteHistoryCursor *cursor) {
+	cursor->rows = g_queue_new();
+}
+
+static void
+purple_sqlite_history_cursor_class_init(PurpleSqliteHistoryCursorClass *klass)
+{
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+	PurpleHistoryCursorClass *cursor_class = PURPLE_HISTORY_CURSOR_CLASS(klass);
+
+	obj_class->finalize = purple_sqlite_history_cursor_finalize;
+
+	cursor_class->next = purple_sqlite_history_cursor_next;
 }
 
 /******************************************************************************
@@ -279,17 +1334,45 @@ purple_sqlite_history_adapter_activate(PurpleHistoryAdapter *adapter,
 		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
 		            _("Error opening database in purplesqlitehistoryadapter for file %s"),
 		            sqlite_adapter->filename);
-		g_clear_pointer(&sqlite_adapter->db, sqlite3_close);
+		purple_sqlite_history_adapter_close(sqlite_adapter);
+
+		return FALSE;
+	}
+
+	if(!purple_sqlite3_apply_connection_profile(sqlite_adapter->db, error)) {
+		purple_sqlite_history_adapter_close(sqlite_adapter);
+
+		return FALSE;
+	}
+
+	sqlite_adapter->statements = purple_sqlite3_statement_cache_new(sqlite_adapter->db);
+
+	if(!purple_sqlite_history_adapter_check_fts5(sqlite_adapter, error) ||
+	   !purple_sqlite_history_adapter_run_migrations(sqlite_adapter, error))
+	{
+		purple_sqlite_history_adapter_close(sqlite_adapter);
 
 		return FALSE;
 	}
 
-	if(!purple_sqlite_history_adapter_run_migrations(sqlite_adapter, error)) {
-		g_clear_pointer(&sqlite_adapter->db, sqlite3_close);
+	if(!purple_sqlite_history_adapter_start_backfill(sqlite_adapter, error)) {
+		purple_sqlite_history_adapter_close(sqlite_adapter);
 
 		return FALSE;
 	}
 
+	if(sqlite_adapter->write_behind) {
+		sqlite_adapter->writer = g_thread_try_new("sqlite-history-writer",
+		                                          purple_sqlite_history_adapter_writer_thread,
+		                                          sqlite_adapter, error);
+		if(sqlite_adapter->writer == NULL) {
+			purple_sqlite_history_adapter_stop_backfill(sqlite_adapter);
+			purple_sqlite_history_adapter_close(sqlite_adapter);
+
+			return FALSE;
+		}
+	}
+
 	return TRUE;
 }
 
@@ -298,9 +1381,24 @@ purple_sqlite_history_adapter_deactivate(PurpleHistoryAdapter *adapter,
                                          G_GNUC_UNUSED GError **error)
 {
 	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+	GError *local_error = NULL;
 
 	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
-	g_clear_pointer(&sqlite_adapter->db, sqlite3_close);
+
+	/* Make sure everything that has been queued hits the disk before we close
+	 * the database.
+	 */
+	if(!purple_sqlite_history_adapter_flush(sqlite_adapter, &local_error)) {
+		purple_debug_warning("sqlite-history-adapter",
+		                     "failed to flush queued messages: %s",
+		                     local_error->message);
+		g_clear_error(&local_error);
+	}
+
+	purple_sqlite_history_adapter_stop_writer(sqlite_adapter);
+	purple_sqlite_history_adapter_stop_backfill(sqlite_adapter);
+
+	purple_sqlite_history_adapter_close(sqlite_adapter);
 
 	return TRUE;
 }
@@ -309,71 +1407,149 @@ static GList*
 purple_sqlite_history_adapter_query(PurpleHistoryAdapter *adapter,
                                     const gchar *query, GError **error)
 {
-	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
-	sqlite3_stmt *prepared_statement = NULL;
+	PurpleHistoryCursor *cursor = NULL;
+	PurpleMessage *message = NULL;
+	GError *local_error = NULL;
 	GList *results = NULL;
 
+	cursor = purple_history_adapter_query_cursor(adapter, query, NULL, 0,
+	                                             error);
+	if(cursor == NULL) {
+		return NULL;
+	}
+
+	while((message = purple_history_cursor_next(cursor, &local_error)) != NULL) {
+		results = g_list_prepend(results, message);
+	}
+
+	g_object_unref(cursor);
+
+	if(local_error != NULL) {
+		g_propagate_error(error, local_error);
+		g_list_free_full(results, g_object_unref);
+
+		return NULL;
+	}
+
+	return g_list_reverse(results);
+}
+
+/* Looks up the rowid of the message with the given id. The caller must be
+ * holding db_lock.
+ */
+static gboolean
+purple_sqlite_history_adapter_find_rowid(PurpleSqliteHistoryAdapter *adapter,
+                                         const char *query,
+                                         const char *message_id,
+                                         sqlite3_int64 *rowid,
+                                         GError **error)
+{
+	PurpleSqliteHistoryAdapterRange range = {
+		.limit = 1,
+		.message_id = message_id,
+	};
+	sqlite3_stmt *stmt = NULL;
+	gboolean found = FALSE;
+
+	/* Message ids are only unique within a conversation, so the message is
+	 * looked for in the conversations the query is about.
+	 */
+	stmt = purple_sqlite_history_adapter_build_query(adapter, query, FALSE,
+	                                                 &range, NULL, error);
+	if(stmt == NULL) {
+		return FALSE;
+	}
+
+	if(sqlite3_step(stmt) == SQLITE_ROW) {
+		*rowid = sqlite3_column_int64(stmt, 0);
+		found = TRUE;
+	} else {
+		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		            "message %s was not found", message_id);
+	}
+
+	sqlite3_finalize(stmt);
+
+	return found;
+}
+
+static PurpleHistoryCursor *
+purple_sqlite_history_adapter_query_cursor(PurpleHistoryAdapter *adapter,
+                                           const gchar *query,
+                                           const gchar *before,
+                                           guint limit, GError **error)
+{
+	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+	PurpleSqliteHistoryCursor *cursor = NULL;
+
 	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
 
 	if(sqlite_adapter->db == NULL) {
 		g_set_error_literal(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
 		                    _("Adapter has not been activated"));
 
-		return FALSE;
+		return NULL;
 	}
 
-	prepared_statement = purple_sqlite_history_adapter_build_query(sqlite_adapter,
-	                                                               query,
-	                                                               FALSE,
-	                                                               error);
+	/* Make sure that anything we've been asked to write is visible to the
+	 * query. Messages that couldn't be written are not this query's problem.
+	 */
+	purple_sqlite_history_adapter_wait_for_writer(sqlite_adapter);
 
-	if(prepared_statement == NULL) {
-		return NULL;
-	}
+	cursor = g_object_new(PURPLE_TYPE_SQLITE_HISTORY_CURSOR, NULL);
+	cursor->adapter = g_object_ref(sqlite_adapter);
+	cursor->query = g_strdup(query);
+	cursor->limited = (limit > 0);
+	cursor->remaining = limit;
 
-	while(sqlite3_step(prepared_statement) == SQLITE_ROW) {
-		PurpleMessage *message = NULL;
-		PurpleMessageContentType ct;
-		GDateTime *g_date_time = NULL;
-		const gchar *message_id = NULL;
-		const gchar *author = NULL;
-		const gchar *author_name_color = NULL;
-		const gchar *author_alias = NULL;
-		const gchar *recipient = NULL;
-		const gchar *content = NULL;
-		const gchar *content_type = NULL;
-		const gchar *timestamp = NULL;
-
-		message_id = (const gchar *)sqlite3_column_text(prepared_statement, 0);
-		author = (const gchar *)sqlite3_column_text(prepared_statement, 1);
-		author_name_color = (const gchar *)sqlite3_column_text(prepared_statement, 2);
-		author_alias = (const gchar *)sqlite3_column_text(prepared_statement, 3);
-		recipient = (const gchar *)sqlite3_column_text(prepared_statement, 4);
-		content_type = (const gchar *)sqlite3_column_text(prepared_statement, 5);
-		ct = purple_sqlite_history_adapter_get_content_type_enum(content_type);
-		content = (const gchar *)sqlite3_column_text(prepared_statement, 6);
-		timestamp = (const gchar *)sqlite3_column_text(prepared_statement, 7);
-		g_date_time = g_date_time_new_from_iso8601(timestamp, NULL);
-
-		message = g_object_new(PURPLE_TYPE_MESSAGE,
-		                       "id", message_id,
-		                       "author", author,
-		                       "author_name_color", author_name_color,
-		                       "author_alias", author_alias,
-		                       "recipient", recipient,
-		                       "contents", content,
-		                       "content_type", ct,
-		                       "timestamp", g_date_time,
-		                       NULL);
+	g_mutex_lock(&sqlite_adapter->db_lock);
 
-		results = g_list_prepend(results, message);
+	if(before != NULL) {
+		if(!purple_sqlite_history_adapter_find_rowid(sqlite_adapter, query,
+		                                             before, &cursor->before,
+		                                             error))
+		{
+			g_mutex_unlock(&sqlite_adapter->db_lock);
+			g_object_unref(cursor);
+
+			return NULL;
+		}
 	}
 
-	results = g_list_reverse(results);
+	/* When paging through messages in the order they were written we want
+	 * the limit messages closest to before, so find the row right before that
+	 * window and start after it.
+	 */
+	if(limit > 0) {
+		PurpleSqliteHistoryAdapterRange range = {
+			.before = cursor->before,
+			.descending = TRUE,
+			.limit = 1,
+			.offset = limit,
+		};
+		sqlite3_stmt *stmt = NULL;
+
+		stmt = purple_sqlite_history_adapter_build_query(sqlite_adapter, query,
+		                                                 FALSE, &range,
+		                                                 &cursor->ranked,
+		                                                 error);
+		if(stmt == NULL) {
+			g_mutex_unlock(&sqlite_adapter->db_lock);
+			g_object_unref(cursor);
+
+			return NULL;
+		}
 
-	sqlite3_finalize(prepared_statement);
+		if(!cursor->ranked && sqlite3_step(stmt) == SQLITE_ROW) {
+			cursor->after = sqlite3_column_int64(stmt, 0);
+		}
+
+		sqlite3_finalize(stmt);
+	}
+
+	g_mutex_unlock(&sqlite_adapter->db_lock);
 
-	return results;
+	return PURPLE_HISTORY_CURSOR(cursor);
 }
 
 static gboolean
@@ -393,12 +1569,21 @@ purple_sqlite_history_adapter_remove(PurpleHistoryAdapter *adapter,
 		return FALSE;
 	}
 
+	/* Queued messages that match the query need to be removed too. */
+	purple_sqlite_history_adapter_wait_for_writer(sqlite_adapter);
+
+	g_mutex_lock(&sqlite_adapter->db_lock);
+
 	prepared_statement = purple_sqlite_history_adapter_build_query(sqlite_adapter,
 	                                                               query,
 	                                                               TRUE,
+	                                                               NULL,
+	                                                               NULL,
 	                                                               error);
 
 	if(prepared_statement == NULL) {
+		g_mutex_unlock(&sqlite_adapter->db_lock);
+
 		return FALSE;
 	}
 
@@ -410,11 +1595,13 @@ purple_sqlite_history_adapter_remove(PurpleHistoryAdapter *adapter,
 		            sqlite3_errmsg(sqlite_adapter->db));
 
 		sqlite3_finalize(prepared_statement);
+		g_mutex_unlock(&sqlite_adapter->db_lock);
 
 		return FALSE;
 	}
 
 	sqlite3_finalize(prepared_statement);
+	g_mutex_unlock(&sqlite_adapter->db_lock);
 
 	return TRUE;
 }
@@ -424,20 +1611,10 @@ purple_sqlite_history_adapter_write(PurpleHistoryAdapter *adapter,
                                     PurpleConversation *conversation,
                                     PurpleMessage *message, GError **error)
 {
-	PurpleAccount *account = NULL;
-	PurpleContactInfo *info = NULL;
 	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
-	sqlite3_stmt *prepared_statement = NULL;
-	gchar *timestamp = NULL;
-	gchar *content_type = NULL;
-	const gchar * message_id = NULL;
-	const gchar *script = NULL;
-	gint result = 0;
-
-	script = "INSERT INTO message_log(protocol, account, conversation_id, "
-			 "message_id, author, author_name_color, author_alias, "
-			 "recipient, content_type, content, client_timestamp) "
-	         "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	GList rows = { NULL, NULL, NULL };
+	gboolean success = FALSE;
 
 	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
 
@@ -448,71 +1625,37 @@ purple_sqlite_history_adapter_write(PurpleHistoryAdapter *adapter,
 		return FALSE;
 	}
 
-	sqlite3_prepare_v2(sqlite_adapter->db, script, -1, &prepared_statement, NULL);
+	row = purple_sqlite_history_adapter_row_new(conversation, message);
 
-	if(prepared_statement == NULL) {
-		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
-		            "Error creating the prepared statement: %s",
-		            sqlite3_errmsg(sqlite_adapter->db));
-		return FALSE;
-	}
-
-	account = purple_conversation_get_account(conversation);
-	info = PURPLE_CONTACT_INFO(account);
+	/* In write-behind mode we just hand the row off to the writer thread,
+	 * unless it has fallen too far behind, in which case we wait for it to
+	 * catch up.
+	 */
+	if(sqlite_adapter->writer != NULL) {
+		g_mutex_lock(&sqlite_adapter->queue_lock);
+		while(g_queue_get_length(sqlite_adapter->queue) >= PURPLE_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE &&
+		      !sqlite_adapter->stopping)
+		{
+			g_cond_wait(&sqlite_adapter->queue_cond,
+			            &sqlite_adapter->queue_lock);
+		}
+		g_queue_push_tail(sqlite_adapter->queue, row);
+		g_cond_broadcast(&sqlite_adapter->queue_cond);
+		g_mutex_unlock(&sqlite_adapter->queue_lock);
 
-	sqlite3_bind_text(prepared_statement,
-	                  1, purple_account_get_protocol_name(account), -1,
-	                  SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  2, purple_contact_info_get_username(info), -1,
-	                  SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  3, purple_conversation_get_name(conversation), -1,
-	                  SQLITE_STATIC);
-	message_id = purple_message_get_id(message);
-	if(message_id != NULL) {
-		sqlite3_bind_text(prepared_statement, 4, message_id, -1,
-		                  SQLITE_STATIC);
-	} else {
-		sqlite3_bind_text(prepared_statement, 4, g_uuid_string_random(), -1,
-		                  g_free);
+		return TRUE;
 	}
-	sqlite3_bind_text(prepared_statement,
-	                  5, purple_message_get_author(message), -1,
-	                  SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  6, purple_message_get_author_name_color(message), -1,
-	                  SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  7, purple_message_get_author_alias(message), -1,
-	                  SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  8, purple_message_get_recipient(message), -1,
-	                  SQLITE_STATIC);
-	content_type = purple_sqlite_history_adapter_get_content_type(purple_message_get_content_type(message));
-	sqlite3_bind_text(prepared_statement,
-	                  9, content_type, -1, SQLITE_STATIC);
-	sqlite3_bind_text(prepared_statement,
-	                  10, purple_message_get_contents(message), -1,
-	                  SQLITE_STATIC);
-	timestamp = g_date_time_format_iso8601(purple_message_get_timestamp(message));
-	sqlite3_bind_text(prepared_statement, 11, timestamp, -1, g_free);
 
-	result = sqlite3_step(prepared_statement);
-
-	if(result != SQLITE_DONE) {
-		g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
-		            "Error writing to the database: %s",
-		            sqlite3_errmsg(sqlite_adapter->db));
-
-		sqlite3_finalize(prepared_statement);
+	rows.data = row;
 
-		return FALSE;
-	}
+	g_mutex_lock(&sqlite_adapter->db_lock);
+	success = purple_sqlite_history_adapter_insert_rows(sqlite_adapter, &rows,
+	                                                    error);
+	g_mutex_unlock(&sqlite_adapter->db_lock);
 
-	sqlite3_finalize(prepared_statement);
+	purple_sqlite_history_adapter_row_free(row);
 
-	return TRUE;
+	return success;
 }
 
 /******************************************************************************
@@ -529,6 +1672,10 @@ purple_sqlite_history_adapter_get_property(GObject *obj, guint param_id,
 			g_value_set_string(value,
 			                   purple_sqlite_history_adapter_get_filename(adapter));
 			break;
+		case PROP_WRITE_BEHIND:
+			g_value_set_boolean(value,
+			                    purple_sqlite_history_adapter_get_write_behind(adapter));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -547,6 +1694,10 @@ purple_sqlite_history_adapter_set_property(GObject *obj, guint param_id,
 			purple_sqlite_history_adapter_set_filename(adapter,
 			                                           g_value_get_string(value));
 			break;
+		case PROP_WRITE_BEHIND:
+			purple_sqlite_history_adapter_set_write_behind(adapter,
+			                                               g_value_get_boolean(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -565,15 +1716,29 @@ purple_sqlite_history_adapter_finalize(GObject *obj) {
 		g_warning("PurpleSqliteHistoryAdapter was finalized before being "
 		          "deactivated");
 
-		g_clear_pointer(&adapter->db, sqlite3_close);
+		purple_sqlite_history_adapter_stop_writer(adapter);
+		purple_sqlite_history_adapter_stop_backfill(adapter);
+		purple_sqlite_history_adapter_close(adapter);
 	}
 
+	g_queue_free_full(adapter->queue, purple_sqlite_history_adapter_row_free);
+	g_queue_free_full(adapter->failed, purple_sqlite_history_adapter_row_free);
+
+	g_mutex_clear(&adapter->db_lock);
+	g_mutex_clear(&adapter->queue_lock);
+	g_cond_clear(&adapter->queue_cond);
+
 	G_OBJECT_CLASS(purple_sqlite_history_adapter_parent_class)->finalize(obj);
 }
 
 static void
-purple_sqlite_history_adapter_init(G_GNUC_UNUSED PurpleSqliteHistoryAdapter *adapter)
-{
+purple_sqlite_history_adapter_init(PurpleSqliteHistoryAdapter *adapter) {
+	g_mutex_init(&adapter->db_lock);
+	g_mutex_init(&adapter->queue_lock);
+	g_cond_init(&adapter->queue_cond);
+
+	adapter->queue = g_queue_new();
+	adapter->failed = g_queue_new();
 }
 
 static void
@@ -589,6 +1754,7 @@ purple_sqlite_history_adapter_class_init(PurpleSqliteHistoryAdapterClass *klass)
 	adapter_class->activate = purple_sqlite_history_adapter_activate;
 	adapter_class->deactivate = purple_sqlite_history_adapter_deactivate;
 	adapter_class->query = purple_sqlite_history_adapter_query;
+	adapter_class->query_cursor = purple_sqlite_history_adapter_query_cursor;
 	adapter_class->remove = purple_sqlite_history_adapter_remove;
 	adapter_class->write = purple_sqlite_history_adapter_write;
 
@@ -605,6 +1771,24 @@ purple_sqlite_history_adapter_class_init(PurpleSqliteHistoryAdapterClass *klass)
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS
 	);
 
+	/**
+	 * PurpleSqliteHistoryAdapter:write-behind:
+	 *
+	 * Whether or not messages should be queued in memory and written to the
+	 * database by a background thread in batched transactions.
+	 *
+	 * Queries and removals always wait for the queue to be written so they
+	 * will see every message that has been written to the adapter.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_WRITE_BEHIND] = g_param_spec_boolean(
+		"write-behind", "write-behind",
+		"Whether or not to write messages from a background thread",
+		TRUE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS
+	);
+
 	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
 }
 
@@ -632,3 +1816,100 @@ purple_sqlite_history_adapter_get_filename(PurpleSqliteHistoryAdapter *adapter)
 
 	return sqlite_adapter->filename;
 }
+
+gboolean
+purple_sqlite_history_adapter_get_write_behind(PurpleSqliteHistoryAdapter *adapter)
+{
+	g_return_val_if_fail(PURPLE_IS_SQLITE_HISTORY_ADAPTER(adapter), FALSE);
+
+	return adapter->write_behind;
+}
+
+gboolean
+purple_sqlite_history_adapter_flush(PurpleSqliteHistoryAdapter *adapter,
+                                    GError **error)
+{
+	PurpleSqliteHistoryAdapterRow *row = NULL;
+	GQueue retry = G_QUEUE_INIT;
+	GQueue failed = G_QUEUE_INIT;
+	GError *local_error = NULL;
+	guint n_failed = 0;
+
+	g_return_val_if_fail(PURPLE_IS_SQLITE_HISTORY_ADAPTER(adapter), FALSE);
+
+	purple_sqlite_history_adapter_wait_for_writer(adapter);
+
+	g_mutex_lock(&adapter->queue_lock);
+	while(!g_queue_is_empty(adapter->failed)) {
+		g_queue_push_tail(&retry, g_queue_pop_head(adapter->failed));
+	}
+	g_mutex_unlock(&adapter->queue_lock);
+
+	if(g_queue_is_empty(&retry)) {
+		return TRUE;
+	}
+
+	g_mutex_lock(&adapter->db_lock);
+	if(adapter->db != NULL) {
+		n_failed = purple_sqlite_history_adapter_insert_each(adapter, &retry,
+		                                                     &failed,
+		                                                     &local_error);
+	} else {
+		n_failed = retry.length;
+		g_set_error_literal(&local_error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+		                    _("Adapter has not been activated"));
+		while(!g_queue_is_empty(&retry)) {
+			g_queue_push_tail(&failed, g_queue_pop_head(&retry));
+		}
+	}
+	g_mutex_unlock(&adapter->db_lock);
+
+	if(n_failed == 0) {
+		return TRUE;
+	}
+
+	/* Put them back in front of anything that has failed since, so they're
+	 * retried in the order they were written.
+	 */
+	g_mutex_lock(&adapter->queue_lock);
+	while((row = g_queue_pop_tail(&failed)) != NULL) {
+		g_queue_push_head(adapter->failed, row);
+	}
+	g_mutex_unlock(&adapter->queue_lock);
+
+	g_set_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0,
+	            "%u messages could not be written and are still queued: %s",
+	            n_failed, local_error->message);
+	g_clear_error(&local_error);
+
+	return FALSE;
+}
+
+guint
+purple_sqlite_history_adapter_get_queue_depth(PurpleSqliteHistoryAdapter *adapter)
+{
+	guint depth = 0;
+
+	g_return_val_if_fail(PURPLE_IS_SQLITE_HISTORY_ADAPTER(adapter), 0);
+
+	g_mutex_lock(&adapter->queue_lock);
+	depth = g_queue_get_length(adapter->queue) + adapter->in_flight +
+	        g_queue_get_length(adapter->failed);
+	g_mutex_unlock(&adapter->queue_lock);
+
+	return depth;
+}
+
+gint64
+purple_sqlite_history_adapter_get_commit_latency(PurpleSqliteHistoryAdapter *adapter)
+{
+	gint64 latency = 0;
+
+	g_return_val_if_fail(PURPLE_IS_SQLITE_HISTORY_ADAPTER(adapter), 0);
+
+	g_mutex_lock(&adapter->queue_lock);
+	latency = adapter->commit_latency;
+	g_mutex_unlock(&adapter->queue_lock);
+
+	return latency;
+}
@@ -68,6 +68,67 @@ PurpleHistoryAdapter *purple_sqlite_history_adapter_new(const gchar *filename);
  */
 const gchar *purple_sqlite_history_adapter_get_filename(PurpleSqliteHistoryAdapter *adapter);
 
+/**
+ * purple_sqlite_history_adapter_get_write_behind:
+ * @adapter: The instance.
+ *
+ * Gets whether or not @adapter queues messages and writes them from a
+ * background thread.
+ *
+ * Returns: %TRUE if write-behind mode is enabled, otherwise %FALSE.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_sqlite_history_adapter_get_write_behind(PurpleSqliteHistoryAdapter *adapter);
+
+/**
+ * purple_sqlite_history_adapter_flush:
+ * @adapter: The instance.
+ * @error: Return address for a #GError, or %NULL.
+ *
+ * Blocks until every message that has been queued in @adapter has been
+ * written to the database.
+ *
+ * Queued messages are written in batches. If a batch fails, its messages are
+ * retried one at a time. Messages that still can't be written stay queued and
+ * are retried by every call to this function until they succeed.
+ *
+ * This is a no-op if @adapter is not in write-behind mode.
+ *
+ * Returns: %TRUE on success, or %FALSE with @error set on error.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_sqlite_history_adapter_flush(PurpleSqliteHistoryAdapter *adapter, GError **error);
+
+/**
+ * purple_sqlite_history_adapter_get_queue_depth:
+ * @adapter: The instance.
+ *
+ * Gets the number of messages that have been written to @adapter but have not
+ * been committed to the database yet, including the ones that failed to be
+ * written and are waiting for the next purple_sqlite_history_adapter_flush().
+ *
+ * Returns: The number of pending messages.
+ *
+ * Since: 3.0.0
+ */
+guint purple_sqlite_history_adapter_get_queue_depth(PurpleSqliteHistoryAdapter *adapter);
+
+/**
+ * purple_sqlite_history_adapter_get_commit_latency:
+ * @adapter: The instance.
+ *
+ * Gets how long the most recent batch of queued messages took to be committed
+ * to the database.
+ *
+ * Returns: The latency of the last commit in microseconds, or 0 if nothing
+ *          has been committed by the background writer yet.
+ *
+ * Since: 3.0.0
+ */
+gint64 purple_sqlite_history_adapter_get_commit_latency(PurpleSqliteHistoryAdapter *adapter);
+
 G_END_DECLS
 
 #endif /* PURPLE_SQLITE_HISTORY_ADAPTER */
@@ -0,0 +1,48 @@
+-- Full text index over message_log.content. This is an external content
+-- table, so the text itself is only stored once in message_log and the
+-- triggers below keep the index in sync.
+CREATE VIRTUAL TABLE message_log_fts USING fts5
+(
+        content,
+        content='message_log',
+        content_rowid='rowid'
+);
+
+-- Messages that were logged before this migration are indexed in the
+-- background, newest first. Every row with a rowid less than or equal to
+-- next_rowid has not been indexed yet and next_rowid is 0 once the backfill
+-- has completed.
+CREATE TABLE message_log_fts_backfill
+(
+        next_rowid INTEGER NOT NULL
+);
+
+INSERT INTO message_log_fts_backfill(next_rowid)
+        SELECT COALESCE(MAX(rowid), 0) FROM message_log;
+
+-- Rows at or below next_rowid are left for the backfill, which can only
+-- happen if rowids are reused after the newest unindexed rows are deleted.
+CREATE TRIGGER message_log_fts_insert AFTER INSERT ON message_log
+        WHEN new.rowid > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(rowid, content)
+                VALUES(new.rowid, new.content);
+END;
+
+-- Rows that haven't been backfilled yet aren't in the index, and telling fts5
+-- to delete something it doesn't have corrupts the index.
+CREATE TRIGGER message_log_fts_delete AFTER DELETE ON message_log
+        WHEN old.rowid > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(message_log_fts, rowid, content)
+                VALUES('delete', old.rowid, old.content);
+END;
+
+CREATE TRIGGER message_log_fts_update AFTER UPDATE OF content ON message_log
+        WHEN old.rowid > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(message_log_fts, rowid, content)
+                VALUES('delete', old.rowid, old.content);
+        INSERT INTO message_log_fts(rowid, content)
+                VALUES(new.rowid, new.content);
+END;
@@ -0,0 +1,89 @@
+-- Messages that were logged more than once in the same conversation are
+-- removed first so that the delete trigger keeps the full text index in sync.
+DELETE FROM message_log WHERE rowid NOT IN
+(
+        SELECT MIN(rowid) FROM message_log
+                GROUP BY protocol, account, conversation_id, message_id
+);
+
+-- Rebuild the table with an explicit primary key and timestamps stored as
+-- microseconds since the unix epoch. The id column is an alias for the
+-- rowid, so existing rowids are kept and the full text index stays valid.
+CREATE TABLE message_log_new
+(
+        id INTEGER PRIMARY KEY,
+        protocol TEXT NOT NULL, -- examples: slack, xmpp, irc, discord
+        account TEXT NOT NULL, -- example: grim@reaperworld.com@milwaukee.slack.com
+        conversation_id TEXT NOT NULL, -- example: #general
+        message_id TEXT NOT NULL, -- exampe: 14fdjakafjakl1155
+        author TEXT NULL, -- could be null for status messages
+        author_name_color TEXT NULL,
+        author_alias TEXT NULL,
+        recipient TEXT NULL,
+        content_type TEXT NULL CHECK(content_type IN ('plain', 'html', 'xhtml', 'markdown', 'bbcode')),
+        content TEXT NULL, -- must be UTF8 string
+        raw_content TEXT NULL, -- the message as came from the protocol
+        protocol_timestamp INTEGER NULL, -- according to protocol, could be wrong
+        client_timestamp INTEGER NULL, -- when it "landed" in libpurple
+        log_version INTEGER DEFAULT 1 NOT NULL
+);
+
+-- The old timestamps were ISO 8601 strings. SQLite's date functions only
+-- understand milliseconds, so that is the precision existing messages keep.
+INSERT INTO message_log_new
+        SELECT rowid, protocol, account, conversation_id, message_id, author,
+                author_name_color, author_alias, recipient, content_type,
+                content, raw_content,
+                CAST(strftime('%s', protocol_timestamp) AS INTEGER) * 1000000 +
+                        CAST(ROUND(strftime('%f', protocol_timestamp) * 1000) AS INTEGER) % 1000 * 1000,
+                CAST(strftime('%s', client_timestamp) AS INTEGER) * 1000000 +
+                        CAST(ROUND(strftime('%f', client_timestamp) * 1000) AS INTEGER) % 1000 * 1000,
+                log_version
+        FROM message_log;
+
+-- Dropping the old table drops the full text index triggers as well, so they
+-- are recreated below.
+DROP TABLE message_log;
+ALTER TABLE message_log_new RENAME TO message_log;
+
+-- A message id is only logged once per conversation. Leading with message_id
+-- also lets us find a message to page from by its id.
+CREATE UNIQUE INDEX message_log_message_id ON message_log
+(
+        message_id, conversation_id, account, protocol
+);
+
+-- in: queries are always ordered by id, so this covers both the lookup and
+-- the ordering of "the last N messages in this conversation".
+CREATE INDEX message_log_conversation ON message_log
+(
+        conversation_id, id
+);
+
+CREATE INDEX message_log_author ON message_log
+(
+        author
+);
+
+CREATE TRIGGER message_log_fts_insert AFTER INSERT ON message_log
+        WHEN new.id > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(rowid, content)
+                VALUES(new.id, new.content);
+END;
+
+CREATE TRIGGER message_log_fts_delete AFTER DELETE ON message_log
+        WHEN old.id > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(message_log_fts, rowid, content)
+                VALUES('delete', old.id, old.content);
+END;
+
+CREATE TRIGGER message_log_fts_update AFTER UPDATE OF content ON message_log
+        WHEN old.id > (SELECT next_rowid FROM message_log_fts_backfill)
+BEGIN
+        INSERT INTO message_log_fts(message_log_fts, rowid, content)
+                VALUES('delete', old.id, old.content);
+        INSERT INTO message_log_fts(rowid, content)
+                VALUES(new.id, new.content);
+END;
@@ -28,12 +28,20 @@
 /* This must be after roomlist.h otherwise you'll get an include cycle. */
 #include "purpleprotocolroomlist.h"
 
+/* Rooms that arrive while a list is being fetched are announced to the
+ * GListModel in batches, either once this many have arrived or after
+ * PURPLE_ROOMLIST_BATCH_INTERVAL milliseconds, whichever comes first. */
+#define PURPLE_ROOMLIST_BATCH_SIZE 1024
+#define PURPLE_ROOMLIST_BATCH_INTERVAL 100
+
 /*
  * Private data for a room list.
  */
 typedef struct {
 	PurpleAccount *account;  /* The account this list belongs to. */
-	GList *rooms;            /* The list of rooms.                */
+	GPtrArray *rooms;        /* The rooms, including pending ones. */
+	guint n_announced;       /* How many rooms the model exposes. */
+	guint batch_timeout;     /* Announces the pending rooms.      */
 	gboolean in_progress;    /* The listing is in progress.       */
 } PurpleRoomlistPrivate;
 
@@ -49,7 +57,87 @@ enum
 static GParamSpec *properties[PROP_LAST];
 static PurpleRoomlistUiOps *ops = NULL;
 
-G_DEFINE_TYPE_WITH_PRIVATE(PurpleRoomlist, purple_roomlist, G_TYPE_OBJECT);
+static void purple_roomlist_list_model_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(PurpleRoomlist, purple_roomlist, G_TYPE_OBJECT,
+                        G_ADD_PRIVATE(PurpleRoomlist)
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              purple_roomlist_list_model_init))
+
+/**************************************************************************/
+/* Helpers                                                                */
+/**************************************************************************/
+
+/* Tells the model's listeners about every room that has arrived since the
+ * last batch. */
+static void
+purple_roomlist_flush(PurpleRoomlist *list)
+{
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+	guint position = priv->n_announced;
+	guint added = priv->rooms->len - priv->n_announced;
+
+	g_clear_handle_id(&priv->batch_timeout, g_source_remove);
+
+	if(added == 0) {
+		return;
+	}
+
+	priv->n_announced = priv->rooms->len;
+	g_list_model_items_changed(G_LIST_MODEL(list), position, 0, added);
+}
+
+static gboolean
+purple_roomlist_batch_timeout_cb(gpointer data)
+{
+	PurpleRoomlist *list = data;
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+
+	priv->batch_timeout = 0;
+	purple_roomlist_flush(list);
+
+	return G_SOURCE_REMOVE;
+}
+
+/**************************************************************************/
+/* GListModel Implementation                                              */
+/**************************************************************************/
+
+static GType
+purple_roomlist_get_item_type(G_GNUC_UNUSED GListModel *model)
+{
+	return PURPLE_TYPE_ROOMLIST_ROOM;
+}
+
+static guint
+purple_roomlist_get_n_items(GListModel *model)
+{
+	PurpleRoomlistPrivate *priv =
+			purple_roomlist_get_instance_private(PURPLE_ROOMLIST(model));
+
+	return priv->n_announced;
+}
+
+static gpointer
+purple_roomlist_get_item(GListModel *model, guint position)
+{
+	PurpleRoomlistPrivate *priv =
+			purple_roomlist_get_instance_private(PURPLE_ROOMLIST(model));
+
+	if(position >= priv->n_announced) {
+		return NULL;
+	}
+
+	return g_object_ref(g_ptr_array_index(priv->rooms, position));
+}
+
+static void
+purple_roomlist_list_model_init(GListModelInterface *iface)
+{
+	iface->get_item_type = purple_roomlist_get_item_type;
+	iface->get_n_items = purple_roomlist_get_n_items;
+	iface->get_item = purple_roomlist_get_item;
+}
 
 /**************************************************************************/
 /* Room List API                                                          */
@@ -80,6 +168,11 @@ void purple_roomlist_set_in_progress(PurpleRoomlist *list, gboolean in_progress)
 	priv = purple_roomlist_get_instance_private(list);
 	priv->in_progress = in_progress;
 
+	/* Don't keep the last rooms waiting once the list is complete. */
+	if(!in_progress) {
+		purple_roomlist_flush(list);
+	}
+
 	g_object_notify_by_pspec(G_OBJECT(list), properties[PROP_IN_PROGRESS]);
 }
 
@@ -101,10 +194,18 @@ void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room)
 	g_return_if_fail(room != NULL);
 
 	priv = purple_roomlist_get_instance_private(list);
-	priv->rooms = g_list_append(priv->rooms, room);
+	g_ptr_array_add(priv->rooms, room);
 
 	if (ops && ops->add_room)
 		ops->add_room(list, room);
+
+	if(priv->rooms->len - priv->n_announced >= PURPLE_ROOMLIST_BATCH_SIZE) {
+		purple_roomlist_flush(list);
+	} else if(priv->batch_timeout == 0) {
+		priv->batch_timeout = g_timeout_add(PURPLE_ROOMLIST_BATCH_INTERVAL,
+		                                    purple_roomlist_batch_timeout_cb,
+		                                    list);
+	}
 }
 
 PurpleRoomlist *purple_roomlist_get_list(PurpleConnection *gc)
@@ -228,8 +329,11 @@ purple_roomlist_get_property(GObject *obj, guint param_id, GValue *value,
 }
 
 static void
-purple_roomlist_init(G_GNUC_UNUSED PurpleRoomlist *list)
+purple_roomlist_init(PurpleRoomlist *list)
 {
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+
+	priv->rooms = g_ptr_array_new_with_free_func(g_object_unref);
 }
 
 /* Called when done constructing */
@@ -254,7 +358,8 @@ purple_roomlist_finalize(GObject *object)
 
 	purple_debug_misc("roomlist", "destroying list %p\n", list);
 
-	g_list_free_full(priv->rooms, g_object_unref);
+	g_clear_handle_id(&priv->batch_timeout, g_source_remove);
+	g_ptr_array_free(priv->rooms, TRUE);
 
 	G_OBJECT_CLASS(purple_roomlist_parent_class)->finalize(object);
 }
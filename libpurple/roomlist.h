@@ -55,6 +55,7 @@ typedef enum
 
 #include "account.h"
 #include <glib.h>
+#include <gio/gio.h>
 #include "purpleroomlistroom.h"
 
 /**************************************************************************/
@@ -66,7 +67,9 @@ typedef enum
  * @show_with_account: Force the ui to pop up a dialog and get the list.
  * @create:            A new list was created.
  * @set_fields:        Sets the columns.
- * @add_room:          Add a room to the list.
+ * @add_room:          Add a room to the list. UIs that can should watch the
+ *                     list's #GListModel instead, which announces rooms in
+ *                     batches.
  *
  * The room list ops to be filled out by the UI.
  */
@@ -87,6 +90,12 @@ struct _PurpleRoomlistUiOps {
  * PurpleRoomlist:
  *
  * Represents a list of rooms for a given connection on a given protocol.
+ *
+ * The list is a #GListModel of #PurpleRoomlistRoom. While it is being
+ * fetched, new rooms are announced with #GListModel::items-changed in
+ * batches rather than one at a time, so lists of many thousands of rooms
+ * don't flood the UI. Anything still pending is announced as soon as
+ * #PurpleRoomlist:in-progress becomes %FALSE.
  */
 struct _PurpleRoomlist {
 	GObject gparent;
@@ -183,7 +192,8 @@ gboolean purple_roomlist_get_in_progress(PurpleRoomlist *list);
  * @room: The room to add to the list. The GList of fields must be in the same
                order as was given in purple_roomlist_set_fields().
  *
- * Adds a room to the list of them.
+ * Adds a room to the list of them. The room takes the place of the caller's
+ * reference, and shows up in the #GListModel with the next batch.
 */
 void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room);
 
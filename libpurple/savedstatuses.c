@@ -26,6 +26,7 @@
 #include "idle.h"
 #include "notify.h"
 #include "purpleaccountmanager.h"
+#include "purpleconfigjournal.h"
 #include "purplemarkup.h"
 #include "savedstatuses.h"
 #include "request.h"
@@ -85,6 +86,7 @@ struct _PurpleSavedStatusSub
 static GList      *saved_statuses = NULL;
 static guint       save_timer = 0;
 static gboolean    statuses_loaded = FALSE;
+static PurpleConfigJournal *statuses_journal = NULL;
 
 /*
  * This hash table keeps track of which timestamps we've
@@ -329,11 +331,26 @@ statuses_to_xmlnode(void)
 	return node;
 }
 
+/* Saved statuses are identified by their creation time. */
+static gchar *
+statuses_journal_key(PurpleXmlNode *node, guint depth, gboolean *container)
+{
+	if (depth == 0)
+	{
+		*container = TRUE;
+		return g_strdup(node->name);
+	}
+
+	if (!purple_strequal(node->name, "status"))
+		return NULL;
+
+	return g_strdup(purple_xmlnode_get_attrib(node, "created"));
+}
+
 static void
 sync_statuses(void)
 {
 	PurpleXmlNode *node;
-	char *data;
 
 	if (!statuses_loaded)
 	{
@@ -343,9 +360,8 @@ sync_statuses(void)
 	}
 
 	node = statuses_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("status.xml", data, -1);
-	g_free(data);
+	purple_config_journal_replace(statuses_journal, NULL, node);
+	purple_config_journal_save(statuses_journal);
 	purple_xmlnode_free(node);
 }
 
@@ -522,6 +538,19 @@ parse_status(PurpleXmlNode *status)
 	return ret;
 }
 
+static void
+load_status_node(PurpleXmlNode *node, G_GNUC_UNUSED gpointer data)
+{
+	PurpleSavedStatus *new;
+
+	/* The root element is passed in too, but only its children matter. */
+	if (node->parent == NULL || !purple_strequal(node->name, "status"))
+		return;
+
+	new = parse_status(node);
+	saved_statuses = g_list_prepend(saved_statuses, new);
+}
+
 /*
  * load_statuses:
  *
@@ -533,25 +562,17 @@ parse_status(PurpleXmlNode *status)
 static void
 load_statuses(void)
 {
-	PurpleXmlNode *statuses, *status;
-
 	statuses_loaded = TRUE;
 
-	statuses = purple_util_read_xml_from_config_file("status.xml", _("saved statuses"));
+	statuses_journal = purple_config_journal_new("status.xml",
+	                                             statuses_journal_key);
+	purple_config_journal_recover(statuses_journal);
 
-	if (statuses == NULL)
-		return;
+	/* A damaged file may still have handed over some statuses. */
+	purple_util_stream_xml_from_config_file("status.xml", _("saved statuses"),
+	                                        1, load_status_node, NULL);
 
-	for (status = purple_xmlnode_get_child(statuses, "status"); status != NULL;
-			status = purple_xmlnode_get_next_twin(status))
-	{
-		PurpleSavedStatus *new;
-		new = parse_status(status);
-		saved_statuses = g_list_prepend(saved_statuses, new);
-	}
 	saved_statuses = g_list_sort(saved_statuses, saved_statuses_sort_func);
-
-	purple_xmlnode_free(statuses);
 }
 
 
@@ -1266,6 +1287,8 @@ purple_savedstatuses_uninit(void)
 		sync_statuses();
 	}
 
+	g_clear_pointer(&statuses_journal, purple_config_journal_free);
+
 	g_clear_list(&saved_statuses, (GDestroyNotify)free_saved_status);
 
 	g_clear_pointer(&creation_times, g_hash_table_destroy);
@@ -17,6 +17,7 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <sqlite3.h>
 
@@ -435,6 +436,330 @@ test_sqlite3_resource_migrations_older(void) {
 	g_assert_cmpint(rc, ==, SQLITE_OK);
 }
 
+/******************************************************************************
+ * connection profile tests
+ *****************************************************************************/
+static void
+test_sqlite3_connection_profile_file(void) {
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt = NULL;
+	char *dir = NULL;
+	char *filename = NULL;
+	gboolean res = FALSE;
+	int rc = 0;
+
+	dir = g_dir_make_tmp("test_sqlite3_XXXXXX", &error);
+	g_assert_no_error(error);
+	filename = g_build_filename(dir, "profile.db", NULL);
+
+	rc = sqlite3_open(filename, &db);
+	g_assert_nonnull(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	res = purple_sqlite3_apply_connection_profile(db, &error);
+	g_assert_no_error(error);
+	g_assert_true(res);
+
+	rc = sqlite3_prepare_v2(db, "PRAGMA journal_mode", -1, &stmt, NULL);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+	g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_ROW);
+	g_assert_cmpstr((const char *)sqlite3_column_text(stmt, 0), ==, "wal");
+	sqlite3_finalize(stmt);
+
+	/* NORMAL is 1. */
+	rc = sqlite3_prepare_v2(db, "PRAGMA synchronous", -1, &stmt, NULL);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+	g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_ROW);
+	g_assert_cmpint(sqlite3_column_int(stmt, 0), ==, 1);
+	sqlite3_finalize(stmt);
+
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	g_remove(filename);
+	g_rmdir(dir);
+	g_free(filename);
+	g_free(dir);
+}
+
+static void
+test_sqlite3_connection_profile_memory(void) {
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	gboolean res = FALSE;
+	int rc = 0;
+
+	rc = sqlite3_open(":memory:", &db);
+	g_assert_nonnull(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	res = purple_sqlite3_apply_connection_profile(db, &error);
+	g_assert_no_error(error);
+	g_assert_true(res);
+
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+}
+
+/******************************************************************************
+ * statement cache tests
+ *****************************************************************************/
+static void
+test_sqlite3_statement_cache_reuse(void) {
+	PurpleSqlite3StatementCache *cache = NULL;
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt1 = NULL;
+	sqlite3_stmt *stmt2 = NULL;
+	int rc = 0;
+
+	rc = sqlite3_open(":memory:", &db);
+	g_assert_nonnull(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	cache = purple_sqlite3_statement_cache_new(db);
+
+	stmt1 = purple_sqlite3_statement_cache_get(cache, "SELECT ?", &error);
+	g_assert_no_error(error);
+	g_assert_nonnull(stmt1);
+
+	sqlite3_bind_int(stmt1, 1, 42);
+	g_assert_cmpint(sqlite3_step(stmt1), ==, SQLITE_ROW);
+	g_assert_cmpint(sqlite3_column_int(stmt1, 0), ==, 42);
+
+	/* Getting the same SQL again should give us the same statement back with
+	 * its bindings cleared.
+	 */
+	stmt2 = purple_sqlite3_statement_cache_get(cache, "SELECT ?", &error);
+	g_assert_no_error(error);
+	g_assert_true(stmt1 == stmt2);
+
+	g_assert_cmpint(sqlite3_step(stmt2), ==, SQLITE_ROW);
+	g_assert_cmpint(sqlite3_column_type(stmt2, 0), ==, SQLITE_NULL);
+	sqlite3_reset(stmt2);
+
+	purple_sqlite3_statement_cache_free(cache);
+
+	/* The cache has to finalize its statements or this would fail with
+	 * SQLITE_BUSY.
+	 */
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+}
+
+static void
+test_sqlite3_statement_cache_syntax_error(void) {
+	PurpleSqlite3StatementCache *cache = NULL;
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt = NULL;
+	int rc = 0;
+
+	rc = sqlite3_open(":memory:", &db);
+	g_assert_nonnull(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	cache = purple_sqlite3_statement_cache_new(db);
+
+	stmt = purple_sqlite3_statement_cache_get(cache, "SELEKT 1", &error);
+	g_assert_error(error, PURPLE_SQLITE3_DOMAIN, 0);
+	g_clear_error(&error);
+	g_assert_null(stmt);
+
+	purple_sqlite3_statement_cache_free(cache);
+
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+}
+
+static void
+test_sqlite3_statement_cache_insert(void) {
+	PurpleSqlite3StatementCache *cache = NULL;
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	sqlite3_stmt *first = NULL;
+	sqlite3_stmt *stmt = NULL;
+	char *dir = NULL;
+	char *filename = NULL;
+	char *path = NULL;
+	const char *sql = "INSERT INTO numbers(value) VALUES(?)";
+	int rc = 0;
+
+	dir = g_dir_make_tmp("test_sqlite3_XXXXXX", &error);
+	g_assert_no_error(error);
+	filename = g_build_filename(dir, "insert.db", NULL);
+
+	rc = sqlite3_open(filename, &db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	purple_sqlite3_apply_connection_profile(db, &error);
+	g_assert_no_error(error);
+
+	rc = sqlite3_exec(db,
+	                  "CREATE TABLE numbers(id INTEGER PRIMARY KEY, "
+	                  "value INTEGER)",
+	                  NULL, NULL, NULL);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	cache = purple_sqlite3_statement_cache_new(db);
+
+	/* Insert each row in its own transaction, the way the history adapter
+	 * writes messages, through the same cached statement.
+	 */
+	for(int i = 0; i < 10; i++) {
+		stmt = purple_sqlite3_statement_cache_get(cache, sql, &error);
+		g_assert_no_error(error);
+
+		if(first == NULL) {
+			first = stmt;
+		}
+		g_assert_true(stmt == first);
+
+		sqlite3_bind_int(stmt, 1, i);
+		g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_DONE);
+		sqlite3_reset(stmt);
+	}
+
+	purple_sqlite3_statement_cache_free(cache);
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	/* Every row made it to the database, even when it is opened without the
+	 * profile.
+	 */
+	rc = sqlite3_open(filename, &db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	rc = sqlite3_prepare_v2(db, "SELECT COUNT(*), SUM(value) FROM numbers",
+	                        -1, &stmt, NULL);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+	g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_ROW);
+	g_assert_cmpint(sqlite3_column_int(stmt, 0), ==, 10);
+	g_assert_cmpint(sqlite3_column_int(stmt, 1), ==, 45);
+	sqlite3_finalize(stmt);
+
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	g_remove(filename);
+	path = g_strconcat(filename, "-wal", NULL);
+	g_remove(path);
+	g_free(path);
+	path = g_strconcat(filename, "-shm", NULL);
+	g_remove(path);
+	g_free(path);
+	g_rmdir(dir);
+
+	g_free(filename);
+	g_free(dir);
+}
+
+/******************************************************************************
+ * performance tests
+ *****************************************************************************/
+#define TEST_SQLITE3_PERF_INSERTS (2000)
+
+/* Inserts TEST_SQLITE3_PERF_INSERTS rows, each in its own transaction like a
+ * synchronous history write, and returns the number of inserts per second.
+ */
+static double
+test_sqlite3_perf_insert_rate(gboolean tuned) {
+	PurpleSqlite3StatementCache *cache = NULL;
+	GError *error = NULL;
+	sqlite3 *db = NULL;
+	char *dir = NULL;
+	char *filename = NULL;
+	char *path = NULL;
+	const char *sql = "INSERT INTO messages(content) VALUES(?)";
+	double elapsed = 0;
+	int rc = 0;
+
+	dir = g_dir_make_tmp("test_sqlite3_XXXXXX", &error);
+	g_assert_no_error(error);
+	filename = g_build_filename(dir, "perf.db", NULL);
+
+	rc = sqlite3_open(filename, &db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	if(tuned) {
+		purple_sqlite3_apply_connection_profile(db, &error);
+		g_assert_no_error(error);
+
+		cache = purple_sqlite3_statement_cache_new(db);
+	}
+
+	rc = sqlite3_exec(db,
+	                  "CREATE TABLE messages(id INTEGER PRIMARY KEY, "
+	                  "content TEXT)",
+	                  NULL, NULL, NULL);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	g_test_timer_start();
+
+	for(int i = 0; i < TEST_SQLITE3_PERF_INSERTS; i++) {
+		sqlite3_stmt *stmt = NULL;
+
+		if(tuned) {
+			stmt = purple_sqlite3_statement_cache_get(cache, sql, &error);
+			g_assert_no_error(error);
+		} else {
+			sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+		}
+
+		sqlite3_bind_text(stmt, 1, "hello world", -1, SQLITE_STATIC);
+		g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_DONE);
+
+		if(tuned) {
+			sqlite3_reset(stmt);
+		} else {
+			sqlite3_finalize(stmt);
+		}
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_clear_pointer(&cache, purple_sqlite3_statement_cache_free);
+	rc = sqlite3_close(db);
+	g_assert_cmpint(rc, ==, SQLITE_OK);
+
+	g_remove(filename);
+	path = g_strconcat(filename, "-wal", NULL);
+	g_remove(path);
+	g_free(path);
+	path = g_strconcat(filename, "-shm", NULL);
+	g_remove(path);
+	g_free(path);
+	g_rmdir(dir);
+
+	g_free(filename);
+	g_free(dir);
+
+	return TEST_SQLITE3_PERF_INSERTS / elapsed;
+}
+
+static void
+test_sqlite3_perf_insert(void) {
+	double baseline = 0;
+	double tuned = 0;
+
+	if(!g_test_perf()) {
+		g_test_skip("performance tests are only run with -m perf");
+
+		return;
+	}
+
+	baseline = test_sqlite3_perf_insert_rate(FALSE);
+	tuned = test_sqlite3_perf_insert_rate(TRUE);
+
+	g_test_message("default connection, prepared per insert: %.0f inserts/s",
+	               baseline);
+	g_test_message("connection profile, cached statement: %.0f inserts/s",
+	               tuned);
+
+	g_test_maximized_result(tuned, "%.0f inserts/s", tuned);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -473,5 +798,19 @@ main(int argc, char *argv[]) {
 	g_test_add_func("/sqlite3/resource_migrations/older",
 	                test_sqlite3_resource_migrations_older);
 
+	g_test_add_func("/sqlite3/connection_profile/file",
+	                test_sqlite3_connection_profile_file);
+	g_test_add_func("/sqlite3/connection_profile/memory",
+	                test_sqlite3_connection_profile_memory);
+
+	g_test_add_func("/sqlite3/statement_cache/reuse",
+	                test_sqlite3_statement_cache_reuse);
+	g_test_add_func("/sqlite3/statement_cache/syntax-error",
+	                test_sqlite3_statement_cache_syntax_error);
+	g_test_add_func("/sqlite3/statement_cache/insert",
+	                test_sqlite3_statement_cache_insert);
+
+	g_test_add_func("/sqlite3/perf/insert", test_sqlite3_perf_insert);
+
 	return g_test_run();
 }
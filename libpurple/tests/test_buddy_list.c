@@ -0,0 +1,398 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/* The longest a queued update may be deferred, see
+ * purple_blist_queue_update_node(). */
+#define TEST_BUDDY_LIST_UPDATE_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+
+#define TEST_BUDDY_LIST_PROTOCOL_ID "prpl-test-buddy-list"
+
+/******************************************************************************
+ * TestPurpleBuddyListProtocol, which names its chats by the room component
+ *****************************************************************************/
+static GType test_purple_buddy_list_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestPurpleBuddyListProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestPurpleBuddyListProtocolClass;
+
+static GList *
+test_purple_buddy_list_protocol_chat_info(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                          G_GNUC_UNUSED PurpleConnection *connection)
+{
+	PurpleProtocolChatEntry *pce = g_new0(PurpleProtocolChatEntry, 1);
+
+	pce->label = "Room";
+	pce->identifier = "room";
+	pce->required = TRUE;
+
+	return g_list_append(NULL, pce);
+}
+
+static void
+test_purple_buddy_list_protocol_chat_iface_init(PurpleProtocolChatInterface *iface) {
+	iface->info = test_purple_buddy_list_protocol_chat_info;
+}
+
+G_DEFINE_TYPE_WITH_CODE(
+	TestPurpleBuddyListProtocol,
+	test_purple_buddy_list_protocol,
+	PURPLE_TYPE_PROTOCOL,
+	G_IMPLEMENT_INTERFACE(
+		PURPLE_TYPE_PROTOCOL_CHAT,
+		test_purple_buddy_list_protocol_chat_iface_init
+	)
+);
+
+static void
+test_purple_buddy_list_protocol_init(G_GNUC_UNUSED TestPurpleBuddyListProtocol *protocol) {
+}
+
+static void
+test_purple_buddy_list_protocol_class_init(G_GNUC_UNUSED TestPurpleBuddyListProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleBuddy *
+test_purple_buddy_list_add_buddy(PurpleAccount **account) {
+	PurpleBuddy *buddy = NULL;
+	PurpleStatusType *type = NULL;
+	GList *statuses = NULL;
+
+	*account = purple_account_new("test", "test");
+
+	type = purple_status_type_new(PURPLE_STATUS_OFFLINE, "offline",
+	                              "offline", TRUE);
+	statuses = g_list_append(statuses, type);
+	purple_account_set_status_types(*account, statuses);
+
+	buddy = purple_buddy_new(*account, "buddy-name", NULL);
+	purple_blist_add_buddy(buddy, NULL, NULL, NULL);
+
+	return buddy;
+}
+
+/* Chats are only looked up for connected accounts, so this creates one that
+ * is and adds it to the account manager like a real one. Free it with
+ * test_purple_buddy_list_disconnect().
+ */
+static PurpleAccount *
+test_purple_buddy_list_connect(void) {
+	PurpleAccountManager *manager = purple_account_manager_get_default();
+	PurpleAccount *account = NULL;
+	PurpleConnection *connection = NULL;
+
+	account = purple_account_new("test", TEST_BUDDY_LIST_PROTOCOL_ID);
+	purple_account_manager_add(manager, account);
+
+	connection = g_object_new(PURPLE_TYPE_CONNECTION,
+	                          "account", account,
+	                          "protocol", purple_account_get_protocol(account),
+	                          NULL);
+
+	purple_account_set_connection(account, connection);
+	purple_connection_set_state(connection,
+	                            PURPLE_CONNECTION_STATE_CONNECTED);
+	g_object_unref(connection);
+
+	g_assert_true(purple_account_is_connected(account));
+
+	return account;
+}
+
+static void
+test_purple_buddy_list_disconnect(PurpleAccount *account) {
+	PurpleAccountManager *manager = purple_account_manager_get_default();
+	PurpleConnection *connection = purple_account_get_connection(account);
+
+	g_assert_true(purple_connection_disconnect(connection, NULL));
+	purple_account_manager_remove(manager, account);
+
+	/* The connection and the account reference each other, so the cycle has
+	 * to be broken by hand.
+	 */
+	purple_account_set_connection(account, NULL);
+	g_object_unref(account);
+}
+
+static PurpleChat *
+test_purple_buddy_list_add_chat(PurpleAccount *account, const char *room) {
+	PurpleChat *chat = NULL;
+	GHashTable *components = NULL;
+
+	components = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                   g_free);
+	g_hash_table_insert(components, g_strdup("room"), g_strdup(room));
+
+	chat = purple_chat_new(account, NULL, components);
+	purple_blist_add_chat(chat, NULL, NULL);
+
+	return chat;
+}
+
+/* Renames a chat in place, without telling the buddy list about it. */
+static void
+test_purple_buddy_list_rename_chat(PurpleChat *chat, const char *room) {
+	g_hash_table_replace(purple_chat_get_components(chat), g_strdup("room"),
+	                     g_strdup(room));
+}
+
+static void
+test_purple_buddy_list_notify_cb(G_GNUC_UNUSED GObject *obj,
+                                 G_GNUC_UNUSED GParamSpec *pspec,
+                                 gpointer data)
+{
+	guint *counter = data;
+
+	*counter = *counter + 1;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_buddy_list_queue_update_window(void) {
+	PurpleAccount *account = NULL;
+	PurpleBuddy *buddy = NULL;
+	PurplePresence *presence = NULL;
+	guint counter = 0;
+
+	buddy = test_purple_buddy_list_add_buddy(&account);
+	presence = purple_buddy_get_presence(buddy);
+	g_signal_connect(presence, "notify::idle",
+	                 G_CALLBACK(test_purple_buddy_list_notify_cb), &counter);
+
+	/* The first change is seen right away and starts the window. */
+	purple_presence_set_idle(presence, TRUE, NULL);
+	g_assert_cmpuint(counter, ==, 1);
+
+	/* The changes in the window are held back, but the property is always
+	 * current. */
+	purple_presence_set_idle(presence, FALSE, NULL);
+	purple_presence_set_idle(presence, TRUE, NULL);
+	purple_presence_set_idle(presence, FALSE, NULL);
+	g_assert_cmpuint(counter, ==, 1);
+	g_assert_false(purple_presence_is_idle(presence));
+
+	/* They arrive as one notification when the window closes. */
+	while(counter == 1) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_cmpuint(counter, ==, 2);
+
+	purple_blist_remove_buddy(buddy);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_buddy_list_queue_update_max_staleness(void) {
+	PurpleAccount *account = NULL;
+	PurpleBuddy *buddy = NULL;
+	PurplePresence *presence = NULL;
+	gint64 start = 0, elapsed = 0;
+	gboolean idle = TRUE;
+	guint counter = 0;
+
+	buddy = test_purple_buddy_list_add_buddy(&account);
+	presence = purple_buddy_get_presence(buddy);
+	g_signal_connect(presence, "notify::idle",
+	                 G_CALLBACK(test_purple_buddy_list_notify_cb), &counter);
+
+	start = g_get_monotonic_time();
+	purple_presence_set_idle(presence, idle, NULL);
+	g_assert_cmpuint(counter, ==, 1);
+
+	/* Keep changing the presence. The window must close anyway instead of
+	 * being pushed back by every change. */
+	while(counter == 1) {
+		elapsed = g_get_monotonic_time() - start;
+		g_assert_cmpint(elapsed, <, 10 * TEST_BUDDY_LIST_UPDATE_INTERVAL);
+
+		idle = !idle;
+		purple_presence_set_idle(presence, idle, NULL);
+
+		g_usleep(G_TIME_SPAN_MILLISECOND);
+		g_main_context_iteration(NULL, FALSE);
+	}
+
+	elapsed = g_get_monotonic_time() - start;
+	g_assert_cmpint(elapsed, >=, TEST_BUDDY_LIST_UPDATE_INTERVAL / 2);
+	g_assert_cmpuint(counter, ==, 2);
+
+	purple_blist_remove_buddy(buddy);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_buddy_list_find_chat_index(void) {
+	PurpleAccount *account = NULL;
+	PurpleChat *lobby = NULL, *kitchen = NULL;
+
+	account = test_purple_buddy_list_connect();
+
+	/* Chats added before the index is built are found. */
+	lobby = test_purple_buddy_list_add_chat(account, "lobby");
+	g_assert_true(purple_blist_find_chat(account, "lobby") == lobby);
+	g_assert_null(purple_blist_find_chat(account, "kitchen"));
+
+	/* So are chats added after it was built. */
+	kitchen = test_purple_buddy_list_add_chat(account, "kitchen");
+	g_assert_true(purple_blist_find_chat(account, "kitchen") == kitchen);
+	g_assert_true(purple_blist_find_chat(account, "lobby") == lobby);
+
+	/* A chat renamed in place is found by its new name once the index is
+	 * told about it.
+	 */
+	test_purple_buddy_list_rename_chat(kitchen, "pantry");
+	purple_blist_update_chats_cache(kitchen);
+	g_assert_null(purple_blist_find_chat(account, "kitchen"));
+	g_assert_true(purple_blist_find_chat(account, "pantry") == kitchen);
+
+	/* Removed chats are not found anymore. */
+	purple_blist_remove_chat(kitchen);
+	g_assert_null(purple_blist_find_chat(account, "pantry"));
+	g_assert_true(purple_blist_find_chat(account, "lobby") == lobby);
+
+	purple_blist_remove_chat(lobby);
+	g_assert_null(purple_blist_find_chat(account, "lobby"));
+
+	test_purple_buddy_list_disconnect(account);
+}
+
+static void
+test_purple_buddy_list_find_chat_duplicates(void) {
+	PurpleAccount *account = NULL;
+	PurpleChat *first = NULL, *second = NULL, *third = NULL;
+
+	account = test_purple_buddy_list_connect();
+
+	first = test_purple_buddy_list_add_chat(account, "lobby");
+	second = test_purple_buddy_list_add_chat(account, "lobby");
+	g_assert_true(purple_blist_find_chat(account, "lobby") == first);
+
+	/* The oldest chat is still the one found when a newer one is added
+	 * after the index was built.
+	 */
+	third = test_purple_buddy_list_add_chat(account, "lobby");
+	g_assert_true(purple_blist_find_chat(account, "lobby") == first);
+
+	/* Re-indexing a chat that wasn't renamed doesn't change the order. */
+	purple_blist_update_chats_cache(first);
+	g_assert_true(purple_blist_find_chat(account, "lobby") == first);
+
+	/* Removing the oldest moves on to the next oldest. */
+	purple_blist_remove_chat(first);
+	g_assert_true(purple_blist_find_chat(account, "lobby") == second);
+
+	purple_blist_remove_chat(second);
+	g_assert_true(purple_blist_find_chat(account, "lobby") == third);
+
+	purple_blist_remove_chat(third);
+	g_assert_null(purple_blist_find_chat(account, "lobby"));
+
+	test_purple_buddy_list_disconnect(account);
+}
+
+static void
+test_purple_buddy_list_find_chat_account_removed(void) {
+	PurpleAccountManager *manager = purple_account_manager_get_default();
+	PurpleAccount *account = NULL;
+	PurpleChat *chat = NULL;
+
+	account = test_purple_buddy_list_connect();
+
+	chat = test_purple_buddy_list_add_chat(account, "lobby");
+	g_assert_true(purple_blist_find_chat(account, "lobby") == chat);
+
+	/* Renaming the chat without telling the buddy list leaves the index
+	 * stale, which shows whether it is still the same index.
+	 */
+	test_purple_buddy_list_rename_chat(chat, "kitchen");
+	g_assert_true(purple_blist_find_chat(account, "lobby") == chat);
+	g_assert_null(purple_blist_find_chat(account, "kitchen"));
+
+	/* Removing the account drops its index, so the next lookup builds a new
+	 * one from the chats as they are now.
+	 */
+	purple_account_manager_remove(manager, account);
+	g_assert_null(purple_blist_find_chat(account, "lobby"));
+	g_assert_true(purple_blist_find_chat(account, "kitchen") == chat);
+
+	purple_blist_remove_chat(chat);
+
+	/* Put the account back for test_purple_buddy_list_disconnect(). */
+	purple_account_manager_add(manager, account);
+	test_purple_buddy_list_disconnect(account);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	PurpleProtocolManager *manager = NULL;
+	PurpleProtocol *protocol = NULL;
+	GError *error = NULL;
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	manager = purple_protocol_manager_get_default();
+	protocol = g_object_new(test_purple_buddy_list_protocol_get_type(),
+	                        "id", TEST_BUDDY_LIST_PROTOCOL_ID,
+	                        "name", "Test Buddy List",
+	                        NULL);
+	purple_protocol_manager_register(manager, protocol, &error);
+	g_assert_no_error(error);
+
+	g_test_add_func("/buddy-list/queue-update/window",
+	                test_purple_buddy_list_queue_update_window);
+	g_test_add_func("/buddy-list/queue-update/max-staleness",
+	                test_purple_buddy_list_queue_update_max_staleness);
+
+	g_test_add_func("/buddy-list/find-chat/index",
+	                test_purple_buddy_list_find_chat_index);
+	g_test_add_func("/buddy-list/find-chat/duplicates",
+	                test_purple_buddy_list_find_chat_duplicates);
+	g_test_add_func("/buddy-list/find-chat/account-removed",
+	                test_purple_buddy_list_find_chat_account_removed);
+
+	ret = g_test_run();
+
+	purple_protocol_manager_unregister(manager, protocol, &error);
+	g_assert_no_error(error);
+	g_object_unref(protocol);
+
+	test_ui_purple_uninit();
+
+	return ret;
+}
@@ -0,0 +1,386 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <purple.h>
+
+#define TEST_FILENAME "test.xml"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static gchar *
+test_config_journal_key(PurpleXmlNode *node, guint depth, gboolean *container)
+{
+	if(depth == 0) {
+		*container = TRUE;
+		return g_strdup(node->name);
+	}
+
+	if(depth == 1 && purple_strequal(node->name, "group")) {
+		*container = TRUE;
+		return g_strdup(purple_xmlnode_get_attrib(node, "name"));
+	}
+
+	if(purple_strequal(node->name, "item")) {
+		return g_strdup(purple_xmlnode_get_attrib(node, "id"));
+	}
+
+	return NULL;
+}
+
+static PurpleXmlNode *
+test_config_journal_read(void) {
+	PurpleXmlNode *node = NULL;
+	gchar *filename = NULL;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	filename = g_build_filename(purple_config_dir(), TEST_FILENAME, NULL);
+	if(g_file_get_contents(filename, &contents, &length, NULL)) {
+		node = purple_xmlnode_from_str(contents, length);
+	}
+	g_free(contents);
+	g_free(filename);
+
+	return node;
+}
+
+static void
+test_config_journal_assert_item(PurpleXmlNode *parent, guint index,
+                                const gchar *id, const gchar *value)
+{
+	PurpleXmlNode *item = purple_xmlnode_get_child(parent, "item");
+	gchar *data = NULL;
+
+	for(guint i = 0; i < index && item != NULL; i++) {
+		item = purple_xmlnode_get_next_twin(item);
+	}
+
+	g_assert_nonnull(item);
+	g_assert_cmpstr(purple_xmlnode_get_attrib(item, "id"), ==, id);
+
+	data = purple_xmlnode_get_data(item);
+	g_assert_cmpstr(data, ==, value);
+	g_free(data);
+}
+
+static PurpleXmlNode *
+test_config_journal_new_tree(void) {
+	PurpleXmlNode *root = NULL, *group = NULL, *child = NULL;
+
+	root = purple_xmlnode_new("config");
+	purple_xmlnode_set_attrib(root, "version", "1");
+
+	child = purple_xmlnode_new_child(root, "item");
+	purple_xmlnode_set_attrib(child, "id", "a");
+	purple_xmlnode_insert_data(child, "1", -1);
+
+	group = purple_xmlnode_new_child(root, "group");
+	purple_xmlnode_set_attrib(group, "name", "g");
+
+	child = purple_xmlnode_new_child(group, "item");
+	purple_xmlnode_set_attrib(child, "id", "b");
+	purple_xmlnode_insert_data(child, "2", -1);
+
+	child = purple_xmlnode_new_child(group, "item");
+	purple_xmlnode_set_attrib(child, "id", "c");
+	purple_xmlnode_insert_data(child, "3", -1);
+
+	return root;
+}
+
+static void
+test_config_journal_setup(void) {
+	gchar *dir = g_dir_make_tmp("purple-config-journal-XXXXXX", NULL);
+
+	g_assert_nonnull(dir);
+
+	purple_util_set_user_dir(dir);
+	g_free(dir);
+}
+
+static void
+test_config_journal_teardown(void) {
+	const gchar *names[] = {
+		TEST_FILENAME, TEST_FILENAME ".journal", TEST_FILENAME ".journal.old",
+	};
+	gchar *dir = g_strdup(purple_user_dir());
+
+	for(gsize i = 0; i < G_N_ELEMENTS(names); i++) {
+		gchar *filename = g_build_filename(purple_config_dir(), names[i],
+		                                   NULL);
+
+		g_unlink(filename);
+		g_free(filename);
+	}
+
+	g_rmdir(purple_config_dir());
+	g_rmdir(dir);
+	g_free(dir);
+
+	purple_util_set_user_dir(NULL);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_config_journal_new_free(void) {
+	PurpleConfigJournal *journal = NULL;
+	PurpleXmlNode *node = NULL;
+
+	test_config_journal_setup();
+
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+	g_assert_nonnull(journal);
+	g_assert_false(purple_config_journal_recover(journal));
+	purple_config_journal_free(journal);
+
+	/* Nothing was changed, so nothing was written. */
+	node = test_config_journal_read();
+	g_assert_null(node);
+
+	test_config_journal_teardown();
+}
+
+static void
+test_config_journal_set(void) {
+	PurpleConfigJournal *journal = NULL;
+	PurpleXmlNode *root = NULL, *node = NULL, *group = NULL;
+	const gchar *group_path[] = { "g", NULL };
+	const gchar *remove_path[] = { "g", "b", NULL };
+
+	test_config_journal_setup();
+
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+
+	root = test_config_journal_new_tree();
+	purple_config_journal_set(journal, NULL, root);
+	purple_xmlnode_free(root);
+
+	/* Change one item and remove another. */
+	node = purple_xmlnode_new("item");
+	purple_xmlnode_set_attrib(node, "id", "c");
+	purple_xmlnode_insert_data(node, "4", -1);
+	purple_config_journal_set(journal, group_path, node);
+	purple_xmlnode_free(node);
+
+	purple_config_journal_remove(journal, remove_path);
+
+	purple_config_journal_free(journal);
+
+	root = test_config_journal_read();
+	g_assert_nonnull(root);
+	g_assert_cmpstr(purple_xmlnode_get_attrib(root, "version"), ==, "1");
+	test_config_journal_assert_item(root, 0, "a", "1");
+
+	group = purple_xmlnode_get_child(root, "group");
+	g_assert_nonnull(group);
+	test_config_journal_assert_item(group, 0, "c", "4");
+	g_assert_null(purple_xmlnode_get_next_twin(
+		purple_xmlnode_get_child(group, "item")));
+
+	purple_xmlnode_free(root);
+
+	test_config_journal_teardown();
+}
+
+static void
+test_config_journal_replace(void) {
+	PurpleConfigJournal *journal = NULL;
+	PurpleXmlNode *root = NULL, *group = NULL, *child = NULL;
+
+	test_config_journal_setup();
+
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+
+	root = test_config_journal_new_tree();
+	purple_config_journal_set(journal, NULL, root);
+	purple_xmlnode_free(root);
+
+	/* Drop item a and swap the items in the group. */
+	root = purple_xmlnode_new("config");
+	purple_xmlnode_set_attrib(root, "version", "2");
+	group = purple_xmlnode_new_child(root, "group");
+	purple_xmlnode_set_attrib(group, "name", "g");
+	child = purple_xmlnode_new_child(group, "item");
+	purple_xmlnode_set_attrib(child, "id", "c");
+	purple_xmlnode_insert_data(child, "3", -1);
+	child = purple_xmlnode_new_child(group, "item");
+	purple_xmlnode_set_attrib(child, "id", "b");
+	purple_xmlnode_insert_data(child, "2", -1);
+
+	purple_config_journal_replace(journal, NULL, root);
+	purple_xmlnode_free(root);
+
+	purple_config_journal_free(journal);
+
+	root = test_config_journal_read();
+	g_assert_nonnull(root);
+	g_assert_cmpstr(purple_xmlnode_get_attrib(root, "version"), ==, "2");
+	g_assert_null(purple_xmlnode_get_child(root, "item"));
+
+	group = purple_xmlnode_get_child(root, "group");
+	g_assert_nonnull(group);
+	test_config_journal_assert_item(group, 0, "c", "3");
+	test_config_journal_assert_item(group, 1, "b", "2");
+
+	purple_xmlnode_free(root);
+
+	test_config_journal_teardown();
+}
+
+static void
+test_config_journal_recover(void) {
+	PurpleConfigJournal *journal = NULL, *recovered = NULL;
+	PurpleXmlNode *root = NULL, *group = NULL;
+	gchar *filename = NULL;
+	FILE *fp = NULL;
+
+	test_config_journal_setup();
+
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+
+	root = test_config_journal_new_tree();
+	purple_config_journal_set(journal, NULL, root);
+	purple_xmlnode_free(root);
+	purple_config_journal_save(journal);
+
+	/* Only the journal has been written so far. */
+	g_assert_null(test_config_journal_read());
+
+	/* Pretend the program stopped in the middle of writing a record. */
+	filename = g_build_filename(purple_config_dir(),
+	                            TEST_FILENAME ".journal", NULL);
+	fp = g_fopen(filename, "ab");
+	g_assert_nonnull(fp);
+	fputs("L 2 1 1:g 1:d 20:<item id='d'>", fp);
+	fclose(fp);
+	g_free(filename);
+
+	recovered = purple_config_journal_new(TEST_FILENAME,
+	                                      test_config_journal_key);
+	g_test_expect_message("config-journal", G_LOG_LEVEL_WARNING,
+	                      "*damaged end*");
+	g_assert_true(purple_config_journal_recover(recovered));
+	g_test_assert_expected_messages();
+	purple_config_journal_free(recovered);
+
+	root = test_config_journal_read();
+	g_assert_nonnull(root);
+	test_config_journal_assert_item(root, 0, "a", "1");
+
+	group = purple_xmlnode_get_child(root, "group");
+	g_assert_nonnull(group);
+	test_config_journal_assert_item(group, 0, "b", "2");
+	test_config_journal_assert_item(group, 1, "c", "3");
+	g_assert_null(purple_xmlnode_get_next_twin(
+		purple_xmlnode_get_next_twin(
+			purple_xmlnode_get_child(group, "item"))));
+
+	purple_xmlnode_free(root);
+
+	purple_config_journal_free(journal);
+
+	test_config_journal_teardown();
+}
+
+static void
+test_config_journal_duplicate_keys(void) {
+	PurpleConfigJournal *journal = NULL;
+	PurpleXmlNode *root = NULL, *group = NULL, *child = NULL;
+	GHashTable *siblings = NULL;
+	const gchar *group_path[] = { "g", NULL };
+
+	test_config_journal_setup();
+
+	siblings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_assert_cmpstr(purple_config_journal_unique_key(siblings, "b"), ==, "b");
+	g_assert_cmpstr(purple_config_journal_unique_key(siblings, "b"), ==,
+	                "b#2");
+	g_assert_cmpstr(purple_config_journal_unique_key(siblings, "c"), ==, "c");
+	g_hash_table_destroy(siblings);
+
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+
+	root = test_config_journal_new_tree();
+	group = purple_xmlnode_get_child(root, "group");
+	child = purple_xmlnode_new_child(group, "item");
+	purple_xmlnode_set_attrib(child, "id", "b");
+	purple_xmlnode_insert_data(child, "5", -1);
+	purple_config_journal_set(journal, NULL, root);
+	purple_xmlnode_free(root);
+
+	purple_config_journal_free(journal);
+
+	/* Load the file back and change the second b without touching the
+	 * first. */
+	journal = purple_config_journal_new(TEST_FILENAME,
+	                                    test_config_journal_key);
+
+	child = purple_xmlnode_new("item");
+	purple_xmlnode_set_attrib(child, "id", "b");
+	purple_xmlnode_insert_data(child, "6", -1);
+	purple_config_journal_set_with_key(journal, group_path, "b#2", child);
+	purple_xmlnode_free(child);
+
+	purple_config_journal_free(journal);
+
+	root = test_config_journal_read();
+	g_assert_nonnull(root);
+
+	group = purple_xmlnode_get_child(root, "group");
+	g_assert_nonnull(group);
+	test_config_journal_assert_item(group, 0, "b", "2");
+	test_config_journal_assert_item(group, 1, "c", "3");
+	test_config_journal_assert_item(group, 2, "b", "6");
+
+	purple_xmlnode_free(root);
+
+	test_config_journal_teardown();
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/config-journal/new-free",
+	                test_config_journal_new_free);
+	g_test_add_func("/config-journal/set", test_config_journal_set);
+	g_test_add_func("/config-journal/replace", test_config_journal_replace);
+	g_test_add_func("/config-journal/recover", test_config_journal_recover);
+	g_test_add_func("/config-journal/duplicate-keys",
+	                test_config_journal_duplicate_keys);
+
+	return g_test_run();
+}
@@ -35,6 +35,18 @@ test_purple_contact_manager_increment_cb(G_GNUC_UNUSED PurpleContactManager *man
 	*called = *called + 1;
 }
 
+static void
+test_purple_contact_manager_items_changed_cb(G_GNUC_UNUSED GListModel *model,
+                                             guint position, guint removed,
+                                             guint added, gpointer data)
+{
+	guint *changed = data;
+
+	changed[0] = position;
+	changed[1] = removed;
+	changed[2] = added;
+}
+
 /******************************************************************************
  * Tests
  *****************************************************************************/
@@ -260,6 +272,287 @@ test_purple_contact_manager_find_with_id(void) {
 	g_clear_object(&manager);
 }
 
+static void
+test_purple_contact_manager_find_renamed(void) {
+	PurpleAccount *account = NULL;
+	PurpleContact *contact = NULL;
+	PurpleContact *found = NULL;
+	PurpleContactInfo *info = NULL;
+	PurpleContactManager *manager = NULL;
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+
+	account = purple_account_new("test", "test");
+
+	contact = purple_contact_new(account, "id-1");
+	info = PURPLE_CONTACT_INFO(contact);
+	purple_contact_info_set_username(info, "user1");
+	purple_contact_manager_add(manager, contact);
+
+	/* Change the username and id and make sure the old ones are gone and the
+	 * new ones are found.
+	 */
+	purple_contact_info_set_username(info, "user2");
+	purple_contact_info_set_id(info, "id-2");
+
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user1");
+	g_assert_null(found);
+	found = purple_contact_manager_find_with_id(manager, account, "id-1");
+	g_assert_null(found);
+
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user2");
+	g_assert_true(found == contact);
+	g_clear_object(&found);
+	found = purple_contact_manager_find_with_id(manager, account, "id-2");
+	g_assert_true(found == contact);
+	g_clear_object(&found);
+
+	/* Once removed, the contact should no longer be found even if it changes
+	 * again.
+	 */
+	purple_contact_manager_remove(manager, contact);
+	purple_contact_info_set_username(info, "user3");
+
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user2");
+	g_assert_null(found);
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user3");
+	g_assert_null(found);
+	found = purple_contact_manager_find_with_id(manager, account, "id-2");
+	g_assert_null(found);
+
+	/* Cleanup. */
+	g_clear_object(&account);
+	g_clear_object(&contact);
+	g_clear_object(&manager);
+}
+
+static void
+test_purple_contact_manager_find_duplicate(void) {
+	PurpleAccount *account = NULL;
+	PurpleContact *contact1 = NULL;
+	PurpleContact *contact2 = NULL;
+	PurpleContact *found = NULL;
+	PurpleContactManager *manager = NULL;
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+
+	account = purple_account_new("test", "test");
+
+	contact1 = purple_contact_new(account, NULL);
+	purple_contact_info_set_username(PURPLE_CONTACT_INFO(contact1), "user");
+	purple_contact_manager_add(manager, contact1);
+
+	contact2 = purple_contact_new(account, NULL);
+	purple_contact_info_set_username(PURPLE_CONTACT_INFO(contact2), "user");
+	purple_contact_manager_add(manager, contact2);
+
+	/* The first contact that was added should win. */
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user");
+	g_assert_true(found == contact1);
+	g_clear_object(&found);
+
+	/* Once it's removed, the other contact should be found. */
+	purple_contact_manager_remove(manager, contact1);
+
+	found = purple_contact_manager_find_with_username(manager, account,
+	                                                  "user");
+	g_assert_true(found == contact2);
+	g_clear_object(&found);
+
+	/* Cleanup. */
+	g_clear_object(&account);
+	g_clear_object(&contact1);
+	g_clear_object(&contact2);
+	g_clear_object(&manager);
+}
+
+static void
+test_purple_contact_manager_remove_middle(void) {
+	PurpleAccount *account = NULL;
+	PurpleContact *contacts[3] = { NULL, };
+	PurpleContact *contact = NULL;
+	PurpleContactManager *manager = NULL;
+	GListModel *model = NULL;
+	guint changed[3] = { 0, };
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+
+	account = purple_account_new("test", "test");
+
+	for(guint i = 0; i < G_N_ELEMENTS(contacts); i++) {
+		char *id = g_strdup_printf("contact-%u", i);
+
+		contacts[i] = purple_contact_new(account, id);
+		purple_contact_manager_add(manager, contacts[i]);
+
+		g_free(id);
+	}
+
+	model = purple_contact_manager_get_all(manager, account);
+	g_signal_connect(model, "items-changed",
+	                 G_CALLBACK(test_purple_contact_manager_items_changed_cb),
+	                 changed);
+
+	/* The contact is removed from where it was and the others keep their
+	 * order.
+	 */
+	g_assert_true(purple_contact_manager_remove(manager, contacts[1]));
+	g_assert_cmpuint(changed[0], ==, 1);
+	g_assert_cmpuint(changed[1], ==, 1);
+	g_assert_cmpuint(changed[2], ==, 0);
+
+	g_assert_cmpuint(g_list_model_get_n_items(model), ==, 2);
+	contact = g_list_model_get_item(model, 0);
+	g_assert_true(contact == contacts[0]);
+	g_clear_object(&contact);
+	contact = g_list_model_get_item(model, 1);
+	g_assert_true(contact == contacts[2]);
+	g_clear_object(&contact);
+
+	contact = purple_contact_manager_find_with_id(manager, account,
+	                                              "contact-1");
+	g_assert_null(contact);
+
+	/* Cleanup. */
+	for(guint i = 0; i < G_N_ELEMENTS(contacts); i++) {
+		g_clear_object(&contacts[i]);
+	}
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
+static void
+test_purple_contact_manager_find_accounts(void) {
+	PurpleAccount *accounts[2] = { NULL, };
+	PurpleContact *contacts[2] = { NULL, };
+	PurpleContact *found = NULL;
+	PurpleContactManager *manager = NULL;
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+
+	/* The same id and username on two accounts are two different contacts. */
+	for(guint i = 0; i < G_N_ELEMENTS(accounts); i++) {
+		accounts[i] = purple_account_new("test", "test");
+
+		contacts[i] = purple_contact_new(accounts[i], "id-1");
+		purple_contact_info_set_username(PURPLE_CONTACT_INFO(contacts[i]),
+		                                 "user1");
+		purple_contact_manager_add(manager, contacts[i]);
+	}
+
+	for(guint i = 0; i < G_N_ELEMENTS(accounts); i++) {
+		found = purple_contact_manager_find_with_id(manager, accounts[i],
+		                                            "id-1");
+		g_assert_true(found == contacts[i]);
+		g_clear_object(&found);
+
+		found = purple_contact_manager_find_with_username(manager,
+		                                                  accounts[i],
+		                                                  "user1");
+		g_assert_true(found == contacts[i]);
+		g_clear_object(&found);
+	}
+
+	/* Removing one of them leaves the other one alone. */
+	purple_contact_manager_remove(manager, contacts[0]);
+
+	found = purple_contact_manager_find_with_id(manager, accounts[0], "id-1");
+	g_assert_null(found);
+	found = purple_contact_manager_find_with_username(manager, accounts[0],
+	                                                  "user1");
+	g_assert_null(found);
+
+	found = purple_contact_manager_find_with_id(manager, accounts[1], "id-1");
+	g_assert_true(found == contacts[1]);
+	g_clear_object(&found);
+	found = purple_contact_manager_find_with_username(manager, accounts[1],
+	                                                  "user1");
+	g_assert_true(found == contacts[1]);
+	g_clear_object(&found);
+
+	/* Cleanup. */
+	for(guint i = 0; i < G_N_ELEMENTS(accounts); i++) {
+		g_clear_object(&contacts[i]);
+		g_clear_object(&accounts[i]);
+	}
+	g_clear_object(&manager);
+}
+
+#define TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS (5000)
+
+static void
+test_purple_contact_manager_perf_find(void) {
+	PurpleAccount *account = NULL;
+	PurpleContactManager *manager = NULL;
+	double elapsed = 0;
+
+	if(!g_test_perf()) {
+		g_test_skip("performance tests are only run with -m perf");
+
+		return;
+	}
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+
+	account = purple_account_new("test", "test");
+
+	for(int i = 0; i < TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS; i++) {
+		PurpleContact *contact = NULL;
+		char *id = g_strdup_printf("id-%d", i);
+		char *username = g_strdup_printf("user%d@example.com", i);
+
+		contact = purple_contact_new(account, id);
+		purple_contact_info_set_username(PURPLE_CONTACT_INFO(contact),
+		                                 username);
+		purple_contact_manager_add(manager, contact);
+
+		g_clear_object(&contact);
+		g_free(username);
+		g_free(id);
+	}
+
+	/* Look up every contact by both keys, which is what a roster push for
+	 * the whole roster would do.
+	 */
+	g_test_timer_start();
+
+	for(int i = 0; i < TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS; i++) {
+		PurpleContact *found = NULL;
+		char *id = g_strdup_printf("id-%d", i);
+		char *username = g_strdup_printf("user%d@example.com", i);
+
+		found = purple_contact_manager_find_with_id(manager, account, id);
+		g_assert_nonnull(found);
+		g_clear_object(&found);
+
+		found = purple_contact_manager_find_with_username(manager, account,
+		                                                  username);
+		g_assert_nonnull(found);
+		g_clear_object(&found);
+
+		g_free(username);
+		g_free(id);
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed * G_USEC_PER_SEC /
+	                        (TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS * 2),
+	                        "%.3f usec per lookup with %d contacts",
+	                        elapsed * G_USEC_PER_SEC /
+	                        (TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS * 2),
+	                        TEST_PURPLE_CONTACT_MANAGER_PERF_CONTACTS);
+
+	/* Cleanup. */
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
 static void
 test_purple_contact_manager_add_buddy(void) {
 	PurpleAccount *account = NULL;
@@ -485,6 +778,8 @@ main(gint argc, gchar *argv[]) {
 	g_test_add_func("/contact-manager/double-remove",
 	                test_purple_contact_manager_double_remove);
 
+	g_test_add_func("/contact-manager/remove-middle",
+	                test_purple_contact_manager_remove_middle);
 	g_test_add_func("/contact-manager/remove-all",
 	                test_purple_contact_manager_remove_all);
 
@@ -492,6 +787,15 @@ main(gint argc, gchar *argv[]) {
 	                test_purple_contact_manager_find_with_username);
 	g_test_add_func("/contact-manager/find/with-id",
 	                test_purple_contact_manager_find_with_id);
+	g_test_add_func("/contact-manager/find/renamed",
+	                test_purple_contact_manager_find_renamed);
+	g_test_add_func("/contact-manager/find/duplicate",
+	                test_purple_contact_manager_find_duplicate);
+	g_test_add_func("/contact-manager/find/accounts",
+	                test_purple_contact_manager_find_accounts);
+
+	g_test_add_func("/contact-manager/perf/find",
+	                test_purple_contact_manager_perf_find);
 
 	g_test_add_func("/contact-manager/add-buddy",
 	                test_purple_contact_manager_add_buddy);
@@ -258,8 +258,329 @@ test_purple_conversation_members_add_remove(void) {
 	g_clear_object(&conversation);
 }
 
+static void
+test_purple_conversation_members_items_changed_cb(G_GNUC_UNUSED GListModel *model,
+                                                  G_GNUC_UNUSED guint position,
+                                                  G_GNUC_UNUSED guint removed,
+                                                  G_GNUC_UNUSED guint added,
+                                                  gpointer data)
+{
+	gint *called = data;
+
+	*called = *called + 1;
+}
+
+static void
+test_purple_conversation_members_bulk(void) {
+	PurpleAccount *account = NULL;
+	PurpleContactInfo *infos[5];
+	PurpleConversation *conversation = NULL;
+	PurpleConversationManager *conversation_manager = NULL;
+	PurpleConversationMember *member = NULL;
+	GListModel *members = NULL;
+	GPtrArray *array = NULL;
+	guint n_removed = 0;
+	guint position = 0;
+	gint added_called = 0;
+	gint removed_called = 0;
+	gint changed_called = 0;
+
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "bulk-members",
+		NULL);
+
+	g_signal_connect(conversation, "member-added",
+	                 G_CALLBACK(test_purple_conversation_membership_signal_cb),
+	                 &added_called);
+	g_signal_connect(conversation, "member-removed",
+	                 G_CALLBACK(test_purple_conversation_membership_signal_cb),
+	                 &removed_called);
+
+	members = purple_conversation_get_members(conversation);
+	g_signal_connect(members, "items-changed",
+	                 G_CALLBACK(test_purple_conversation_members_items_changed_cb),
+	                 &changed_called);
+
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		infos[i] = purple_contact_info_new(NULL);
+	}
+
+	/* Add one member by itself so the bulk add has to skip it. */
+	purple_conversation_add_member(conversation, infos[0], TRUE,
+	                               "announcement message");
+	g_assert_cmpint(added_called, ==, 1);
+	g_assert_cmpint(changed_called, ==, 1);
+
+	/* Add everyone, with a duplicate, and verify items-changed was only
+	 * emitted once.
+	 */
+	array = g_ptr_array_new();
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		g_ptr_array_add(array, infos[i]);
+	}
+	g_ptr_array_add(array, infos[1]);
+
+	purple_conversation_add_members(conversation, array, TRUE,
+	                                "announcement message");
+	g_ptr_array_set_size(array, 0);
+
+	g_assert_cmpint(added_called, ==, 5);
+	g_assert_cmpint(changed_called, ==, 2);
+	g_assert_cmpuint(g_list_model_get_n_items(members), ==, 5);
+
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		guint position = 0;
+
+		g_assert_true(purple_conversation_has_member(conversation, infos[i],
+		                                             &position));
+		g_assert_cmpuint(position, ==, i);
+	}
+
+	/* Remove members 1 and 3 and verify 2 stays where it should. They aren't
+	 * next to each other, so each gets its own items-changed instead of
+	 * member 2 being reported as changed too.
+	 */
+	member = purple_conversation_find_member(conversation, infos[1]);
+	g_ptr_array_add(array, member);
+	member = purple_conversation_find_member(conversation, infos[3]);
+	g_ptr_array_add(array, member);
+
+	n_removed = purple_conversation_remove_members(conversation, array, TRUE,
+	                                               "announcement message");
+	g_assert_cmpuint(n_removed, ==, 2);
+	g_assert_cmpint(removed_called, ==, 2);
+	g_assert_cmpint(changed_called, ==, 4);
+	g_assert_cmpuint(g_list_model_get_n_items(members), ==, 3);
+
+	g_assert_null(purple_conversation_find_member(conversation, infos[1]));
+	g_assert_null(purple_conversation_find_member(conversation, infos[3]));
+
+	member = g_list_model_get_item(members, 1);
+	g_assert_true(purple_conversation_member_get_contact_info(member) ==
+	              infos[2]);
+	g_clear_object(&member);
+
+	/* The positions of the members after them have moved up. */
+	g_assert_true(purple_conversation_has_member(conversation, infos[4],
+	                                             &position));
+	g_assert_cmpuint(position, ==, 2);
+
+	/* Removing the same members again shouldn't do anything. */
+	n_removed = purple_conversation_remove_members(conversation, array, TRUE,
+	                                               "announcement message");
+	g_assert_cmpuint(n_removed, ==, 0);
+	g_assert_cmpint(removed_called, ==, 2);
+	g_assert_cmpint(changed_called, ==, 4);
+	g_ptr_array_free(array, TRUE);
+
+	/* TODO: Conversations are automatically registered on construction for
+	 * legacy reasons, so we need to explicitly unregister to clean them up,
+	 * but this can go away once that stops happening. */
+	conversation_manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(conversation_manager, conversation);
+
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		g_clear_object(&infos[i]);
+	}
+	g_clear_object(&account);
+	g_clear_object(&conversation);
+}
+
+typedef struct {
+	guint called;
+	guint position;
+	guint removed;
+	guint added;
+} TestPurpleConversationItemsChanged;
+
+static void
+test_purple_conversation_members_items_changed_record_cb(G_GNUC_UNUSED GListModel *model,
+                                                         guint position,
+                                                         guint removed,
+                                                         guint added,
+                                                         gpointer data)
+{
+	TestPurpleConversationItemsChanged *changed = data;
+
+	changed->called++;
+	changed->position = position;
+	changed->removed = removed;
+	changed->added = added;
+}
+
+static void
+test_purple_conversation_members_bulk_remove_all(void) {
+	PurpleAccount *account = NULL;
+	PurpleContactInfo *infos[5];
+	PurpleConversation *conversation = NULL;
+	PurpleConversationManager *conversation_manager = NULL;
+	GListModel *members = NULL;
+	GPtrArray *array = NULL;
+	TestPurpleConversationItemsChanged changed = { 0, };
+	guint position = 0;
+
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "bulk-remove-all",
+		NULL);
+
+	members = purple_conversation_get_members(conversation);
+	g_signal_connect(members, "items-changed",
+	                 G_CALLBACK(test_purple_conversation_members_items_changed_record_cb),
+	                 &changed);
+
+	array = g_ptr_array_new();
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		infos[i] = purple_contact_info_new(NULL);
+		g_ptr_array_add(array, infos[i]);
+	}
+
+	/* Everyone is appended in one go, like the initial member list of a
+	 * channel.
+	 */
+	purple_conversation_add_members(conversation, array, FALSE, NULL);
+	g_ptr_array_set_size(array, 0);
+
+	g_assert_cmpuint(changed.called, ==, 1);
+	g_assert_cmpuint(changed.position, ==, 0);
+	g_assert_cmpuint(changed.removed, ==, 0);
+	g_assert_cmpuint(changed.added, ==, G_N_ELEMENTS(infos));
+
+	/* Remove everyone, in the opposite order of the model. They are all next
+	 * to each other, so there is still only one items-changed.
+	 */
+	for(guint i = G_N_ELEMENTS(infos); i > 0; i--) {
+		PurpleConversationMember *member = NULL;
+
+		member = purple_conversation_find_member(conversation, infos[i - 1]);
+		g_assert_nonnull(member);
+		g_ptr_array_add(array, member);
+	}
+
+	g_assert_cmpuint(purple_conversation_remove_members(conversation, array,
+	                                                    FALSE, NULL),
+	                 ==, G_N_ELEMENTS(infos));
+	g_ptr_array_free(array, TRUE);
+
+	g_assert_cmpuint(changed.called, ==, 2);
+	g_assert_cmpuint(changed.position, ==, 0);
+	g_assert_cmpuint(changed.removed, ==, G_N_ELEMENTS(infos));
+	g_assert_cmpuint(changed.added, ==, 0);
+	g_assert_cmpuint(g_list_model_get_n_items(members), ==, 0);
+
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		g_assert_false(purple_conversation_has_member(conversation, infos[i],
+		                                              NULL));
+		g_assert_null(purple_conversation_find_member(conversation,
+		                                              infos[i]));
+	}
+
+	/* The index is empty, so a member that is added again starts over. */
+	purple_conversation_add_member(conversation, infos[3], FALSE, NULL);
+	g_assert_true(purple_conversation_has_member(conversation, infos[3],
+	                                             &position));
+	g_assert_cmpuint(position, ==, 0);
+
+	for(guint i = 0; i < G_N_ELEMENTS(infos); i++) {
+		g_clear_object(&infos[i]);
+	}
+
+	/* TODO: Conversations are automatically registered on construction for
+	 * legacy reasons, so we need to explicitly unregister to clean them up,
+	 * but this can go away once that stops happening. */
+	conversation_manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(conversation_manager, conversation);
+
+	g_clear_object(&account);
+	g_clear_object(&conversation);
+}
+
+#define TEST_PURPLE_CONVERSATION_PERF_MEMBERS (10000)
+
+static void
+test_purple_conversation_members_perf(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversationManager *conversation_manager = NULL;
+	GPtrArray *infos = NULL;
+	GPtrArray *members = NULL;
+	double elapsed = 0;
+
+	if(!g_test_perf()) {
+		g_test_skip("performance tests are only run with -m perf");
+
+		return;
+	}
+
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "members-perf",
+		NULL);
+
+	infos = g_ptr_array_new_full(TEST_PURPLE_CONVERSATION_PERF_MEMBERS,
+	                             g_object_unref);
+	for(int i = 0; i < TEST_PURPLE_CONVERSATION_PERF_MEMBERS; i++) {
+		g_ptr_array_add(infos, purple_contact_info_new(NULL));
+	}
+
+	/* This is what joining a large channel does with the initial member
+	 * list.
+	 */
+	g_test_timer_start();
+	purple_conversation_add_members(conversation, infos, FALSE, NULL);
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed, "%.3f sec to add %d members", elapsed,
+	                        TEST_PURPLE_CONVERSATION_PERF_MEMBERS);
+
+	members = g_ptr_array_sized_new(infos->len);
+
+	g_test_timer_start();
+	for(guint i = 0; i < infos->len; i++) {
+		PurpleConversationMember *member = NULL;
+
+		member = purple_conversation_find_member(conversation,
+		                                         g_ptr_array_index(infos, i));
+		g_assert_nonnull(member);
+
+		g_ptr_array_add(members, member);
+	}
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed, "%.3f sec to find %d members", elapsed,
+	                        TEST_PURPLE_CONVERSATION_PERF_MEMBERS);
+
+	g_test_timer_start();
+	g_assert_cmpuint(purple_conversation_remove_members(conversation, members,
+	                                                    FALSE, NULL),
+	                 ==, TEST_PURPLE_CONVERSATION_PERF_MEMBERS);
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed, "%.3f sec to remove %d members", elapsed,
+	                        TEST_PURPLE_CONVERSATION_PERF_MEMBERS);
+
+	g_ptr_array_free(members, TRUE);
+	g_ptr_array_free(infos, TRUE);
+
+	/* TODO: Conversations are automatically registered on construction for
+	 * legacy reasons, so we need to explicitly unregister to clean them up,
+	 * but this can go away once that stops happening. */
+	conversation_manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(conversation_manager, conversation);
+
+	g_clear_object(&account);
+	g_clear_object(&conversation);
+}
+
 /******************************************************************************
- * Message Tests
+ * Message tests
  *****************************************************************************/
 static void
 test_purple_conversation_message_write_one(void) {
@@ -292,6 +613,232 @@ test_purple_conversation_message_write_one(void) {
 	g_clear_object(&conversation);
 }
 
+static char *
+test_purple_conversation_message_contents(GListModel *messages, guint position)
+{
+	PurpleMessage *message = NULL;
+	char *contents = NULL;
+
+	message = g_list_model_get_item(messages, position);
+	contents = g_strdup(purple_message_get_contents(message));
+	g_clear_object(&message);
+
+	return contents;
+}
+
+static void
+test_purple_conversation_message_limit(void) {
+	PurpleAccount *account = NULL;
+	PurpleAccount *other_account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversation *other = NULL;
+	PurpleConversationManager *manager = NULL;
+	PurpleMessage *message = NULL;
+	GError *error = NULL;
+	GListModel *messages = NULL;
+	char *contents = NULL;
+	guint loaded = 0;
+
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "message limit",
+		"message-limit", 3,
+		NULL);
+	g_assert_cmpuint(purple_conversation_get_message_limit(conversation), ==,
+	                 3);
+
+	messages = purple_conversation_get_messages(conversation);
+
+	for(guint i = 0; i < 5; i++) {
+		contents = g_strdup_printf("message %u", i);
+		message = purple_message_new_outgoing("alice", NULL, contents, 0);
+		g_free(contents);
+
+		purple_conversation_write_message(conversation, message);
+		g_clear_object(&message);
+	}
+
+	/* Only the newest messages should be kept. */
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 3);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 2");
+	g_free(contents);
+
+	/* The evicted messages can be loaded back from the history. */
+	loaded = purple_conversation_load_older_messages(conversation, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 2);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 5);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 0");
+	g_free(contents);
+	contents = test_purple_conversation_message_contents(messages, 2);
+	g_assert_cmpstr(contents, ==, "message 2");
+	g_free(contents);
+
+	/* There is nothing older than message 0. */
+	loaded = purple_conversation_load_older_messages(conversation, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 0);
+
+	/* New messages still push out the oldest message, even a loaded one. */
+	message = purple_message_new_outgoing("alice", NULL, "message 5", 0);
+	purple_conversation_write_message(conversation, message);
+	g_clear_object(&message);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 5);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 1");
+	g_free(contents);
+
+	/* Releasing them trims back down to the limit. */
+	purple_conversation_release_older_messages(conversation);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 3);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 3");
+	g_free(contents);
+
+	/* Lowering the limit should evict right away. */
+	purple_conversation_set_message_limit(conversation, 1);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 1);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 5");
+	g_free(contents);
+
+	/* No more older messages are loaded than the limit allows. */
+	loaded = purple_conversation_load_older_messages(conversation, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 1);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "message 4");
+	g_free(contents);
+
+	loaded = purple_conversation_load_older_messages(conversation, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 0);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 2);
+
+	purple_conversation_release_older_messages(conversation);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 1);
+
+	/* A conversation with the same name on another account doesn't see any of
+	 * the history above.
+	 */
+	other_account = purple_account_new("other", "test");
+	other = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", other_account,
+		"name", "message limit",
+		NULL);
+	loaded = purple_conversation_load_older_messages(other, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 0);
+
+	manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(manager, conversation);
+	purple_conversation_manager_unregister(manager, other);
+
+	g_clear_object(&account);
+	g_clear_object(&other_account);
+	g_clear_object(&conversation);
+	g_clear_object(&other);
+}
+
+static void
+test_purple_conversation_message_limit_quoted_name(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversationManager *manager = NULL;
+	GError *error = NULL;
+	GListModel *messages = NULL;
+	char *contents = NULL;
+	guint loaded = 0;
+
+	/* A quote in the name must not end the in: term of the history query. */
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "say \"hi\" OR",
+		"message-limit", 1,
+		NULL);
+
+	messages = purple_conversation_get_messages(conversation);
+
+	for(guint i = 0; i < 2; i++) {
+		PurpleMessage *message = NULL;
+
+		contents = g_strdup_printf("quoted %u", i);
+		message = purple_message_new_outgoing("alice", NULL, contents, 0);
+		g_free(contents);
+
+		purple_conversation_write_message(conversation, message);
+		g_clear_object(&message);
+	}
+
+	loaded = purple_conversation_load_older_messages(conversation, 10, &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(loaded, ==, 1);
+	contents = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(contents, ==, "quoted 0");
+	g_free(contents);
+
+	manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(manager, conversation);
+
+	g_clear_object(&account);
+	g_clear_object(&conversation);
+}
+
+static void
+test_purple_conversation_message_size_limit(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversationManager *manager = NULL;
+	GListModel *messages = NULL;
+	const char *contents[] = {"12345", "abcde", "ABCDE", NULL};
+	char *first = NULL;
+
+	account = purple_account_new("test", "test");
+	conversation = g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", "message size limit",
+		"message-limit", 0,
+		"message-size-limit", (guint64)10,
+		NULL);
+
+	messages = purple_conversation_get_messages(conversation);
+
+	for(guint i = 0; contents[i] != NULL; i++) {
+		PurpleMessage *message = NULL;
+
+		message = purple_message_new_outgoing("alice", NULL, contents[i], 0);
+		purple_conversation_write_message(conversation, message);
+		g_clear_object(&message);
+	}
+
+	/* Two five byte messages fit in ten bytes. */
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 2);
+	first = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(first, ==, "abcde");
+	g_free(first);
+
+	/* A message that is larger than the limit is still kept by itself. */
+	purple_conversation_set_message_size_limit(conversation, 1);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 1);
+	first = test_purple_conversation_message_contents(messages, 0);
+	g_assert_cmpstr(first, ==, "ABCDE");
+	g_free(first);
+
+	manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(manager, conversation);
+
+	g_clear_object(&account);
+	g_clear_object(&conversation);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -308,9 +855,21 @@ main(gint argc, gchar *argv[]) {
 
 	g_test_add_func("/conversation/members/add-remove",
 	                test_purple_conversation_members_add_remove);
+	g_test_add_func("/conversation/members/bulk",
+	                test_purple_conversation_members_bulk);
+	g_test_add_func("/conversation/members/bulk-remove-all",
+	                test_purple_conversation_members_bulk_remove_all);
+	g_test_add_func("/conversation/members/perf",
+	                test_purple_conversation_members_perf);
 
 	g_test_add_func("/conversation/message/write-one",
 	                test_purple_conversation_message_write_one);
+	g_test_add_func("/conversation/message/limit",
+	                test_purple_conversation_message_limit);
+	g_test_add_func("/conversation/message/limit-quoted-name",
+	                test_purple_conversation_message_limit_quoted_name);
+	g_test_add_func("/conversation/message/size-limit",
+	                test_purple_conversation_message_size_limit);
 
 	ret = g_test_run();
 
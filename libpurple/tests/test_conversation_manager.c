@@ -93,6 +93,94 @@ test_purple_conversation_manager_register_unregister(void) {
 	g_clear_object(&manager);
 }
 
+/******************************************************************************
+ * Find Tests
+ *****************************************************************************/
+static void
+test_purple_conversation_manager_find(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversationManager *manager = NULL;
+	PurpleConversation *chat = NULL;
+	PurpleConversation *found = NULL;
+	PurpleConversation *im = NULL;
+
+	manager = g_object_new(PURPLE_TYPE_CONVERSATION_MANAGER, NULL);
+
+	account = purple_account_new("test", "test");
+
+	im = g_object_new(
+		PURPLE_TYPE_IM_CONVERSATION,
+		"account", account,
+		"id", "im-id",
+		"name", "friend",
+		NULL);
+	purple_conversation_manager_register(manager, im);
+
+	chat = g_object_new(
+		PURPLE_TYPE_CHAT_CONVERSATION,
+		"account", account,
+		"id", "chat-id",
+		"name", "friend",
+		"chat-id", 42,
+		NULL);
+	purple_conversation_manager_register(manager, chat);
+
+	/* Both conversations share a name, so the type has to pick the right
+	 * one.
+	 */
+	found = purple_conversation_manager_find_im(manager, account, "friend");
+	g_assert_true(found == im);
+	found = purple_conversation_manager_find_chat(manager, account, "friend");
+	g_assert_true(found == chat);
+	found = purple_conversation_manager_find(manager, account, "friend");
+	g_assert_true(found == im || found == chat);
+
+	found = purple_conversation_manager_find_chat_by_id(manager, account, 42);
+	g_assert_true(found == chat);
+	found = purple_conversation_manager_find_with_id(manager, account,
+	                                                 "im-id");
+	g_assert_true(found == im);
+	found = purple_conversation_manager_find_with_id(manager, account,
+	                                                 "chat-id");
+	g_assert_true(found == chat);
+
+	found = purple_conversation_manager_find(manager, account, "stranger");
+	g_assert_null(found);
+
+	/* Change the name and chat id and make sure the lookups follow. */
+	purple_conversation_set_name(im, "best friend");
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(chat), 43);
+
+	found = purple_conversation_manager_find_im(manager, account, "friend");
+	g_assert_null(found);
+	found = purple_conversation_manager_find_im(manager, account,
+	                                            "best friend");
+	g_assert_true(found == im);
+	found = purple_conversation_manager_find_chat_by_id(manager, account, 42);
+	g_assert_null(found);
+	found = purple_conversation_manager_find_chat_by_id(manager, account, 43);
+	g_assert_true(found == chat);
+
+	/* Unregistered conversations should no longer be found. */
+	purple_conversation_manager_unregister(manager, chat);
+
+	found = purple_conversation_manager_find_chat(manager, account, "friend");
+	g_assert_null(found);
+	found = purple_conversation_manager_find_chat_by_id(manager, account, 43);
+	g_assert_null(found);
+	found = purple_conversation_manager_find_with_id(manager, account,
+	                                                 "chat-id");
+	g_assert_null(found);
+
+	purple_conversation_manager_unregister(manager, im);
+
+	/* Clean up. */
+	g_clear_object(&im);
+	g_clear_object(&chat);
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
 /******************************************************************************
  * Signal Tests
  *****************************************************************************/
@@ -176,6 +264,8 @@ main(gint argc, gchar *argv[]) {
 
 	g_test_add_func("/conversation-manager/register-unregister",
 	                test_purple_conversation_manager_register_unregister);
+	g_test_add_func("/conversation-manager/find",
+	                test_purple_conversation_manager_find);
 
 	g_test_add_func("/conversation-manager/signals/conversation-changed",
 	                test_purple_conversation_manager_signal_conversation_changed);
@@ -0,0 +1,178 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_purple_debug_ring_append(G_GNUC_UNUSED GDateTime *timestamp,
+                              G_GNUC_UNUSED PurpleDebugLevel level,
+                              G_GNUC_UNUSED const gchar *category,
+                              const gchar *message, gpointer data)
+{
+	GString *str = data;
+
+	g_string_append(str, message);
+}
+
+static gchar *
+test_purple_debug_ring_read(PurpleDebugRing *ring, guint64 *cursor) {
+	GString *str = g_string_new("");
+
+	purple_debug_ring_read(ring, cursor, test_purple_debug_ring_append, str);
+
+	return g_string_free(str, FALSE);
+}
+
+/******************************************************************************
+ * Level Tests
+ *****************************************************************************/
+static void
+test_purple_debug_category_level(void) {
+	g_assert_cmpint(purple_debug_get_level(), ==, PURPLE_DEBUG_ALL);
+	g_assert_cmpint(purple_debug_get_category_level("test"), ==,
+	                PURPLE_DEBUG_ALL);
+
+	purple_debug_set_enabled(TRUE);
+
+	purple_debug_set_category_level("test", PURPLE_DEBUG_WARNING);
+	g_assert_cmpint(purple_debug_get_category_level("test"), ==,
+	                PURPLE_DEBUG_WARNING);
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_MISC, "test"));
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_INFO, "test"));
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_WARNING, "test"));
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_FATAL, "test"));
+
+	/* Other categories are not affected. */
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_MISC, "other"));
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_MISC, NULL));
+
+	/* The default level applies to everything without its own level. */
+	purple_debug_set_level(PURPLE_DEBUG_ERROR);
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_WARNING, "other"));
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_WARNING, "test"));
+
+	purple_debug_set_level(PURPLE_DEBUG_ALL);
+	purple_debug_set_category_level("test", PURPLE_DEBUG_ALL);
+	purple_debug_set_enabled(FALSE);
+}
+
+/******************************************************************************
+ * Ring Tests
+ *****************************************************************************/
+static void
+test_purple_debug_ring_read_cursor(void) {
+	PurpleDebugRing *ring = purple_debug_ring_new(4);
+	guint64 cursor = 0;
+	gchar *data = NULL;
+
+	/* Only the first push after a read asks to be woken up. */
+	g_assert_true(purple_debug_ring_push(ring, PURPLE_DEBUG_INFO, "test", "a"));
+	g_assert_false(purple_debug_ring_push(ring, PURPLE_DEBUG_INFO, "test", "b"));
+
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "ab");
+	g_clear_pointer(&data, g_free);
+
+	/* Nothing new. */
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "");
+	g_clear_pointer(&data, g_free);
+
+	g_assert_true(purple_debug_ring_push(ring, PURPLE_DEBUG_INFO, "test", "c"));
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "c");
+	g_clear_pointer(&data, g_free);
+
+	/* A fresh cursor sees everything that's retained. */
+	cursor = 0;
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "abc");
+	g_clear_pointer(&data, g_free);
+
+	purple_debug_ring_free(ring);
+}
+
+static void
+test_purple_debug_ring_overflow(void) {
+	PurpleDebugRing *ring = purple_debug_ring_new(3);
+	guint64 cursor = 0;
+	const gchar *messages[] = {"a", "b", "c", "d", "e"};
+	gchar *data = NULL;
+
+	for(gsize i = 0; i < G_N_ELEMENTS(messages); i++) {
+		purple_debug_ring_push(ring, PURPLE_DEBUG_MISC, NULL, messages[i]);
+	}
+
+	/* The oldest messages were dropped. */
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "cde");
+	g_clear_pointer(&data, g_free);
+
+	/* Shrinking keeps the newest. */
+	purple_debug_ring_set_capacity(ring, 2);
+	g_assert_cmpuint(purple_debug_ring_get_capacity(ring), ==, 2);
+	cursor = 0;
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "de");
+	g_clear_pointer(&data, g_free);
+
+	/* Growing keeps everything. */
+	purple_debug_ring_set_capacity(ring, 4);
+	purple_debug_ring_push(ring, PURPLE_DEBUG_MISC, NULL, "f");
+	purple_debug_ring_push(ring, PURPLE_DEBUG_MISC, NULL, "g");
+	cursor = 0;
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "defg");
+	g_clear_pointer(&data, g_free);
+
+	/* Clearing doesn't invalidate the cursor. */
+	purple_debug_ring_clear(ring);
+	purple_debug_ring_push(ring, PURPLE_DEBUG_MISC, NULL, "h");
+	data = test_purple_debug_ring_read(ring, &cursor);
+	g_assert_cmpstr(data, ==, "h");
+	g_clear_pointer(&data, g_free);
+
+	purple_debug_ring_free(ring);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/debug/category-level",
+	                test_purple_debug_category_level);
+
+	g_test_add_func("/debug/ring/read-cursor",
+	                test_purple_debug_ring_read_cursor);
+	g_test_add_func("/debug/ring/overflow",
+	                test_purple_debug_ring_overflow);
+
+	return g_test_run();
+}
@@ -0,0 +1,436 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#define TEST_MEDIA_MANAGER_SESSION "session"
+#define TEST_MEDIA_MANAGER_PARTICIPANT "bob"
+
+/******************************************************************************
+ * TestPurpleMediaBackend, which lets media be created without a real backend
+ *****************************************************************************/
+static GType test_purple_media_backend_get_type(void);
+
+typedef struct {
+	GObject parent;
+} TestPurpleMediaBackend;
+
+typedef struct {
+	GObjectClass parent;
+} TestPurpleMediaBackendClass;
+
+enum {
+	PROP_0,
+	PROP_CONFERENCE_TYPE,
+	PROP_MEDIA,
+};
+
+static void
+test_purple_media_backend_iface_init(G_GNUC_UNUSED PurpleMediaBackendInterface *iface) {
+}
+
+G_DEFINE_TYPE_WITH_CODE(
+	TestPurpleMediaBackend,
+	test_purple_media_backend,
+	G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE(
+		PURPLE_MEDIA_TYPE_BACKEND,
+		test_purple_media_backend_iface_init
+	)
+);
+
+static void
+test_purple_media_backend_get_property(GObject *obj, guint param_id,
+                                       G_GNUC_UNUSED GValue *value,
+                                       GParamSpec *pspec)
+{
+	switch(param_id) {
+		case PROP_CONFERENCE_TYPE:
+		case PROP_MEDIA:
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+test_purple_media_backend_set_property(GObject *obj, guint param_id,
+                                       G_GNUC_UNUSED const GValue *value,
+                                       GParamSpec *pspec)
+{
+	switch(param_id) {
+		case PROP_CONFERENCE_TYPE:
+		case PROP_MEDIA:
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+test_purple_media_backend_init(G_GNUC_UNUSED TestPurpleMediaBackend *backend) {
+}
+
+static void
+test_purple_media_backend_class_init(TestPurpleMediaBackendClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->get_property = test_purple_media_backend_get_property;
+	obj_class->set_property = test_purple_media_backend_set_property;
+
+	g_object_class_override_property(obj_class, PROP_CONFERENCE_TYPE,
+	                                 "conference-type");
+	g_object_class_override_property(obj_class, PROP_MEDIA, "media");
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	PurpleMediaManager *manager;
+	PurpleMedia *media;
+	GstElement *pipeline;
+} TestPurpleMediaManagerFixture;
+
+static gboolean
+test_purple_media_manager_has_element(const char *name) {
+	GstElementFactory *factory = gst_element_factory_find(name);
+
+	if(factory == NULL) {
+		return FALSE;
+	}
+
+	gst_object_unref(factory);
+
+	return TRUE;
+}
+
+/* Creates the application data source and sink of the test session of @media
+ * and links them to each other, so everything that is sent on the session is
+ * received on it again.
+ */
+static GstElement *
+test_purple_media_manager_start_session(PurpleMediaManager *manager,
+                                        PurpleMedia *media)
+{
+	PurpleMediaElementInfo *info = NULL;
+	GstElement *pipeline = NULL, *appsrc = NULL, *appsink = NULL;
+	GstStateChangeReturn ret;
+
+	info = purple_media_manager_get_active_element(manager,
+		PURPLE_MEDIA_ELEMENT_APPLICATION | PURPLE_MEDIA_ELEMENT_SRC);
+	appsrc = purple_media_element_info_call_create(info, media,
+	                                               TEST_MEDIA_MANAGER_SESSION,
+	                                               TEST_MEDIA_MANAGER_PARTICIPANT);
+
+	info = purple_media_manager_get_active_element(manager,
+		PURPLE_MEDIA_ELEMENT_APPLICATION | PURPLE_MEDIA_ELEMENT_SINK);
+	appsink = purple_media_element_info_call_create(info, media,
+	                                                TEST_MEDIA_MANAGER_SESSION,
+	                                                TEST_MEDIA_MANAGER_PARTICIPANT);
+
+	g_assert_nonnull(appsrc);
+	g_assert_nonnull(appsink);
+
+	/* There is no clock to sync to, and we don't want to wait for the sink to
+	 * preroll before the first buffer is sent.
+	 */
+	g_object_set(appsink, "sync", FALSE, "async", FALSE, NULL);
+
+	pipeline = gst_pipeline_new(NULL);
+	gst_bin_add_many(GST_BIN(pipeline), appsrc, appsink, NULL);
+	g_assert_true(gst_element_link(appsrc, appsink));
+
+	ret = gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	g_assert_cmpint(ret, !=, GST_STATE_CHANGE_FAILURE);
+
+	/* Nothing can be sent until the session is connected. */
+	g_signal_emit_by_name(media, "candidate-pair-established",
+	                      TEST_MEDIA_MANAGER_SESSION,
+	                      TEST_MEDIA_MANAGER_PARTICIPANT, NULL, NULL);
+
+	return pipeline;
+}
+
+static void
+test_purple_media_manager_stop_session(GstElement *pipeline) {
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+}
+
+static void
+test_purple_media_manager_setup(TestPurpleMediaManagerFixture *fixture,
+                                G_GNUC_UNUSED gconstpointer data)
+{
+	fixture->manager = purple_media_manager_get();
+	fixture->media = purple_media_manager_create_media(fixture->manager, NULL,
+	                                                   "test",
+	                                                   TEST_MEDIA_MANAGER_PARTICIPANT,
+	                                                   TRUE);
+	g_assert_true(PURPLE_IS_MEDIA(fixture->media));
+
+	/* The sessions are built from the app elements of GStreamer, which are
+	 * in a plugin that may not be installed.
+	 */
+	if(test_purple_media_manager_has_element("appsrc") &&
+	   test_purple_media_manager_has_element("appsink"))
+	{
+		fixture->pipeline = test_purple_media_manager_start_session(
+			fixture->manager, fixture->media);
+	}
+}
+
+static void
+test_purple_media_manager_teardown(TestPurpleMediaManagerFixture *fixture,
+                                   G_GNUC_UNUSED gconstpointer data)
+{
+	g_clear_pointer(&fixture->pipeline,
+	                test_purple_media_manager_stop_session);
+
+	/* This also removes it from the manager. */
+	g_clear_object(&fixture->media);
+}
+
+static gboolean
+test_purple_media_manager_skip(TestPurpleMediaManagerFixture *fixture) {
+	if(fixture->pipeline == NULL) {
+		g_test_skip("the GStreamer app elements are not available");
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_media_manager_send_bytes(TestPurpleMediaManagerFixture *fixture,
+                                     G_GNUC_UNUSED gconstpointer data)
+{
+	GBytes *bytes = NULL, *received = NULL;
+	gint sent = 0;
+
+	if(test_purple_media_manager_skip(fixture)) {
+		return;
+	}
+
+	bytes = g_bytes_new_static("hello", 5);
+	sent = purple_media_manager_send_application_data_bytes(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, bytes, FALSE);
+	g_assert_cmpint(sent, ==, 5);
+
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, TRUE);
+	g_assert_nonnull(received);
+	g_assert_true(g_bytes_equal(received, bytes));
+
+	/* Neither side made a copy of the data. */
+	g_assert_true(g_bytes_get_data(received, NULL) ==
+	              g_bytes_get_data(bytes, NULL));
+
+	g_bytes_unref(received);
+	g_bytes_unref(bytes);
+}
+
+static void
+test_purple_media_manager_send_buffer(TestPurpleMediaManagerFixture *fixture,
+                                      G_GNUC_UNUSED gconstpointer data)
+{
+	GstBuffer *buffer = NULL;
+	GstMapInfo map;
+	GBytes *received = NULL;
+	gint sent = 0;
+
+	if(test_purple_media_manager_skip(fixture)) {
+		return;
+	}
+
+	buffer = gst_buffer_new_wrapped(g_strdup("hello"), 5);
+	sent = purple_media_manager_send_application_buffer(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, buffer, FALSE);
+	g_assert_cmpint(sent, ==, 5);
+
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, TRUE);
+	g_assert_nonnull(received);
+	g_assert_cmpmem(g_bytes_get_data(received, NULL),
+	                g_bytes_get_size(received), "hello", 5);
+
+	/* The caller keeps its buffer, and it was pushed as is. */
+	g_assert_true(gst_buffer_map(buffer, &map, GST_MAP_READ));
+	g_assert_true(g_bytes_get_data(received, NULL) == map.data);
+	gst_buffer_unmap(buffer, &map);
+
+	g_bytes_unref(received);
+	gst_buffer_unref(buffer);
+}
+
+static void
+test_purple_media_manager_receive_bytes_partial(TestPurpleMediaManagerFixture *fixture,
+                                                G_GNUC_UNUSED gconstpointer data)
+{
+	GBytes *received = NULL;
+	gchar buffer[5];
+	gint sent = 0, n_read = 0;
+
+	if(test_purple_media_manager_skip(fixture)) {
+		return;
+	}
+
+	sent = purple_media_manager_send_application_data(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, "hello world", 11, FALSE);
+	g_assert_cmpint(sent, ==, 11);
+
+	/* Only read the start of the chunk into a buffer. */
+	n_read = purple_media_manager_receive_application_data(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, buffer, sizeof(buffer), TRUE);
+	g_assert_cmpint(n_read, ==, 5);
+	g_assert_cmpmem(buffer, n_read, "hello", 5);
+
+	/* The rest of it is what comes next as bytes. */
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, TRUE);
+	g_assert_nonnull(received);
+	g_assert_cmpmem(g_bytes_get_data(received, NULL),
+	                g_bytes_get_size(received), " world", 6);
+	g_bytes_unref(received);
+
+	/* And then there is nothing left. */
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, FALSE);
+	g_assert_nonnull(received);
+	g_assert_cmpuint(g_bytes_get_size(received), ==, 0);
+	g_bytes_unref(received);
+}
+
+static void
+test_purple_media_manager_remove_media(TestPurpleMediaManagerFixture *fixture,
+                                       G_GNUC_UNUSED gconstpointer data)
+{
+	PurpleMedia *other = NULL;
+	GstElement *other_pipeline = NULL;
+	GBytes *bytes = NULL, *received = NULL;
+	gchar buffer[5];
+	gint ret = 0;
+
+	if(test_purple_media_manager_skip(fixture)) {
+		return;
+	}
+
+	/* Another media with a session of the same id and participant. */
+	other = purple_media_manager_create_media(fixture->manager, NULL, "test",
+	                                          TEST_MEDIA_MANAGER_PARTICIPANT,
+	                                          TRUE);
+	other_pipeline = test_purple_media_manager_start_session(fixture->manager,
+	                                                         other);
+
+	bytes = g_bytes_new_static("hello", 5);
+
+	/* Removing the media drops its session from the index. */
+	purple_media_manager_remove_media(fixture->manager, fixture->media);
+	ret = purple_media_manager_send_application_data_bytes(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, bytes, FALSE);
+	g_assert_cmpint(ret, ==, -1);
+
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, FALSE);
+	g_assert_null(received);
+
+	ret = purple_media_manager_receive_application_data(fixture->manager,
+		fixture->media, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, buffer, sizeof(buffer), FALSE);
+	g_assert_cmpint(ret, ==, -1);
+
+	/* The session of the other media is still there. */
+	ret = purple_media_manager_send_application_data_bytes(fixture->manager,
+		other, TEST_MEDIA_MANAGER_SESSION, TEST_MEDIA_MANAGER_PARTICIPANT,
+		bytes, FALSE);
+	g_assert_cmpint(ret, ==, 5);
+
+	received = purple_media_manager_receive_application_bytes(
+		fixture->manager, other, TEST_MEDIA_MANAGER_SESSION,
+		TEST_MEDIA_MANAGER_PARTICIPANT, TRUE);
+	g_assert_nonnull(received);
+	g_assert_true(g_bytes_equal(received, bytes));
+	g_bytes_unref(received);
+
+	g_bytes_unref(bytes);
+
+	test_purple_media_manager_stop_session(other_pipeline);
+	g_object_unref(other);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	purple_media_manager_set_backend_type(purple_media_manager_get(),
+	                                      test_purple_media_backend_get_type());
+
+	g_test_add("/media-manager/application-data/send-bytes",
+	           TestPurpleMediaManagerFixture, NULL,
+	           test_purple_media_manager_setup,
+	           test_purple_media_manager_send_bytes,
+	           test_purple_media_manager_teardown);
+	g_test_add("/media-manager/application-data/send-buffer",
+	           TestPurpleMediaManagerFixture, NULL,
+	           test_purple_media_manager_setup,
+	           test_purple_media_manager_send_buffer,
+	           test_purple_media_manager_teardown);
+	g_test_add("/media-manager/application-data/receive-bytes-partial",
+	           TestPurpleMediaManagerFixture, NULL,
+	           test_purple_media_manager_setup,
+	           test_purple_media_manager_receive_bytes_partial,
+	           test_purple_media_manager_teardown);
+	g_test_add("/media-manager/application-data/remove-media",
+	           TestPurpleMediaManagerFixture, NULL,
+	           test_purple_media_manager_setup,
+	           test_purple_media_manager_remove_media,
+	           test_purple_media_manager_teardown);
+
+	ret = g_test_run();
+
+	test_ui_purple_uninit();
+
+	return ret;
+}
@@ -0,0 +1,148 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+test_purple_roomlist_items_changed_cb(GListModel *model, guint position,
+                                      guint removed, guint added,
+                                      gpointer data)
+{
+	guint *counter = data;
+
+	/* Rooms are only ever appended. */
+	g_assert_cmpuint(removed, ==, 0);
+	g_assert_cmpuint(position + added, ==, g_list_model_get_n_items(model));
+
+	*counter = *counter + 1;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_roomlist_list_model(void) {
+	PurpleRoomlist *list = NULL;
+	PurpleRoomlistRoom *room = NULL;
+	guint counter = 0;
+
+	list = purple_roomlist_new(NULL);
+	g_assert_true(G_IS_LIST_MODEL(list));
+	g_assert_true(g_list_model_get_item_type(G_LIST_MODEL(list)) ==
+	              PURPLE_TYPE_ROOMLIST_ROOM);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 0);
+
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(test_purple_roomlist_items_changed_cb),
+	                 &counter);
+
+	purple_roomlist_set_in_progress(list, TRUE);
+	purple_roomlist_room_add(list, purple_roomlist_room_new("a", NULL));
+	purple_roomlist_room_add(list, purple_roomlist_room_new("b", NULL));
+	purple_roomlist_room_add(list, purple_roomlist_room_new("c", NULL));
+
+	/* Nothing is announced until the batch is delivered. */
+	g_assert_cmpuint(counter, ==, 0);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 0);
+
+	/* Finishing the list delivers everything in one go. */
+	purple_roomlist_set_in_progress(list, FALSE);
+	g_assert_cmpuint(counter, ==, 1);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 3);
+
+	room = g_list_model_get_item(G_LIST_MODEL(list), 1);
+	g_assert_true(PURPLE_IS_ROOMLIST_ROOM(room));
+	g_assert_cmpstr(purple_roomlist_room_get_name(room), ==, "b");
+	g_clear_object(&room);
+
+	g_assert_null(g_list_model_get_item(G_LIST_MODEL(list), 3));
+
+	g_clear_object(&list);
+}
+
+static void
+test_purple_roomlist_batch_size(void) {
+	PurpleRoomlist *list = NULL;
+	guint counter = 0;
+
+	list = purple_roomlist_new(NULL);
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(test_purple_roomlist_items_changed_cb),
+	                 &counter);
+
+	purple_roomlist_set_in_progress(list, TRUE);
+	for(guint i = 0; i < 5000; i++) {
+		gchar *name = g_strdup_printf("room%u", i);
+
+		purple_roomlist_room_add(list, purple_roomlist_room_new(name, NULL));
+		g_free(name);
+	}
+
+	/* Large lists are delivered in a handful of chunks, not room by room. */
+	g_assert_cmpuint(counter, >, 0);
+	g_assert_cmpuint(counter, <, 10);
+
+	purple_roomlist_set_in_progress(list, FALSE);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 5000);
+
+	g_clear_object(&list);
+}
+
+static void
+test_purple_roomlist_batch_timeout(void) {
+	PurpleRoomlist *list = NULL;
+	guint counter = 0;
+
+	list = purple_roomlist_new(NULL);
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(test_purple_roomlist_items_changed_cb),
+	                 &counter);
+
+	purple_roomlist_set_in_progress(list, TRUE);
+	purple_roomlist_room_add(list, purple_roomlist_room_new("a", NULL));
+
+	/* A partial batch is delivered by the main loop. */
+	while(counter == 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_assert_cmpuint(counter, ==, 1);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 1);
+
+	g_clear_object(&list);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/roomlist/list-model", test_purple_roomlist_list_model);
+	g_test_add_func("/roomlist/batch-size", test_purple_roomlist_batch_size);
+	g_test_add_func("/roomlist/batch-timeout",
+	                test_purple_roomlist_batch_timeout);
+
+	return g_test_run();
+}
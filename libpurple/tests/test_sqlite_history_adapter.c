@@ -0,0 +1,708 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#define PURPLE_GLOBAL_HEADER_INSIDE
+#include "../purpleprivate.h"
+#undef PURPLE_GLOBAL_HEADER_INSIDE
+
+/* These match the private defines in purplesqlitehistoryadapter.c. */
+#define TEST_SQLITE_HISTORY_ADAPTER_BATCH_SIZE (256)
+#define TEST_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE (4 * TEST_SQLITE_HISTORY_ADAPTER_BATCH_SIZE)
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleHistoryAdapter *
+test_purple_sqlite_history_adapter_new(gboolean write_behind) {
+	PurpleHistoryAdapter *adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = g_object_new(
+		PURPLE_TYPE_SQLITE_HISTORY_ADAPTER,
+		"id", "test-sqlite-adapter",
+		"name", "Test SQLite Adapter",
+		"filename", ":memory:",
+		"write-behind", write_behind,
+		NULL);
+
+	ret = purple_history_adapter_activate(adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	return adapter;
+}
+
+static void
+test_purple_sqlite_history_adapter_free(PurpleHistoryAdapter *adapter) {
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	ret = purple_history_adapter_deactivate(adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_clear_object(&adapter);
+}
+
+static PurpleConversation *
+test_purple_sqlite_history_adapter_conversation_new(PurpleAccount *account,
+                                                    const char *name)
+{
+	return g_object_new(
+		PURPLE_TYPE_CONVERSATION,
+		"account", account,
+		"name", name,
+		NULL);
+}
+
+static void
+test_purple_sqlite_history_adapter_conversation_free(PurpleConversation *conversation)
+{
+	PurpleConversationManager *manager = NULL;
+
+	/* Conversations are automatically registered on construction for legacy
+	 * reasons, so we need to explicitly unregister them.
+	 */
+	manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(manager, conversation);
+
+	g_clear_object(&conversation);
+}
+
+static void
+test_purple_sqlite_history_adapter_write_n(PurpleHistoryAdapter *adapter,
+                                           PurpleConversation *conversation,
+                                           const char *author, guint n)
+{
+	for(guint i = 0; i < n; i++) {
+		PurpleMessage *message = NULL;
+		GError *error = NULL;
+		char *contents = NULL;
+		gboolean ret = FALSE;
+
+		contents = g_strdup_printf("message %u", i);
+		message = purple_message_new_outgoing(author, NULL, contents, 0);
+		g_free(contents);
+
+		ret = purple_history_adapter_write(adapter, conversation, message,
+		                                   &error);
+		g_assert_no_error(error);
+		g_assert_true(ret);
+
+		g_clear_object(&message);
+	}
+}
+
+static void
+test_purple_sqlite_history_adapter_write_contents(PurpleHistoryAdapter *adapter,
+                                                  PurpleConversation *conversation,
+                                                  const char *author,
+                                                  const char *contents)
+{
+	PurpleMessage *message = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	message = purple_message_new_outgoing(author, NULL, contents, 0);
+
+	ret = purple_history_adapter_write(adapter, conversation, message, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_clear_object(&message);
+}
+
+static guint
+test_purple_sqlite_history_adapter_count(PurpleHistoryAdapter *adapter,
+                                         const char *query)
+{
+	GError *error = NULL;
+	GList *results = NULL;
+	guint count = 0;
+
+	results = purple_history_adapter_query(adapter, query, &error);
+	g_assert_no_error(error);
+
+	count = g_list_length(results);
+	g_list_free_full(results, g_object_unref);
+
+	return count;
+}
+
+/* Reads all of the messages from a cursor and returns their contents joined
+ * by commas.
+ */
+static char *
+test_purple_sqlite_history_adapter_cursor_contents(PurpleHistoryAdapter *adapter,
+                                                   const char *query,
+                                                   const char *before,
+                                                   guint limit,
+                                                   char **first_id)
+{
+	PurpleHistoryCursor *cursor = NULL;
+	PurpleMessage *message = NULL;
+	GError *error = NULL;
+	GString *str = g_string_new(NULL);
+
+	cursor = purple_history_adapter_query_cursor(adapter, query, before, limit,
+	                                             &error);
+	g_assert_no_error(error);
+	g_assert_true(PURPLE_IS_HISTORY_CURSOR(cursor));
+
+	while((message = purple_history_cursor_next(cursor, &error)) != NULL) {
+		if(str->len > 0) {
+			g_string_append_c(str, ',');
+		} else if(first_id != NULL) {
+			*first_id = g_strdup(purple_message_get_id(message));
+		}
+
+		g_string_append(str, purple_message_get_contents(message));
+
+		g_clear_object(&message);
+	}
+	g_assert_no_error(error);
+
+	g_clear_object(&cursor);
+
+	return g_string_free(str, FALSE);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_sqlite_history_adapter_write_synchronous(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+
+	adapter = test_purple_sqlite_history_adapter_new(FALSE);
+	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
+	g_assert_false(purple_sqlite_history_adapter_get_write_behind(sqlite_adapter));
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "sync");
+
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "alice",
+	                                           5);
+	g_assert_cmpuint(purple_sqlite_history_adapter_get_queue_depth(sqlite_adapter),
+	                 ==, 0);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:sync"),
+	                 ==, 5);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_write_behind(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
+	g_assert_true(purple_sqlite_history_adapter_get_write_behind(sqlite_adapter));
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "async");
+
+	/* Write more than a single batch worth of messages. */
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "bob",
+	                                           1000);
+
+	ret = purple_sqlite_history_adapter_flush(sqlite_adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(purple_sqlite_history_adapter_get_queue_depth(sqlite_adapter),
+	                 ==, 0);
+	g_assert_cmpint(purple_sqlite_history_adapter_get_commit_latency(sqlite_adapter),
+	                >, 0);
+
+	/* Queries flush on their own, so write a few more and make sure they're
+	 * visible right away.
+	 */
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "bob",
+	                                           10);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:async"),
+	                 ==, 1010);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_write_behind_remove(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "remove");
+
+	/* Removing right after writing must also remove the queued messages. */
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "carol",
+	                                           20);
+
+	ret = purple_history_adapter_remove(adapter, "in:remove", &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:remove"),
+	                 ==, 0);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_write_behind_bad_row(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversation *nameless = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "bad-row");
+	nameless = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                               NULL);
+
+	/* A message without a conversation id can't be logged, but it must not
+	 * take the messages that are batched with it down too.
+	 */
+	g_test_expect_message("sqlite-history-adapter", G_LOG_LEVEL_WARNING,
+	                      "failed to write a batch of *");
+	g_test_expect_message("sqlite-history-adapter", G_LOG_LEVEL_WARNING,
+	                      "failed to write 1 of * messages, keeping them *");
+
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "dave",
+	                                           10);
+	test_purple_sqlite_history_adapter_write_contents(adapter, nameless,
+	                                                  "dave", "lost");
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "dave",
+	                                           10);
+
+	/* Flushing tries again, reports the failure and keeps the message for
+	 * the next flush.
+	 */
+	for(guint i = 0; i < 2; i++) {
+		ret = purple_sqlite_history_adapter_flush(sqlite_adapter, &error);
+		g_assert_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0);
+		g_assert_false(ret);
+		g_clear_error(&error);
+
+		g_assert_cmpuint(purple_sqlite_history_adapter_get_queue_depth(sqlite_adapter),
+		                 ==, 1);
+	}
+	g_test_assert_expected_messages();
+
+	/* Queries don't fail because of a message they had nothing to do with. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:bad-row"),
+	                 ==, 20);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "lost"),
+	                 ==, 0);
+
+	test_purple_sqlite_history_adapter_conversation_free(nameless);
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+
+	g_test_expect_message("sqlite-history-adapter", G_LOG_LEVEL_WARNING,
+	                      "failed to flush queued messages: *");
+	test_purple_sqlite_history_adapter_free(adapter);
+	g_test_assert_expected_messages();
+}
+
+static void
+test_purple_sqlite_history_adapter_write_behind_queue_size(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleSqliteHistoryAdapter *sqlite_adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+	sqlite_adapter = PURPLE_SQLITE_HISTORY_ADAPTER(adapter);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "burst");
+
+	/* Writes wait for the writer once too many messages are queued, instead
+	 * of letting the queue grow without a limit.
+	 */
+	for(guint i = 0; i < 4 * TEST_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE; i++) {
+		test_purple_sqlite_history_adapter_write_n(adapter, conversation,
+		                                           "erin", 1);
+		g_assert_cmpuint(purple_sqlite_history_adapter_get_queue_depth(sqlite_adapter),
+		                 <=, TEST_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE +
+		                     TEST_SQLITE_HISTORY_ADAPTER_BATCH_SIZE);
+	}
+
+	ret = purple_sqlite_history_adapter_flush(sqlite_adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:burst"),
+	                 ==, 4 * TEST_SQLITE_HISTORY_ADAPTER_QUEUE_SIZE);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_write_duplicate(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleMessage *message = NULL;
+	GDateTime *timestamp = NULL;
+	GError *error = NULL;
+	GList *results = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "dupes");
+
+	timestamp = g_date_time_new_utc(2023, 6, 1, 12, 30, 15.123456);
+	message = g_object_new(
+		PURPLE_TYPE_MESSAGE,
+		"id", "duplicate",
+		"author", "alice",
+		"contents", "hello",
+		"timestamp", timestamp,
+		NULL);
+
+	/* Writing the same message twice should only log it once. */
+	for(guint i = 0; i < 2; i++) {
+		ret = purple_history_adapter_write(adapter, conversation, message,
+		                                   &error);
+		g_assert_no_error(error);
+		g_assert_true(ret);
+	}
+	g_clear_object(&message);
+
+	results = purple_history_adapter_query(adapter, "in:dupes", &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(g_list_length(results), ==, 1);
+
+	/* The timestamp should survive the round trip down to the microsecond. */
+	message = results->data;
+	g_assert_cmpstr(purple_message_get_id(message), ==, "duplicate");
+	g_assert_true(g_date_time_equal(purple_message_get_timestamp(message),
+	                                timestamp));
+	g_assert_cmpint(g_date_time_get_utc_offset(purple_message_get_timestamp(message)),
+	                ==, 0);
+	g_list_free_full(results, g_object_unref);
+	g_date_time_unref(timestamp);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_query_keywords(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	GError *error = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "search");
+
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "alice", "hello world");
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "bob", "hello there");
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "alice", "goodbye world");
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "bob", "helicopter");
+
+	/* Keywords are and'd together by default. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hello"),
+	                 ==, 2);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hello world"),
+	                 ==, 1);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hello AND world"),
+	                 ==, 1);
+
+	/* OR works between keywords. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hello OR goodbye"),
+	                 ==, 3);
+
+	/* Prefixes. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hel*"),
+	                 ==, 3);
+
+	/* Phrases. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "\"hello world\""),
+	                 ==, 1);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "\"world hello\""),
+	                 ==, 0);
+
+	/* Keywords combined with in: and from:. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:search from:bob hel*"),
+	                 ==, 2);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:other hello"),
+	                 ==, 0);
+
+	/* in: can be narrowed down to an account and protocol. */
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:search account:test"),
+	                 ==, 4);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:search account:other"),
+	                 ==, 0);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:search protocol:nope"),
+	                 ==, 0);
+
+	/* Removing by keyword keeps the index in sync. */
+	ret = purple_history_adapter_remove(adapter, "world", &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "hel*"),
+	                 ==, 2);
+	g_assert_cmpuint(test_purple_sqlite_history_adapter_count(adapter,
+	                                                          "in:search"),
+	                 ==, 2);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_query_cursor(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	char *contents = NULL;
+	char *first_id = NULL;
+	char *second_id = NULL;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "paging");
+
+	test_purple_sqlite_history_adapter_write_n(adapter, conversation, "dave",
+	                                           10);
+
+	/* Without a limit we get everything in the order it was written. */
+	contents = test_purple_sqlite_history_adapter_cursor_contents(adapter,
+	                                                              "in:paging",
+	                                                              NULL, 0,
+	                                                              NULL);
+	g_assert_cmpstr(contents, ==,
+	                "message 0,message 1,message 2,message 3,message 4,"
+	                "message 5,message 6,message 7,message 8,message 9");
+	g_clear_pointer(&contents, g_free);
+
+	/* A limit without before gives us the newest messages. */
+	contents = test_purple_sqlite_history_adapter_cursor_contents(adapter,
+	                                                              "in:paging",
+	                                                              NULL, 3,
+	                                                              &first_id);
+	g_assert_cmpstr(contents, ==, "message 7,message 8,message 9");
+	g_clear_pointer(&contents, g_free);
+	g_assert_nonnull(first_id);
+
+	/* Now page backwards from the oldest message we've seen. */
+	contents = test_purple_sqlite_history_adapter_cursor_contents(adapter,
+	                                                              "in:paging",
+	                                                              first_id, 3,
+	                                                              &second_id);
+	g_assert_cmpstr(contents, ==, "message 4,message 5,message 6");
+	g_clear_pointer(&contents, g_free);
+	g_clear_pointer(&first_id, g_free);
+
+	contents = test_purple_sqlite_history_adapter_cursor_contents(adapter,
+	                                                              "in:paging",
+	                                                              second_id, 10,
+	                                                              NULL);
+	g_assert_cmpstr(contents, ==, "message 0,message 1,message 2,message 3");
+	g_clear_pointer(&contents, g_free);
+	g_clear_pointer(&second_id, g_free);
+
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_query_cursor_scoped(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleConversation *other = NULL;
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleMessage *message = NULL;
+	GError *error = NULL;
+	char *contents = NULL;
+	gboolean ret = FALSE;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	account = purple_account_new("test", "test");
+	conversation = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                                   "scoped");
+	other = test_purple_sqlite_history_adapter_conversation_new(account,
+	                                                            "other");
+
+	/* The same message id is logged in another conversation first. */
+	message = purple_message_new_outgoing("dave", NULL, "shared", 0);
+
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "dave", "message 0");
+	ret = purple_history_adapter_write(adapter, other, message, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+	test_purple_sqlite_history_adapter_write_contents(adapter, conversation,
+	                                                  "dave", "message 1");
+	ret = purple_history_adapter_write(adapter, conversation, message, &error);
+	g_assert_no_error(error);
+	g_assert_true(ret);
+
+	/* Paging from it finds the one in the conversation being paged. */
+	contents = test_purple_sqlite_history_adapter_cursor_contents(adapter,
+	                                                              "in:scoped",
+	                                                              purple_message_get_id(message),
+	                                                              10, NULL);
+	g_assert_cmpstr(contents, ==, "message 0,message 1");
+	g_clear_pointer(&contents, g_free);
+
+	g_clear_object(&message);
+	test_purple_sqlite_history_adapter_conversation_free(other);
+	test_purple_sqlite_history_adapter_conversation_free(conversation);
+	g_clear_object(&account);
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_purple_sqlite_history_adapter_query_cursor_unknown(void) {
+	PurpleHistoryAdapter *adapter = NULL;
+	PurpleHistoryCursor *cursor = NULL;
+	GError *error = NULL;
+
+	adapter = test_purple_sqlite_history_adapter_new(TRUE);
+
+	cursor = purple_history_adapter_query_cursor(adapter, "in:paging",
+	                                             "does-not-exist", 10, &error);
+	g_assert_error(error, PURPLE_HISTORY_ADAPTER_DOMAIN, 0);
+	g_assert_null(cursor);
+	g_clear_error(&error);
+
+	test_purple_sqlite_history_adapter_free(adapter);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/sqlite-history-adapter/write/synchronous",
+	                test_purple_sqlite_history_adapter_write_synchronous);
+	g_test_add_func("/sqlite-history-adapter/write/write-behind",
+	                test_purple_sqlite_history_adapter_write_behind);
+	g_test_add_func("/sqlite-history-adapter/write/write-behind-remove",
+	                test_purple_sqlite_history_adapter_write_behind_remove);
+	g_test_add_func("/sqlite-history-adapter/write/write-behind-bad-row",
+	                test_purple_sqlite_history_adapter_write_behind_bad_row);
+	g_test_add_func("/sqlite-history-adapter/write/write-behind-queue-size",
+	                test_purple_sqlite_history_adapter_write_behind_queue_size);
+	g_test_add_func("/sqlite-history-adapter/write/duplicate",
+	                test_purple_sqlite_history_adapter_write_duplicate);
+
+	g_test_add_func("/sqlite-history-adapter/query/keywords",
+	                test_purple_sqlite_history_adapter_query_keywords);
+	g_test_add_func("/sqlite-history-adapter/query/cursor",
+	                test_purple_sqlite_history_adapter_query_cursor);
+	g_test_add_func("/sqlite-history-adapter/query/cursor-scoped",
+	                test_purple_sqlite_history_adapter_query_cursor_scoped);
+	g_test_add_func("/sqlite-history-adapter/query/cursor-unknown",
+	                test_purple_sqlite_history_adapter_query_cursor_unknown);
+
+	ret = g_test_run();
+
+	test_ui_purple_uninit();
+
+	return ret;
+}
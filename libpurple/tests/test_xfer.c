@@ -0,0 +1,754 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <glib-unix.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Matches FT_INITIAL_BUFFER_SIZE in xfer.c, the most the buffered path moves
+ * on its first iteration. */
+#define TEST_XFER_INITIAL_CHUNK 4096
+
+/* A rate limit and what each transfer may move of it in one interval of the
+ * scheduler, which runs every FT_SCHEDULER_INTERVAL (100 ms) in xfer.c. */
+#define TEST_XFER_RATE (20 * 1024)
+#define TEST_XFER_RATE_SHARE (TEST_XFER_RATE / 10)
+
+/******************************************************************************
+ * TestAckXfer, a transfer that looks at the data it sends
+ *****************************************************************************/
+#define TEST_TYPE_ACK_XFER (test_ack_xfer_get_type())
+G_DECLARE_FINAL_TYPE(TestAckXfer, test_ack_xfer, TEST, ACK_XFER, PurpleXfer)
+
+struct _TestAckXfer {
+	PurpleXfer parent;
+
+	gsize acked;
+	gsize max_chunk;
+};
+
+G_DEFINE_FINAL_TYPE(TestAckXfer, test_ack_xfer, PURPLE_TYPE_XFER)
+
+static void
+test_ack_xfer_ack(PurpleXfer *xfer, const guchar *buffer, gsize size) {
+	TestAckXfer *ack_xfer = TEST_ACK_XFER(xfer);
+
+	/* A cancelled transfer has given its buffer back already. */
+	g_assert_false(purple_xfer_is_cancelled(xfer));
+	g_assert_nonnull(buffer);
+
+	ack_xfer->acked += size;
+	ack_xfer->max_chunk = MAX(ack_xfer->max_chunk, size);
+}
+
+static void
+test_ack_xfer_init(G_GNUC_UNUSED TestAckXfer *xfer) {
+}
+
+static void
+test_ack_xfer_class_init(TestAckXferClass *klass) {
+	PurpleXferClass *xfer_class = PURPLE_XFER_CLASS(klass);
+
+	xfer_class->ack = test_ack_xfer_ack;
+}
+
+/******************************************************************************
+ * TestReadXfer, a transfer with its own read method
+ *****************************************************************************/
+#define TEST_TYPE_READ_XFER (test_read_xfer_get_type())
+G_DECLARE_FINAL_TYPE(TestReadXfer, test_read_xfer, TEST, READ_XFER,
+                     PurpleXfer)
+
+struct _TestReadXfer {
+	PurpleXfer parent;
+
+	/* The buffer returned by each call to read, in order. */
+	GPtrArray *buffers;
+};
+
+G_DEFINE_FINAL_TYPE(TestReadXfer, test_read_xfer, PURPLE_TYPE_XFER)
+
+static gssize
+test_read_xfer_read(PurpleXfer *xfer, guchar **buffer, gsize size) {
+	TestReadXfer *read_xfer = TEST_READ_XFER(xfer);
+	gssize r;
+
+	*buffer = g_malloc(size);
+	r = read(purple_xfer_get_fd(xfer), *buffer, size);
+	if(r < 0 && errno == EAGAIN) {
+		r = 0;
+	} else if(r <= 0) {
+		r = -1;
+	}
+
+	if(r > 0) {
+		g_ptr_array_add(read_xfer->buffers, *buffer);
+	}
+
+	return r;
+}
+
+static void
+test_read_xfer_finalize(GObject *obj) {
+	TestReadXfer *read_xfer = TEST_READ_XFER(obj);
+
+	g_ptr_array_free(read_xfer->buffers, TRUE);
+
+	G_OBJECT_CLASS(test_read_xfer_parent_class)->finalize(obj);
+}
+
+static void
+test_read_xfer_init(TestReadXfer *xfer) {
+	xfer->buffers = g_ptr_array_new();
+}
+
+static void
+test_read_xfer_class_init(TestReadXferClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+	PurpleXferClass *xfer_class = PURPLE_XFER_CLASS(klass);
+
+	obj_class->finalize = test_read_xfer_finalize;
+
+	xfer_class->read = test_read_xfer_read;
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleXfer *
+test_xfer_new_for_account(GType type, PurpleXferType xfer_type,
+                          PurpleAccount *account)
+{
+	PurpleXfer *xfer = NULL;
+
+	xfer = g_object_new(type,
+	                    "account", account,
+	                    "type", xfer_type,
+	                    "remote-user", "bob",
+	                    NULL);
+	/* The transfer doesn't hold a reference to its account. */
+	g_object_set_data_full(G_OBJECT(xfer), "test-account",
+	                       g_object_ref(account), g_object_unref);
+
+	return xfer;
+}
+
+static PurpleXfer *
+test_xfer_new(GType type, PurpleXferType xfer_type) {
+	PurpleAccount *account = purple_account_new("test", "test");
+	PurpleXfer *xfer = NULL;
+
+	xfer = test_xfer_new_for_account(type, xfer_type, account);
+	g_object_unref(account);
+
+	return xfer;
+}
+
+static GBytes *
+test_xfer_create_contents(gsize size) {
+	guchar *data = g_malloc(size);
+
+	for(gsize i = 0; i < size; i++) {
+		data[i] = i % 251;
+	}
+
+	return g_bytes_new_take(data, size);
+}
+
+/* Writes @size bytes of a pattern to a new temporary file. */
+static gchar *
+test_xfer_create_file(gsize size, GBytes **contents) {
+	GError *error = NULL;
+	gchar *filename = NULL;
+	gint fd;
+
+	*contents = test_xfer_create_contents(size);
+
+	fd = g_file_open_tmp("purple-test-xfer-XXXXXX", &filename, &error);
+	g_assert_no_error(error);
+	close(fd);
+
+	g_file_set_contents(filename, g_bytes_get_data(*contents, NULL), size,
+	                    &error);
+	g_assert_no_error(error);
+
+	return filename;
+}
+
+static void
+test_xfer_socketpair(gint fds[2]) {
+	GError *error = NULL;
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	g_unix_set_fd_nonblocking(fds[0], TRUE, &error);
+	g_assert_no_error(error);
+	g_unix_set_fd_nonblocking(fds[1], TRUE, &error);
+	g_assert_no_error(error);
+}
+
+/* Reads whatever is waiting on @fd. Returns FALSE once it is closed. */
+static gboolean
+test_xfer_drain(gint fd, GByteArray *received) {
+	guint8 buffer[8192];
+	gssize r;
+
+	while((r = read(fd, buffer, sizeof(buffer))) > 0) {
+		g_byte_array_append(received, buffer, r);
+	}
+
+	return r != 0;
+}
+
+static void
+test_xfer_bytes_sent_cb(PurpleXfer *xfer, G_GNUC_UNUSED GParamSpec *pspec,
+                        gpointer data)
+{
+	goffset *first_chunk = data;
+
+	if(*first_chunk == 0) {
+		*first_chunk = purple_xfer_get_bytes_sent(xfer);
+	}
+}
+
+/* Sends @filename over a socket pair and returns how much the first
+ * iteration moved. */
+static goffset
+test_xfer_run_send(PurpleXfer *xfer, const gchar *filename, GBytes *contents) {
+	GByteArray *received = g_byte_array_new();
+	goffset first_chunk = 0;
+	gint fds[2];
+
+	test_xfer_socketpair(fds);
+
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, g_bytes_get_size(contents));
+	g_signal_connect(xfer, "notify::bytes-sent",
+	                 G_CALLBACK(test_xfer_bytes_sent_cb), &first_chunk);
+
+	/* Ending the transfer drops a reference that a protocol would hold. */
+	g_object_ref(xfer);
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+
+	while(purple_xfer_get_status(xfer) == PURPLE_XFER_STATUS_STARTED) {
+		test_xfer_drain(fds[1], received);
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_assert_true(purple_xfer_is_completed(xfer));
+	g_signal_handlers_disconnect_by_data(xfer, &first_chunk);
+
+	while(test_xfer_drain(fds[1], received)) {
+	}
+	close(fds[1]);
+
+	g_assert_cmpmem(received->data, received->len,
+	                g_bytes_get_data(contents, NULL),
+	                g_bytes_get_size(contents));
+	g_byte_array_unref(received);
+
+	return first_chunk;
+}
+
+static gssize
+test_xfer_write_local_cb(G_GNUC_UNUSED PurpleXfer *xfer, guchar *buffer,
+                         gssize size, gpointer data)
+{
+	GPtrArray *chunks = data;
+
+	g_ptr_array_add(chunks, g_bytes_new(buffer, size));
+	/* Keep the address to see which buffer the data came in. */
+	g_ptr_array_add(chunks, buffer);
+
+	return size;
+}
+
+/* Receives @contents over a socket pair, returning the buffer each chunk was
+ * handed to write-local in. */
+static GPtrArray *
+test_xfer_run_receive(PurpleXfer *xfer, GBytes *contents) {
+	GByteArray *received = g_byte_array_new();
+	GPtrArray *chunks = g_ptr_array_new();
+	GPtrArray *buffers = g_ptr_array_new();
+	gchar *filename = NULL;
+	gint fds[2];
+	gint fd;
+
+	test_xfer_socketpair(fds);
+	g_assert_cmpint(write(fds[1], g_bytes_get_data(contents, NULL),
+	                      g_bytes_get_size(contents)),
+	                ==, g_bytes_get_size(contents));
+
+	fd = g_file_open_tmp("purple-test-xfer-XXXXXX", &filename, NULL);
+	close(fd);
+
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, g_bytes_get_size(contents));
+	g_signal_connect(xfer, "write-local",
+	                 G_CALLBACK(test_xfer_write_local_cb), chunks);
+
+	g_object_ref(xfer);
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+
+	while(purple_xfer_get_status(xfer) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_assert_true(purple_xfer_is_completed(xfer));
+	g_signal_handlers_disconnect_by_data(xfer, chunks);
+	close(fds[1]);
+
+	for(guint i = 0; i < chunks->len; i += 2) {
+		GBytes *chunk = g_ptr_array_index(chunks, i);
+
+		g_byte_array_append(received, g_bytes_get_data(chunk, NULL),
+		                    g_bytes_get_size(chunk));
+		g_ptr_array_add(buffers, g_ptr_array_index(chunks, i + 1));
+		g_bytes_unref(chunk);
+	}
+
+	g_assert_cmpmem(received->data, received->len,
+	                g_bytes_get_data(contents, NULL),
+	                g_bytes_get_size(contents));
+
+	g_byte_array_unref(received);
+	g_ptr_array_free(chunks, TRUE);
+	g_unlink(filename);
+	g_free(filename);
+
+	return buffers;
+}
+
+/* Starts receiving @size bytes over a socket pair into a new temporary file,
+ * whose name is returned. The other end of the pair is returned in @peer. */
+static gchar *
+test_xfer_start_receive(PurpleXfer *xfer, gsize size, gint *peer) {
+	gchar *filename = NULL;
+	gint fds[2];
+	gint fd;
+
+	test_xfer_socketpair(fds);
+
+	fd = g_file_open_tmp("purple-test-xfer-XXXXXX", &filename, NULL);
+	close(fd);
+
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, size);
+
+	g_object_ref(xfer);
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+
+	*peer = fds[1];
+
+	return filename;
+}
+
+/******************************************************************************
+ * Send tests
+ *****************************************************************************/
+#ifdef HAVE_SENDFILE
+static void
+test_purple_xfer_send_sendfile(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	gchar *filename = NULL;
+	goffset first_chunk = 0;
+
+	filename = test_xfer_create_file(64 * 1024, &contents);
+
+	/* The default write method sends the data unchanged, so the file goes
+	 * out with sendfile() in one go instead of through the buffer. */
+	xfer = test_xfer_new(PURPLE_TYPE_XFER, PURPLE_XFER_TYPE_SEND);
+	first_chunk = test_xfer_run_send(xfer, filename, contents);
+	g_assert_cmpint(first_chunk, >, TEST_XFER_INITIAL_CHUNK);
+
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+	g_unlink(filename);
+	g_free(filename);
+}
+#endif /* HAVE_SENDFILE */
+
+static void
+test_purple_xfer_send_buffered(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	gchar *filename = NULL;
+	goffset first_chunk = 0;
+
+	filename = test_xfer_create_file(64 * 1024, &contents);
+
+	/* The ack method has to see every chunk, so the data is read into the
+	 * transfer buffer a piece at a time. */
+	xfer = test_xfer_new(TEST_TYPE_ACK_XFER, PURPLE_XFER_TYPE_SEND);
+	first_chunk = test_xfer_run_send(xfer, filename, contents);
+	g_assert_cmpint(first_chunk, <=, TEST_XFER_INITIAL_CHUNK);
+	g_assert_cmpuint(TEST_ACK_XFER(xfer)->acked, ==,
+	                 g_bytes_get_size(contents));
+
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+static gboolean
+test_xfer_data_not_sent_cb(G_GNUC_UNUSED PurpleXfer *xfer,
+                           G_GNUC_UNUSED gpointer buffer,
+                           G_GNUC_UNUSED gulong size, gpointer data)
+{
+	gboolean *called = data;
+
+	*called = TRUE;
+
+	return FALSE;
+}
+
+static void
+test_purple_xfer_send_data_not_sent_cancels(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	gchar *filename = NULL;
+	GByteArray *received = g_byte_array_new();
+	gboolean called = FALSE;
+	gint sndbuf = 4096;
+	gint fds[2];
+
+	filename = test_xfer_create_file(1024 * 1024, &contents);
+
+	/* With a small socket buffer, a write comes up short once the chunks have
+	 * grown past it. */
+	test_xfer_socketpair(fds);
+	setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	xfer = test_xfer_new(TEST_TYPE_ACK_XFER, PURPLE_XFER_TYPE_SEND);
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, g_bytes_get_size(contents));
+	g_signal_connect(xfer, "data-not-sent",
+	                 G_CALLBACK(test_xfer_data_not_sent_cb), &called);
+
+	g_object_ref(xfer);
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+
+	while(purple_xfer_get_status(xfer) == PURPLE_XFER_STATUS_STARTED) {
+		test_xfer_drain(fds[1], received);
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	/* test_ack_xfer_ack() fails if it's called after the cancel. */
+	g_signal_handlers_disconnect_by_data(xfer, &called);
+	g_assert_true(called);
+	g_assert_cmpint(purple_xfer_get_status(xfer), ==,
+	                PURPLE_XFER_STATUS_CANCEL_LOCAL);
+	g_assert_cmpuint(TEST_ACK_XFER(xfer)->acked, <,
+	                 g_bytes_get_size(contents));
+
+	close(fds[1]);
+	g_byte_array_unref(received);
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+/******************************************************************************
+ * Receive tests
+ *****************************************************************************/
+static void
+test_purple_xfer_receive_reuses_buffer(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	GPtrArray *buffers = NULL;
+
+	contents = test_xfer_create_contents(32 * 1024);
+
+	xfer = test_xfer_new(PURPLE_TYPE_XFER, PURPLE_XFER_TYPE_RECEIVE);
+	buffers = test_xfer_run_receive(xfer, contents);
+
+	/* Without a read method every chunk lands in the same buffer. */
+	g_assert_cmpuint(buffers->len, >, 1);
+	for(guint i = 1; i < buffers->len; i++) {
+		g_assert_true(g_ptr_array_index(buffers, i) ==
+		              g_ptr_array_index(buffers, 0));
+	}
+
+	g_ptr_array_free(buffers, TRUE);
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+}
+
+static void
+test_purple_xfer_receive_protocol_read(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	GPtrArray *buffers = NULL;
+	GPtrArray *read_buffers = NULL;
+
+	contents = test_xfer_create_contents(32 * 1024);
+
+	xfer = test_xfer_new(TEST_TYPE_READ_XFER, PURPLE_XFER_TYPE_RECEIVE);
+	buffers = test_xfer_run_receive(xfer, contents);
+
+	/* Each chunk is the buffer the read method returned. */
+	read_buffers = TEST_READ_XFER(xfer)->buffers;
+	g_assert_cmpuint(buffers->len, >, 1);
+	g_assert_cmpuint(buffers->len, ==, read_buffers->len);
+	for(guint i = 0; i < buffers->len; i++) {
+		g_assert_true(g_ptr_array_index(buffers, i) ==
+		              g_ptr_array_index(read_buffers, i));
+	}
+
+	g_ptr_array_free(buffers, TRUE);
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+}
+
+/******************************************************************************
+ * Scheduler tests
+ *****************************************************************************/
+static void
+test_purple_xfer_scheduler_rate(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	gchar *filename = NULL;
+	goffset first_chunk = 0;
+
+	filename = test_xfer_create_file(8 * 1024, &contents);
+
+	purple_xfers_set_max_rate(TEST_XFER_RATE);
+
+	/* Every chunk fits in the transfer's share of the rate, so the file
+	 * takes several intervals to go out. */
+	xfer = test_xfer_new(TEST_TYPE_ACK_XFER, PURPLE_XFER_TYPE_SEND);
+	first_chunk = test_xfer_run_send(xfer, filename, contents);
+	g_assert_cmpint(first_chunk, <=, TEST_XFER_RATE_SHARE);
+	g_assert_cmpuint(TEST_ACK_XFER(xfer)->max_chunk, <=,
+	                 TEST_XFER_RATE_SHARE);
+	g_assert_cmpuint(TEST_ACK_XFER(xfer)->acked, ==,
+	                 g_bytes_get_size(contents));
+
+	purple_xfers_set_max_rate(0);
+
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+#ifdef HAVE_SENDFILE
+static void
+test_purple_xfer_scheduler_rate_sendfile(void) {
+	PurpleXfer *xfer = NULL;
+	GBytes *contents = NULL;
+	gchar *filename = NULL;
+	goffset first_chunk = 0;
+
+	filename = test_xfer_create_file(8 * 1024, &contents);
+
+	purple_xfers_set_max_rate(TEST_XFER_RATE);
+
+	/* sendfile() is capped to the share as well, instead of sending the
+	 * whole file in one go. */
+	xfer = test_xfer_new(PURPLE_TYPE_XFER, PURPLE_XFER_TYPE_SEND);
+	first_chunk = test_xfer_run_send(xfer, filename, contents);
+	g_assert_cmpint(first_chunk, <=, TEST_XFER_RATE_SHARE);
+
+	purple_xfers_set_max_rate(0);
+
+	g_clear_object(&xfer);
+	g_bytes_unref(contents);
+	g_unlink(filename);
+	g_free(filename);
+}
+#endif /* HAVE_SENDFILE */
+
+static void
+test_purple_xfer_scheduler_per_account(void) {
+	PurpleAccount *account = NULL, *other = NULL;
+	PurpleXfer *first = NULL, *second = NULL, *third = NULL;
+	GBytes *contents = NULL;
+	gchar *first_file = NULL, *second_file = NULL, *third_file = NULL;
+	gint first_peer, second_peer, third_peer;
+	gsize size = 4096;
+
+	contents = test_xfer_create_contents(size);
+	account = purple_account_new("test", "test");
+	other = purple_account_new("other", "test");
+
+	purple_xfers_set_max_active_per_account(1);
+
+	first = test_xfer_new_for_account(PURPLE_TYPE_XFER,
+	                                  PURPLE_XFER_TYPE_RECEIVE, account);
+	second = test_xfer_new_for_account(PURPLE_TYPE_XFER,
+	                                   PURPLE_XFER_TYPE_RECEIVE, account);
+	third = test_xfer_new_for_account(PURPLE_TYPE_XFER,
+	                                  PURPLE_XFER_TYPE_RECEIVE, other);
+
+	first_file = test_xfer_start_receive(first, size, &first_peer);
+	second_file = test_xfer_start_receive(second, size, &second_peer);
+	third_file = test_xfer_start_receive(third, size, &third_peer);
+
+	/* The second transfer is queued behind the first one on its account,
+	 * while the third one on another account runs right away. */
+	g_assert_cmpint(write(second_peer, g_bytes_get_data(contents, NULL), size),
+	                ==, size);
+	g_assert_cmpint(write(third_peer, g_bytes_get_data(contents, NULL), size),
+	                ==, size);
+
+	while(purple_xfer_get_status(third) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_true(purple_xfer_is_completed(third));
+	g_assert_cmpint(purple_xfer_get_status(second), ==,
+	                PURPLE_XFER_STATUS_STARTED);
+	g_assert_cmpint(purple_xfer_get_bytes_sent(second), ==, 0);
+
+	/* Once the first transfer is done, the second one is resumed. */
+	g_assert_cmpint(write(first_peer, g_bytes_get_data(contents, NULL), size),
+	                ==, size);
+
+	while(purple_xfer_get_status(first) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_true(purple_xfer_is_completed(first));
+	g_assert_cmpint(purple_xfer_get_bytes_sent(second), ==, 0);
+
+	while(purple_xfer_get_status(second) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_true(purple_xfer_is_completed(second));
+
+	purple_xfers_set_max_active_per_account(0);
+
+	close(first_peer);
+	close(second_peer);
+	close(third_peer);
+	g_unlink(first_file);
+	g_unlink(second_file);
+	g_unlink(third_file);
+	g_free(first_file);
+	g_free(second_file);
+	g_free(third_file);
+	g_clear_object(&first);
+	g_clear_object(&second);
+	g_clear_object(&third);
+	g_clear_object(&account);
+	g_clear_object(&other);
+	g_bytes_unref(contents);
+}
+#endif /* _WIN32 */
+
+/******************************************************************************
+ * Conversation tests
+ *****************************************************************************/
+static void
+test_purple_xfer_conversation_write(void) {
+	PurpleAccount *account = NULL;
+	PurpleConversation *im = NULL;
+	PurpleConversationManager *manager = NULL;
+	PurpleXfer *xfer = NULL;
+	GListModel *messages = NULL;
+
+	account = purple_account_new("test", "test");
+	xfer = g_object_new(PURPLE_TYPE_XFER,
+	                    "account", account,
+	                    "type", PURPLE_XFER_TYPE_SEND,
+	                    "remote-user", "bob",
+	                    NULL);
+
+	/* Without a conversation with the remote user there is nowhere to write
+	 * to, so nothing happens.
+	 */
+	purple_xfer_conversation_write(xfer, "no conversation", FALSE);
+
+	/* Conversations register themselves when they are created. */
+	im = g_object_new(PURPLE_TYPE_IM_CONVERSATION,
+	                  "account", account,
+	                  "name", "bob",
+	                  NULL);
+	messages = purple_conversation_get_messages(im);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 0);
+
+	/* With one, the message ends up in it. */
+	purple_xfer_conversation_write(xfer, "transfer message", FALSE);
+	g_assert_cmpuint(g_list_model_get_n_items(messages), ==, 1);
+
+	manager = purple_conversation_manager_get_default();
+	purple_conversation_manager_unregister(manager, im);
+
+	g_clear_object(&im);
+	g_clear_object(&xfer);
+	g_clear_object(&account);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	gint ret = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/xfer/conversation/write",
+	                test_purple_xfer_conversation_write);
+
+#ifndef _WIN32
+#ifdef HAVE_SENDFILE
+	g_test_add_func("/xfer/send/sendfile",
+	                test_purple_xfer_send_sendfile);
+#endif /* HAVE_SENDFILE */
+	g_test_add_func("/xfer/send/buffered",
+	                test_purple_xfer_send_buffered);
+	g_test_add_func("/xfer/send/data-not-sent-cancels",
+	                test_purple_xfer_send_data_not_sent_cancels);
+	g_test_add_func("/xfer/receive/reuses-buffer",
+	                test_purple_xfer_receive_reuses_buffer);
+	g_test_add_func("/xfer/receive/protocol-read",
+	                test_purple_xfer_receive_protocol_read);
+	g_test_add_func("/xfer/scheduler/rate",
+	                test_purple_xfer_scheduler_rate);
+#ifdef HAVE_SENDFILE
+	g_test_add_func("/xfer/scheduler/rate-sendfile",
+	                test_purple_xfer_scheduler_rate_sendfile);
+#endif /* HAVE_SENDFILE */
+	g_test_add_func("/xfer/scheduler/per-account",
+	                test_purple_xfer_scheduler_per_account);
+#endif /* _WIN32 */
+
+	ret = g_test_run();
+
+	test_ui_purple_uninit();
+
+	return ret;
+}
@@ -21,9 +21,12 @@
  *
  */
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <purple.h>
 
+#include "../purpleprivate.h"
+
 /*
  * If we really wanted to test the billion laughs attack we would
  * need to have more than just 4 ha's.  But as long as this shorter
@@ -134,8 +137,426 @@ test_strip_prefixes(void) {
 	purple_xmlnode_free(xml);
 }
 
+static void
+test_xmlnode_arena(void) {
+	PurpleXmlNodeArena *arena = NULL;
+	PurpleXmlNode *iq, *query, *item, *copy;
+	char *str;
+
+	arena = purple_xmlnode_arena_new();
+	iq = purple_xmlnode_new_in_arena(arena, "iq");
+	purple_xmlnode_arena_unref(arena);
+
+	g_assert_nonnull(iq);
+	g_assert_true(iq->arena == arena);
+
+	purple_xmlnode_set_namespace(iq, "jabber:client");
+	purple_xmlnode_set_attrib(iq, "type", "result");
+	purple_xmlnode_set_attrib(iq, "id", "1");
+
+	/* Children, attributes and data should all end up in the arena. */
+	query = purple_xmlnode_new_child(iq, "query");
+	g_assert_true(query->arena == arena);
+	purple_xmlnode_set_namespace(query, "jabber:iq:roster");
+
+	item = purple_xmlnode_new_child(query, "item");
+	purple_xmlnode_set_attrib(item, "jid", "alice@example.com");
+	purple_xmlnode_insert_data(item, "hello", -1);
+
+	/* Replacing and removing values shouldn't try to free arena memory. */
+	purple_xmlnode_set_attrib(iq, "type", "set");
+	purple_xmlnode_set_attrib(iq, "type", "set");
+	purple_xmlnode_remove_attrib(iq, "id");
+	purple_xmlnode_set_prefix(item, "r");
+	purple_xmlnode_set_prefix(item, NULL);
+	purple_xmlnode_declare_namespace(query, "r", "jabber:iq:roster");
+
+	g_assert_cmpstr(purple_xmlnode_get_attrib(iq, "type"), ==, "set");
+	g_assert_null(purple_xmlnode_get_attrib(iq, "id"));
+
+	/* A replaced value is allocated on its own instead of in the arena. */
+	for(PurpleXmlNode *attrib = iq->child; attrib; attrib = attrib->next) {
+		if(attrib->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			g_assert_cmpstr(attrib->name, ==, "type");
+			g_assert_null(attrib->arena);
+		}
+	}
+	g_assert_cmpstr(purple_xmlnode_get_prefix_namespace(item, "r"), ==,
+	                "jabber:iq:roster");
+
+	str = purple_xmlnode_to_str(iq, NULL);
+	g_assert_cmpstr(str, ==,
+	                "<iq xmlns='jabber:client' type='set'>"
+	                "<query xmlns:r='jabber:iq:roster'>"
+	                "<item jid='alice@example.com'>hello</item>"
+	                "</query></iq>");
+	g_free(str);
+
+	/* A copy doesn't live in the arena and outlives the original. */
+	copy = purple_xmlnode_copy(iq);
+	g_assert_null(copy->arena);
+
+	purple_xmlnode_free(iq);
+
+	g_assert_cmpstr(purple_xmlnode_get_attrib(copy, "type"), ==, "set");
+	purple_xmlnode_free(copy);
+}
+
+static void
+test_xmlnode_arena_detach(void) {
+	PurpleXmlNodeArena *arena = NULL;
+	PurpleXmlNode *message, *subject, *body, *other, *plain;
+	char *data;
+
+	arena = purple_xmlnode_arena_new();
+	message = purple_xmlnode_new_in_arena(arena, "message");
+	purple_xmlnode_arena_unref(arena);
+
+	subject = purple_xmlnode_new_child(message, "subject");
+	body = purple_xmlnode_new_child(message, "body");
+	purple_xmlnode_set_attrib(body, "xml:lang", "en");
+	purple_xmlnode_insert_data(body, "still here", -1);
+
+	/* Move body out of the stanza and into a tree that isn't in the arena
+	 * before the stanza is freed, which is what handlers that keep part of a
+	 * stanza around do. The copy doesn't hold on to the arena.
+	 */
+	body = purple_xmlnode_detach(body);
+	g_assert_null(body->arena);
+	g_assert_null(body->parent);
+	g_assert_true(message->child == subject);
+	g_assert_true(message->lastchild == subject);
+	g_assert_null(subject->next);
+
+	other = purple_xmlnode_new("other");
+	purple_xmlnode_insert_child(other, body);
+
+	/* This releases the last reference to the arena. */
+	purple_xmlnode_free(message);
+
+	data = purple_xmlnode_get_data(body);
+	g_assert_cmpstr(data, ==, "still here");
+	g_free(data);
+	g_assert_cmpstr(purple_xmlnode_get_attrib(body, "xml:lang"), ==, "en");
+
+	/* Nodes that aren't in an arena are detached as is. */
+	plain = purple_xmlnode_detach(body);
+	g_assert_true(plain == body);
+	g_assert_null(other->child);
+	g_assert_null(other->lastchild);
+
+	purple_xmlnode_free(plain);
+	purple_xmlnode_free(other);
+}
+
+static void
+test_xmlnode_write_to_string(void) {
+	PurpleXmlNode *message, *body;
+	GString *buffer = NULL;
+	char *str = NULL;
+	int len = 0;
+	const gsize offset = sizeof("<?xml?>") - 1;
+
+	message = purple_xmlnode_new("message");
+	purple_xmlnode_set_namespace(message, "jabber:client");
+	purple_xmlnode_set_attrib(message, "to", "a&b<c>'d\"");
+
+	body = purple_xmlnode_new_child(message, "body");
+	purple_xmlnode_insert_data(body, "x\001y\302\205z\302\220", -1);
+
+	/* The buffer is appended to, not replaced. */
+	buffer = g_string_new("<?xml?>");
+	purple_xmlnode_write_to_string(message, buffer);
+	g_assert_cmpstr(buffer->str, ==,
+	                "<?xml?>"
+	                "<message xmlns='jabber:client' "
+	                "to='a&amp;b&lt;c&gt;&apos;d&quot;'>"
+	                "<body>x&#x1;y\302\205z&#x90;</body>"
+	                "</message>");
+
+	/* It must match what purple_xmlnode_to_str produces. */
+	str = purple_xmlnode_to_str(message, &len);
+	g_assert_cmpint(len, ==, buffer->len - offset);
+	g_assert_cmpstr(str, ==, buffer->str + offset);
+
+	g_free(str);
+	g_string_free(buffer, TRUE);
+	purple_xmlnode_free(message);
+}
+
+static void
+test_xmlnode_stream_collect(PurpleXmlNode *node, gpointer data) {
+	GPtrArray *seen = data;
+	gchar *text = NULL;
+
+	if(node->parent == NULL) {
+		/* The root arrives before its children and without any text. */
+		g_assert_null(purple_xmlnode_get_child(node, "item"));
+		g_ptr_array_add(seen, g_strdup_printf("%s(%s)", node->name,
+			purple_xmlnode_get_attrib(node, "version")));
+		return;
+	}
+
+	/* Children arrive complete and already detached from their siblings. */
+	g_assert_null(purple_xmlnode_get_next_twin(node));
+	text = purple_xmlnode_get_data(purple_xmlnode_get_child(node, "value"));
+	g_ptr_array_add(seen, g_strdup_printf("%s=%s",
+		purple_xmlnode_get_attrib(node, "id"), text));
+	g_free(text);
+}
+
+static void
+test_xmlnode_stream_from_file(void) {
+	GPtrArray *seen = g_ptr_array_new_with_free_func(g_free);
+	gchar *dir = g_dir_make_tmp("purple-xmlnode-XXXXXX", NULL);
+	gchar *filename = g_build_filename(dir, "test.xml", NULL);
+	const gchar *contents =
+		"<?xml version='1.0' encoding='UTF-8' ?>\n"
+		"<config version='1'>\n"
+		"  <item id='a'><value>1</value></item>\n"
+		"  <item id='b'><value>2</value></item>\n"
+		"  <item id='c'><value>3</value></item>\n"
+		"</config>\n";
+	gboolean ret = FALSE;
+
+	g_assert_true(g_file_set_contents(filename, contents, -1, NULL));
+
+	ret = purple_xmlnode_stream_from_file(dir, "test.xml", "test", "test", 1,
+	                                      test_xmlnode_stream_collect, seen);
+	g_assert_true(ret);
+
+	g_assert_cmpuint(seen->len, ==, 4);
+	g_assert_cmpstr(g_ptr_array_index(seen, 0), ==, "config(1)");
+	g_assert_cmpstr(g_ptr_array_index(seen, 1), ==, "a=1");
+	g_assert_cmpstr(g_ptr_array_index(seen, 2), ==, "b=2");
+	g_assert_cmpstr(g_ptr_array_index(seen, 3), ==, "c=3");
+
+	/* A missing file is not an error, but nothing is streamed. */
+	g_ptr_array_set_size(seen, 0);
+	ret = purple_xmlnode_stream_from_file(dir, "missing.xml", "test", "test",
+	                                      1, test_xmlnode_stream_collect,
+	                                      seen);
+	g_assert_false(ret);
+	g_assert_cmpuint(seen->len, ==, 0);
+
+	g_unlink(filename);
+	g_rmdir(dir);
+	g_free(filename);
+	g_free(dir);
+	g_ptr_array_free(seen, TRUE);
+}
+
+static void
+test_xmlnode_stream_from_file_corrupt(void) {
+	if(g_test_subprocess()) {
+		GPtrArray *seen = g_ptr_array_new_with_free_func(g_free);
+		gchar *dir = g_dir_make_tmp("purple-xmlnode-XXXXXX", NULL);
+		gchar *filename = g_build_filename(dir, "test.xml", NULL);
+		gchar *backup = g_build_filename(dir, "test.xml~", NULL);
+		const gchar *contents =
+			"<?xml version='1.0' encoding='UTF-8' ?>\n"
+			"<config version='1'>\n"
+			"  <item id='a'><value>1</value></item>\n"
+			"  <item id='b'><value>2</value></oops>\n"
+			"  <item id='c'><value>3</value></item>\n"
+			"</config>\n";
+		gboolean ret = FALSE;
+
+		/* The parser errors are logged as criticals. */
+		g_log_set_always_fatal(G_LOG_FATAL_MASK);
+
+		g_assert_true(g_file_set_contents(filename, contents, -1, NULL));
+
+		ret = purple_xmlnode_stream_from_file(dir, "test.xml", "test", "test",
+		                                      1, test_xmlnode_stream_collect,
+		                                      seen);
+		g_assert_false(ret);
+
+		/* What came before the error was handed over, nothing after it. */
+		g_assert_cmpuint(seen->len, ==, 2);
+		g_assert_cmpstr(g_ptr_array_index(seen, 0), ==, "config(1)");
+		g_assert_cmpstr(g_ptr_array_index(seen, 1), ==, "a=1");
+
+		/* The file was backed up before anything could overwrite it. */
+		g_assert_true(g_file_test(backup, G_FILE_TEST_EXISTS));
+
+		g_unlink(backup);
+		g_unlink(filename);
+		g_rmdir(dir);
+		g_free(backup);
+		g_free(filename);
+		g_free(dir);
+		g_ptr_array_free(seen, TRUE);
+
+		return;
+	}
+
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_passed();
+	g_test_trap_assert_stderr("*Error parsing file*");
+}
+
+static void
+test_xmlnode_stream_serialize(PurpleXmlNode *node, gpointer data) {
+	GPtrArray *seen = data;
+
+	if(!purple_strequal(node->name, "contact")) {
+		g_ptr_array_add(seen, g_strdup(node->name));
+		return;
+	}
+
+	/* The ancestors of a complete element are still there. */
+	g_assert_cmpstr(node->parent->name, ==, "group");
+	g_assert_nonnull(purple_xmlnode_get_attrib(node->parent, "name"));
+
+	g_ptr_array_add(seen, purple_xmlnode_to_str(node, NULL));
+}
+
+/* Streaming a buddy list has to hand over the same elements as reading it
+ * whole.
+ */
+static void
+test_xmlnode_stream_from_file_matches_tree(void) {
+	GPtrArray *expected = g_ptr_array_new_with_free_func(g_free);
+	GPtrArray *seen = g_ptr_array_new_with_free_func(g_free);
+	PurpleXmlNode *root = NULL, *blist = NULL;
+	gchar *dir = g_dir_make_tmp("purple-xmlnode-XXXXXX", NULL);
+	gchar *filename = g_build_filename(dir, "blist.xml", NULL);
+	const gchar *contents =
+		"<?xml version='1.0' encoding='UTF-8' ?>\n"
+		"<purple version='1.0'><blist>"
+		"<group name='Buddies'>"
+		"<contact><buddy account='me@example.com' proto='prpl-jabber'>"
+		"<name>alice@example.com</name><alias>Alice &amp; Co</alias>"
+		"<setting name='last_seen' type='int'>1</setting>"
+		"</buddy></contact>"
+		"<contact alias='Bob'>"
+		"<buddy account='me@example.com' proto='prpl-jabber'>"
+		"<name>bob@example.com</name></buddy>"
+		"<buddy account='me@example.com' proto='prpl-jabber'>"
+		"<name>bob@example.org</name></buddy>"
+		"</contact>"
+		"</group>"
+		"<group name='Work &lt;3'>"
+		"<contact><buddy account='me@example.com' proto='prpl-jabber'>"
+		"<name>carol@example.com</name></buddy></contact>"
+		"</group>"
+		"</blist></purple>\n";
+
+	g_assert_true(g_file_set_contents(filename, contents, -1, NULL));
+
+	root = purple_xmlnode_from_file(dir, "blist.xml", "test", "test");
+	g_assert_nonnull(root);
+
+	g_ptr_array_add(expected, g_strdup(root->name));
+	blist = purple_xmlnode_get_child(root, "blist");
+	g_ptr_array_add(expected, g_strdup(blist->name));
+	for(PurpleXmlNode *group = purple_xmlnode_get_child(blist, "group");
+	    group != NULL; group = purple_xmlnode_get_next_twin(group))
+	{
+		g_ptr_array_add(expected, g_strdup(group->name));
+
+		for(PurpleXmlNode *contact = purple_xmlnode_get_child(group, "contact");
+		    contact != NULL; contact = purple_xmlnode_get_next_twin(contact))
+		{
+			g_ptr_array_add(expected, purple_xmlnode_to_str(contact, NULL));
+		}
+	}
+	purple_xmlnode_free(root);
+
+	g_assert_true(purple_xmlnode_stream_from_file(dir, "blist.xml", "test",
+	                                              "test", 3,
+	                                              test_xmlnode_stream_serialize,
+	                                              seen));
+
+	g_assert_cmpuint(seen->len, ==, expected->len);
+	for(guint i = 0; i < expected->len; i++) {
+		g_assert_cmpstr(g_ptr_array_index(seen, i), ==,
+		                g_ptr_array_index(expected, i));
+	}
+
+	g_unlink(filename);
+	g_rmdir(dir);
+	g_free(filename);
+	g_free(dir);
+	g_ptr_array_free(seen, TRUE);
+	g_ptr_array_free(expected, TRUE);
+}
+
+static void
+test_xmlnode_stream_count(G_GNUC_UNUSED PurpleXmlNode *node, gpointer data) {
+	guint *count = data;
+
+	(*count)++;
+}
+
+/* Compares reading a large buddy list in one go against streaming it. */
+static void
+test_xmlnode_stream_perf(void) {
+	GString *contents = NULL;
+	gchar *dir = NULL, *filename = NULL;
+	gdouble dom = 0.0, stream = 0.0;
+	guint count = 0;
+
+	if(!g_test_perf()) {
+		g_test_skip("only run in performance mode");
+		return;
+	}
+
+	contents = g_string_new("<?xml version='1.0' encoding='UTF-8' ?>\n"
+	                        "<purple version='1.0'><blist>"
+	                        "<group name='Buddies'>");
+	for(guint i = 0; i < 50000; i++) {
+		g_string_append_printf(contents,
+		                       "<contact><buddy account='me@example.com' "
+		                       "proto='prpl-jabber'>"
+		                       "<name>buddy%u@example.com</name>"
+		                       "<alias>Buddy %u</alias>"
+		                       "<setting name='last_seen' type='int'>%u"
+		                       "</setting></buddy></contact>", i, i, i);
+	}
+	g_string_append(contents, "</group></blist></purple>\n");
+
+	dir = g_dir_make_tmp("purple-xmlnode-XXXXXX", NULL);
+	filename = g_build_filename(dir, "blist.xml", NULL);
+	g_assert_true(g_file_set_contents(filename, contents->str, contents->len,
+	                                  NULL));
+
+	for(gint i = 0; i < 3; i++) {
+		PurpleXmlNode *node = NULL;
+
+		g_test_timer_start();
+		node = purple_xmlnode_from_file(dir, "blist.xml", "test", "test");
+		dom = (i == 0) ? g_test_timer_elapsed() :
+		                 MIN(dom, g_test_timer_elapsed());
+		g_assert_nonnull(node);
+		purple_xmlnode_free(node);
+
+		count = 0;
+		g_test_timer_start();
+		g_assert_true(purple_xmlnode_stream_from_file(dir, "blist.xml",
+		                                              "test", "test", 3,
+		                                              test_xmlnode_stream_count,
+		                                              &count));
+		stream = (i == 0) ? g_test_timer_elapsed() :
+		                    MIN(stream, g_test_timer_elapsed());
+		g_assert_cmpuint(count, ==, 50000 + 3);
+	}
+
+	g_test_minimized_result(dom, "whole tree: %.3fs", dom);
+	g_test_minimized_result(stream, "streamed: %.3fs", stream);
+
+	g_unlink(filename);
+	g_rmdir(dir);
+	g_free(filename);
+	g_free(dir);
+	g_string_free(contents, TRUE);
+}
+
 gint
 main(gint argc, gchar **argv) {
+	gint ret = 0;
+
 	g_test_init(&argc, &argv, NULL);
 
 	g_test_add_func("/xmlnode/billion_laughs_attack",
@@ -144,6 +565,24 @@ main(gint argc, gchar **argv) {
 	                test_xmlnode_prefixes);
 	g_test_add_func("/xmlnode/strip_prefixes",
 	                test_strip_prefixes);
+	g_test_add_func("/xmlnode/arena",
+	                test_xmlnode_arena);
+	g_test_add_func("/xmlnode/arena/detach",
+	                test_xmlnode_arena_detach);
+	g_test_add_func("/xmlnode/write_to_string",
+	                test_xmlnode_write_to_string);
+	g_test_add_func("/xmlnode/stream_from_file",
+	                test_xmlnode_stream_from_file);
+	g_test_add_func("/xmlnode/stream_from_file/corrupt",
+	                test_xmlnode_stream_from_file_corrupt);
+	g_test_add_func("/xmlnode/stream_from_file/matches-tree",
+	                test_xmlnode_stream_from_file_matches_tree);
+	g_test_add_func("/xmlnode/stream_from_file/perf",
+	                test_xmlnode_stream_perf);
+
+	ret = g_test_run();
+
+	purple_xmlnode_uninit();
 
-	return g_test_run();
+	return ret;
 }
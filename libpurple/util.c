@@ -128,6 +128,28 @@ purple_util_read_xml_from_data_file(const char *filename, const char *descriptio
 	return purple_xmlnode_from_file(purple_data_dir(), filename, description, "util");
 }
 
+gboolean
+purple_util_stream_xml_from_cache_file(const char *filename,
+                                       const char *description, guint depth,
+                                       PurpleXmlNodeStreamFunc func,
+                                       gpointer data)
+{
+	return purple_xmlnode_stream_from_file(purple_cache_dir(), filename,
+	                                       description, "util", depth, func,
+	                                       data);
+}
+
+gboolean
+purple_util_stream_xml_from_config_file(const char *filename,
+                                        const char *description, guint depth,
+                                        PurpleXmlNodeStreamFunc func,
+                                        gpointer data)
+{
+	return purple_xmlnode_stream_from_file(purple_config_dir(), filename,
+	                                       description, "util", depth, func,
+	                                       data);
+}
+
 gboolean
 purple_running_gnome(void)
 {
@@ -166,6 +166,42 @@ purple_util_read_xml_from_config_file(const char *filename, const char *descript
 PurpleXmlNode *
 purple_util_read_xml_from_data_file(const char *filename, const char *description);
 
+/**
+ * purple_util_stream_xml_from_cache_file:
+ * @filename:    The basename of the file to open in the purple_cache_dir.
+ * @description: A very short description of the contents of this file.
+ * @depth:       How deep the elements that are handed over whole are.
+ * @func:        (scope call): The function to call with each element.
+ * @data:        User data to pass to @func.
+ *
+ * Like purple_util_read_xml_from_cache_file(), but hands the file to @func
+ * a piece at a time. See purple_xmlnode_stream_from_file().
+ *
+ * Returns: %TRUE if the whole file was read.
+ *
+ * Since: 3.0.0
+ */
+gboolean
+purple_util_stream_xml_from_cache_file(const char *filename, const char *description, guint depth, PurpleXmlNodeStreamFunc func, gpointer data);
+
+/**
+ * purple_util_stream_xml_from_config_file:
+ * @filename:    The basename of the file to open in the purple_config_dir.
+ * @description: A very short description of the contents of this file.
+ * @depth:       How deep the elements that are handed over whole are.
+ * @func:        (scope call): The function to call with each element.
+ * @data:        User data to pass to @func.
+ *
+ * Like purple_util_read_xml_from_config_file(), but hands the file to @func
+ * a piece at a time. See purple_xmlnode_stream_from_file().
+ *
+ * Returns: %TRUE if the whole file was read.
+ *
+ * Since: 3.0.0
+ */
+gboolean
+purple_util_stream_xml_from_config_file(const char *filename, const char *description, guint depth, PurpleXmlNodeStreamFunc func, gpointer data);
+
 /**************************************************************************/
 /* Environment Detection Functions                                        */
 /**************************************************************************/
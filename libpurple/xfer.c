@@ -20,8 +20,16 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif /* HAVE_CONFIG_H */
+
 #include <glib/gi18n-lib.h>
 
+#ifdef HAVE_SENDFILE
+# include <sys/sendfile.h>
+#endif
+
 #include "glibcompat.h" /* for purple_g_stat on win32 */
 
 #include <glib/gstdio.h>
@@ -44,10 +52,27 @@
 #define FT_INITIAL_BUFFER_SIZE 4096
 #define FT_MAX_BUFFER_SIZE     65535
 
+/* How many transfer buffers are kept around for the next transfer. */
+#define FT_BUFFER_POOL_SIZE    4
+
+/* The most that is handed to sendfile() at once, so that one transfer can't
+ * hog the main loop. */
+#define FT_MAX_SENDFILE_SIZE   (1024 * 1024)
+
+/* How often, in milliseconds, the rate limit is shared out again. */
+#define FT_SCHEDULER_INTERVAL  100
+
 typedef struct _PurpleXferPrivate  PurpleXferPrivate;
 
 static PurpleXferUiOps *xfer_ui_ops = NULL;
 static GList *xfers;
+static GSList *buffer_pool = NULL;
+
+/* Transfers that are moving data, in the order they were started. */
+static GQueue scheduled_xfers = G_QUEUE_INIT;
+static guint max_active_per_account = 0;
+static gsize max_rate = 0;
+static guint scheduler_timeout = 0;
 
 /* Private data for a file transfer */
 struct _PurpleXferPrivate {
@@ -100,6 +125,24 @@ struct _PurpleXferPrivate {
 	/* TODO: Should really use a PurpleCircBuffer for this. */
 	GByteArray *buffer;
 
+	/* Borrowed from buffer_pool while data is moving, so that each chunk
+	 * doesn't need its own allocation. Always FT_MAX_BUFFER_SIZE bytes. */
+	guchar *transfer_buffer;
+
+	/* The protocol's write method sends data to fd unchanged. */
+	gboolean passthrough;
+
+	/* sendfile() failed with EINVAL or ENOSYS, so don't try it again. */
+	gboolean sendfile_unsupported;
+
+	/* Scheduler state. A transfer is paused while it is queued behind other
+	 * transfers on its account, or throttled because it used up its share of
+	 * the rate limit for this interval. */
+	gboolean scheduled;
+	gboolean queued;
+	gboolean throttled;
+	gssize quota;
+
 	gpointer thumbnail_data;     /* thumbnail image */
 	gsize thumbnail_size;
 	gchar *thumbnail_mimetype;
@@ -148,6 +191,8 @@ static guint signals[SIG_LAST] = {0};
 G_DEFINE_TYPE_WITH_PRIVATE(PurpleXfer, purple_xfer, G_TYPE_OBJECT);
 
 static void purple_xfer_choose_file(PurpleXfer *xfer);
+static void transfer_cb(gpointer data, gint source,
+                        PurpleInputCondition condition);
 
 static const gchar *
 purple_xfer_status_type_to_string(PurpleXferStatus type)
@@ -226,7 +271,7 @@ purple_xfer_conversation_write_internal(PurpleXfer *xfer,
 	im = purple_conversation_manager_find_im(manager,
 	                                         purple_xfer_get_account(xfer),
 	                                         priv->who);
-	if(PURPLE_IS_IM_CONVERSATION(im)) {
+	if(!PURPLE_IS_IM_CONVERSATION(im)) {
 		return;
 	}
 
@@ -935,6 +980,28 @@ void purple_xfer_set_fd(PurpleXfer *xfer, int fd)
 	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_FD]);
 }
 
+void
+purple_xfer_set_passthrough(PurpleXfer *xfer, gboolean passthrough)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_XFER(xfer));
+
+	priv = purple_xfer_get_instance_private(xfer);
+	priv->passthrough = passthrough;
+}
+
+gboolean
+purple_xfer_get_passthrough(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), FALSE);
+
+	priv = purple_xfer_get_instance_private(xfer);
+	return priv->passthrough;
+}
+
 void purple_xfer_set_watcher(PurpleXfer *xfer, int watcher)
 {
 	PurpleXferPrivate *priv = NULL;
@@ -1115,6 +1182,298 @@ purple_xfer_get_ui_ops(PurpleXfer *xfer)
 	return priv->ui_ops;
 }
 
+/******************************************************************************
+ * Buffer pool
+ *****************************************************************************/
+static guchar *
+purple_xfer_buffer_acquire(void)
+{
+	guchar *buffer = NULL;
+
+	if (buffer_pool != NULL) {
+		buffer = buffer_pool->data;
+		buffer_pool = g_slist_delete_link(buffer_pool, buffer_pool);
+	} else {
+		buffer = g_malloc(FT_MAX_BUFFER_SIZE);
+	}
+
+	return buffer;
+}
+
+static void
+purple_xfer_buffer_release(guchar *buffer)
+{
+	if (buffer == NULL) {
+		return;
+	}
+
+	if (g_slist_length(buffer_pool) < FT_BUFFER_POOL_SIZE) {
+		buffer_pool = g_slist_prepend(buffer_pool, buffer);
+	} else {
+		g_free(buffer);
+	}
+}
+
+static guchar *
+purple_xfer_get_transfer_buffer(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (priv->transfer_buffer == NULL) {
+		priv->transfer_buffer = purple_xfer_buffer_acquire();
+	}
+
+	return priv->transfer_buffer;
+}
+
+/* Gives the transfer buffer back once the local file is closed. */
+static void
+purple_xfer_release_transfer_buffer(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	purple_xfer_buffer_release(priv->transfer_buffer);
+	priv->transfer_buffer = NULL;
+}
+
+/******************************************************************************
+ * Scheduler
+ *****************************************************************************/
+static gboolean
+purple_xfer_is_paused(PurpleXferPrivate *priv)
+{
+	return priv->queued || priv->throttled;
+}
+
+/* How much each of @active transfers may move per interval. */
+static gssize
+purple_xfer_scheduler_share(guint active)
+{
+	gsize budget = max_rate * FT_SCHEDULER_INTERVAL / 1000;
+
+	return (gssize)MAX(budget / MAX(active, 1), 1);
+}
+
+static void
+purple_xfer_pause(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (priv->watcher != 0) {
+		g_source_remove(priv->watcher);
+		purple_xfer_set_watcher(xfer, 0);
+	}
+}
+
+static void
+purple_xfer_resume(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (purple_xfer_is_paused(priv) ||
+			purple_xfer_get_status(xfer) != PURPLE_XFER_STATUS_STARTED) {
+		return;
+	}
+
+	if (priv->fd != -1) {
+		if (priv->watcher == 0) {
+			PurpleInputCondition cond = PURPLE_INPUT_READ;
+
+			if (priv->type == PURPLE_XFER_TYPE_SEND) {
+				cond = PURPLE_INPUT_WRITE;
+			}
+
+			purple_xfer_set_watcher(
+				xfer,
+				purple_input_add(priv->fd, cond, transfer_cb, xfer)
+			);
+		}
+	} else if (priv->ready & PURPLE_XFER_READY_PROTOCOL) {
+		/* The protocol told us it was ready while we were paused. */
+		purple_xfer_protocol_ready(xfer);
+	}
+}
+
+/* Resumes each transfer in @resume, which holds a reference to each of them
+ * because resuming one can end another. */
+static void
+purple_xfer_resume_list(GList *resume)
+{
+	resume = g_list_reverse(resume);
+
+	for (GList *l = resume; l != NULL; l = l->next) {
+		purple_xfer_resume(l->data);
+	}
+
+	g_list_free_full(resume, g_object_unref);
+}
+
+static gboolean
+purple_xfer_scheduler_tick(G_GNUC_UNUSED gpointer data)
+{
+	GList *resume = NULL;
+	guint active = 0;
+	gssize share;
+
+	for (GList *l = scheduled_xfers.head; l != NULL; l = l->next) {
+		PurpleXferPrivate *priv = purple_xfer_get_instance_private(l->data);
+
+		if (!priv->queued) {
+			active++;
+		}
+	}
+
+	/* Every transfer gets the same share, so a fast one can't starve the
+	 * others. Unused shares are not carried over, to avoid bursts. */
+	share = purple_xfer_scheduler_share(active);
+
+	for (GList *l = scheduled_xfers.head; l != NULL; l = l->next) {
+		PurpleXfer *xfer = l->data;
+		PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+		if (priv->queued) {
+			continue;
+		}
+
+		priv->quota = share;
+		if (priv->throttled) {
+			priv->throttled = FALSE;
+			resume = g_list_prepend(resume, g_object_ref(xfer));
+		}
+	}
+
+	purple_xfer_resume_list(resume);
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Works out which transfers may run after a transfer was started or stopped,
+ * or the limits changed. */
+static void
+purple_xfer_scheduler_update(void)
+{
+	GHashTable *per_account = NULL;
+	GList *resume = NULL;
+	guint active = 0;
+
+	if (max_active_per_account > 0) {
+		per_account = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	for (GList *l = scheduled_xfers.head; l != NULL; l = l->next) {
+		PurpleXfer *xfer = l->data;
+		PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+		gboolean was_paused = purple_xfer_is_paused(priv);
+		gboolean admitted = TRUE;
+
+		if (per_account != NULL) {
+			guint count = GPOINTER_TO_UINT(g_hash_table_lookup(per_account,
+			                                                   priv->account));
+
+			admitted = count < max_active_per_account;
+			if (admitted) {
+				g_hash_table_insert(per_account, priv->account,
+				                    GUINT_TO_POINTER(count + 1));
+			}
+		}
+
+		priv->queued = !admitted;
+		if (admitted) {
+			active++;
+		}
+
+		if (max_rate == 0) {
+			priv->throttled = FALSE;
+		}
+
+		if (!was_paused && purple_xfer_is_paused(priv)) {
+			purple_xfer_pause(xfer);
+		} else if (was_paused && !purple_xfer_is_paused(priv)) {
+			resume = g_list_prepend(resume, g_object_ref(xfer));
+		}
+	}
+
+	g_clear_pointer(&per_account, g_hash_table_destroy);
+
+	if (max_rate > 0 && active > 0) {
+		if (scheduler_timeout == 0) {
+			scheduler_timeout = g_timeout_add(FT_SCHEDULER_INTERVAL,
+			                                  purple_xfer_scheduler_tick,
+			                                  NULL);
+		}
+	} else {
+		g_clear_handle_id(&scheduler_timeout, g_source_remove);
+	}
+
+	purple_xfer_resume_list(resume);
+}
+
+static void
+purple_xfer_scheduler_add(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (priv->scheduled) {
+		return;
+	}
+
+	priv->scheduled = TRUE;
+	g_queue_push_tail(&scheduled_xfers, xfer);
+
+	priv->quota =
+		purple_xfer_scheduler_share(g_queue_get_length(&scheduled_xfers));
+
+	purple_xfer_scheduler_update();
+}
+
+static void
+purple_xfer_scheduler_remove(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (!priv->scheduled) {
+		return;
+	}
+
+	g_queue_remove(&scheduled_xfers, xfer);
+	priv->scheduled = FALSE;
+	priv->queued = FALSE;
+	priv->throttled = FALSE;
+
+	purple_xfer_scheduler_update();
+}
+
+/* The most the transfer may move right now. */
+static gsize
+purple_xfer_get_quota(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (max_rate == 0 || !priv->scheduled) {
+		return G_MAXSIZE;
+	}
+
+	return (gsize)MAX(priv->quota, 1);
+}
+
+/* Takes @size bytes off the transfer's share, pausing it once the share is
+ * used up until the next interval. */
+static void
+purple_xfer_charge(PurpleXfer *xfer, gssize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (max_rate == 0 || !priv->scheduled || size <= 0) {
+		return;
+	}
+
+	priv->quota -= size;
+	if (priv->quota <= 0 && !priv->throttled) {
+		priv->throttled = TRUE;
+		purple_xfer_pause(xfer);
+	}
+}
+
 static void
 purple_xfer_increase_buffer_size(PurpleXfer *xfer)
 {
@@ -1125,19 +1484,12 @@ purple_xfer_increase_buffer_size(PurpleXfer *xfer)
 }
 
 static gssize
-do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
+do_read_into(PurpleXfer *xfer, guchar *buffer, gsize size)
 {
-	PurpleXferPrivate *priv = NULL;
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 	gssize r;
 
-	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
-	g_return_val_if_fail(buffer != NULL, 0);
-
-	priv = purple_xfer_get_instance_private(xfer);
-
-	*buffer = g_malloc0(size);
-
-	r = read(priv->fd, *buffer, size);
+	r = read(priv->fd, buffer, size);
 	if (r < 0 && errno == EAGAIN) {
 		r = 0;
 	} else if (r < 0) {
@@ -1149,10 +1501,71 @@ do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
 	return r;
 }
 
+static gssize
+do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
+{
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
+	g_return_val_if_fail(buffer != NULL, 0);
+
+	*buffer = g_malloc0(size);
+
+	return do_read_into(xfer, *buffer, size);
+}
+
+static gsize
+purple_xfer_get_read_size(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	gsize size = priv->current_buffer_size;
+
+	if (purple_xfer_get_size(xfer) != 0) {
+		size = MIN((gsize)purple_xfer_get_bytes_remaining(xfer), size);
+	}
+
+	return MIN(size, purple_xfer_get_quota(xfer));
+}
+
+static void
+purple_xfer_update_read_size(PurpleXfer *xfer, gssize r)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (r >= 0 && (gsize)r == priv->current_buffer_size) {
+		/*
+		 * We managed to read the entire buffer.  This means our
+		 * network is fast and our buffer is too small, so make it
+		 * bigger.
+		 */
+		purple_xfer_increase_buffer_size(xfer);
+	}
+}
+
+/* Like purple_xfer_read, but when the protocol doesn't have its own read
+ * method the data is read into the transfer buffer, in which case *owned is
+ * set to FALSE and the caller must not free it.
+ */
+static gssize
+purple_xfer_read_reusing(PurpleXfer *xfer, guchar **buffer, gboolean *owned)
+{
+	PurpleXferClass *klass = PURPLE_XFER_GET_CLASS(xfer);
+	gssize r;
+
+	if (klass && klass->read && klass->read != do_read) {
+		*owned = TRUE;
+		return purple_xfer_read(xfer, buffer);
+	}
+
+	*owned = FALSE;
+	*buffer = purple_xfer_get_transfer_buffer(xfer);
+	r = do_read_into(xfer, *buffer, purple_xfer_get_read_size(xfer));
+	purple_xfer_update_read_size(xfer, r);
+
+	return r;
+}
+
 gssize
 purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 {
-	PurpleXferPrivate *priv = NULL;
 	PurpleXferClass *klass = NULL;
 	gsize s;
 	gssize r;
@@ -1160,16 +1573,7 @@ purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
 	g_return_val_if_fail(buffer != NULL, 0);
 
-	priv = purple_xfer_get_instance_private(xfer);
-
-	if (purple_xfer_get_size(xfer) == 0) {
-		s = priv->current_buffer_size;
-	} else {
-		s = MIN(
-			(gssize)purple_xfer_get_bytes_remaining(xfer),
-			(gssize)priv->current_buffer_size
-		);
-	}
+	s = purple_xfer_get_read_size(xfer);
 
 	klass = PURPLE_XFER_GET_CLASS(xfer);
 	if(klass && klass->read) {
@@ -1178,14 +1582,7 @@ purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 		r = do_read(xfer, buffer, s);
 	}
 
-	if (r >= 0 && (gsize)r == priv->current_buffer_size) {
-		/*
-		 * We managed to read the entire buffer.  This means our
-		 * network is fast and our buffer is too small, so make it
-		 * bigger.
-		 */
-		purple_xfer_increase_buffer_size(xfer);
-	}
+	purple_xfer_update_read_size(xfer, r);
 
 	return r;
 }
@@ -1339,28 +1736,110 @@ do_data_not_sent(PurpleXfer *xfer, const guchar *buffer, gsize size)
 	return TRUE;
 }
 
+/* Marks the transfer as completed and ends it once all of the data has been
+ * moved. */
+static void
+purple_xfer_check_completed(PurpleXfer *xfer)
+{
+	if (purple_xfer_get_bytes_sent(xfer) >= purple_xfer_get_size(xfer) &&
+			!purple_xfer_is_completed(xfer)) {
+		purple_xfer_set_completed(xfer, TRUE);
+	}
+
+	/* TODO: Check if above is the only place xfers are marked completed.
+	 *       If so, merge these conditions.
+	 */
+	if (purple_xfer_is_completed(xfer)) {
+		purple_xfer_end(xfer);
+	}
+}
+
+#ifdef HAVE_SENDFILE
+/* Whether the next chunk can go straight from the file to the socket, which
+ * is only the case when nothing needs to see or change the data on the way.
+ */
+static gboolean
+purple_xfer_can_sendfile(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	PurpleXferClass *klass = PURPLE_XFER_GET_CLASS(xfer);
+
+	if (priv->sendfile_unsupported || priv->fd < 0 ||
+			priv->dest_fp == NULL || priv->buffer != NULL) {
+		return FALSE;
+	}
+
+	/* The default write method sends the data to the socket unchanged. */
+	if (klass != NULL &&
+			((klass->write != NULL && klass->write != do_write &&
+			  !priv->passthrough) ||
+			 klass->ack != NULL)) {
+		return FALSE;
+	}
+
+	/* Someone else is providing the data. */
+	return !g_signal_has_handler_pending(xfer, signals[SIG_READ_LOCAL], 0,
+	                                     FALSE);
+}
+
+/* Returns the number of bytes sent, 0 if the socket is full, or -1 with errno
+ * set on failure.
+ */
+static gssize
+do_sendfile(PurpleXfer *xfer, gsize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	off_t offset = ftello(priv->dest_fp);
+	gssize r;
+
+	if (offset < 0) {
+		return -1;
+	}
+
+	r = sendfile(priv->fd, fileno(priv->dest_fp), &offset,
+	             MIN(size, FT_MAX_SENDFILE_SIZE));
+	if (r < 0) {
+		return (errno == EAGAIN) ? 0 : -1;
+	}
+
+	/* sendfile() doesn't move the file position, so do that ourselves in case
+	 * we have to fall back to reading the file. */
+	if (fseeko(priv->dest_fp, offset, SEEK_SET) != 0) {
+		return -1;
+	}
+
+	return r;
+}
+#endif /* HAVE_SENDFILE */
+
 static void
 do_transfer(PurpleXfer *xfer)
 {
 	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 	guchar *buffer = NULL;
+	gboolean owned = FALSE;
 	gssize r = 0;
 
 	if (priv->type == PURPLE_XFER_TYPE_RECEIVE) {
-		r = purple_xfer_read(xfer, &buffer);
+		r = purple_xfer_read_reusing(xfer, &buffer, &owned);
 		if (r > 0) {
 			if (!purple_xfer_write_file(xfer, buffer, r)) {
-				g_free(buffer);
+				if (owned) {
+					g_free(buffer);
+				}
 				return;
 			}
 
 		} else if(r < 0) {
 			purple_xfer_cancel_remote(xfer);
-			g_free(buffer);
+			if (owned) {
+				g_free(buffer);
+			}
 			return;
 		}
 	} else if (priv->type == PURPLE_XFER_TYPE_SEND) {
 		gssize result = 0;
+		gsize quota = purple_xfer_get_quota(xfer);
 		gsize s = MIN(
 			(gsize)purple_xfer_get_bytes_remaining(xfer),
 			(gsize)priv->current_buffer_size
@@ -1378,6 +1857,36 @@ do_transfer(PurpleXfer *xfer)
 			return;
 		}
 
+		s = MIN(s, quota);
+
+#ifdef HAVE_SENDFILE
+		if (purple_xfer_can_sendfile(xfer)) {
+			r = do_sendfile(xfer,
+			                MIN((gsize)purple_xfer_get_bytes_remaining(xfer),
+			                    quota));
+
+			if (r >= 0) {
+				/* If the socket was full, the watcher calls us again. */
+				if (r > 0) {
+					purple_xfer_set_bytes_sent(xfer,
+						purple_xfer_get_bytes_sent(xfer) + r);
+					purple_xfer_charge(xfer, r);
+				}
+
+				purple_xfer_check_completed(xfer);
+				return;
+			} else if (errno == EINVAL || errno == ENOSYS) {
+				/* Not supported for this file or socket, so copy instead. */
+				priv->sendfile_unsupported = TRUE;
+			} else {
+				purple_debug_error("xfer", "sendfile failed! %s\n",
+				                   g_strerror(errno));
+				purple_xfer_cancel_remote(xfer);
+				return;
+			}
+		}
+#endif /* HAVE_SENDFILE */
+
 		if (priv->buffer) {
 			existing_buffer = TRUE;
 			if (priv->buffer->len < s) {
@@ -1389,7 +1898,8 @@ do_transfer(PurpleXfer *xfer)
 		}
 
 		if (read_more) {
-			buffer = g_new(guchar, s);
+			/* s is never more than current_buffer_size, so this fits. */
+			buffer = purple_xfer_get_transfer_buffer(xfer);
 			result = purple_xfer_read_file(xfer, buffer, s);
 			if (result == 0) {
 				/*
@@ -1405,18 +1915,15 @@ do_transfer(PurpleXfer *xfer)
 				/* Need to indicate the protocol is still ready... */
 				priv->ready |= PURPLE_XFER_READY_PROTOCOL;
 
-				g_free(buffer);
 				g_return_if_reached();
 			}
 			if (result < 0) {
-				g_free(buffer);
 				return;
 			}
 		}
 
 		if (priv->buffer) {
 			g_byte_array_append(priv->buffer, buffer, result);
-			g_free(buffer);
 			buffer = priv->buffer->data;
 			result = priv->buffer->len;
 		}
@@ -1426,10 +1933,6 @@ do_transfer(PurpleXfer *xfer)
 		if (r == -1) {
 			purple_debug_error("xfer", "do_write failed! %s\n", g_strerror(errno));
 			purple_xfer_cancel_remote(xfer);
-			if (!priv->buffer)
-				/* We don't free buffer if priv->buffer is set, because in
-				   that case buffer doesn't belong to us. */
-				g_free(buffer);
 			return;
 		} else if (r == result) {
 			/*
@@ -1443,7 +1946,9 @@ do_transfer(PurpleXfer *xfer)
 			g_signal_emit(xfer, signals[SIG_DATA_NOT_SENT], 0, buffer + r,
 			              result - r, &handler_result);
 			if (!handler_result) {
+				/* This releases the transfer buffer, so we're done. */
 				purple_xfer_cancel_local(xfer);
+				return;
 			}
 		}
 
@@ -1463,21 +1968,15 @@ do_transfer(PurpleXfer *xfer)
 
 		if (klass && klass->ack)
 			klass->ack(xfer, buffer, r);
-	}
-
-	g_free(buffer);
 
-	if (purple_xfer_get_bytes_sent(xfer) >= purple_xfer_get_size(xfer) &&
-			!purple_xfer_is_completed(xfer)) {
-		purple_xfer_set_completed(xfer, TRUE);
+		purple_xfer_charge(xfer, r);
 	}
 
-	/* TODO: Check if above is the only place xfers are marked completed.
-	 *       If so, merge these conditions.
-	 */
-	if (purple_xfer_is_completed(xfer)) {
-		purple_xfer_end(xfer);
+	if (owned) {
+		g_free(buffer);
 	}
+
+	purple_xfer_check_completed(xfer);
 }
 
 static void
@@ -1552,6 +2051,10 @@ begin_transfer(PurpleXfer *xfer, PurpleInputCondition cond)
 		);
 	}
 
+	if (!purple_xfer_is_cancelled(xfer)) {
+		purple_xfer_scheduler_add(xfer);
+	}
+
 	priv->start_time = g_get_monotonic_time();
 
 	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_START_TIME]);
@@ -1596,6 +2099,11 @@ purple_xfer_ui_ready(PurpleXfer *xfer)
 
 	priv->ready |= PURPLE_XFER_READY_UI;
 
+	/* The scheduler picks this up when the transfer is resumed. */
+	if (purple_xfer_is_paused(priv)) {
+		return;
+	}
+
 	if (0 == (priv->ready & PURPLE_XFER_READY_PROTOCOL)) {
 		purple_debug_misc("xfer", "UI is ready on ft %p, waiting for protocol\n", xfer);
 		return;
@@ -1632,6 +2140,11 @@ purple_xfer_protocol_ready(PurpleXfer *xfer)
 
 	priv->ready |= PURPLE_XFER_READY_PROTOCOL;
 
+	/* The scheduler picks this up when the transfer is resumed. */
+	if (purple_xfer_is_paused(priv)) {
+		return;
+	}
+
 	/* I don't think fwrite/fread are ever *not* ready */
 	if (priv->dest_fp == NULL && 0 == (priv->ready & PURPLE_XFER_READY_UI)) {
 		purple_debug_misc("xfer", "Protocol is ready on ft %p, waiting for UI\n", xfer);
@@ -1729,6 +2242,8 @@ purple_xfer_end(PurpleXfer *xfer)
 		klass->end(xfer);
 	}
 
+	purple_xfer_scheduler_remove(xfer);
+
 	if (priv->watcher != 0) {
 		g_source_remove(priv->watcher);
 		purple_xfer_set_watcher(xfer, 0);
@@ -1749,6 +2264,8 @@ purple_xfer_end(PurpleXfer *xfer)
 		priv->dest_fp = NULL;
 	}
 
+	purple_xfer_release_transfer_buffer(xfer);
+
 	g_object_unref(xfer);
 }
 
@@ -1806,6 +2323,8 @@ purple_xfer_cancel_local(PurpleXfer *xfer)
 		}
 	}
 
+	purple_xfer_scheduler_remove(xfer);
+
 	if (priv->watcher != 0) {
 		g_source_remove(priv->watcher);
 		purple_xfer_set_watcher(xfer, 0);
@@ -1820,6 +2339,8 @@ purple_xfer_cancel_local(PurpleXfer *xfer)
 		priv->dest_fp = NULL;
 	}
 
+	purple_xfer_release_transfer_buffer(xfer);
+
 	g_object_unref(xfer);
 }
 
@@ -1870,6 +2391,8 @@ purple_xfer_cancel_remote(PurpleXfer *xfer)
 		}
 	}
 
+	purple_xfer_scheduler_remove(xfer);
+
 	if (priv->watcher != 0) {
 		g_source_remove(priv->watcher);
 		purple_xfer_set_watcher(xfer, 0);
@@ -1883,6 +2406,8 @@ purple_xfer_cancel_remote(PurpleXfer *xfer)
 		priv->dest_fp = NULL;
 	}
 
+	purple_xfer_release_transfer_buffer(xfer);
+
 	g_object_unref(xfer);
 }
 
@@ -2144,6 +2669,7 @@ purple_xfer_finalize(GObject *object)
 	}
 
 	xfers = g_list_remove(xfers, xfer);
+	purple_xfer_scheduler_remove(xfer);
 
 	g_free(priv->who);
 	g_free(priv->filename);
@@ -2155,6 +2681,8 @@ purple_xfer_finalize(GObject *object)
 		g_byte_array_free(priv->buffer, TRUE);
 	}
 
+	purple_xfer_release_transfer_buffer(xfer);
+
 	g_free(priv->thumbnail_data);
 	g_free(priv->thumbnail_mimetype);
 
@@ -2461,6 +2989,57 @@ purple_xfers_get_all(void)
 	return xfers;
 }
 
+void
+purple_xfers_set_max_active_per_account(guint max_active)
+{
+	if (max_active_per_account == max_active) {
+		return;
+	}
+
+	max_active_per_account = max_active;
+	purple_xfer_scheduler_update();
+}
+
+guint
+purple_xfers_get_max_active_per_account(void)
+{
+	return max_active_per_account;
+}
+
+void
+purple_xfers_set_max_rate(gsize bytes_per_second)
+{
+	if (max_rate == bytes_per_second) {
+		return;
+	}
+
+	max_rate = bytes_per_second;
+	purple_xfer_scheduler_update();
+}
+
+gsize
+purple_xfers_get_max_rate(void)
+{
+	return max_rate;
+}
+
+static void
+max_active_pref_cb(G_GNUC_UNUSED const char *name,
+                   G_GNUC_UNUSED PurplePrefType type, gconstpointer val,
+                   G_GNUC_UNUSED gpointer data)
+{
+	purple_xfers_set_max_active_per_account(MAX(GPOINTER_TO_INT(val), 0));
+}
+
+static void
+max_rate_pref_cb(G_GNUC_UNUSED const char *name,
+                 G_GNUC_UNUSED PurplePrefType type, gconstpointer val,
+                 G_GNUC_UNUSED gpointer data)
+{
+	/* The preference is in KiB/s. */
+	purple_xfers_set_max_rate((gsize)MAX(GPOINTER_TO_INT(val), 0) * 1024);
+}
+
 void *
 purple_xfers_get_handle(void) {
 	static int handle = 0;
@@ -2476,6 +3055,20 @@ purple_xfers_init(void) {
 	purple_signal_register(handle, "file-recv-request",
 	                     purple_marshal_VOID__POINTER, G_TYPE_NONE, 1,
 	                     PURPLE_TYPE_XFER);
+
+	/* 0 means unlimited for both of these. */
+	purple_prefs_add_none("/purple/filetransfer");
+	purple_prefs_add_int("/purple/filetransfer/max_active_per_account", 0);
+	purple_prefs_add_int("/purple/filetransfer/max_rate", 0);
+
+	purple_prefs_connect_callback(handle,
+	                              "/purple/filetransfer/max_active_per_account",
+	                              max_active_pref_cb, NULL);
+	purple_prefs_connect_callback(handle, "/purple/filetransfer/max_rate",
+	                              max_rate_pref_cb, NULL);
+
+	purple_prefs_trigger_callback("/purple/filetransfer/max_active_per_account");
+	purple_prefs_trigger_callback("/purple/filetransfer/max_rate");
 }
 
 void
@@ -2485,6 +3078,11 @@ purple_xfers_uninit(void)
 
 	purple_signals_disconnect_by_handle(handle);
 	purple_signals_unregister_by_instance(handle);
+	purple_prefs_disconnect_by_handle(handle);
+
+	g_clear_handle_id(&scheduler_timeout, g_source_remove);
+
+	g_slist_free_full(g_steal_pointer(&buffer_pool), g_free);
 }
 
 void
@@ -417,6 +417,36 @@ gint64 purple_xfer_get_end_time(PurpleXfer *xfer);
  */
 void purple_xfer_set_fd(PurpleXfer *xfer, int fd);
 
+/**
+ * purple_xfer_set_passthrough:
+ * @xfer: The file transfer.
+ * @passthrough: Whether the protocol's write method sends data unchanged.
+ *
+ * Tells the transfer that, even though the protocol has its own write
+ * method, the data ends up on the socket file descriptor exactly as it was
+ * read from the file. This lets the file be sent with sendfile()
+ * where that is available, instead of being copied through a buffer.
+ *
+ * Transfers whose class has neither a write nor an ack method already do
+ * this without having to set it.
+ *
+ * Since: 3.0.0
+ */
+void purple_xfer_set_passthrough(PurpleXfer *xfer, gboolean passthrough);
+
+/**
+ * purple_xfer_get_passthrough:
+ * @xfer: The file transfer.
+ *
+ * Gets whether the protocol's write method sends data unchanged. See
+ * purple_xfer_set_passthrough().
+ *
+ * Returns: %TRUE if data is sent unchanged.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_xfer_get_passthrough(PurpleXfer *xfer);
+
 /**
  * purple_xfer_set_watcher:
  * @xfer:      The file transfer.
@@ -750,6 +780,60 @@ GType purple_xfer_ui_ops_get_type(void);
  */
 GList *purple_xfers_get_all(void);
 
+/**
+ * purple_xfers_set_max_active_per_account:
+ * @max_active: The most transfers that may move data at once on one account,
+ *              or 0 for no limit.
+ *
+ * Limits how many transfers move data at the same time on each account.
+ * Transfers over the limit wait, in the order they were started, until an
+ * earlier one finishes.
+ *
+ * This is normally set with the
+ * <literal>/purple/filetransfer/max_active_per_account</literal> preference.
+ *
+ * Since: 3.0.0
+ */
+void purple_xfers_set_max_active_per_account(guint max_active);
+
+/**
+ * purple_xfers_get_max_active_per_account:
+ *
+ * Gets the limit set by purple_xfers_set_max_active_per_account().
+ *
+ * Returns: The most transfers that may move data at once on one account, or
+ *          0 for no limit.
+ *
+ * Since: 3.0.0
+ */
+guint purple_xfers_get_max_active_per_account(void);
+
+/**
+ * purple_xfers_set_max_rate:
+ * @bytes_per_second: The limit, or 0 for no limit.
+ *
+ * Limits the combined rate of all file transfers. The bandwidth is shared
+ * equally between the transfers that are moving data.
+ *
+ * This is normally set with the
+ * <literal>/purple/filetransfer/max_rate</literal> preference, which is in
+ * KiB/s.
+ *
+ * Since: 3.0.0
+ */
+void purple_xfers_set_max_rate(gsize bytes_per_second);
+
+/**
+ * purple_xfers_get_max_rate:
+ *
+ * Gets the limit set by purple_xfers_set_max_rate().
+ *
+ * Returns: The combined rate limit in bytes per second, or 0 for no limit.
+ *
+ * Since: 3.0.0
+ */
+gsize purple_xfers_get_max_rate(void);
+
 /**
  * purple_xfers_get_handle:
  *
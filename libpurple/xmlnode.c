@@ -28,11 +28,15 @@
 
 #include "debug.h"
 
+#include <errno.h>
 #include <libxml/parser.h>
+#include <stdio.h>
 #include <string.h>
+#include <glib/gstdio.h>
 #include <glib.h>
 
 #include "purplemarkup.h"
+#include "purpleprivate.h"
 #include "util.h"
 #include "xmlnode.h"
 #include "glibcompat.h"
@@ -43,23 +47,225 @@
 # define NEWLINE_S "\n"
 #endif
 
+/* Nodes in an arena are carved out of large chunks that are all freed at once
+ * when the last node referencing the arena is freed.
+ */
+#define PURPLE_XMLNODE_ARENA_CHUNK_SIZE (4096)
+#define PURPLE_XMLNODE_ARENA_ALIGN (2 * sizeof(gpointer))
+
+/* Element names, attribute names, namespaces and prefixes come from a small
+ * vocabulary, so nodes in an arena share a single copy of them. The table is
+ * capped so that a peer sending made up names can't grow it forever; anything
+ * past the cap gets a copy of its own instead. The table lives until
+ * purple_xmlnode_uninit.
+ */
+#define PURPLE_XMLNODE_INTERN_MAX (4096)
+
+struct _PurpleXmlNodeArena {
+	gatomicrefcount ref_count;
+
+	guint8 *chunk;
+	gsize offset;
+
+	GSList *chunks;
+
+	/* Strings that nodes in the arena own individually, because they weren't
+	 * interned, so they can be freed as soon as they are replaced instead of
+	 * piling up until the arena goes away.
+	 */
+	GHashTable *owned;
+};
+
+G_LOCK_DEFINE_STATIC(interned);
+static GHashTable *interned = NULL;
+
+static gpointer
+purple_xmlnode_arena_alloc(PurpleXmlNodeArena *arena, gsize size)
+{
+	gpointer ret = NULL;
+
+	size = (size + PURPLE_XMLNODE_ARENA_ALIGN - 1) &
+	       ~(gsize)(PURPLE_XMLNODE_ARENA_ALIGN - 1);
+
+	/* Large allocations, like a base64 encoded avatar, get a chunk of their
+	 * own so they don't waste whatever is left in the current one.
+	 */
+	if(size > PURPLE_XMLNODE_ARENA_CHUNK_SIZE / 4) {
+		ret = g_malloc0(size);
+		arena->chunks = g_slist_prepend(arena->chunks, ret);
+
+		return ret;
+	}
+
+	if(arena->chunk == NULL ||
+	   arena->offset + size > PURPLE_XMLNODE_ARENA_CHUNK_SIZE)
+	{
+		arena->chunk = g_malloc(PURPLE_XMLNODE_ARENA_CHUNK_SIZE);
+		arena->offset = 0;
+		arena->chunks = g_slist_prepend(arena->chunks, arena->chunk);
+	}
+
+	ret = arena->chunk + arena->offset;
+	arena->offset += size;
+
+	memset(ret, 0, size);
+
+	return ret;
+}
+
+static char *
+purple_xmlnode_arena_strndup(PurpleXmlNodeArena *arena, const char *str,
+                             gsize len)
+{
+	char *ret = NULL;
+
+	if(str == NULL) {
+		return NULL;
+	}
+
+	/* The allocation is zeroed, so it's already terminated. */
+	ret = purple_xmlnode_arena_alloc(arena, len + 1);
+	memcpy(ret, str, len);
+
+	return ret;
+}
+
+/* Returns the shared copy of str, or NULL if the table is full. */
+static char *
+purple_xmlnode_intern(const char *str)
+{
+	char *ret = NULL;
+
+	G_LOCK(interned);
+
+	if(interned == NULL) {
+		interned = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                 NULL);
+	}
+
+	ret = g_hash_table_lookup(interned, str);
+	if(ret == NULL && g_hash_table_size(interned) < PURPLE_XMLNODE_INTERN_MAX) {
+		ret = g_strdup(str);
+		g_hash_table_add(interned, ret);
+	}
+
+	G_UNLOCK(interned);
+
+	return ret;
+}
+
+/* Copies a name, namespace or prefix for a node in arena, which may be NULL
+ * for a node that isn't in an arena. The result must be released with
+ * purple_xmlnode_free_name.
+ */
+static char *
+purple_xmlnode_dup_name(PurpleXmlNodeArena *arena, const char *str)
+{
+	char *ret = NULL;
+
+	if(arena == NULL || str == NULL) {
+		return g_strdup(str);
+	}
+
+	ret = purple_xmlnode_intern(str);
+	if(ret == NULL) {
+		if(arena->owned == NULL) {
+			arena->owned = g_hash_table_new_full(g_direct_hash,
+			                                     g_direct_equal, g_free,
+			                                     NULL);
+		}
+
+		ret = g_strdup(str);
+		g_hash_table_add(arena->owned, ret);
+	}
+
+	return ret;
+}
+
+static void
+purple_xmlnode_free_name(PurpleXmlNodeArena *arena, char *str)
+{
+	if(arena == NULL) {
+		g_free(str);
+	} else if(str != NULL && arena->owned != NULL) {
+		/* Interned strings aren't in the table, so they are left alone. */
+		g_hash_table_remove(arena->owned, str);
+	}
+}
+
 static PurpleXmlNode*
-new_node(const char *name, PurpleXmlNodeType type)
+new_node(PurpleXmlNodeArena *arena, const char *name, PurpleXmlNodeType type)
 {
-	PurpleXmlNode *node = g_new0(PurpleXmlNode, 1);
+	PurpleXmlNode *node = NULL;
 
-	node->name = g_strdup(name);
+	if(arena != NULL) {
+		node = purple_xmlnode_arena_alloc(arena, sizeof(PurpleXmlNode));
+		node->arena = purple_xmlnode_arena_ref(arena);
+	} else {
+		node = g_new0(PurpleXmlNode, 1);
+	}
+
+	node->name = purple_xmlnode_dup_name(arena, name);
 	node->type = type;
 
 	return node;
 }
 
+PurpleXmlNodeArena *
+purple_xmlnode_arena_new(void)
+{
+	PurpleXmlNodeArena *arena = g_new0(PurpleXmlNodeArena, 1);
+
+	g_atomic_ref_count_init(&arena->ref_count);
+
+	return arena;
+}
+
+PurpleXmlNodeArena *
+purple_xmlnode_arena_ref(PurpleXmlNodeArena *arena)
+{
+	g_return_val_if_fail(arena != NULL, NULL);
+
+	g_atomic_ref_count_inc(&arena->ref_count);
+
+	return arena;
+}
+
+void
+purple_xmlnode_arena_unref(PurpleXmlNodeArena *arena)
+{
+	g_return_if_fail(arena != NULL);
+
+	if(g_atomic_ref_count_dec(&arena->ref_count)) {
+		g_slist_free_full(arena->chunks, g_free);
+		g_clear_pointer(&arena->owned, g_hash_table_destroy);
+		g_free(arena);
+	}
+}
+
+PurpleXmlNode *
+purple_xmlnode_new_in_arena(PurpleXmlNodeArena *arena, const char *name)
+{
+	g_return_val_if_fail(arena != NULL, NULL);
+	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
+
+	return new_node(arena, name, PURPLE_XMLNODE_TYPE_TAG);
+}
+
+void
+purple_xmlnode_uninit(void)
+{
+	G_LOCK(interned);
+	g_clear_pointer(&interned, g_hash_table_destroy);
+	G_UNLOCK(interned);
+}
+
 PurpleXmlNode*
 purple_xmlnode_new(const char *name)
 {
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	return new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	return new_node(NULL, name, PURPLE_XMLNODE_TYPE_TAG);
 }
 
 PurpleXmlNode *
@@ -70,7 +276,7 @@ purple_xmlnode_new_child(PurpleXmlNode *parent, const char *name)
 	g_return_val_if_fail(parent != NULL, NULL);
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	node = new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	node = new_node(parent->arena, name, PURPLE_XMLNODE_TYPE_TAG);
 
 	purple_xmlnode_insert_child(parent, node);
 
@@ -106,9 +312,14 @@ purple_xmlnode_insert_data(PurpleXmlNode *node, const char *data, gssize size)
 
 	real_size = size == -1 ? strlen(data) : (gsize)size;
 
-	child = new_node(NULL, PURPLE_XMLNODE_TYPE_DATA);
+	child = new_node(node->arena, NULL, PURPLE_XMLNODE_TYPE_DATA);
 
-	child->data = g_memdup2(data, real_size);
+	if(node->arena != NULL) {
+		child->data = purple_xmlnode_arena_strndup(node->arena, data,
+		                                           real_size);
+	} else {
+		child->data = g_memdup2(data, real_size);
+	}
 	child->data_sz = real_size;
 
 	purple_xmlnode_insert_child(node, child);
@@ -175,30 +386,66 @@ purple_xmlnode_remove_attrib_with_namespace(PurpleXmlNode *node, const char *att
 	}
 }
 
+/* Adds a new attribute to node, allocating it from arena, which may be NULL
+ * even if node is in an arena.
+ */
+static void
+purple_xmlnode_add_attrib(PurpleXmlNode *node, PurpleXmlNodeArena *arena,
+                          const char *attr, const char *xmlns,
+                          const char *prefix, const char *value)
+{
+	PurpleXmlNode *attrib_node;
+
+	attrib_node = new_node(arena, attr, PURPLE_XMLNODE_TYPE_ATTRIB);
+
+	if(arena != NULL) {
+		attrib_node->data = purple_xmlnode_arena_strndup(arena, value,
+		                                                 strlen(value));
+	} else {
+		attrib_node->data = g_strdup(value);
+	}
+	attrib_node->xmlns = purple_xmlnode_dup_name(arena, xmlns);
+	attrib_node->prefix = purple_xmlnode_dup_name(arena, prefix);
+
+	purple_xmlnode_insert_child(node, attrib_node);
+}
+
 void
 purple_xmlnode_set_attrib(PurpleXmlNode *node, const char *attr, const char *value)
 {
+	PurpleXmlNodeArena *arena = NULL;
+
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(attr != NULL);
+	g_return_if_fail(value != NULL);
+
+	/* The memory of a replaced attribute can't be reused in an arena, so
+	 * the new one is allocated on its own rather than growing the arena
+	 * every time the attribute is set.
+	 */
+	if(purple_xmlnode_get_attrib(node, attr) == NULL) {
+		arena = node->arena;
+	}
+
 	purple_xmlnode_remove_attrib(node, attr);
-	purple_xmlnode_set_attrib_full(node, attr, NULL, NULL, value);
+	purple_xmlnode_add_attrib(node, arena, attr, NULL, NULL, value);
 }
 
 void
 purple_xmlnode_set_attrib_full(PurpleXmlNode *node, const char *attr, const char *xmlns, const char *prefix, const char *value)
 {
-	PurpleXmlNode *attrib_node;
+	PurpleXmlNodeArena *arena = NULL;
 
 	g_return_if_fail(node != NULL);
 	g_return_if_fail(attr != NULL);
 	g_return_if_fail(value != NULL);
 
-	purple_xmlnode_remove_attrib_with_namespace(node, attr, xmlns);
-	attrib_node = new_node(attr, PURPLE_XMLNODE_TYPE_ATTRIB);
-
-	attrib_node->data = g_strdup(value);
-	attrib_node->xmlns = g_strdup(xmlns);
-	attrib_node->prefix = g_strdup(prefix);
+	if(purple_xmlnode_get_attrib_with_namespace(node, attr, xmlns) == NULL) {
+		arena = node->arena;
+	}
 
-	purple_xmlnode_insert_child(node, attrib_node);
+	purple_xmlnode_remove_attrib_with_namespace(node, attr, xmlns);
+	purple_xmlnode_add_attrib(node, arena, attr, xmlns, prefix, value);
 }
 
 
@@ -245,14 +492,30 @@ void purple_xmlnode_set_namespace(PurpleXmlNode *node, const char *xmlns)
 	g_return_if_fail(node != NULL);
 
 	tmp = node->xmlns;
-	node->xmlns = g_strdup(xmlns);
+	node->xmlns = purple_xmlnode_dup_name(node->arena, xmlns);
 
 	if (node->namespace_map) {
 		g_hash_table_insert(node->namespace_map,
 			g_strdup(""), g_strdup(xmlns));
 	}
 
-	g_free(tmp);
+	purple_xmlnode_free_name(node->arena, tmp);
+}
+
+void
+purple_xmlnode_declare_namespace(PurpleXmlNode *node, const char *prefix,
+                                 const char *xmlns)
+{
+	g_return_if_fail(node != NULL);
+
+	if(node->namespace_map == NULL) {
+		node->namespace_map = g_hash_table_new_full(g_str_hash, g_str_equal,
+		                                            g_free, g_free);
+	}
+
+	g_hash_table_insert(node->namespace_map,
+	                    g_strdup(prefix ? prefix : ""),
+	                    g_strdup(xmlns ? xmlns : ""));
 }
 
 const char *purple_xmlnode_get_namespace(const PurpleXmlNode *node)
@@ -291,10 +554,13 @@ const char *purple_xmlnode_get_default_namespace(const PurpleXmlNode *node)
 
 void purple_xmlnode_set_prefix(PurpleXmlNode *node, const char *prefix)
 {
+	char *tmp;
 	g_return_if_fail(node != NULL);
 
-	g_free(node->prefix);
-	node->prefix = g_strdup(prefix);
+	tmp = node->prefix;
+	node->prefix = purple_xmlnode_dup_name(node->arena, prefix);
+
+	purple_xmlnode_free_name(node->arena, tmp);
 }
 
 const char *purple_xmlnode_get_prefix(const PurpleXmlNode *node)
@@ -357,6 +623,58 @@ PurpleXmlNode *purple_xmlnode_get_parent(const PurpleXmlNode *child)
 	return child->parent;
 }
 
+/* Removes node from its parent, if it has one. */
+static void
+purple_xmlnode_unlink(PurpleXmlNode *node)
+{
+	if(NULL == node->parent) {
+		return;
+	}
+
+	if(node->parent->child == node) {
+		node->parent->child = node->next;
+		if (node->parent->lastchild == node) {
+			node->parent->lastchild = node->next;
+		}
+	} else {
+		PurpleXmlNode *prev = node->parent->child;
+		while(prev && prev->next != node) {
+			prev = prev->next;
+		}
+		if(prev) {
+			prev->next = node->next;
+			if (node->parent->lastchild == node) {
+				node->parent->lastchild = prev;
+			}
+		}
+	}
+
+	node->parent = NULL;
+	node->next = NULL;
+}
+
+PurpleXmlNode *
+purple_xmlnode_detach(PurpleXmlNode *node)
+{
+	PurpleXmlNode *copy = NULL;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	purple_xmlnode_unlink(node);
+
+	if(node->arena == NULL) {
+		return node;
+	}
+
+	/* Keeping the node itself would keep the whole arena it came from alive,
+	 * which is usually a lot more than the subtree.
+	 */
+	copy = purple_xmlnode_copy(node);
+	purple_xmlnode_free(node);
+
+	return copy;
+}
+
 void
 purple_xmlnode_free(PurpleXmlNode *node)
 {
@@ -365,25 +683,7 @@ purple_xmlnode_free(PurpleXmlNode *node)
 	g_return_if_fail(node != NULL);
 
 	/* if we're part of a tree, remove ourselves from the tree first */
-	if(NULL != node->parent) {
-		if(node->parent->child == node) {
-			node->parent->child = node->next;
-			if (node->parent->lastchild == node) {
-				node->parent->lastchild = node->next;
-			}
-		} else {
-			PurpleXmlNode *prev = node->parent->child;
-			while(prev && prev->next != node) {
-				prev = prev->next;
-			}
-			if(prev) {
-				prev->next = node->next;
-				if (node->parent->lastchild == node) {
-					node->parent->lastchild = prev;
-				}
-			}
-		}
-	}
+	purple_xmlnode_unlink(node);
 
 	/* now free our children */
 	x = node->child;
@@ -393,6 +693,20 @@ purple_xmlnode_free(PurpleXmlNode *node)
 		x = y;
 	}
 
+	/* The node itself and its data are released with the arena, but names
+	 * that didn't fit in the intern table are owned by the node.
+	 */
+	if(node->arena != NULL) {
+		purple_xmlnode_free_name(node->arena, node->name);
+		purple_xmlnode_free_name(node->arena, node->xmlns);
+		purple_xmlnode_free_name(node->arena, node->prefix);
+
+		g_clear_pointer(&node->namespace_map, g_hash_table_destroy);
+		purple_xmlnode_arena_unref(node->arena);
+
+		return;
+	}
+
 	/* now dispose of ourselves */
 	g_free(node->name);
 	g_free(node->data);
@@ -483,47 +797,141 @@ purple_xmlnode_get_data_unescaped(const PurpleXmlNode *node)
 	return unescaped;
 }
 
+/* Appends str to buffer escaped the same way g_markup_escape_text() would,
+ * but without an intermediate allocation. Runs of characters that don't need
+ * escaping are appended in one go.
+ */
 static void
-purple_xmlnode_to_str_foreach_append_ns(const char *key, const char *value,
-	GString *buf)
+purple_xmlnode_append_escaped(GString *buffer, const char *str, gssize len)
+{
+	const char *end = NULL;
+	const char *run = str;
+	const char *p = str;
+
+	if(str == NULL) {
+		return;
+	}
+
+	end = str + (len < 0 ? strlen(str) : (gsize)len);
+
+	while(p < end) {
+		const char *replacement = NULL;
+		guchar c = *p;
+		gunichar control = 0;
+		gsize skip = 1;
+
+		switch(c) {
+			case '&':
+				replacement = "&amp;";
+				break;
+			case '<':
+				replacement = "&lt;";
+				break;
+			case '>':
+				replacement = "&gt;";
+				break;
+			case '\'':
+				replacement = "&apos;";
+				break;
+			case '"':
+				replacement = "&quot;";
+				break;
+			default:
+				/* These are the restricted characters from XML 1.1 that
+				 * g_markup_escape_text() writes as character references.
+				 */
+				if((c >= 0x1 && c <= 0x8) || c == 0xb || c == 0xc ||
+				   (c >= 0xe && c <= 0x1f) || c == 0x7f)
+				{
+					control = c;
+				} else if(c == 0xc2 && p + 1 < end &&
+				          (guchar)p[1] >= 0x80 && (guchar)p[1] <= 0x9f &&
+				          (guchar)p[1] != 0x85)
+				{
+					control = (guchar)p[1];
+					skip = 2;
+				}
+				break;
+		}
+
+		if(replacement == NULL && control == 0) {
+			p++;
+
+			continue;
+		}
+
+		g_string_append_len(buffer, run, p - run);
+
+		if(replacement != NULL) {
+			g_string_append(buffer, replacement);
+		} else {
+			g_string_append_printf(buffer, "&#x%x;", control);
+		}
+
+		p += skip;
+		run = p;
+	}
+
+	g_string_append_len(buffer, run, p - run);
+}
+
+static void
+purple_xmlnode_append_tabs(GString *buffer, int depth)
+{
+	for(int i = 0; i < depth; i++) {
+		g_string_append_c(buffer, '\t');
+	}
+}
+
+static void
+purple_xmlnode_append_name(GString *buffer, const char *prefix,
+                           const char *name)
+{
+	if(prefix != NULL) {
+		g_string_append(buffer, prefix);
+		g_string_append_c(buffer, ':');
+	}
+
+	purple_xmlnode_append_escaped(buffer, name, -1);
+}
+
+static void
+purple_xmlnode_write_foreach_append_ns(const char *key, const char *value,
+                                       GString *buffer)
 {
 	if (*key) {
-		g_string_append_printf(buf, " xmlns:%s='%s'", key, value);
+		g_string_append(buffer, " xmlns:");
+		g_string_append(buffer, key);
+		g_string_append(buffer, "='");
 	} else {
-		g_string_append_printf(buf, " xmlns='%s'", value);
+		g_string_append(buffer, " xmlns='");
 	}
+
+	g_string_append(buffer, value);
+	g_string_append_c(buffer, '\'');
 }
 
-static char *
-purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean formatting, int depth)
+/* Serializes node into buffer in a single pass. */
+static void
+purple_xmlnode_write(const PurpleXmlNode *node, GString *buffer,
+                     gboolean formatting, int depth)
 {
-	GString *text;
 	const char *prefix;
 	const PurpleXmlNode *c;
-	char *node_name, *esc, *esc2, *tab = NULL;
 	gboolean need_end = FALSE, pretty = formatting;
 
-	g_return_val_if_fail(node != NULL, NULL);
-
-	text = g_string_new("");
-
 	if(pretty && depth) {
-		tab = g_strnfill(depth, '\t');
-		text = g_string_append(text, tab);
+		purple_xmlnode_append_tabs(buffer, depth);
 	}
 
-	node_name = g_markup_escape_text(node->name, -1);
 	prefix = purple_xmlnode_get_prefix(node);
 
-	if (prefix) {
-		g_string_append_printf(text, "<%s:%s", prefix, node_name);
-	} else {
-		g_string_append_printf(text, "<%s", node_name);
-	}
+	g_string_append_c(buffer, '<');
+	purple_xmlnode_append_name(buffer, prefix, node->name);
 
 	if (node->namespace_map) {
 		g_hash_table_foreach(node->namespace_map,
-			(GHFunc)purple_xmlnode_to_str_foreach_append_ns, text);
+			(GHFunc)purple_xmlnode_write_foreach_append_ns, buffer);
 	} else {
 		/* Figure out if this node has a different default namespace from parent */
 		const char *xmlns = NULL;
@@ -539,23 +947,19 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 			parent_xmlns = purple_xmlnode_get_default_namespace(node->parent);
 		}
 		if (!purple_strequal(xmlns, parent_xmlns)) {
-			char *escaped_xmlns = g_markup_escape_text(xmlns, -1);
-			g_string_append_printf(text, " xmlns='%s'", escaped_xmlns);
-			g_free(escaped_xmlns);
+			g_string_append(buffer, " xmlns='");
+			purple_xmlnode_append_escaped(buffer, xmlns, -1);
+			g_string_append_c(buffer, '\'');
 		}
 	}
 	for(c = node->child; c; c = c->next) {
 		if(c->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
-			const char *aprefix = purple_xmlnode_get_prefix(c);
-			esc = g_markup_escape_text(c->name, -1);
-			esc2 = g_markup_escape_text(c->data, -1);
-			if (aprefix) {
-				g_string_append_printf(text, " %s:%s='%s'", aprefix, esc, esc2);
-			} else {
-				g_string_append_printf(text, " %s='%s'", esc, esc2);
-			}
-			g_free(esc);
-			g_free(esc2);
+			g_string_append_c(buffer, ' ');
+			purple_xmlnode_append_name(buffer, purple_xmlnode_get_prefix(c),
+			                           c->name);
+			g_string_append(buffer, "='");
+			purple_xmlnode_append_escaped(buffer, c->data, -1);
+			g_string_append_c(buffer, '\'');
 		} else if(c->type == PURPLE_XMLNODE_TYPE_TAG || c->type == PURPLE_XMLNODE_TYPE_DATA) {
 			if(c->type == PURPLE_XMLNODE_TYPE_DATA) {
 				pretty = FALSE;
@@ -565,36 +969,44 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 	}
 
 	if(need_end) {
-		g_string_append_printf(text, ">%s", pretty ? NEWLINE_S : "");
+		g_string_append_c(buffer, '>');
+		if(pretty) {
+			g_string_append(buffer, NEWLINE_S);
+		}
 
 		for(c = node->child; c; c = c->next) {
 			if(c->type == PURPLE_XMLNODE_TYPE_TAG) {
-				int esc_len;
-				esc = purple_xmlnode_to_str_helper(c, &esc_len, pretty, depth+1);
-				text = g_string_append_len(text, esc, esc_len);
-				g_free(esc);
+				purple_xmlnode_write(c, buffer, pretty, depth + 1);
 			} else if(c->type == PURPLE_XMLNODE_TYPE_DATA && c->data_sz > 0) {
-				esc = g_markup_escape_text(c->data, c->data_sz);
-				text = g_string_append(text, esc);
-				g_free(esc);
+				purple_xmlnode_append_escaped(buffer, c->data, c->data_sz);
 			}
 		}
 
-		if(tab && pretty) {
-			text = g_string_append(text, tab);
-		}
-		if (prefix) {
-			g_string_append_printf(text, "</%s:%s>%s", prefix, node_name, formatting ? NEWLINE_S : "");
-		} else {
-			g_string_append_printf(text, "</%s>%s", node_name, formatting ? NEWLINE_S : "");
+		if(formatting && depth && pretty) {
+			purple_xmlnode_append_tabs(buffer, depth);
 		}
+
+		g_string_append(buffer, "</");
+		purple_xmlnode_append_name(buffer, prefix, node->name);
+		g_string_append_c(buffer, '>');
 	} else {
-		g_string_append_printf(text, "/>%s", formatting ? NEWLINE_S : "");
+		g_string_append(buffer, "/>");
 	}
 
-	g_free(node_name);
+	if(formatting) {
+		g_string_append(buffer, NEWLINE_S);
+	}
+}
 
-	g_free(tab);
+static char *
+purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean formatting, int depth)
+{
+	GString *text;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	text = g_string_new("");
+	purple_xmlnode_write(node, text, formatting, depth);
 
 	if(len) {
 		*len = text->len;
@@ -603,6 +1015,15 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 	return g_string_free(text, FALSE);
 }
 
+void
+purple_xmlnode_write_to_string(const PurpleXmlNode *node, GString *buffer)
+{
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(buffer != NULL);
+
+	purple_xmlnode_write(node, buffer, FALSE, 0);
+}
+
 char *
 purple_xmlnode_to_str(const PurpleXmlNode *node, int *len)
 {
@@ -628,9 +1049,22 @@ purple_xmlnode_to_formatted_str(const PurpleXmlNode *node, int *len)
 	return xml_with_declaration;
 }
 
+/* How much of a file is handed to the parser at a time when streaming. */
+#define PURPLE_XMLNODE_STREAM_CHUNK_SIZE (64 * 1024)
+
 struct _xmlnode_parser_data {
 	PurpleXmlNode *current;
 	gboolean error;
+
+	/* Only used when streaming. An element is collected when it is to be
+	 * handed over whole, and collect_depth is its depth, or G_MAXUINT while
+	 * nothing is being collected. */
+	PurpleXmlNodeStreamStartFunc stream_start;
+	PurpleXmlNodeStreamFunc stream_func;
+	gpointer stream_data;
+	guint stream_depth;
+	guint collect_depth;
+	guint depth;
 };
 
 static void
@@ -660,16 +1094,10 @@ purple_xmlnode_parser_element_start_libxml(gpointer user_data,
 		purple_xmlnode_set_namespace(node, (const char *) xmlns);
 		purple_xmlnode_set_prefix(node, (const char *)prefix);
 
-		if (nb_namespaces != 0) {
-			node->namespace_map = g_hash_table_new_full(
-				g_str_hash, g_str_equal, g_free, g_free);
-
-			for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
-				const char *key = (const char *)namespaces[j];
-				const char *val = (const char *)namespaces[j + 1];
-				g_hash_table_insert(node->namespace_map,
-					g_strdup(key ? key : ""), g_strdup(val ? val : ""));
-			}
+		for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
+			purple_xmlnode_declare_namespace(node,
+			                                 (const char *)namespaces[j],
+			                                 (const char *)namespaces[j + 1]);
 		}
 
 		for(i=0; i < nb_attributes * 5; i+=5) {
@@ -686,6 +1114,25 @@ purple_xmlnode_parser_element_start_libxml(gpointer user_data,
 		}
 
 		xpd->current = node;
+
+		if(xpd->stream_func != NULL) {
+			if(xpd->collect_depth == G_MAXUINT) {
+				gboolean descend = FALSE;
+
+				if(xpd->stream_start != NULL) {
+					descend = xpd->stream_start(node, xpd->depth,
+					                            xpd->stream_data);
+				} else if(xpd->depth < xpd->stream_depth) {
+					xpd->stream_func(node, xpd->stream_data);
+					descend = TRUE;
+				}
+
+				if(!descend) {
+					xpd->collect_depth = xpd->depth;
+				}
+			}
+			xpd->depth++;
+		}
 	}
 }
 
@@ -701,6 +1148,20 @@ purple_xmlnode_parser_element_end_libxml(gpointer user_data,
 		return;
 	}
 
+	if(xpd->stream_func != NULL) {
+		PurpleXmlNode *node = xpd->current;
+
+		xpd->depth--;
+		if(xpd->depth == xpd->collect_depth) {
+			/* The element is complete, so hand it over and forget it. */
+			xpd->collect_depth = G_MAXUINT;
+			xpd->stream_func(node, xpd->stream_data);
+			xpd->current = node->parent;
+			purple_xmlnode_free(node);
+			return;
+		}
+	}
+
 	if(xpd->current->parent) {
 		if(!xmlStrcmp((xmlChar*) xpd->current->name, element_name)) {
 			xpd->current = xpd->current->parent;
@@ -721,6 +1182,12 @@ purple_xmlnode_parser_element_text_libxml(void *user_data, const xmlChar *text,
 		return;
 	}
 
+	/* When streaming, the elements above the ones being handed over only
+	 * keep their attributes. */
+	if(xpd->stream_func != NULL && xpd->collect_depth == G_MAXUINT) {
+		return;
+	}
+
 	purple_xmlnode_insert_data(xpd->current, (const char*) text, text_len);
 }
 
@@ -826,6 +1293,50 @@ purple_xmlnode_from_str(const char *str, gssize size)
 	return ret;
 }
 
+/* Keeps a copy of a file that couldn't be parsed before it's overwritten. */
+static void
+purple_xmlnode_file_backup(const char *dir, const char *filename,
+                           const char *filename_full, const gchar *contents,
+                           gsize length)
+{
+	gchar *filename_temp, *filename_temp_full;
+
+	filename_temp = g_strdup_printf("%s~", filename);
+	filename_temp_full = g_build_filename(dir, filename_temp, NULL);
+
+	purple_debug_error("util", "Error parsing file %s.  Renaming old "
+					 "file to %s", filename_full, filename_temp);
+	g_file_set_contents(filename_temp_full, contents, length, NULL);
+
+	g_free(filename_temp_full);
+	g_free(filename_temp);
+}
+
+/* Tells the user that a file couldn't be parsed. A file that was streamed has
+ * been loaded up to the error, so the message has to say so. */
+static void
+purple_xmlnode_file_error(const char *filename, const char *filename_full,
+                          const char *description, gboolean partial)
+{
+	gchar *title, *msg;
+
+	title = g_strdup_printf(_("Error Reading %s"), filename);
+	if (partial) {
+		msg = g_strdup_printf(_("An error was encountered reading your "
+					"%s.  Only the part of the file before the error "
+					"has been loaded, and the old file has been renamed "
+					"to %s~."), description, filename_full);
+	} else {
+		msg = g_strdup_printf(_("An error was encountered reading your "
+					"%s.  The file has not been loaded, and the old "
+					"file has been renamed to %s~."), description,
+					filename_full);
+	}
+	purple_notify_error(NULL, NULL, title, msg, NULL);
+	g_free(title);
+	g_free(msg);
+}
+
 PurpleXmlNode *
 purple_xmlnode_from_file(const char *dir, const char *filename, const char *description, const char *process)
 {
@@ -860,17 +1371,8 @@ purple_xmlnode_from_file(const char *dir, const char *filename, const char *desc
 
 		/* If we were unable to parse the file then save its contents to a backup file */
 		if (node == NULL) {
-			gchar *filename_temp, *filename_temp_full;
-
-			filename_temp = g_strdup_printf("%s~", filename);
-			filename_temp_full = g_build_filename(dir, filename_temp, NULL);
-
-			purple_debug_error("util", "Error parsing file %s.  Renaming old "
-							 "file to %s", filename_full, filename_temp);
-			g_file_set_contents(filename_temp_full, contents, length, NULL);
-
-			g_free(filename_temp_full);
-			g_free(filename_temp);
+			purple_xmlnode_file_backup(dir, filename, filename_full,
+			                           contents, length);
 		}
 
 		g_free(contents);
@@ -878,14 +1380,8 @@ purple_xmlnode_from_file(const char *dir, const char *filename, const char *desc
 
 	/* If we could not parse the file then show the user an error message */
 	if (node == NULL) {
-		gchar *title, *msg;
-		title = g_strdup_printf(_("Error Reading %s"), filename);
-		msg = g_strdup_printf(_("An error was encountered reading your "
-					"%s.  The file has not been loaded, and the old file "
-					"has been renamed to %s~."), description, filename_full);
-		purple_notify_error(NULL, NULL, title, msg, NULL);
-		g_free(title);
-		g_free(msg);
+		purple_xmlnode_file_error(filename, filename_full, description,
+		                          FALSE);
 	}
 
 	g_free(filename_full);
@@ -893,6 +1389,140 @@ purple_xmlnode_from_file(const char *dir, const char *filename, const char *desc
 	return node;
 }
 
+/* Streams a file for purple_xmlnode_stream_from_file() and
+ * purple_xmlnode_stream_from_file_full(). The user is only told about errors
+ * if there is a description. */
+static gboolean
+purple_xmlnode_stream_from_file_internal(const char *dir, const char *filename,
+                                         const char *description,
+                                         const char *process, guint depth,
+                                         PurpleXmlNodeStreamStartFunc start_func,
+                                         PurpleXmlNodeStreamFunc func,
+                                         gpointer data)
+{
+	struct _xmlnode_parser_data *xpd;
+	xmlParserCtxtPtr context;
+	gchar *filename_full, *buffer;
+	gsize length, total = 0;
+	gboolean ret;
+	FILE *fp;
+
+	purple_debug_misc(process, "Reading file %s from directory %s",
+					filename, dir);
+
+	filename_full = g_build_filename(dir, filename, NULL);
+
+	if (!g_file_test(filename_full, G_FILE_TEST_EXISTS)) {
+		purple_debug_info(process, "File %s does not exist (this is not "
+						"necessarily an error)", filename_full);
+		g_free(filename_full);
+		return FALSE;
+	}
+
+	fp = g_fopen(filename_full, "rb");
+	if (fp == NULL) {
+		purple_debug_error(process, "Error reading file %s: %s",
+						 filename_full, g_strerror(errno));
+		if (description != NULL) {
+			purple_xmlnode_file_error(filename, filename_full, description,
+			                          FALSE);
+		}
+		g_free(filename_full);
+		return FALSE;
+	}
+
+	xpd = g_new0(struct _xmlnode_parser_data, 1);
+	xpd->stream_start = start_func;
+	xpd->stream_func = func;
+	xpd->stream_data = data;
+	xpd->stream_depth = depth;
+	xpd->collect_depth = G_MAXUINT;
+
+	buffer = g_malloc(PURPLE_XMLNODE_STREAM_CHUNK_SIZE);
+	context = xmlCreatePushParserCtxt(&purple_xmlnode_parser_libxml, xpd,
+	                                  NULL, 0, filename_full);
+
+	while (!xpd->error &&
+	       (length = fread(buffer, 1, PURPLE_XMLNODE_STREAM_CHUNK_SIZE, fp)) > 0)
+	{
+		xmlParseChunk(context, buffer, length, 0);
+		total += length;
+	}
+
+	if (ferror(fp)) {
+		purple_debug_error(process, "Error reading file %s: %s",
+						 filename_full, g_strerror(errno));
+		xpd->error = TRUE;
+	}
+
+	if (!xpd->error) {
+		xmlParseChunk(context, NULL, 0, 1);
+	}
+
+	ret = (total > 0 && !xpd->error && context->wellFormed);
+
+	xmlFreeParserCtxt(context);
+	g_free(buffer);
+	fclose(fp);
+
+	/* Whatever is left is the root and, after an error, its open children. */
+	while (xpd->current && xpd->current->parent) {
+		xpd->current = xpd->current->parent;
+	}
+	g_clear_pointer(&xpd->current, purple_xmlnode_free);
+	g_free(xpd);
+
+	if (!ret && description != NULL) {
+		gchar *contents = NULL;
+
+		/* Only the failure path reads the whole file. */
+		if (g_file_get_contents(filename_full, &contents, &length, NULL) &&
+		    length > 0)
+		{
+			purple_xmlnode_file_backup(dir, filename, filename_full,
+			                           contents, length);
+		}
+		g_free(contents);
+
+		purple_xmlnode_file_error(filename, filename_full, description,
+		                          total > 0);
+	}
+
+	g_free(filename_full);
+
+	return ret;
+}
+
+gboolean
+purple_xmlnode_stream_from_file(const char *dir, const char *filename,
+                                const char *description, const char *process,
+                                guint depth, PurpleXmlNodeStreamFunc func,
+                                gpointer data)
+{
+	g_return_val_if_fail(dir != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	return purple_xmlnode_stream_from_file_internal(dir, filename,
+	                                                description, process,
+	                                                depth, NULL, func, data);
+}
+
+gboolean
+purple_xmlnode_stream_from_file_full(const char *dir, const char *filename,
+                                     const char *process,
+                                     PurpleXmlNodeStreamStartFunc start_func,
+                                     PurpleXmlNodeStreamFunc func,
+                                     gpointer data)
+{
+	g_return_val_if_fail(dir != NULL, FALSE);
+	g_return_val_if_fail(start_func != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	return purple_xmlnode_stream_from_file_internal(dir, filename, NULL,
+	                                                process, 0, start_func,
+	                                                func, data);
+}
+
 static void
 purple_xmlnode_copy_foreach_ns(gpointer key, gpointer value, gpointer user_data)
 {
@@ -909,7 +1539,7 @@ purple_xmlnode_copy(const PurpleXmlNode *src)
 
 	g_return_val_if_fail(src != NULL, NULL);
 
-	ret = new_node(src->name, src->type);
+	ret = new_node(NULL, src->name, src->type);
 	ret->xmlns = g_strdup(src->xmlns);
 	if (src->data) {
 		if (src->data_sz) {
@@ -61,11 +61,40 @@ typedef enum
  * @next:          The next node or %NULL.
  * @prefix:        The namespace prefix if any.
  * @namespace_map: The namespace map.
+ * @arena:         The [struct@Purple.XmlNodeArena] the node was allocated from
+ *                 or %NULL. (Since: 3.0.0)
  *
  * XmlNode is a simplified API for handling XML. An XmlNode represents an XML
  * element and has API for children as well as attributes.
  */
 typedef struct _PurpleXmlNode PurpleXmlNode;
+
+/**
+ * PurpleXmlNodeArena:
+ *
+ * An opaque, reference counted block of memory that [struct@Purple.XmlNode]'s
+ * can be allocated from.
+ *
+ * Building a tree out of many small allocations is expensive when the tree is
+ * thrown away right after it was built, like an incoming XMPP stanza. Nodes
+ * created in an arena, as well as all children, attributes and data that are
+ * added to them, are carved out of a few large chunks. Their names,
+ * namespaces and prefixes are shared between all arenas. Values that replace
+ * existing ones, like setting an attribute a second time, are allocated on
+ * their own so that they don't grow the arena.
+ *
+ * Every node holds a reference to its arena, so the memory is released once
+ * the last node in it has been freed with [func@Purple.xmlnode_free]. Nodes
+ * are otherwise used exactly like any other node, but a subtree that should
+ * outlive the rest of the tree should be taken out of it with
+ * [func@Purple.xmlnode_detach], which doesn't keep the arena alive.
+ *
+ * Nodes may only be added to an arena from one thread at a time.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleXmlNodeArena PurpleXmlNodeArena;
+
 struct _PurpleXmlNode
 {
 	char *name;
@@ -79,6 +108,7 @@ struct _PurpleXmlNode
 	PurpleXmlNode *next;
 	char *prefix;
 	GHashTable *namespace_map;
+	PurpleXmlNodeArena *arena;
 };
 
 G_BEGIN_DECLS
@@ -102,6 +132,57 @@ GType purple_xmlnode_get_type(void);
  */
 PurpleXmlNode *purple_xmlnode_new(const char *name);
 
+/**
+ * purple_xmlnode_arena_new:
+ *
+ * Creates a new, empty arena to allocate nodes from.
+ *
+ * Returns: (transfer full): The new arena.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNodeArena *purple_xmlnode_arena_new(void);
+
+/**
+ * purple_xmlnode_arena_ref:
+ * @arena: The instance.
+ *
+ * Increases the reference count of @arena.
+ *
+ * Returns: (transfer full): @arena.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNodeArena *purple_xmlnode_arena_ref(PurpleXmlNodeArena *arena);
+
+/**
+ * purple_xmlnode_arena_unref:
+ * @arena: (transfer full): The instance.
+ *
+ * Decreases the reference count of @arena, freeing it and all of the memory
+ * it holds when the count reaches zero.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_arena_unref(PurpleXmlNodeArena *arena);
+
+/**
+ * purple_xmlnode_new_in_arena:
+ * @arena: The arena to allocate from.
+ * @name: The name of the node.
+ *
+ * Creates a new PurpleXmlNode in @arena. Any children, attributes or data that
+ * are added to the node are allocated from @arena as well.
+ *
+ * The node holds its own reference to @arena, so the caller may drop theirs
+ * right away.
+ *
+ * Returns: The new node.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNode *purple_xmlnode_new_in_arena(PurpleXmlNodeArena *arena, const char *name);
+
 /**
  * purple_xmlnode_new_child:
  * @parent: The parent node.
@@ -262,6 +343,21 @@ void purple_xmlnode_remove_attrib_with_namespace(PurpleXmlNode *node, const char
  */
 void purple_xmlnode_set_namespace(PurpleXmlNode *node, const char *xmlns);
 
+/**
+ * purple_xmlnode_declare_namespace:
+ * @node: The node.
+ * @prefix: (nullable): The prefix being declared or %NULL for the default
+ *          namespace.
+ * @xmlns: (nullable): The namespace the prefix refers to.
+ *
+ * Adds a namespace declaration to @node, which will be used to resolve
+ * prefixes on @node and its children and will be written out by
+ * [func@Purple.xmlnode_to_str].
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_declare_namespace(PurpleXmlNode *node, const char *prefix, const char *xmlns);
+
 /**
  * purple_xmlnode_get_namespace:
  * @node: The node to get the namespace from
@@ -349,6 +445,22 @@ void purple_xmlnode_strip_prefixes(PurpleXmlNode *node);
  */
 PurpleXmlNode *purple_xmlnode_get_parent(const PurpleXmlNode *child);
 
+/**
+ * purple_xmlnode_detach:
+ * @node: (transfer full): The node to detach.
+ *
+ * Removes @node from its parent so it can be kept after the rest of the tree
+ * has been freed.
+ *
+ * If @node was allocated from a [struct@Purple.XmlNodeArena], @node is freed
+ * and a copy of it that isn't in any arena is returned instead.
+ *
+ * Returns: (transfer full): @node or its copy.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNode *purple_xmlnode_detach(PurpleXmlNode *node);
+
 /**
  * purple_xmlnode_to_str:
  * @node: The starting node to output.
@@ -361,6 +473,20 @@ PurpleXmlNode *purple_xmlnode_get_parent(const PurpleXmlNode *child);
  */
 char *purple_xmlnode_to_str(const PurpleXmlNode *node, int *len);
 
+/**
+ * purple_xmlnode_write_to_string:
+ * @node: The starting node to output.
+ * @buffer: The buffer to append to.
+ *
+ * Appends the same XML that [func@Purple.xmlnode_to_str] returns for @node
+ * to @buffer. This avoids an extra copy when the output is going to end up
+ * in a larger buffer anyway, for example one that is about to be written to
+ * a network stream.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_write_to_string(const PurpleXmlNode *node, GString *buffer);
+
 /**
  * purple_xmlnode_to_formatted_str:
  * @node: The starting node to output.
@@ -424,6 +550,52 @@ void purple_xmlnode_free(PurpleXmlNode *node);
 PurpleXmlNode *purple_xmlnode_from_file(const char *dir, const char *filename,
 		const char *description, const char *process);
 
+/**
+ * PurpleXmlNodeStreamFunc:
+ * @node: The element.
+ * @data: The user data passed to purple_xmlnode_stream_from_file().
+ *
+ * Receives the elements of a file that is being streamed. @node is only valid
+ * for the duration of the call.
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PurpleXmlNodeStreamFunc)(PurpleXmlNode *node, gpointer data);
+
+/**
+ * purple_xmlnode_stream_from_file:
+ * @dir: The directory where the file is located.
+ * @filename: The filename.
+ * @description: A description of the file being parsed. Displayed to
+ *               the user if the file cannot be read.
+ * @process: The subsystem that is calling this function. Used as the
+ *           category for debugging.
+ * @depth: How deep the elements that are handed over whole are, where the
+ *         root element is 0.
+ * @func: (scope call): The function to call with each element.
+ * @data: User data to pass to @func.
+ *
+ * Parses a file a piece at a time without building a tree for all of it.
+ *
+ * Elements above @depth are passed to @func as soon as they start, with their
+ * attributes but without their contents. Elements at @depth are passed to
+ * @func once they are complete, with everything in them, and are freed
+ * afterwards. Their ancestors are available through their parent pointers.
+ *
+ * The file is not buffered until it has been parsed successfully, so if it
+ * can't be parsed, the elements read before the error have already been
+ * passed to @func. Callers that can't work with part of a file have to
+ * discard what they were given when this returns %FALSE. Like
+ * purple_xmlnode_from_file(), the file is backed up, but the user is told
+ * that only the part of it before the error was loaded.
+ *
+ * Returns: %TRUE if the whole file was read, %FALSE if it doesn't exist or
+ *          an error occurred.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_xmlnode_stream_from_file(const char *dir, const char *filename, const char *description, const char *process, guint depth, PurpleXmlNodeStreamFunc func, gpointer data);
+
 G_END_DECLS
 
 #endif /* PURPLE_XMLNODE_H */
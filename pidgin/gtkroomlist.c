@@ -49,6 +49,7 @@ struct _PidginRoomlistDialog {
 	GtkWidget *progress;
 	GtkWidget *view;
 	GtkSingleSelection *selection;
+	GtkSortListModel *sort;
 	GtkFilterListModel *filter;
 
 	GtkWidget *stop_button;
@@ -68,7 +69,6 @@ G_DEFINE_TYPE(PidginRoomlistDialog, pidgin_roomlist_dialog, GTK_TYPE_DIALOG)
 
 typedef struct {
 	PidginRoomlistDialog *dialog;
-	GListStore *model;
 } PidginRoomlist;
 
 /******************************************************************************
@@ -111,10 +111,6 @@ pidgin_roomlist_start_listing(PidginRoomlistDialog *dialog)
 		return;
 
 	if (dialog->roomlist != NULL) {
-		rl = g_object_get_data(G_OBJECT(dialog->roomlist),
-		                       PIDGIN_ROOMLIST_UI_DATA);
-
-		g_clear_object(&rl->model);
 		g_object_unref(dialog->roomlist);
 	}
 
@@ -129,7 +125,10 @@ pidgin_roomlist_start_listing(PidginRoomlistDialog *dialog)
 
 	gtk_widget_set_sensitive(dialog->account_widget, FALSE);
 
-	gtk_filter_list_model_set_model(dialog->filter, G_LIST_MODEL(rl->model));
+	/* The room list is the model, so rooms show up as the protocol delivers
+	 * them, in batches. */
+	gtk_filter_list_model_set_model(dialog->filter,
+	                                G_LIST_MODEL(dialog->roomlist));
 
 	/* some protocols (not bundled with libpurple) finish getting their
 	 * room list immediately */
@@ -279,12 +278,6 @@ dialog_select_account_cb(GObject *obj, G_GNUC_UNUSED GParamSpec *pspec,
 	dialog->account = account;
 
 	if (change && dialog->roomlist) {
-		PidginRoomlist *rl = NULL;
-
-		rl = g_object_get_data(G_OBJECT(dialog->roomlist),
-		                       PIDGIN_ROOMLIST_UI_DATA);
-
-		g_clear_object(&rl->model);
 		g_clear_object(&dialog->roomlist);
 	}
 }
@@ -370,6 +363,8 @@ pidgin_roomlist_dialog_class_init(PidginRoomlistDialogClass *klass)
 	                                     view);
 	gtk_widget_class_bind_template_child(widget_class, PidginRoomlistDialog,
 	                                     selection);
+	gtk_widget_class_bind_template_child(widget_class, PidginRoomlistDialog,
+	                                     sort);
 	gtk_widget_class_bind_template_child(widget_class, PidginRoomlistDialog,
 	                                     filter);
 	gtk_widget_class_bind_template_child(widget_class, PidginRoomlistDialog,
@@ -403,6 +398,10 @@ pidgin_roomlist_dialog_init(PidginRoomlistDialog *self)
 
 	gtk_widget_init_template(GTK_WIDGET(self));
 
+	/* Clicking the column headers sorts the rooms. */
+	gtk_sort_list_model_set_sorter(self->sort,
+	        gtk_column_view_get_sorter(GTK_COLUMN_VIEW(self->view)));
+
 	filter = gtk_custom_filter_new(account_filter_func, NULL, NULL);
 	pidgin_account_chooser_set_filter(
 	        PIDGIN_ACCOUNT_CHOOSER(self->account_widget),
@@ -473,10 +472,15 @@ static gboolean pidgin_progress_bar_pulse(gpointer data)
 }
 
 static void
-pidgin_roomlist_add_room(PurpleRoomlist *list, PurpleRoomlistRoom *room) {
-	PidginRoomlist *rl = NULL;
+pidgin_roomlist_items_changed(GListModel *model, G_GNUC_UNUSED guint position,
+                              G_GNUC_UNUSED guint removed, guint added,
+                              gpointer data)
+{
+	PurpleRoomlist *list = PURPLE_ROOMLIST(model);
+	PidginRoomlist *rl = data;
 
-	rl = g_object_get_data(G_OBJECT(list), PIDGIN_ROOMLIST_UI_DATA);
+	if (added == 0)
+		return;
 
 	if (rl->dialog) {
 		if (rl->dialog->pg_update_to == 0) {
@@ -486,8 +490,6 @@ pidgin_roomlist_add_room(PurpleRoomlist *list, PurpleRoomlistRoom *room) {
 		} else
 			rl->dialog->pg_needs_pulse = TRUE;
 	}
-
-	g_list_store_append(rl->model, room);
 }
 
 static void
@@ -522,8 +524,8 @@ pidgin_roomlist_new(PurpleRoomlist *list)
 	g_object_set_data_full(G_OBJECT(list), PIDGIN_ROOMLIST_UI_DATA, rl,
 	                       (GDestroyNotify)g_free);
 
-	rl->model = g_list_store_new(PURPLE_TYPE_ROOMLIST_ROOM);
-
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(pidgin_roomlist_items_changed), rl);
 	g_signal_connect(list, "notify::in-progress",
 	                 G_CALLBACK(pidgin_roomlist_in_progress), rl);
 }
@@ -531,7 +533,6 @@ pidgin_roomlist_new(PurpleRoomlist *list)
 static PurpleRoomlistUiOps ops = {
 	.show_with_account = pidgin_roomlist_dialog_show_with_account,
 	.create = pidgin_roomlist_new,
-	.add_room = pidgin_roomlist_add_room,
 };
 
 
@@ -68,17 +68,20 @@ struct _PidginDebugWindow {
 	GRegex *regex;
 };
 
-typedef struct {
-	GDateTime *timestamp;
-	PurpleDebugLevel level;
-	gchar *domain;
-	gchar *message;
-} PidginDebugMessage;
+/* Messages are collected in debug_ring by the log writer, which may run on
+ * any thread, and are added to the window in batches at most this often.
+ */
+#define PIDGIN_DEBUG_FLUSH_INTERVAL (33)
+
+/* How many lines the debug window keeps by default. */
+#define PIDGIN_DEBUG_DEFAULT_MAX_LINES (10000)
 
 static gboolean debug_print_enabled = FALSE;
 static PidginDebugWindow *debug_win = NULL;
 static guint pref_callback_id = 0;
 static guint debug_enabled_timer = 0;
+static PurpleDebugRing *debug_ring = NULL;
+static guint64 debug_ring_cursor = 0;
 
 G_DEFINE_TYPE(PidginDebugWindow, pidgin_debug_window, GTK_TYPE_WINDOW);
 
@@ -499,6 +502,18 @@ filter_level_changed_cb(GObject *obj, G_GNUC_UNUSED GParamSpec *pspec)
 	                     gtk_drop_down_get_selected(dropdown));
 }
 
+static guint
+pidgin_debug_get_max_lines(void) {
+	gint max_lines = purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/max_lines");
+
+	return max_lines > 0 ? (guint)max_lines : PIDGIN_DEBUG_DEFAULT_MAX_LINES;
+}
+
+static void
+pidgin_debug_update_enabled(void) {
+	purple_debug_set_enabled(debug_win != NULL || debug_print_enabled);
+}
+
 static void
 pidgin_debug_window_dispose(GObject *object)
 {
@@ -519,6 +534,7 @@ pidgin_debug_window_finalize(GObject *object)
 	g_clear_pointer(&win->regex, g_regex_unref);
 
 	debug_win = NULL;
+	pidgin_debug_update_enabled();
 	purple_prefs_set_bool(PIDGIN_PREFS_ROOT "/debug/enabled", FALSE);
 
 	G_OBJECT_CLASS(pidgin_debug_window_parent_class)->finalize(object);
@@ -693,83 +709,89 @@ debug_enabled_cb(G_GNUC_UNUSED const gchar *name,
 	                                    (gpointer)value);
 }
 
-static gboolean
-pidgin_debug_g_log_handler_cb(gpointer data)
+static void
+pidgin_debug_window_append(GDateTime *timestamp, PurpleDebugLevel level,
+                           const gchar *category, const gchar *message,
+                           gpointer data)
 {
-	PidginDebugMessage *message = data;
+	PidginDebugWindow *win = data;
 	GtkTextTag *level_tag = NULL;
+	GtkTextTag *paused_tag = NULL;
 	gchar *local_time = NULL;
 	GtkTextIter end;
+
+	gtk_text_buffer_get_end_iter(win->buffer, &end);
+
+	level_tag = win->tags.level[level];
+	paused_tag = win->paused ? win->tags.paused : NULL;
+	local_time = g_date_time_format(timestamp, "(%H:%M:%S) ");
+
+	gtk_text_buffer_insert_with_tags(win->buffer, &end, local_time, -1,
+	                                 level_tag, paused_tag, NULL);
+
+	if (category != NULL && *category != '\0') {
+		gtk_text_buffer_insert_with_tags(win->buffer, &end, category, -1,
+		                                 level_tag, win->tags.category,
+		                                 paused_tag, NULL);
+		gtk_text_buffer_insert_with_tags(win->buffer, &end, ": ", 2,
+		                                 level_tag, win->tags.category,
+		                                 paused_tag, NULL);
+	}
+
+	gtk_text_buffer_insert_with_tags(win->buffer, &end, message, -1,
+	                                 level_tag, paused_tag, NULL);
+	gtk_text_buffer_insert_with_tags(win->buffer, &end, "\n", 1,
+	                                 level_tag, paused_tag, NULL);
+
+	g_free(local_time);
+}
+
+/* Drops the oldest lines once the buffer holds more than the retention cap. */
+static void
+pidgin_debug_window_trim(PidginDebugWindow *win) {
+	gint max_lines = pidgin_debug_get_max_lines();
+	gint lines = gtk_text_buffer_get_line_count(win->buffer);
+
+	if (lines > max_lines) {
+		GtkTextIter start, end;
+
+		gtk_text_buffer_get_start_iter(win->buffer, &start);
+		gtk_text_buffer_get_iter_at_line(win->buffer, &end,
+		                                 lines - max_lines);
+		gtk_text_buffer_delete(win->buffer, &start, &end);
+	}
+}
+
+static gboolean
+pidgin_debug_flush_cb(G_GNUC_UNUSED gpointer data)
+{
+	GtkTextIter end;
 	gboolean scroll;
 
+	if (debug_ring == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
 	if (debug_win == NULL ||
 			!purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/enabled")) {
 		/* The Debug Window may have been closed/disabled after the thread that
-		 * sent this message. */
-		g_date_time_unref(message->timestamp);
-		g_free(message->domain);
-		g_free(message->message);
-		g_free(message);
-		return FALSE;
+		 * sent these messages. */
+		purple_debug_ring_clear(debug_ring);
+		return G_SOURCE_REMOVE;
 	}
 
 	scroll = view_near_bottom(debug_win);
 	gtk_text_buffer_get_end_iter(debug_win->buffer, &end);
 	gtk_text_buffer_move_mark(debug_win->buffer, debug_win->start_mark, &end);
 
-	level_tag = debug_win->tags.level[message->level];
-	local_time = g_date_time_format(message->timestamp, "(%H:%M:%S) ");
-
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			local_time,
-			-1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-
-	if (message->domain != NULL && *message->domain != '\0') {
-		gtk_text_buffer_insert_with_tags(
-				debug_win->buffer,
-				&end,
-				message->domain,
-				-1,
-				level_tag,
-				debug_win->tags.category,
-				debug_win->paused ? debug_win->tags.paused : NULL,
-				NULL);
-		gtk_text_buffer_insert_with_tags(
-				debug_win->buffer,
-				&end,
-				": ",
-				2,
-				level_tag,
-				debug_win->tags.category,
-				debug_win->paused ? debug_win->tags.paused : NULL,
-				NULL);
+	if (purple_debug_ring_read(debug_ring, &debug_ring_cursor,
+	                           pidgin_debug_window_append, debug_win) == 0) {
+		return G_SOURCE_REMOVE;
 	}
 
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			message->message,
-			-1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			"\n",
-			1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-
 	if (purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/filter") &&
 			debug_win->regex) {
-		/* Filter out any new messages. */
+		/* Filter out the new messages all at once. */
 		GtkTextIter start;
 
 		gtk_text_buffer_get_iter_at_mark(debug_win->buffer, &start,
@@ -780,29 +802,30 @@ pidgin_debug_g_log_handler_cb(gpointer data)
 		do_regex(debug_win, &start, &end);
 	}
 
+	pidgin_debug_window_trim(debug_win);
+
 	if (scroll) {
 		gtk_text_view_scroll_to_mark(
 				GTK_TEXT_VIEW(debug_win->textview),
 				debug_win->end_mark, 0, TRUE, 0, 1);
 	}
 
-	g_free(local_time);
-	g_date_time_unref(message->timestamp);
-	g_free(message->domain);
-	g_free(message->message);
-	g_free(message);
-
-	return FALSE;
+	return G_SOURCE_REMOVE;
 }
 
 static GLogWriterOutput
 pidgin_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
                            gsize n_fields, G_GNUC_UNUSED gpointer user_data)
 {
-	PidginDebugMessage *message = NULL;
+	PurpleDebugLevel level = PURPLE_DEBUG_MISC;
+	PurpleDebugRing *ring = NULL;
+	const gchar *domain = NULL;
+	const gchar *message = NULL;
 	gsize i;
 
-	if (debug_win == NULL) {
+	/* The ring is gone once pidgin_debug_uninit has run. */
+	ring = g_atomic_pointer_get(&debug_ring);
+	if (debug_win == NULL || ring == NULL) {
 		if (debug_print_enabled) {
 			return g_log_writer_default(log_level, fields, n_fields, user_data);
 		} else {
@@ -810,34 +833,35 @@ pidgin_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
 		}
 	}
 
-	message = g_new0(PidginDebugMessage, 1);
-	message->timestamp = g_date_time_new_now_local();
-
 	for (i = 0; i < n_fields; i++) {
 		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
-			message->domain = g_strdup(fields[i].value);
+			domain = fields[i].value;
 		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
-			message->message = g_strdup(fields[i].value);
+			message = fields[i].value;
 		}
 	}
 
 	if((log_level & G_LOG_LEVEL_ERROR) != 0) {
-		message->level = PURPLE_DEBUG_ERROR;
+		level = PURPLE_DEBUG_ERROR;
 	} else if((log_level & G_LOG_LEVEL_CRITICAL) != 0) {
-		message->level = PURPLE_DEBUG_FATAL;
+		level = PURPLE_DEBUG_FATAL;
 	} else if((log_level & G_LOG_LEVEL_WARNING) != 0) {
-		message->level = PURPLE_DEBUG_WARNING;
+		level = PURPLE_DEBUG_WARNING;
 	} else if((log_level & G_LOG_LEVEL_MESSAGE) != 0) {
-		message->level = PURPLE_DEBUG_INFO;
+		level = PURPLE_DEBUG_INFO;
 	} else if((log_level & G_LOG_LEVEL_INFO) != 0) {
-		message->level = PURPLE_DEBUG_INFO;
+		level = PURPLE_DEBUG_INFO;
 	} else if((log_level & G_LOG_LEVEL_DEBUG) != 0) {
-		message->level = PURPLE_DEBUG_MISC;
+		level = PURPLE_DEBUG_MISC;
 	} else {
-		message->level = PURPLE_DEBUG_MISC;
+		level = PURPLE_DEBUG_MISC;
 	}
 
-	g_timeout_add(0, pidgin_debug_g_log_handler_cb, message);
+	/* Only the first message of a batch schedules the flush. */
+	if (message != NULL &&
+			purple_debug_ring_push(ring, level, domain, message)) {
+		g_timeout_add(PIDGIN_DEBUG_FLUSH_INTERVAL, pidgin_debug_flush_cb, NULL);
+	}
 
 	if (debug_print_enabled) {
 		return g_log_writer_default(log_level, fields, n_fields, user_data);
@@ -862,6 +886,13 @@ pidgin_debug_window_show(void)
 				g_object_new(PIDGIN_TYPE_DEBUG_WINDOW, NULL));
 
 		gtk_window_set_transient_for(GTK_WINDOW(debug_win), parent);
+
+		/* Don't replay whatever was left over from the last window. */
+		purple_debug_ring_set_capacity(debug_ring,
+		                               pidgin_debug_get_max_lines());
+		purple_debug_ring_clear(debug_ring);
+
+		pidgin_debug_update_enabled();
 	}
 
 	gtk_window_present_with_time(GTK_WINDOW(debug_win), GDK_CURRENT_TIME);
@@ -880,6 +911,11 @@ pidgin_debug_window_hide(void)
 void
 pidgin_debug_init_handler(void)
 {
+	/* This is called before the preferences are loaded, so the ring is sized
+	 * when the window is shown.
+	 */
+	debug_ring = purple_debug_ring_new(PIDGIN_DEBUG_DEFAULT_MAX_LINES);
+
 	g_log_set_writer_func(pidgin_debug_g_log_handler, NULL, NULL);
 }
 
@@ -887,6 +923,7 @@ void
 pidgin_debug_set_print_enabled(gboolean enable)
 {
 	debug_print_enabled = enable;
+	pidgin_debug_update_enabled();
 }
 
 void
@@ -907,6 +944,9 @@ pidgin_debug_init(void)
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/filterlevel",
 	                     PURPLE_DEBUG_ALL);
 
+	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/max_lines",
+	                     PIDGIN_DEBUG_DEFAULT_MAX_LINES);
+
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/width",  450);
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/height", 250);
 
@@ -926,6 +966,12 @@ pidgin_debug_uninit(void)
 {
 	g_clear_handle_id(&pref_callback_id, purple_prefs_disconnect_callback);
 	g_clear_handle_id(&debug_enabled_timer, g_source_remove);
+
+	/* GLib doesn't let us remove the log writer, so take the ring away from
+	 * it before freeing it.
+	 */
+	purple_debug_ring_free(g_atomic_pointer_exchange(&debug_ring, NULL));
+	debug_ring_cursor = 0;
 }
 
 void *
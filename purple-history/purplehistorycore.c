@@ -34,22 +34,32 @@
 static gboolean
 purple_history_query(const gchar *query, GError **error) {
 	PurpleHistoryManager *manager = purple_history_manager_get_default();
-	GList *results = NULL;
-
-	results = purple_history_manager_query(manager, query, error);
-
-	if(error != NULL) {
+	PurpleHistoryCursor *cursor = NULL;
+	PurpleMessage *message = NULL;
+	GError *local_error = NULL;
+
+	/* Use a cursor so that messages are printed as they're loaded instead of
+	 * loading every result into memory first.
+	 */
+	cursor = purple_history_manager_query_cursor(manager, query, NULL, 0,
+	                                             error);
+	if(cursor == NULL) {
 		return FALSE;
 	}
 
-	while(results != NULL) {
-		PurpleMessage *message = PURPLE_MESSAGE(results->data);
-
+	while((message = purple_history_cursor_next(cursor, &local_error)) != NULL) {
 		g_printf("%s: %s\n", purple_message_get_author(message),
 		         purple_message_get_contents(message));
 
 		g_clear_object(&message);
-		results = g_list_delete_link(results, results);
+	}
+
+	g_clear_object(&cursor);
+
+	if(local_error != NULL) {
+		g_propagate_error(error, local_error);
+
+		return FALSE;
 	}
 
 	return TRUE;